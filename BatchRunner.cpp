@@ -0,0 +1,265 @@
+#include "BatchRunner.h"
+#include "FrameDumper.h"
+
+#include <algorithm>
+#include <iomanip>
+
+BatchRunner::BatchRunner(FileLogger* logger)
+{
+	this->logger = logger;
+}
+
+bool BatchRunner::LoadManifest(std::string path)
+{
+	std::ifstream manifest(path);
+
+	if (!manifest)
+	{
+		logger->Log<LOG_ERROR>("Unable to open batch manifest: " + path);
+		return false;
+	}
+
+	std::string line;
+	unsigned int line_number = 0;
+
+	while (std::getline(manifest, line))
+	{
+		++line_number;
+
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream ss(line);
+		BatchJob job;
+
+		if (!(ss >> job.rom_path))
+			continue;
+
+		if (!(ss >> job.input_path >> job.frames))
+		{
+			logger->Log<LOG_ERROR>("Malformed manifest line " + std::to_string(line_number));
+			return false;
+		}
+
+		if (!roms.contains(job.rom_path))
+		{
+			std::ifstream rom(job.rom_path, std::ios::in | std::ios::binary);
+
+			if (!rom)
+			{
+				logger->Log<LOG_ERROR>("Unable to open rom: " + job.rom_path);
+				return false;
+			}
+
+			roms[job.rom_path] = std::vector<unsigned char>(std::istreambuf_iterator<char>(rom), {});
+		}
+
+		if (job.input_path != "-" && !inputs.contains(job.input_path))
+		{
+			if (!ParseInputScript(job.input_path, inputs[job.input_path]))
+			{
+				logger->Log<LOG_ERROR>("Unable to parse input script: " + job.input_path);
+				return false;
+			}
+		}
+
+		jobs.push_back(job);
+	}
+
+	// Map nodes are stable, so the jobs can keep pointers into them
+	for (auto& job : jobs)
+	{
+		job.rom = &roms[job.rom_path];
+		job.input = job.input_path == "-" ? nullptr : &inputs[job.input_path];
+	}
+
+	return true;
+}
+
+bool BatchRunner::ParseButtons(std::string text, unsigned char& buttons)
+{
+	static const std::map<std::string, unsigned char> names =
+	{
+		{ "RIGHT", 1 << Joypad_Right }, { "LEFT", 1 << Joypad_Left }, { "UP", 1 << Joypad_Up }, { "DOWN", 1 << Joypad_Down },
+		{ "A", 1 << Joypad_A }, { "B", 1 << Joypad_B }, { "SELECT", 1 << Joypad_Select }, { "START", 1 << Joypad_Start },
+		{ "NONE", 0 }
+	};
+
+	buttons = 0;
+
+	if (text.starts_with("0x"))
+	{
+		buttons = static_cast<unsigned char>(std::stoul(text, nullptr, 16));
+		return true;
+	}
+
+	std::istringstream ss(text);
+	std::string name;
+
+	while (std::getline(ss, name, '+'))
+	{
+		std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+
+		auto button = names.find(name);
+
+		if (button == names.end())
+			return false;
+
+		buttons |= button->second;
+	}
+
+	return true;
+}
+
+bool BatchRunner::ParseInputScript(std::string path, std::vector<InputEvent>& events)
+{
+	std::ifstream script(path);
+
+	if (!script)
+		return false;
+
+	std::string line;
+
+	while (std::getline(script, line))
+	{
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream ss(line);
+		InputEvent event;
+		std::string buttons;
+
+		if (!(ss >> event.frame))
+			continue;
+
+		if (!(ss >> buttons) || !ParseButtons(buttons, event.buttons))
+			return false;
+
+		events.push_back(event);
+	}
+
+	std::stable_sort(events.begin(), events.end(), [](const InputEvent& a, const InputEvent& b) { return a.frame < b.frame; });
+
+	return true;
+}
+
+void BatchRunner::SetFrameDumper(FrameDumper* dumper, std::string directory)
+{
+	this->dumper = dumper;
+	dump_directory = directory;
+}
+
+double BatchRunner::Run(unsigned int thread_count, bool keep_frame_hashes)
+{
+	results.assign(jobs.size(), BatchResult{});
+
+	auto start = std::chrono::steady_clock::now();
+
+	{
+		ThreadPool pool(thread_count);
+
+		for (size_t i = 0; i < jobs.size(); ++i)
+			pool.Submit([this, i, keep_frame_hashes] { RunJob(i, keep_frame_hashes); });
+
+		pool.Wait();
+	}
+
+	// Frames still being encoded belong to this batch
+	if (dumper != nullptr)
+		dumper->Flush();
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BatchRunner::RunJob(size_t index, bool keep_frame_hashes)
+{
+	const BatchJob& job = jobs[index];
+	BatchResult& result = results[index];
+
+	auto start = std::chrono::steady_clock::now();
+
+	System* system = new System(logger);
+
+	// Dumped frames need the PPU to draw, everything else only needs state
+	system->SetRenderingEnabled(dumper != nullptr);
+	system->LoadRom(job.rom->data(), job.rom->size());
+
+	size_t next_event = 0;
+	std::string dump_prefix = dump_directory + "/" + std::to_string(index) + "_";
+
+	if (keep_frame_hashes)
+		result.frame_hashes.reserve(job.frames);
+
+	for (unsigned int frame = 0; frame < job.frames && system->IsRunning(); ++frame)
+	{
+		while (job.input && next_event < job.input->size() && (*job.input)[next_event].frame <= frame)
+			system->SetJoypad((*job.input)[next_event++].buttons);
+
+		system->RunFrame();
+
+		if (dumper != nullptr)
+			dumper->PushFrame(system->GetFramebuffer(), frame, dump_prefix);
+
+		++result.frames_run;
+
+		if (keep_frame_hashes)
+			result.frame_hashes.push_back(system->GetStateHash());
+	}
+
+	result.completed = result.frames_run == job.frames;
+	result.final_hash = system->GetStateHash();
+
+	delete system;
+
+	result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool BatchRunner::WriteResults(std::string path)
+{
+	std::ofstream output(path, std::ios::out | std::ios::trunc);
+
+	if (!output)
+		return false;
+
+	output << "# job rom input frames_run completed final_hash milliseconds\n";
+
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		output << i << " " << jobs[i].rom_path << " " << jobs[i].input_path << " " << results[i].frames_run << " "
+			<< results[i].completed << " " << std::hex << std::setfill('0') << std::setw(16) << results[i].final_hash << std::dec
+			<< " " << std::fixed << std::setprecision(3) << results[i].milliseconds << "\n";
+	}
+
+	return true;
+}
+
+bool BatchRunner::WriteFrameHashes(std::string path)
+{
+	std::ofstream output(path, std::ios::out | std::ios::trunc);
+
+	if (!output)
+		return false;
+
+	output << "# job frame hash\n" << std::hex << std::setfill('0');
+
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		for (size_t frame = 0; frame < results[i].frame_hashes.size(); ++frame)
+			output << std::dec << i << " " << frame << " " << std::hex << std::setw(16) << results[i].frame_hashes[frame] << "\n";
+	}
+
+	return true;
+}
+
+unsigned long long BatchRunner::GetTotalFrames()
+{
+	unsigned long long frames = 0;
+
+	for (auto& result : results)
+		frames += result.frames_run;
+
+	return frames;
+}
+
+size_t BatchRunner::GetJobCount()
+{
+	return jobs.size();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+#include "System.h"
+#include "ThreadPool.h"
+
+class FrameDumper;
+
+// Joypad state that takes effect from a given frame on
+struct InputEvent
+{
+	unsigned int frame{};
+	unsigned char buttons{};
+};
+
+struct BatchJob
+{
+	std::string rom_path;
+	std::string input_path;
+	unsigned int frames{};
+
+	const std::vector<unsigned char>* rom{};
+	const std::vector<InputEvent>* input{};
+};
+
+struct BatchResult
+{
+	bool completed = false;
+	unsigned int frames_run{};
+	unsigned long long final_hash{};
+	std::vector<unsigned long long> frame_hashes;
+	double milliseconds{};
+};
+
+// Runs many short headless sessions, one System per job, on a thread pool.
+//
+// Manifest lines are "<rom> <input script|-> <frames>", '#' starts a comment.
+// Input script lines are "<frame> <buttons>" where buttons is a hex mask of
+// JoypadButtons bits or names joined by '+' (RIGHT+A, START, NONE).
+class BatchRunner
+{
+public:
+	BatchRunner(FileLogger* logger);
+
+	bool LoadManifest(std::string path);
+
+	// Returns the wall clock time of the whole batch in seconds
+	double Run(unsigned int thread_count, bool keep_frame_hashes);
+
+	// Job frames are dumped as <directory>/<job>_<frame>.png through the
+	// dumper, which must outlive Run. Pass nullptr to stop dumping.
+	void SetFrameDumper(FrameDumper* dumper, std::string directory);
+
+	bool WriteResults(std::string path);
+	bool WriteFrameHashes(std::string path);
+
+	unsigned long long GetTotalFrames();
+	size_t GetJobCount();
+
+	static bool ParseInputScript(std::string path, std::vector<InputEvent>& events);
+	static bool ParseButtons(std::string text, unsigned char& buttons);
+
+private:
+	void RunJob(size_t index, bool keep_frame_hashes);
+
+	std::vector<BatchJob> jobs;
+	std::vector<BatchResult> results;
+
+	// Loaded once and shared read-only by all jobs
+	std::map<std::string, std::vector<unsigned char>> roms;
+	std::map<std::string, std::vector<InputEvent>> inputs;
+
+	FrameDumper* dumper{};
+	std::string dump_directory;
+
+	FileLogger* logger;
+};
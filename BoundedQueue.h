@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+
+// Fixed-size multi-producer single-consumer queue (Vyukov's bounded queue).
+// Every slot carries a sequence number telling producers it is free for their
+// position and the consumer it has been filled, so neither side takes a lock.
+// Push fails instead of waiting when the queue is full.
+//
+// Elements are filled and drained in place through a callback, which avoids
+// copying large slots twice. Size must be a power of two.
+template<typename T, unsigned int Size>
+class BoundedQueue
+{
+public:
+	static_assert((Size & (Size - 1)) == 0, "BoundedQueue size must be a power of two");
+
+	BoundedQueue()
+	{
+		slots = new Slot[Size];
+
+		for (unsigned int i = 0; i < Size; ++i)
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	~BoundedQueue()
+	{
+		delete[] slots;
+	}
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	template<typename Fill>
+	bool Push(Fill&& fill)
+	{
+		unsigned int position = enqueue_position.load(std::memory_order_relaxed);
+		Slot* slot;
+
+		while (true)
+		{
+			slot = &slots[position % Size];
+
+			// Positions wrap, compare through the signed difference
+			int difference = static_cast<int>(slot->sequence.load(std::memory_order_acquire) - position);
+
+			if (difference == 0)
+			{
+				if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (difference < 0)
+				return false;
+			else
+				position = enqueue_position.load(std::memory_order_relaxed);
+		}
+
+		fill(slot->value);
+
+		slot->sequence.store(position + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	// Consumer only
+	template<typename Drain>
+	bool Pop(Drain&& drain)
+	{
+		Slot& slot = slots[dequeue_position % Size];
+
+		if (slot.sequence.load(std::memory_order_acquire) != dequeue_position + 1)
+			return false;
+
+		drain(slot.value);
+
+		slot.sequence.store(dequeue_position + Size, std::memory_order_release);
+		++dequeue_position;
+
+		return true;
+	}
+
+	// Number of pushes claimed so far, wrapping
+	unsigned int GetEnqueuePosition()
+	{
+		return enqueue_position.load(std::memory_order_acquire);
+	}
+	// Consumer only, number of pops so far, wrapping
+	unsigned int GetDequeuePosition()
+	{
+		return dequeue_position;
+	}
+
+private:
+	struct Slot
+	{
+		std::atomic<unsigned int> sequence{};
+		T value{};
+	};
+
+	Slot* slots{};
+	std::atomic<unsigned int> enqueue_position{};
+	unsigned int dequeue_position{};
+};
@@ -1,85 +1,328 @@
 #include "Debug.h"
 
+#include <cstdlib>
+
+static constexpr const char* help_text =
+	"p: Pause, c: Continue, s: Step, r: Registers\n"
+	"m <addr> [bytes]: Memory, l [addr] [count]: List code\n"
+	"b/d <addr>: Set/delete breakpoint, w/u <addr>: Set/delete write watchpoint\n"
+	"Addresses are hex or labels, counts decimal\n";
+
 Debug::Debug(System* system)
+	: disassembler(system)
 {
 	this->system = system;
 
-	this->breakpoints = { 0xc3 };
+	commands = std::make_shared<CommandQueue>();
+
+	input_thread = std::thread(&Debug::InputLoop, commands);
+	output_thread = std::thread(&Debug::OutputLoop, this);
+}
+
+Debug::~Debug()
+{
+	stopping.store(true, std::memory_order_release);
+	output_thread.join();
+
+	// Blocked reading the terminal, ends with the process
+	input_thread.detach();
+}
+
+bool Debug::LoadSymbols(std::string path)
+{
+	return disassembler.LoadSymbols(path);
 }
-//Debug::Debug(System* system, unsigned char* breakpoints)
-//	: breakpoints(*breakpoints, *breakpoints + sizeof(*breakpoints) / sizeof(breakpoints[0]))
-//{
-//	this->system = system;
-//
-//	for (auto i = this->breakpoints.begin(); i != this->breakpoints.end(); ++i)
-//	{
-//		std::cout << *i << " ";
-//	}
-//}
 
 void Debug::Step()
 {
-	next_opcode = system->GetNextOpcode();
+	while (commands->Pop([&](Command& command) { Execute(command); }));
 
-	switch (current_mode)
-	{
-	case Mode::Wait:
+	bool stopped = system->GetStopReason() != Stop_None;
+
+	if (stopped && !stop_reported)
+		PrintStop();
+
+	stop_reported = stopped;
+}
+
+void Debug::InputLoop(std::shared_ptr<CommandQueue> commands)
+{
+	std::string line;
+
+	while (std::getline(std::cin, line))
 	{
-		if (breakpoints.contains(next_opcode))
-		{
-			ProcessInput();
-		}
+		Command command = ParseCommand(line);
 
-		break;
+		if (command.type == Command_Invalid && line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+
+		// The emulation thread drains the queue every frame, it only fills up
+		// if commands are pasted faster than that
+		while (!commands->Push([&](Command& entry) { entry = command; }))
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
 	}
-	case Mode::Step:
-	{
-		ProcessInput();
+}
+
+Debug::Command Debug::ParseCommand(const std::string& line)
+{
+	std::istringstream stream(line);
+	std::string name;
+	std::string argument;
+	std::string count;
+
+	Command command;
 
+	if (!(stream >> name))
+		return command;
+
+	stream >> argument >> count;
+
+	switch (name[0])
+	{
+	case 'h':
+		command.type = Command_Help;
+		break;
+	case 'p':
+		command.type = Command_Pause;
+		break;
+	case 'c':
+		command.type = Command_Continue;
+		break;
+	case 's':
+		command.type = Command_Step;
+		break;
+	case 'r':
+		command.type = Command_Registers;
+		break;
+	case 'm':
+		command.type = Command_Memory;
+		command.count = 64;
+		break;
+	case 'l':
+		command.type = Command_List;
+		command.count = 10;
+		break;
+	case 'b':
+		command.type = Command_Break;
+		break;
+	case 'd':
+		command.type = Command_Delete;
+		break;
+	case 'w':
+		command.type = Command_Watch;
+		break;
+	case 'u':
+		command.type = Command_Unwatch;
 		break;
-	}
 	default:
-		return;
+		return command;
+	}
+
+	if (argument.size() >= max_argument_length)
+	{
+		command.type = Command_Invalid;
+		return command;
 	}
+
+	std::copy(argument.begin(), argument.end(), command.argument);
+
+	if (!count.empty())
+		command.count = std::strtoul(count.c_str(), nullptr, 10);
+
+	return command;
 }
 
-void Debug::ProcessInput()
+void Debug::OutputLoop()
 {
-	// std::cout << RegistersToString();
-	std::cout << "\nOpcode to be executed: 0x" << std::setfill('0') << std::hex << std::setw(2) << std::right << (int)next_opcode << "\n";
-	std::cout << "r: Print registers, s: Step one instruction, c: Continue to next breakpoint:\n";
+	std::string batch;
 
-	char input;
+	while (true)
+	{
+		bool stop = stopping.load(std::memory_order_acquire);
+
+		while (output.Pop([&](Output& entry) { batch.append(entry.text, entry.length); }));
+
+		if (!batch.empty())
+		{
+			std::cout << batch << std::flush;
+			batch.clear();
+		}
+		else if (stop)
+			break;
+		else
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+}
 
-	std::cin >> input;
+void Debug::Execute(const Command& command)
+{
+	unsigned short address = system->GetPC();
+	bool has_address = command.argument[0] != '\0';
 
-	switch (input)
+	if (has_address && !ResolveAddress(command.argument, address))
 	{
-	case 'regs':
+		Print("Invalid address.\n");
+		return;
+	}
+
+	bool stopped = system->GetStopReason() != Stop_None;
+
+	switch (command.type)
 	{
-		std::cout << RegistersToString() << "\n";
+	case Command_Help:
+		Print(help_text);
+		break;
+	case Command_Pause:
+		system->Stop();
+		break;
+	case Command_Continue:
+		if (stopped)
+			system->Resume();
+		break;
+	case Command_Step:
+		// Pauses a running CPU, steps a stopped one
+		if (stopped)
+			system->Resume(true);
+		else
+			system->Stop();
+		break;
+	case Command_Registers:
+		Print(RegistersToString());
+		break;
+	case Command_Memory:
+		PrintMemory(address, command.count);
+		break;
+	case Command_List:
+		PrintDisassembly(address, command.count);
+		break;
+	case Command_Break:
+	case Command_Delete:
+	case Command_Watch:
+	case Command_Unwatch:
+		if (!has_address)
+		{
+			Print("Missing address.\n");
+			break;
+		}
 
+		if (command.type == Command_Break)
+			system->AddBreakpoint(address);
+		else if (command.type == Command_Delete)
+			system->RemoveBreakpoint(address);
+		else if (command.type == Command_Watch)
+			system->AddWatchpoint(address, 1, Watch_Write);
+		else
+			system->RemoveWatchpoint(address, 1, Watch_Write);
+		break;
+	default:
+		Print("Invalid input, h for help.\n");
 		break;
 	}
-	case 'step':
+}
+
+void Debug::Print(std::string_view text)
+{
+	while (!text.empty())
 	{
-		current_mode = Mode::Step;
+		size_t length = text.size() < max_output_length ? text.size() : max_output_length;
 
+		// Nobody reads the console, the rest is lost rather than waited for
+		if (!output.Push([&](Output& entry)
+		{
+			entry.length = static_cast<unsigned int>(length);
+			std::copy(text.begin(), text.begin() + length, entry.text);
+		}))
+			return;
+
+		text.remove_prefix(length);
+	}
+}
+
+void Debug::PrintStop()
+{
+	std::ostringstream ss;
+	ss << std::setfill('0') << std::hex << std::uppercase << std::right;
+
+	switch (system->GetStopReason())
+	{
+	case Stop_Breakpoint:
+		ss << "\nBreakpoint at $" << std::setw(4) << system->GetPC() << "\n";
+		break;
+	case Stop_Watchpoint:
+		ss << "\n" << (system->GetWatchType() == Watch_Write ? "Write to" : "Read from") << " $" << std::setw(4) << system->GetWatchAddress() << "\n";
+		break;
+	default:
 		break;
 	}
-	case 'continue':
+
+	Print(ss.str());
+	PrintDisassembly(system->GetPC(), 1);
+}
+
+void Debug::PrintDisassembly(unsigned short address, unsigned int count)
+{
+	std::ostringstream ss;
+	ss << std::uppercase << std::setfill('0') << std::hex << std::right;
+
+	for (unsigned int i = 0; i < count; ++i)
 	{
-		current_mode = Mode::Wait;
+		const Disassembler::Line& line = disassembler.Disassemble(address);
+		const char* label = disassembler.GetSymbols().Find(line.bank, address);
 
-		break;
+		if (label != nullptr)
+			ss << label << ":\n";
+
+		ss << std::setw(2) << line.bank << ":" << std::setw(4) << address << "  " << line.text << "\n";
+
+		address = static_cast<unsigned short>(address + line.length);
 	}
-	default:
-		std::cout << "Invalid input.\n";
 
-		ProcessInput();
+	Print(ss.str());
+}
 
-		break;
+void Debug::PrintMemory(unsigned short address, unsigned int length)
+{
+	// A screenful at most
+	if (length > 0x400)
+		length = 0x400;
+
+	std::ostringstream ss;
+	ss << std::uppercase << std::setfill('0') << std::hex << std::right;
+
+	unsigned char bytes[16];
+
+	for (unsigned int offset = 0; offset < length; offset += 16)
+	{
+		unsigned int row = length - offset < 16 ? length - offset : 16;
+		unsigned short row_address = static_cast<unsigned short>(address + offset);
+
+		system->ReadMemoryBlock(row_address, row, bytes);
+
+		ss << std::setw(4) << row_address << " ";
+
+		for (unsigned int i = 0; i < row; ++i)
+			ss << " " << std::setw(2) << static_cast<int>(bytes[i]);
+
+		ss << "\n";
 	}
+
+	Print(ss.str());
+}
+
+// A hex address or a label from the symbol file
+bool Debug::ResolveAddress(const char* text, unsigned short& address)
+{
+	unsigned short bank;
+
+	if (disassembler.GetSymbols().FindAddress(text, bank, address))
+		return true;
+
+	char* end;
+	unsigned long value = std::strtoul(text, &end, 16);
+
+	address = static_cast<unsigned short>(value);
+
+	return *end == '\0' && value <= 0xFFFF;
 }
 
 std::string Debug::RegistersToString()
@@ -99,7 +342,7 @@ std::string Debug::RegistersToString()
 	short h = regs.f >> 5 & 1;
 	short c = regs.f >> 4 & 1;
 
-	ss << std::hex << "Z: " << z << " N: " << z << " H: " << z << " C: " << z << "\n";
+	ss << std::hex << "Z: " << z << " N: " << n << " H: " << h << " C: " << c << "\n";
 
 	return ss.str();
 }
\ No newline at end of file
@@ -1,34 +1,99 @@
 #pragma once
 
-#include <initializer_list>
+#include <atomic>
 #include <iostream>
 #include <iomanip>
+#include <memory>
 #include <sstream>
-#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
 
+#include "BoundedQueue.h"
+#include "Disassembler.h"
 #include "System.h"
 
+// Console debugger. A console thread reads and parses the commands and passes
+// them to the emulation thread through a lock-free queue; Step runs them
+// between frames and queues the replies for an output thread to print. The
+// emulation thread never waits on the terminal, with nothing typed Step costs
+// a look at an empty queue.
+//
+// Breakpoints and watchpoints live in System, the CPU stops at them on an
+// instruction boundary and the stop is reported at the next Step.
 class Debug
 {
 public:
+	static constexpr unsigned int command_queue_size = 64;
+	static constexpr unsigned int output_queue_size = 512;
+	static constexpr unsigned int max_argument_length = 64;
+	static constexpr unsigned int max_output_length = 248;
+
 	Debug(System* system);
-	// Debug(System* system, unsigned char* breakpoints);
+	~Debug();
+
+	// Called by the emulation thread between frames, never blocks
 	void Step();
 
-	enum class Mode
+	// Labels for the disassembly and for breakpoints given by name
+	bool LoadSymbols(std::string path);
+
+private:
+	enum CommandType
 	{
-		Step,
-		Wait
+		Command_Help,
+		Command_Pause,
+		Command_Continue,
+		Command_Step,
+		Command_Registers,
+		Command_Memory,
+		Command_List,
+		Command_Break,
+		Command_Delete,
+		Command_Watch,
+		Command_Unwatch,
+		Command_Invalid
 	};
 
-private:
-	void ProcessInput();
+	struct Command
+	{
+		CommandType type = Command_Invalid;
+		// Address or label, empty when not given
+		char argument[max_argument_length]{};
+		unsigned int count{};
+	};
+
+	struct Output
+	{
+		unsigned int length{};
+		char text[max_output_length];
+	};
+
+	using CommandQueue = BoundedQueue<Command, command_queue_size>;
+
+	// Console thread, holds its own reference to the queue so it can outlive
+	// the Debug while blocked reading the terminal at shutdown
+	static void InputLoop(std::shared_ptr<CommandQueue> commands);
+	static Command ParseCommand(const std::string& line);
+	void OutputLoop();
+
+	void Execute(const Command& command);
+	void Print(std::string_view text);
+	void PrintStop();
+	void PrintDisassembly(unsigned short address, unsigned int count);
+	void PrintMemory(unsigned short address, unsigned int length);
+	bool ResolveAddress(const char* text, unsigned short& address);
 	std::string RegistersToString();
 
 	System* system;
+	Disassembler disassembler;
 
-	Mode current_mode = Mode::Wait;
-	unsigned char next_opcode{};
-	std::set<unsigned char> breakpoints{};
-};
+	std::shared_ptr<CommandQueue> commands;
+	BoundedQueue<Output, output_queue_size> output;
+	std::atomic<bool> stopping = false;
+	std::thread input_thread;
+	std::thread output_thread;
 
+	// The current stop has been printed
+	bool stop_reported = false;
+};
\ No newline at end of file
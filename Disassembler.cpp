@@ -0,0 +1,434 @@
+#include "Disassembler.h"
+
+#include <array>
+
+// Operands are written into the mnemonics as tokens, which the tables below
+// turn into instruction lengths and operand positions at compile time
+enum OperandType : unsigned char
+{
+	Operand_None,
+	// Immediate byte and word
+	Operand_D8,
+	Operand_D16,
+	// Address 0xFF00 + byte, word address
+	Operand_A8,
+	Operand_A16,
+	// Jump relative to the next instruction, signed byte added to SP
+	Operand_R8,
+	Operand_E8
+};
+
+struct OpcodeInfo
+{
+	// nullptr for the opcodes the CPU does not define
+	const char* text{};
+	unsigned char length = 1;
+	OperandType operand = Operand_None;
+	// Operand token within text
+	unsigned char operand_position{};
+	unsigned char operand_length{};
+};
+
+static constexpr const char* opcode_mnemonics[256] =
+{
+	// 0x00
+	"NOP", "LD BC,d16", "LD (BC),A", "INC BC",
+	"INC B", "DEC B", "LD B,d8", "RLCA",
+	"LD (a16),SP", "ADD HL,BC", "LD A,(BC)", "DEC BC",
+	"INC C", "DEC C", "LD C,d8", "RRCA",
+	// 0x10
+	"STOP d8", "LD DE,d16", "LD (DE),A", "INC DE",
+	"INC D", "DEC D", "LD D,d8", "RLA",
+	"JR r8", "ADD HL,DE", "LD A,(DE)", "DEC DE",
+	"INC E", "DEC E", "LD E,d8", "RRA",
+	// 0x20
+	"JR NZ,r8", "LD HL,d16", "LD (HL+),A", "INC HL",
+	"INC H", "DEC H", "LD H,d8", "DAA",
+	"JR Z,r8", "ADD HL,HL", "LD A,(HL+)", "DEC HL",
+	"INC L", "DEC L", "LD L,d8", "CPL",
+	// 0x30
+	"JR NC,r8", "LD SP,d16", "LD (HL-),A", "INC SP",
+	"INC (HL)", "DEC (HL)", "LD (HL),d8", "SCF",
+	"JR C,r8", "ADD HL,SP", "LD A,(HL-)", "DEC SP",
+	"INC A", "DEC A", "LD A,d8", "CCF",
+	// 0x40
+	"LD B,B", "LD B,C", "LD B,D", "LD B,E",
+	"LD B,H", "LD B,L", "LD B,(HL)", "LD B,A",
+	"LD C,B", "LD C,C", "LD C,D", "LD C,E",
+	"LD C,H", "LD C,L", "LD C,(HL)", "LD C,A",
+	// 0x50
+	"LD D,B", "LD D,C", "LD D,D", "LD D,E",
+	"LD D,H", "LD D,L", "LD D,(HL)", "LD D,A",
+	"LD E,B", "LD E,C", "LD E,D", "LD E,E",
+	"LD E,H", "LD E,L", "LD E,(HL)", "LD E,A",
+	// 0x60
+	"LD H,B", "LD H,C", "LD H,D", "LD H,E",
+	"LD H,H", "LD H,L", "LD H,(HL)", "LD H,A",
+	"LD L,B", "LD L,C", "LD L,D", "LD L,E",
+	"LD L,H", "LD L,L", "LD L,(HL)", "LD L,A",
+	// 0x70
+	"LD (HL),B", "LD (HL),C", "LD (HL),D", "LD (HL),E",
+	"LD (HL),H", "LD (HL),L", "HALT", "LD (HL),A",
+	"LD A,B", "LD A,C", "LD A,D", "LD A,E",
+	"LD A,H", "LD A,L", "LD A,(HL)", "LD A,A",
+	// 0x80
+	"ADD A,B", "ADD A,C", "ADD A,D", "ADD A,E",
+	"ADD A,H", "ADD A,L", "ADD A,(HL)", "ADD A,A",
+	"ADC A,B", "ADC A,C", "ADC A,D", "ADC A,E",
+	"ADC A,H", "ADC A,L", "ADC A,(HL)", "ADC A,A",
+	// 0x90
+	"SUB B", "SUB C", "SUB D", "SUB E",
+	"SUB H", "SUB L", "SUB (HL)", "SUB A",
+	"SBC A,B", "SBC A,C", "SBC A,D", "SBC A,E",
+	"SBC A,H", "SBC A,L", "SBC A,(HL)", "SBC A,A",
+	// 0xA0
+	"AND B", "AND C", "AND D", "AND E",
+	"AND H", "AND L", "AND (HL)", "AND A",
+	"XOR B", "XOR C", "XOR D", "XOR E",
+	"XOR H", "XOR L", "XOR (HL)", "XOR A",
+	// 0xB0
+	"OR B", "OR C", "OR D", "OR E",
+	"OR H", "OR L", "OR (HL)", "OR A",
+	"CP B", "CP C", "CP D", "CP E",
+	"CP H", "CP L", "CP (HL)", "CP A",
+	// 0xC0
+	"RET NZ", "POP BC", "JP NZ,a16", "JP a16",
+	"CALL NZ,a16", "PUSH BC", "ADD A,d8", "RST $00",
+	"RET Z", "RET", "JP Z,a16", "PREFIX CB",
+	"CALL Z,a16", "CALL a16", "ADC A,d8", "RST $08",
+	// 0xD0
+	"RET NC", "POP DE", "JP NC,a16", nullptr,
+	"CALL NC,a16", "PUSH DE", "SUB d8", "RST $10",
+	"RET C", "RETI", "JP C,a16", nullptr,
+	"CALL C,a16", nullptr, "SBC A,d8", "RST $18",
+	// 0xE0
+	"LDH (a8),A", "POP HL", "LD (C),A", nullptr,
+	nullptr, "PUSH HL", "AND d8", "RST $20",
+	"ADD SP,e8", "JP HL", "LD (a16),A", nullptr,
+	nullptr, nullptr, "XOR d8", "RST $28",
+	// 0xF0
+	"LDH A,(a8)", "POP AF", "LD A,(C)", "DI",
+	nullptr, "PUSH AF", "OR d8", "RST $30",
+	"LD HL,SP+e8", "LD SP,HL", "LD A,(a16)", "EI",
+	nullptr, nullptr, "CP d8", "RST $38",
+};
+
+static constexpr OpcodeInfo MakeOpcodeInfo(const char* text)
+{
+	struct Token
+	{
+		const char* name;
+		unsigned char name_length;
+		OperandType operand;
+		unsigned char length;
+	};
+
+	constexpr Token tokens[] =
+	{
+		{ "d16", 3, Operand_D16, 3 },
+		{ "a16", 3, Operand_A16, 3 },
+		{ "d8", 2, Operand_D8, 2 },
+		{ "a8", 2, Operand_A8, 2 },
+		{ "r8", 2, Operand_R8, 2 },
+		{ "e8", 2, Operand_E8, 2 },
+	};
+
+	OpcodeInfo info;
+	info.text = text;
+
+	if (text == nullptr)
+		return info;
+
+	for (unsigned char position = 0; text[position] != '\0'; ++position)
+	{
+		for (const Token& token : tokens)
+		{
+			bool match = true;
+
+			for (unsigned char i = 0; i < token.name_length && match; ++i)
+				match = text[position + i] == token.name[i];
+
+			if (match)
+			{
+				info.operand = token.operand;
+				info.length = token.length;
+				info.operand_position = position;
+				info.operand_length = token.name_length;
+
+				return info;
+			}
+		}
+	}
+
+	return info;
+}
+
+static constexpr std::array<OpcodeInfo, 256> MakeOpcodeTable()
+{
+	std::array<OpcodeInfo, 256> table{};
+
+	for (int opcode = 0; opcode < 256; ++opcode)
+		table[opcode] = MakeOpcodeInfo(opcode_mnemonics[opcode]);
+
+	return table;
+}
+
+static constexpr std::array<OpcodeInfo, 256> opcode_table = MakeOpcodeTable();
+
+static_assert(opcode_table[0x01].length == 3 && opcode_table[0x18].operand == Operand_R8 && opcode_table[0xE0].operand == Operand_A8, "Opcode table tokens");
+
+// CB prefixed opcodes follow a regular pattern: operation in bits 3-7,
+// register in bits 0-2
+struct ExtendedMnemonic
+{
+	char text[12]{};
+};
+
+static constexpr std::array<ExtendedMnemonic, 256> MakeExtendedTable()
+{
+	constexpr const char* shifts[8] = { "RLC ", "RRC ", "RL ", "RR ", "SLA ", "SRA ", "SWAP ", "SRL " };
+	constexpr const char* bit_operations[3] = { "BIT ", "RES ", "SET " };
+	constexpr const char* registers[8] = { "B", "C", "D", "E", "H", "L", "(HL)", "A" };
+
+	std::array<ExtendedMnemonic, 256> table{};
+
+	for (int opcode = 0; opcode < 256; ++opcode)
+	{
+		char* output = table[opcode].text;
+
+		auto append = [&](const char* text)
+		{
+			while (*text != '\0')
+				*output++ = *text++;
+		};
+
+		if (opcode < 0x40)
+			append(shifts[opcode >> 3]);
+		else
+		{
+			append(bit_operations[(opcode >> 6) - 1]);
+			*output++ = static_cast<char>('0' + ((opcode >> 3) & 7));
+			*output++ = ',';
+		}
+
+		append(registers[opcode & 7]);
+	}
+
+	return table;
+}
+
+static constexpr std::array<ExtendedMnemonic, 256> extended_table = MakeExtendedTable();
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static void AppendDigits(std::string& text, unsigned int value, int digits)
+{
+	for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4)
+		text += hex_digits[(value >> shift) & 0x0F];
+}
+
+static void AppendHex(std::string& text, unsigned int value, int digits)
+{
+	text += '$';
+	AppendDigits(text, value, digits);
+}
+
+// Bank the label of an address is filed under: ROM addresses by the bank
+// mapped there, everything else under bank 0 as RGBDS writes WRAM0 and HRAM
+static unsigned short TargetBank(unsigned short target, unsigned short address, unsigned short bank, unsigned short mapped_bank)
+{
+	if (target < 0x4000 || target >= 0x8000)
+		return 0;
+
+	return address >= 0x4000 && address < 0x8000 ? bank : mapped_bank;
+}
+
+Disassembler::Disassembler(System* system)
+{
+	this->system = system;
+}
+
+bool Disassembler::LoadSymbols(std::string path)
+{
+	// Cached lines carry the old labels
+	cache.clear();
+
+	return symbols.Load(path);
+}
+
+const SymbolTable& Disassembler::GetSymbols()
+{
+	return symbols;
+}
+
+const Disassembler::Line& Disassembler::Disassemble(unsigned short address)
+{
+	unsigned short bank = system->GetBank(address);
+
+	unsigned char bytes[3];
+	system->ReadMemoryBlock(address, 3, bytes);
+
+	Line& line = cache[static_cast<unsigned int>(bank) << 16 | address];
+
+	if (line.length != 0 && std::equal(bytes, bytes + line.length, line.bytes))
+		return line;
+
+	line.address = address;
+	line.bank = bank;
+	line.text.clear();
+	line.length = static_cast<unsigned char>(Decode(bytes, address, bank, system->GetBank(0x4000), &symbols, line.text));
+	std::copy(bytes, bytes + 3, line.bytes);
+
+	return line;
+}
+
+unsigned int Disassembler::Decode(const unsigned char* bytes, unsigned short address, unsigned short bank, unsigned short mapped_bank, const SymbolTable* symbols, std::string& text)
+{
+	unsigned char opcode = bytes[0];
+
+	if (opcode == 0xCB)
+	{
+		text += extended_table[bytes[1]].text;
+		return 2;
+	}
+
+	const OpcodeInfo& info = opcode_table[opcode];
+
+	if (info.text == nullptr)
+	{
+		text += "DB ";
+		AppendHex(text, opcode, 2);
+		return 1;
+	}
+
+	if (info.operand == Operand_None)
+	{
+		text += info.text;
+		return 1;
+	}
+
+	text.append(info.text, info.operand_position);
+
+	unsigned short word = static_cast<unsigned short>(bytes[1] | bytes[2] << 8);
+	int target = -1;
+
+	switch (info.operand)
+	{
+	case Operand_D8:
+		AppendHex(text, bytes[1], 2);
+		break;
+	case Operand_D16:
+		AppendHex(text, word, 4);
+		target = word;
+		break;
+	case Operand_A8:
+		AppendHex(text, 0xFF00 | bytes[1], 4);
+		target = 0xFF00 | bytes[1];
+		break;
+	case Operand_A16:
+		AppendHex(text, word, 4);
+		target = word;
+		break;
+	case Operand_R8:
+		target = static_cast<unsigned short>(address + 2 + static_cast<signed char>(bytes[1]));
+		AppendHex(text, target, 4);
+		break;
+	case Operand_E8:
+	{
+		int offset = static_cast<signed char>(bytes[1]);
+
+		// "SP+e8" keeps its sign in the mnemonic, "ADD SP,e8" has none
+		if (offset < 0)
+		{
+			if (text.back() == '+')
+				text.back() = '-';
+			else
+				text += '-';
+		}
+
+		AppendHex(text, offset < 0 ? -offset : offset, 2);
+		break;
+	}
+	default:
+		break;
+	}
+
+	text += info.text + info.operand_position + info.operand_length;
+
+	if (target >= 0 && symbols != nullptr)
+	{
+		const char* label = symbols->Find(TargetBank(static_cast<unsigned short>(target), address, bank, mapped_bank), static_cast<unsigned short>(target));
+
+		if (label != nullptr)
+		{
+			text += " ; ";
+			text += label;
+		}
+	}
+
+	return info.length;
+}
+
+void Disassembler::DisassembleRom(const unsigned char* rom, size_t size, const SymbolTable* symbols, std::string& output)
+{
+	static constexpr size_t bank_size = 0x4000;
+
+	// A line is about 30 characters and an instruction 1.5 bytes on average
+	output.reserve(output.size() + size * 20);
+
+	std::string text;
+
+	for (size_t offset = 0; offset < size;)
+	{
+		unsigned short bank = static_cast<unsigned short>(offset / bank_size);
+		unsigned short address = static_cast<unsigned short>(bank == 0 ? offset : 0x4000 + offset % bank_size);
+
+		if (symbols != nullptr)
+		{
+			const char* label = symbols->Find(bank, address);
+
+			if (label != nullptr)
+			{
+				output += label;
+				output += ":\n";
+			}
+		}
+
+		// Instructions do not run past the end of their bank
+		size_t available = std::min(bank_size - offset % bank_size, size - offset);
+		unsigned char bytes[3]{};
+		std::copy(rom + offset, rom + offset + std::min<size_t>(available, 3), bytes);
+
+		text.clear();
+		unsigned int length = Decode(bytes, address, bank, bank == 0 ? 1 : bank, symbols, text);
+
+		// Truncated by the end of the bank, shown as data
+		if (length > available)
+		{
+			text = "DB ";
+			AppendHex(text, bytes[0], 2);
+			length = 1;
+		}
+
+		AppendDigits(output, bank, bank > 0xFF ? 3 : 2);
+		output += ':';
+		AppendDigits(output, address, 4);
+		output += "  ";
+
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			if (i < length)
+				AppendDigits(output, bytes[i], 2);
+			else
+				output += "  ";
+
+			output += ' ';
+		}
+
+		output += ' ';
+		output += text;
+		output += '\n';
+
+		offset += length;
+	}
+}
\ No newline at end of file
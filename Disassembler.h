@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include "SymbolTable.h"
+#include "System.h"
+
+// SM83 disassembler. Instructions are decoded from constexpr tables built
+// from the mnemonics, addresses with a label in the loaded symbol file are
+// annotated with it.
+//
+// Lines decoded from a running System are cached per (bank, address). A line
+// stays valid while the bytes it was decoded from are unchanged, so writes
+// and bank switches are noticed without a hook in the memory write path.
+class Disassembler
+{
+public:
+	struct Line
+	{
+		unsigned short address{};
+		unsigned short bank{};
+		unsigned char length{};
+		unsigned char bytes[3]{};
+		std::string text;
+	};
+
+	Disassembler(System* system);
+
+	bool LoadSymbols(std::string path);
+	const SymbolTable& GetSymbols();
+
+	// Instruction at address in the currently mapped bank
+	const Line& Disassemble(unsigned short address);
+
+	// Decodes the instruction starting at bytes, which must hold 3 bytes, into
+	// text and returns its length. mapped_bank is assumed for targets in
+	// 0x4000-0x7FFF when the instruction itself lies in bank 0.
+	static unsigned int Decode(const unsigned char* bytes, unsigned short address, unsigned short bank, unsigned short mapped_bank, const SymbolTable* symbols, std::string& text);
+
+	// Linear sweep over a whole ROM image, one "BB:AAAA  bytes  text" line per
+	// instruction with "label:" lines before labelled addresses
+	static void DisassembleRom(const unsigned char* rom, size_t size, const SymbolTable* symbols, std::string& output);
+
+private:
+	System* system;
+	SymbolTable symbols;
+	std::unordered_map<unsigned int, Line> cache;
+};
\ No newline at end of file
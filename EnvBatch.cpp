@@ -0,0 +1,152 @@
+#include "EnvBatch.h"
+
+EnvBatch::EnvBatch(FileLogger* logger, const unsigned char* rom, size_t rom_size, unsigned int batch_size, unsigned int thread_count)
+	: rom(rom, rom + rom_size)
+{
+	if (thread_count == 0)
+		thread_count = std::thread::hardware_concurrency();
+	if (thread_count == 0)
+		thread_count = 1;
+	if (thread_count > batch_size)
+		thread_count = batch_size;
+
+	this->batch_size = batch_size;
+	this->thread_count = thread_count;
+
+	for (unsigned int i = 0; i < batch_size; ++i)
+		systems.push_back(new System(logger));
+
+	Reset();
+
+	for (unsigned int shard = 1; shard < thread_count; ++shard)
+		threads.emplace_back(&EnvBatch::WorkerLoop, this, shard);
+}
+
+EnvBatch::~EnvBatch()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	start.notify_all();
+
+	for (auto& thread : threads)
+		thread.join();
+
+	for (System* system : systems)
+		delete system;
+}
+
+void EnvBatch::Reset()
+{
+	for (unsigned int i = 0; i < batch_size; ++i)
+		Reset(i);
+}
+
+void EnvBatch::Reset(unsigned int index)
+{
+	systems[index]->SetFramebufferTarget(nullptr);
+	systems[index]->SetJoypad(0);
+	systems[index]->LoadRom(rom.data(), rom.size());
+}
+
+void EnvBatch::Step(unsigned int frames, const unsigned char* buttons, unsigned char* observations)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		step_frames = frames;
+		step_buttons = buttons;
+		step_observations = observations;
+		running_shards = thread_count - 1;
+		++generation;
+	}
+
+	start.notify_all();
+
+	RunShard(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	done.wait(lock, [this] { return running_shards == 0; });
+}
+
+void EnvBatch::WorkerLoop(unsigned int shard)
+{
+	unsigned long long seen_generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			start.wait(lock, [this, seen_generation] { return stopping || generation != seen_generation; });
+
+			if (stopping)
+				return;
+
+			seen_generation = generation;
+		}
+
+		RunShard(shard);
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (--running_shards == 0)
+			done.notify_one();
+	}
+}
+
+void EnvBatch::RunShard(unsigned int shard)
+{
+	unsigned int begin = static_cast<unsigned int>(static_cast<unsigned long long>(batch_size) * shard / thread_count);
+	unsigned int end = static_cast<unsigned int>(static_cast<unsigned long long>(batch_size) * (shard + 1) / thread_count);
+
+	for (unsigned int i = begin; i < end; ++i)
+	{
+		System* system = systems[i];
+
+		system->SetJoypad(step_buttons != nullptr ? step_buttons[i] : 0);
+
+		// Without observations the caller's buffer from an earlier step may be
+		// gone, frames go back to the instance's own framebuffer
+		system->SetFramebufferTarget(step_observations != nullptr ? step_observations + static_cast<size_t>(i) * observation_size : nullptr);
+
+		for (unsigned int frame = 0; frame < step_frames; ++frame)
+		{
+			// Only the last frame can be observed, either in the caller's
+			// buffer or later through GetFramebuffers
+			system->SetRenderingEnabled(frame + 1 == step_frames);
+			system->RunFrame();
+		}
+	}
+}
+
+void EnvBatch::GetFramebuffers(unsigned char* output)
+{
+	for (unsigned int i = 0; i < batch_size; ++i)
+		std::memcpy(output + static_cast<size_t>(i) * observation_size, systems[i]->GetFramebuffer(), observation_size);
+}
+
+void EnvBatch::GetRam(unsigned short address, unsigned int length, unsigned char* output)
+{
+	for (unsigned int i = 0; i < batch_size; ++i)
+		systems[i]->ReadMemoryBlock(address, length, output + static_cast<size_t>(i) * length);
+}
+
+void EnvBatch::GetStateHashes(unsigned long long* output)
+{
+	for (unsigned int i = 0; i < batch_size; ++i)
+		output[i] = systems[i]->GetStateHash();
+}
+
+unsigned int EnvBatch::GetBatchSize()
+{
+	return batch_size;
+}
+
+unsigned int EnvBatch::GetThreadCount()
+{
+	return thread_count;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "FileLogger.h"
+#include "System.h"
+
+// A batch of System instances stepped together for training loops.
+//
+// Each Step splits the batch into one fixed shard per thread and runs the
+// shards in parallel; the calling thread works on the first shard. Stepping
+// does not allocate, and observations are rendered straight into the caller's
+// buffer.
+class EnvBatch
+{
+public:
+	static constexpr unsigned int observation_size = System::screen_width * System::screen_height;
+
+	// A thread count of 0 uses every hardware thread
+	EnvBatch(FileLogger* logger, const unsigned char* rom, size_t rom_size, unsigned int batch_size, unsigned int thread_count);
+	~EnvBatch();
+
+	void Reset();
+	void Reset(unsigned int index);
+
+	// Runs every instance for frames frames with buttons[i] held on instance i.
+	// Only the last frame is drawn, with observations directly into
+	// observations + i * observation_size, which must stay valid until the
+	// next Step or Reset if GetFramebuffers is used.
+	void Step(unsigned int frames, const unsigned char* buttons, unsigned char* observations);
+
+	void GetFramebuffers(unsigned char* output);
+	void GetRam(unsigned short address, unsigned int length, unsigned char* output);
+	void GetStateHashes(unsigned long long* output);
+
+	unsigned int GetBatchSize();
+	unsigned int GetThreadCount();
+
+private:
+	void WorkerLoop(unsigned int shard);
+	void RunShard(unsigned int shard);
+
+	std::vector<unsigned char> rom;
+	std::vector<System*> systems;
+	unsigned int batch_size{};
+	unsigned int thread_count{};
+
+	// Parameters of the step being run
+	unsigned int step_frames{};
+	const unsigned char* step_buttons{};
+	unsigned char* step_observations{};
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable start;
+	std::condition_variable done;
+	unsigned long long generation{};
+	unsigned int running_shards{};
+	bool stopping = false;
+};
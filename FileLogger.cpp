@@ -1,15 +1,44 @@
 #include "FileLogger.h"
 
-FileLogger::FileLogger()
+FileLogger::FileLogger(std::string record_path)
 {
 	logfile_stream = new std::ofstream("./debug.log", std::ios::app);
 	*logfile_stream << "\n==========================\n " << GetTimestamp() << "\n==========================\n" << std::endl;
+
+	if (!record_path.empty())
+	{
+		record_stream = new std::ofstream(record_path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+		if (*record_stream)
+		{
+			record_stream->write(record_file_magic, sizeof(record_file_magic));
+			record_stream->write(reinterpret_cast<const char*>(&record_file_version), sizeof(record_file_version));
+		}
+		else
+		{
+			*logfile_stream << logtype[LOG_ERROR] << "Unable to create log record file: " << record_path << std::endl;
+
+			delete record_stream;
+			record_stream = nullptr;
+		}
+	}
+
+	writer = std::thread(&FileLogger::WriterLoop, this);
 }
 
 FileLogger::~FileLogger()
 {
+	stopping.store(true, std::memory_order_release);
+	writer.join();
+
 	logfile_stream->close();
 	delete logfile_stream;
+
+	if (record_stream != nullptr)
+	{
+		record_stream->close();
+		delete record_stream;
+	}
 }
 
 std::string FileLogger::GetTimestamp()
@@ -26,4 +55,111 @@ std::string FileLogger::GetTimestamp()
 	timestring.erase(std::remove(timestring.begin(), timestring.end(), '\n'), timestring.end());
 
 	return timestring;
-}
\ No newline at end of file
+}
+
+void FileLogger::Flush()
+{
+	unsigned int message_target = messages.GetEnqueuePosition();
+	unsigned int record_target = records.GetEnqueuePosition();
+
+	// Positions wrap, compare through the signed difference
+	while (static_cast<int>(written_messages.load(std::memory_order_acquire) - message_target) < 0
+		|| static_cast<int>(written_records.load(std::memory_order_acquire) - record_target) < 0)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+unsigned long long FileLogger::GetDroppedCount()
+{
+	return dropped.load(std::memory_order_relaxed);
+}
+
+std::string FileLogger::FormatRecord(const LogRecord& record)
+{
+	if (record.format >= LogFormat_Count)
+		return std::string(logtype[LOG_ERROR]) + "Unknown log record format " + std::to_string(record.format);
+
+	const LogFormatInfo& info = log_formats[record.format];
+
+	char text[max_message_length];
+
+	std::snprintf(text, sizeof(text), info.text, record.arguments[0], record.arguments[1], record.arguments[2]);
+
+	return std::string(logtype[info.type]) + text;
+}
+
+void FileLogger::Push(std::string_view message)
+{
+	bool pushed = messages.Push([&](Message& entry)
+	{
+		entry.length = static_cast<unsigned int>(message.size() < max_message_length ? message.size() : max_message_length);
+		std::memcpy(entry.text, message.data(), entry.length);
+	});
+
+	// Never wait for the writer, a full queue costs the message
+	if (!pushed)
+		dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FileLogger::WriterLoop()
+{
+	std::string batch;
+	std::vector<LogRecord> record_batch;
+	unsigned long long dropped_reported = 0;
+
+	while (true)
+	{
+		bool stop = stopping.load(std::memory_order_acquire);
+
+		while (messages.Pop([&](Message& entry)
+		{
+			batch.append(entry.text, entry.length);
+			batch += '\n';
+		}));
+
+		while (records.Pop([&](LogRecord& record)
+		{
+			if (record_stream != nullptr)
+				record_batch.push_back(record);
+			else
+			{
+				batch += FormatRecord(record);
+				batch += '\n';
+			}
+		}));
+
+		unsigned long long dropped_now = dropped.load(std::memory_order_relaxed);
+
+		if (dropped_now != dropped_reported)
+		{
+			batch += std::string(logtype[LOG_WARNING]) + std::to_string(dropped_now - dropped_reported) + " log messages dropped, queue full\n";
+			dropped_reported = dropped_now;
+		}
+
+		if (!record_batch.empty())
+		{
+			record_stream->write(reinterpret_cast<const char*>(record_batch.data()), record_batch.size() * sizeof(LogRecord));
+			record_stream->flush();
+			record_batch.clear();
+		}
+
+		if (!batch.empty())
+		{
+			logfile_stream->write(batch.data(), batch.size());
+			logfile_stream->flush();
+			batch.clear();
+		}
+
+		unsigned int message_position = messages.GetDequeuePosition();
+		unsigned int record_position = records.GetDequeuePosition();
+
+		if (message_position != written_messages.load(std::memory_order_relaxed) || record_position != written_records.load(std::memory_order_relaxed))
+		{
+			written_messages.store(message_position, std::memory_order_release);
+			written_records.store(record_position, std::memory_order_release);
+		}
+		else if (stop)
+			break;
+		else
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+}
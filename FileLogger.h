@@ -1,45 +1,159 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <chrono>
 #include <time.h>
 #include <string>
-#include <memory>
-#include <cstdarg>
-#include <map>
+#include <string_view>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <iterator>
+#include <vector>
+
+#include "BoundedQueue.h"
 
 #define LOG_INFO 0
 #define LOG_WARNING 1
 #define LOG_ERROR 2
 
+// Messages below this level compile to nothing, release builds can define it
+// as LOG_WARNING or LOG_ERROR
+#ifndef GBE_LOG_LEVEL
+#define GBE_LOG_LEVEL LOG_INFO
+#endif
+
+// Formats for binary records. Call sites only store the format and the raw
+// arguments, the text is produced later by the writer thread or offline by
+// gbe-logdecode.
+enum LogFormat : unsigned int
+{
+	LogFormat_Unknown_Opcode,
+	LogFormat_Unknown_CB_Opcode,
+	LogFormat_Count
+};
+
+struct LogFormatInfo
+{
+	int type;
+	// printf style, every argument is passed as unsigned long long
+	const char* text;
+};
+
+static constexpr LogFormatInfo log_formats[LogFormat_Count] =
+{
+	{ LOG_WARNING, "Unknown Opcode: %llx at PC %04llx" },
+	{ LOG_WARNING, "Unknown Extended(BC) Opcode: %llx at PC %04llx" },
+};
+
+struct LogRecord
+{
+	unsigned int format{};
+	unsigned int argument_count{};
+	// Steady clock nanoseconds, only differences between records are meaningful
+	unsigned long long timestamp{};
+	unsigned long long arguments[3]{};
+};
+
+// Asynchronous logger. Log formats the message on the calling thread and
+// pushes it onto a bounded lock-free queue; a background thread drains the
+// queue and writes it out in batches. A full queue drops the message instead
+// of making the caller wait on the disk, the writer logs how many were lost.
+// Messages longer than max_message_length are truncated.
+//
+// Record skips formatting on the calling thread altogether. By default the
+// writer formats records into debug.log; given a record path they are written
+// there raw instead, for gbe-logdecode to turn into text.
 class FileLogger
 {
 public:
-	FileLogger();
+	static constexpr unsigned int queue_size = 4096;
+	static constexpr unsigned int record_queue_size = 16384;
+	static constexpr unsigned int max_message_length = 248;
+	static constexpr unsigned int record_file_version = 1;
+
+	FileLogger(std::string record_path = "");
 	~FileLogger();
 
 	std::string GetTimestamp();
 
-	template<typename T>
-	void Log(int type, T&& msg)
+	template<int type, typename... Args>
+	void Log(Args&&... args)
 	{
-		*logfile_stream << logtype[type] << msg << std::endl;
+		if constexpr (type >= GBE_LOG_LEVEL)
+		{
+			// One stream per thread, rewound instead of cleared so its buffer is reused.
+			// Manipulators passed by an earlier call must not leak into this one.
+			thread_local std::ostringstream stream;
+
+			stream.seekp(0);
+			stream.flags(std::ios_base::dec | std::ios_base::skipws);
+			stream.fill(' ');
+			stream.precision(6);
+			stream << logtype[type];
+			(stream << ... << args);
+
+			Push(std::string_view(stream.view().data(), static_cast<size_t>(stream.tellp())));
+		}
 	}
-	template<typename Head, typename... Tail>
-	void Log(int type, Head&& head, Tail&&... tail) {
-		*logfile_stream << logtype[type] << head;
 
-		Log(std::forward<Tail>(tail)...);
+	template<LogFormat format, typename... Args>
+	void Record(Args... args)
+	{
+		static_assert(sizeof...(Args) <= std::size(LogRecord{}.arguments), "Too many arguments for a log record");
+
+		if constexpr (log_formats[format].type >= GBE_LOG_LEVEL)
+		{
+			unsigned long long timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+			bool pushed = records.Push([&](LogRecord& record)
+			{
+				unsigned int index = 0;
+
+				record.format = format;
+				record.argument_count = sizeof...(Args);
+				record.timestamp = timestamp;
+				((record.arguments[index++] = static_cast<unsigned long long>(args)), ...);
+			});
+
+			if (!pushed)
+				dropped.fetch_add(1, std::memory_order_relaxed);
+		}
 	}
 
+	// Blocks until every message and record logged before the call has been written
+	void Flush();
+	// Messages and records lost to a full queue since the logger was created
+	unsigned long long GetDroppedCount();
+
+	// Text of a record as it appears in debug.log
+	static std::string FormatRecord(const LogRecord& record);
+
+	static constexpr const char* logtype[3] = { "[Info]    ", "[Warning] ", "[Error]   " };
+	static constexpr char record_file_magic[4] = { 'G', 'B', 'E', 'R' };
+
 private:
-	template<typename T>
-	void Log(T&& msg)
+	struct Message
 	{
-		*logfile_stream << msg << std::endl;
-	}
+		unsigned int length{};
+		char text[max_message_length];
+	};
+
+	void Push(std::string_view message);
+	void WriterLoop();
 
 	std::ofstream* logfile_stream{};
-	std::map<int, std::string> logtype = { {0, "[Info]    "}, {1, "[Warning] "}, {2, "[Error]   "} };
-};
+	std::ofstream* record_stream{};
+
+	BoundedQueue<Message, queue_size> messages;
+	BoundedQueue<LogRecord, record_queue_size> records;
+	std::atomic<unsigned int> written_messages{};
+	std::atomic<unsigned int> written_records{};
+	std::atomic<unsigned long long> dropped{};
 
+	std::thread writer;
+	std::atomic<bool> stopping = false;
+};
@@ -0,0 +1,242 @@
+#include "FlightRecorder.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+
+static int OpenDumpFile(const char* path, bool create)
+{
+	return _open(path, _O_WRONLY | _O_BINARY | (create ? _O_CREAT | _O_EXCL : 0), _S_IREAD | _S_IWRITE);
+}
+static bool TruncateDumpFile(int file)
+{
+	return _lseek(file, 0, SEEK_SET) == 0 && _chsize(file, 0) == 0;
+}
+static long long WriteDumpFile(int file, const char* data, size_t size)
+{
+	return _write(file, data, static_cast<unsigned int>(size));
+}
+static bool IsDumpFileEmpty(int file)
+{
+	return _filelengthi64(file) == 0;
+}
+static void CloseDumpFile(int file)
+{
+	_close(file);
+}
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int OpenDumpFile(const char* path, bool create)
+{
+	return open(path, O_WRONLY | (create ? O_CREAT | O_EXCL : 0), 0644);
+}
+static bool TruncateDumpFile(int file)
+{
+	return lseek(file, 0, SEEK_SET) == 0 && ftruncate(file, 0) == 0;
+}
+static long long WriteDumpFile(int file, const char* data, size_t size)
+{
+	ssize_t written;
+
+	do
+		written = write(file, data, size);
+	while (written < 0 && errno == EINTR);
+
+	return written;
+}
+static bool IsDumpFileEmpty(int file)
+{
+	struct stat status;
+	return fstat(file, &status) == 0 && status.st_size == 0;
+}
+static void CloseDumpFile(int file)
+{
+	close(file);
+}
+#endif
+
+static bool WriteAll(int file, const void* data, size_t size)
+{
+	const char* cursor = static_cast<const char*>(data);
+
+	while (size > 0)
+	{
+		long long written = WriteDumpFile(file, cursor, size);
+
+		if (written <= 0)
+			return false;
+
+		cursor += written;
+		size -= static_cast<size_t>(written);
+	}
+
+	return true;
+}
+
+static const char flight_magic[4] = { 'G', 'B', 'E', 'F' };
+
+FlightRecorder::FlightRecorder(unsigned int capacity)
+{
+	unsigned int size = min_capacity;
+
+	while (size < capacity && size < max_capacity)
+		size <<= 1;
+
+	entries = new Entry[size];
+	mask = size - 1;
+}
+
+FlightRecorder::~FlightRecorder()
+{
+	CloseSignalDump();
+
+	delete[] entries;
+}
+
+bool FlightRecorder::Dump(const char* path)
+{
+	std::FILE* file = std::fopen(path, "wb");
+
+	if (file == nullptr)
+		return false;
+
+	unsigned int count = GetCount();
+	unsigned int first = static_cast<unsigned int>((position - count) & mask);
+	// The oldest entries run to the end of the ring, the rest wrap to the start
+	unsigned int head = first + count > mask + 1 ? mask + 1 - first : count;
+
+	bool written = std::fwrite(flight_magic, sizeof(flight_magic), 1, file) == 1
+		&& std::fwrite(&version, sizeof(version), 1, file) == 1
+		&& std::fwrite(&count, sizeof(count), 1, file) == 1
+		&& std::fwrite(entries + first, sizeof(Entry), head, file) == head
+		&& std::fwrite(entries, sizeof(Entry), count - head, file) == count - head;
+
+	return std::fclose(file) == 0 && written;
+}
+
+bool FlightRecorder::OpenSignalDump(const char* path)
+{
+	CloseSignalDump();
+
+	signal_dump_file = OpenDumpFile(path, false);
+	signal_dump_created = false;
+
+	if (signal_dump_file < 0)
+	{
+		signal_dump_file = OpenDumpFile(path, true);
+		signal_dump_created = signal_dump_file >= 0;
+	}
+
+	signal_dump_path = path;
+
+	return signal_dump_file >= 0;
+}
+
+bool FlightRecorder::DumpOnSignal()
+{
+	if (signal_dump_file < 0)
+		return false;
+
+	unsigned int count = GetCount();
+	unsigned int first = static_cast<unsigned int>((position - count) & mask);
+	unsigned int head = first + count > mask + 1 ? mask + 1 - first : count;
+
+	char header[sizeof(flight_magic) + sizeof(version) + sizeof(count)];
+
+	std::memcpy(header, flight_magic, sizeof(flight_magic));
+	std::memcpy(header + sizeof(flight_magic), &version, sizeof(version));
+	std::memcpy(header + sizeof(flight_magic) + sizeof(version), &count, sizeof(count));
+
+	return TruncateDumpFile(signal_dump_file)
+		&& WriteAll(signal_dump_file, header, sizeof(header))
+		&& WriteAll(signal_dump_file, entries + first, head * sizeof(Entry))
+		&& WriteAll(signal_dump_file, entries, (count - head) * sizeof(Entry));
+}
+
+void FlightRecorder::CloseSignalDump()
+{
+	if (signal_dump_file < 0)
+		return;
+
+	bool empty = IsDumpFileEmpty(signal_dump_file);
+
+	CloseDumpFile(signal_dump_file);
+	signal_dump_file = -1;
+
+	if (signal_dump_created && empty)
+		std::remove(signal_dump_path.c_str());
+}
+
+void FlightRecorder::OnError()
+{
+	if (error_dumped || error_dump_path.empty())
+		return;
+
+	error_dumped = true;
+
+	Dump(error_dump_path.c_str());
+}
+
+void FlightRecorder::SetErrorDumpPath(std::string path)
+{
+	error_dump_path = path;
+	error_dumped = false;
+}
+
+unsigned int FlightRecorder::GetCapacity()
+{
+	return mask + 1;
+}
+unsigned int FlightRecorder::GetCount()
+{
+	return static_cast<unsigned int>(position < mask + 1ULL ? position : mask + 1ULL);
+}
+unsigned long long FlightRecorder::GetRecordedCount()
+{
+	return position;
+}
+
+bool FlightRecorder::Load(std::string path, std::vector<Entry>& output)
+{
+	std::FILE* file = std::fopen(path.c_str(), "rb");
+
+	if (file == nullptr)
+		return false;
+
+	char magic[4]{};
+	unsigned int file_version = 0;
+	unsigned int count = 0;
+
+	bool valid = std::fread(magic, sizeof(magic), 1, file) == 1
+		&& std::fread(&file_version, sizeof(file_version), 1, file) == 1
+		&& std::fread(&count, sizeof(count), 1, file) == 1
+		&& std::memcmp(magic, flight_magic, sizeof(magic)) == 0
+		&& file_version == version && count <= max_capacity;
+
+	if (valid)
+	{
+		output.resize(count);
+		valid = std::fread(output.data(), sizeof(Entry), count, file) == count;
+	}
+
+	std::fclose(file);
+
+	return valid;
+}
+
+std::string FlightRecorder::FormatEntry(const Entry& entry)
+{
+	const Registers& r = entry.registers;
+
+	char text[96];
+
+	std::snprintf(text, sizeof(text), "%12llu  %02X:%04X  %02X  A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X SP:%04X",
+		entry.cycles, entry.bank, entry.pc, entry.opcode, r.a, r.f, r.b, r.c, r.d, r.e, r.h, r.l, entry.sp);
+
+	return text;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "System.h"
+
+// Always-on record of the last executed instructions. Every instruction stores
+// one fixed size entry into a power of two ring, which is written out when the
+// core hits an error, on a fatal signal or on request. Dumps hold the raw
+// entries, oldest first, and are read by gbe-flight.
+class FlightRecorder
+{
+public:
+	// State before the instruction ran
+	struct Entry
+	{
+		Registers registers;
+		unsigned short pc{};
+		unsigned short sp{};
+		unsigned char opcode{};
+		unsigned char bank{};
+		unsigned char reserved[2]{};
+		unsigned long long cycles{};
+	};
+
+	static constexpr unsigned int min_capacity = 4096;
+	static constexpr unsigned int max_capacity = 65536;
+	static constexpr unsigned int default_capacity = 16384;
+	static constexpr unsigned int version = 1;
+
+	// Capacity is rounded up to a power of two within [min_capacity, max_capacity]
+	FlightRecorder(unsigned int capacity = default_capacity);
+	~FlightRecorder();
+
+	// Called by System before each instruction while attached with SetFlightRecorder
+	void Record(const Registers& registers, unsigned short pc, unsigned short sp, unsigned char opcode, unsigned char bank, unsigned long long cycles)
+	{
+		Entry& entry = entries[position++ & mask];
+
+		entry.registers = registers;
+		entry.pc = pc;
+		entry.sp = sp;
+		entry.opcode = opcode;
+		entry.bank = bank;
+		entry.cycles = cycles;
+	}
+
+	// Writes the ring to path through stdio, which a signal handler must not
+	// use, see DumpOnSignal
+	bool Dump(const char* path);
+
+	// Opens path ahead of a fatal signal, leaving an earlier dump in it alone
+	bool OpenSignalDump(const char* path);
+	// Writes the ring to the file OpenSignalDump opened with plain write calls,
+	// so a signal handler can call it
+	bool DumpOnSignal();
+	// Removes the file again if OpenSignalDump created it and it stayed empty
+	void CloseSignalDump();
+
+	// Called by System when it logs an error. The first error dumps the ring to
+	// the error dump path, later ones would only repeat the same context.
+	void OnError();
+	// Empty disables dumping on errors
+	void SetErrorDumpPath(std::string path);
+
+	unsigned int GetCapacity();
+	// Entries held, at most the capacity
+	unsigned int GetCount();
+	unsigned long long GetRecordedCount();
+
+	static bool Load(std::string path, std::vector<Entry>& output);
+	static std::string FormatEntry(const Entry& entry);
+
+private:
+	Entry* entries{};
+	unsigned int mask{};
+	unsigned long long position{};
+
+	std::string error_dump_path;
+	bool error_dumped = false;
+
+	std::string signal_dump_path;
+	int signal_dump_file = -1;
+	bool signal_dump_created = false;
+};
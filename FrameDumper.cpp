@@ -0,0 +1,163 @@
+#include "FrameDumper.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+FrameDumper::FrameDumper(FileLogger* logger, unsigned int interval, unsigned int thread_count)
+{
+	this->logger = logger;
+	this->interval = interval == 0 ? 1 : interval;
+
+	std::memcpy(palette, Scaler::default_palette, sizeof(palette));
+
+	buffers = new Buffer[buffer_count];
+	free_buffers.reserve(buffer_count);
+
+	for (unsigned int i = 0; i < buffer_count; ++i)
+		free_buffers.push_back(&buffers[i]);
+
+	pool = new ThreadPool(thread_count == 0 ? 1 : thread_count);
+}
+
+FrameDumper::~FrameDumper()
+{
+	Flush();
+
+	delete pool;
+	delete[] buffers;
+}
+
+void FrameDumper::PushFrame(const unsigned char* shades, unsigned long long frame, const std::string& prefix)
+{
+	if (frame % interval != 0)
+		return;
+
+	Buffer* buffer;
+
+	{
+		std::unique_lock<std::mutex> lock(free_mutex);
+
+		if (free_buffers.empty())
+		{
+			stall_count.fetch_add(1, std::memory_order_relaxed);
+			buffer_freed.wait(lock, [this] { return !free_buffers.empty(); });
+		}
+
+		buffer = free_buffers.back();
+		free_buffers.pop_back();
+	}
+
+	std::memcpy(buffer->shades, shades, sizeof(buffer->shades));
+
+	char number[24];
+	std::snprintf(number, sizeof(number), "%08llu.png", frame);
+
+	// Assigning keeps the string's storage from the last frame
+	buffer->path.assign(prefix);
+	buffer->path.append(number);
+
+	pool->Submit([this, buffer] { Dump(buffer); });
+}
+
+void FrameDumper::Dump(Buffer* buffer)
+{
+	// Encoders hold sizeable hash tables, one per pool thread is enough
+	thread_local PngEncoder encoder;
+
+	auto start = std::chrono::steady_clock::now();
+
+	// Only the shades the frame uses go into the palette, most frames then
+	// fit one or two bits per pixel
+	bool used[4]{};
+
+	for (unsigned char shade : buffer->shades)
+		used[shade & 3] = true;
+
+	unsigned char remap[4]{};
+	unsigned int colors[4];
+	unsigned int color_count = 0;
+
+	for (unsigned int shade = 0; shade < 4; ++shade)
+	{
+		if (!used[shade])
+			continue;
+
+		remap[shade] = static_cast<unsigned char>(color_count);
+		colors[color_count++] = palette[shade];
+	}
+
+	for (unsigned int i = 0; i < sizeof(buffer->shades); ++i)
+		buffer->indices[i] = remap[buffer->shades[i] & 3];
+
+	encoder.EncodeIndexed(buffer->indices, System::screen_width, System::screen_height, colors, color_count, buffer->png);
+
+	encode_nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+
+	std::ofstream output(buffer->path, std::ios::out | std::ios::binary | std::ios::trunc);
+	output.write(reinterpret_cast<const char*>(buffer->png.data()), buffer->png.size());
+
+	if (output)
+	{
+		dumped_count.fetch_add(1, std::memory_order_relaxed);
+		file_bytes.fetch_add(buffer->png.size(), std::memory_order_relaxed);
+	}
+	else
+	{
+		// Only the first failure is logged, a bad prefix would fail every frame
+		if (failed_count.fetch_add(1, std::memory_order_relaxed) == 0)
+			logger->Log<LOG_ERROR>("Unable to write frame dump: " + buffer->path);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(free_mutex);
+		free_buffers.push_back(buffer);
+	}
+
+	buffer_freed.notify_one();
+}
+
+void FrameDumper::Flush()
+{
+	pool->Wait();
+}
+
+void FrameDumper::SetPalette(const unsigned int colors[4])
+{
+	std::memcpy(palette, colors, sizeof(palette));
+}
+
+unsigned int FrameDumper::GetInterval()
+{
+	return interval;
+}
+
+unsigned long long FrameDumper::GetDumpedCount()
+{
+	return dumped_count;
+}
+
+unsigned long long FrameDumper::GetFailedCount()
+{
+	return failed_count;
+}
+
+unsigned long long FrameDumper::GetStallCount()
+{
+	return stall_count;
+}
+
+double FrameDumper::GetAverageEncodeTime()
+{
+	unsigned long long count = dumped_count + failed_count;
+
+	return count == 0 ? 0.0 : encode_nanoseconds / 1e6 / count;
+}
+
+double FrameDumper::GetAverageFileSize()
+{
+	unsigned long long count = dumped_count;
+
+	return count == 0 ? 0.0 : static_cast<double>(file_bytes) / count;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+#include "PngEncoder.h"
+#include "Scaler.h"
+#include "System.h"
+#include "ThreadPool.h"
+
+// Saves every Nth frame as an indexed PNG, for building image sets from
+// batch runs. PushFrame copies the shades into a buffer from a fixed pool and
+// hands it to a small thread pool, which palettizes the frame down to the
+// shades it uses, compresses it and writes <prefix><frame>.png while the
+// emulation carries on. Buffers and encoders are reused, nothing is
+// allocated per frame once every buffer has been through a frame.
+//
+// PushFrame may be called from several threads. It waits for a buffer when
+// all of them are queued, a dump never skips a frame.
+class FrameDumper
+{
+public:
+	static constexpr unsigned int buffer_count = 16;
+
+	FrameDumper(FileLogger* logger, unsigned int interval = 1, unsigned int thread_count = 2);
+	// Writes out every queued frame first
+	~FrameDumper();
+
+	// Frames whose number is not a multiple of the interval are ignored
+	void PushFrame(const unsigned char* shades, unsigned long long frame, const std::string& prefix);
+	// Blocks until every pushed frame has been written
+	void Flush();
+
+	// Colors of shades 0 (white) to 3 (black), set before the first PushFrame
+	void SetPalette(const unsigned int colors[4]);
+	unsigned int GetInterval();
+
+	unsigned long long GetDumpedCount();
+	unsigned long long GetFailedCount();
+	// Pushes that had to wait for a free buffer
+	unsigned long long GetStallCount();
+	// Milliseconds spent palettizing and compressing a frame, and its average PNG size
+	double GetAverageEncodeTime();
+	double GetAverageFileSize();
+
+private:
+	struct Buffer
+	{
+		unsigned char shades[System::screen_width * System::screen_height];
+		unsigned char indices[System::screen_width * System::screen_height];
+		std::string path;
+		std::vector<unsigned char> png;
+	};
+
+	void Dump(Buffer* buffer);
+
+	unsigned int interval;
+	unsigned int palette[4];
+
+	Buffer* buffers{};
+	std::vector<Buffer*> free_buffers;
+	std::mutex free_mutex;
+	std::condition_variable buffer_freed;
+
+	ThreadPool* pool{};
+
+	std::atomic<unsigned long long> dumped_count{};
+	std::atomic<unsigned long long> failed_count{};
+	std::atomic<unsigned long long> stall_count{};
+	std::atomic<long long> encode_nanoseconds{};
+	std::atomic<unsigned long long> file_bytes{};
+
+	FileLogger* logger;
+};
\ No newline at end of file
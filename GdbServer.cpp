@@ -0,0 +1,678 @@
+#include "GdbServer.h"
+
+#include <thread>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+using SocketHandle = SOCKET;
+
+static int CloseSocket(SocketHandle socket)
+{
+	return closesocket(socket);
+}
+static bool WouldBlock()
+{
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+static void SetNonBlocking(SocketHandle socket)
+{
+	u_long mode = 1;
+	ioctlsocket(socket, FIONBIO, &mode);
+}
+static void DisableBrokenPipeSignal(SocketHandle)
+{
+}
+
+static constexpr int send_flags = 0;
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using SocketHandle = int;
+
+static int CloseSocket(SocketHandle socket)
+{
+	return close(socket);
+}
+static bool WouldBlock()
+{
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+static void SetNonBlocking(SocketHandle socket)
+{
+	fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+}
+// Sending to a client that has gone away raises SIGPIPE, which would kill
+// the emulator. Linux takes MSG_NOSIGNAL per send, macOS a socket option.
+static void DisableBrokenPipeSignal([[maybe_unused]] SocketHandle socket)
+{
+#ifdef SO_NOSIGPIPE
+	int no_signal = 1;
+	setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &no_signal, sizeof(no_signal));
+#endif
+}
+
+#ifdef MSG_NOSIGNAL
+static constexpr int send_flags = MSG_NOSIGNAL;
+#else
+static constexpr int send_flags = 0;
+#endif
+#endif
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static void PutHex8(std::string& output, unsigned char value)
+{
+	output += hex_digits[value >> 4];
+	output += hex_digits[value & 0x0F];
+}
+
+// Registers go over the wire little endian
+static void PutHex16(std::string& output, unsigned short value)
+{
+	PutHex8(output, static_cast<unsigned char>(value & 0xFF));
+	PutHex8(output, static_cast<unsigned char>(value >> 8));
+}
+
+static int HexValue(char digit)
+{
+	if (digit >= '0' && digit <= '9')
+		return digit - '0';
+	if (digit >= 'a' && digit <= 'f')
+		return digit - 'a' + 10;
+	if (digit >= 'A' && digit <= 'F')
+		return digit - 'A' + 10;
+
+	return -1;
+}
+
+// Parses hex digits up to the first non-hex character, advances position past them
+static unsigned long ParseHex(const std::string& text, size_t& position)
+{
+	unsigned long value = 0;
+
+	for (; position < text.size() && HexValue(text[position]) >= 0; ++position)
+		value = value << 4 | HexValue(text[position]);
+
+	return value;
+}
+
+static bool ParseHexBytes(const std::string& text, size_t position, unsigned char* output, size_t length)
+{
+	if (text.size() < position + length * 2)
+		return false;
+
+	for (size_t i = 0; i < length; ++i)
+	{
+		int high = HexValue(text[position + i * 2]);
+		int low = HexValue(text[position + i * 2 + 1]);
+
+		if (high < 0 || low < 0)
+			return false;
+
+		output[i] = static_cast<unsigned char>(high << 4 | low);
+	}
+
+	return true;
+}
+
+GdbServer::GdbServer(System* system, FileLogger* logger)
+{
+	this->system = system;
+	this->logger = logger;
+
+#ifdef _WIN32
+	WSADATA data;
+	WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+}
+
+GdbServer::~GdbServer()
+{
+	if (client_socket != -1)
+		Detach();
+
+	if (listen_socket != -1)
+		CloseSocket(static_cast<SocketHandle>(listen_socket));
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+bool GdbServer::Listen(unsigned short port)
+{
+	SocketHandle handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+	if (static_cast<std::intptr_t>(handle) == -1)
+	{
+		logger->Log<LOG_ERROR>("Unable to create the GDB server socket");
+		return false;
+	}
+
+	int reuse = 1;
+	setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+	// Only reachable from this machine, the protocol has no authentication
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+
+	if (bind(handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(handle, 1) != 0)
+	{
+		logger->Log<LOG_ERROR>("Unable to listen for GDB on port ", port);
+
+		CloseSocket(handle);
+		return false;
+	}
+
+	SetNonBlocking(handle);
+
+	listen_socket = static_cast<std::intptr_t>(handle);
+
+	logger->Log<LOG_INFO>("GDB server listening on localhost:", port);
+
+	return true;
+}
+
+bool GdbServer::IsAttached()
+{
+	return client_socket != -1;
+}
+
+void GdbServer::Poll()
+{
+	if (client_socket == -1)
+	{
+		if (listen_socket != -1)
+			Accept();
+
+		return;
+	}
+
+	if (!Receive(0))
+	{
+		Detach();
+		return;
+	}
+
+	ProcessInput();
+
+	if (running && system->GetStopReason() != Stop_None)
+	{
+		running = false;
+		SendPacket(StopReply());
+	}
+
+	// GDB sends a burst of packets after every stop, answer them without
+	// waiting a frame for each
+	while (client_socket != -1 && !running && system->GetStopReason() != Stop_None)
+	{
+		size_t received = input.size();
+
+		if (!Receive(10))
+		{
+			Detach();
+			return;
+		}
+
+		if (input.size() == received)
+			break;
+
+		ProcessInput();
+	}
+}
+
+void GdbServer::Accept()
+{
+	SocketHandle handle = accept(static_cast<SocketHandle>(listen_socket), nullptr, nullptr);
+
+	if (static_cast<std::intptr_t>(handle) == -1)
+		return;
+
+	SetNonBlocking(handle);
+	DisableBrokenPipeSignal(handle);
+
+	// Packets are tiny and every one waits for an answer
+	int no_delay = 1;
+	setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+
+	client_socket = static_cast<std::intptr_t>(handle);
+	input.clear();
+	no_ack = false;
+	running = false;
+
+	// GDB expects the target to be stopped once it is attached
+	system->Stop();
+
+	logger->Log<LOG_INFO>("GDB client attached");
+}
+
+bool GdbServer::Receive(int timeout_ms)
+{
+	SocketHandle handle = static_cast<SocketHandle>(client_socket);
+
+	if (timeout_ms > 0)
+	{
+		fd_set sockets;
+		FD_ZERO(&sockets);
+		FD_SET(handle, &sockets);
+
+		timeval timeout{};
+		timeout.tv_usec = timeout_ms * 1000;
+
+		if (select(static_cast<int>(handle) + 1, &sockets, nullptr, nullptr, &timeout) <= 0)
+			return true;
+	}
+
+	char buffer[max_packet_size];
+
+	while (true)
+	{
+		int received = recv(handle, buffer, sizeof(buffer), 0);
+
+		if (received > 0)
+			input.append(buffer, received);
+		else if (received < 0 && WouldBlock())
+			return true;
+		else
+			return false;
+	}
+}
+
+void GdbServer::ProcessInput()
+{
+	size_t position = 0;
+
+	while (position < input.size() && client_socket != -1)
+	{
+		char start = input[position];
+
+		// Ctrl-C from the client
+		if (start == '\x03')
+		{
+			system->Stop();
+			++position;
+			continue;
+		}
+
+		if (start != '$')
+		{
+			// Acknowledgements and noise
+			++position;
+			continue;
+		}
+
+		size_t end = input.find('#', position);
+
+		// Wait for the packet and its two checksum digits
+		if (end == std::string::npos || end + 2 >= input.size())
+			break;
+
+		std::string packet = input.substr(position + 1, end - position - 1);
+
+		unsigned char checksum = 0;
+
+		for (char c : packet)
+			checksum += static_cast<unsigned char>(c);
+
+		unsigned char expected = 0;
+		bool valid = ParseHexBytes(input, end + 1, &expected, 1) && expected == checksum;
+
+		position = end + 3;
+
+		if (!no_ack)
+			SendRaw(valid ? "+" : "-", 1);
+
+		if (valid)
+			HandlePacket(packet);
+	}
+
+	input.erase(0, position);
+}
+
+void GdbServer::HandlePacket(const std::string& packet)
+{
+	if (packet.empty())
+	{
+		SendPacket("");
+		return;
+	}
+
+	size_t position = 1;
+
+	switch (packet[0])
+	{
+	case '?':
+	{
+		SendPacket(StopReply());
+
+		break;
+	}
+	case 'g':
+	{
+		Registers registers = system->GetRegisters();
+
+		std::string reply;
+		PutHex16(reply, registers.fa);
+		PutHex16(reply, registers.cb);
+		PutHex16(reply, registers.ed);
+		PutHex16(reply, registers.lh);
+		PutHex16(reply, system->GetSP());
+		PutHex16(reply, system->GetPC());
+
+		SendPacket(reply);
+
+		break;
+	}
+	case 'G':
+	{
+		unsigned char bytes[12];
+
+		if (!ParseHexBytes(packet, 1, bytes, sizeof(bytes)))
+		{
+			SendPacket("E01");
+			break;
+		}
+
+		Registers registers;
+		registers.fa = static_cast<unsigned short>(bytes[0] | bytes[1] << 8);
+		registers.cb = static_cast<unsigned short>(bytes[2] | bytes[3] << 8);
+		registers.ed = static_cast<unsigned short>(bytes[4] | bytes[5] << 8);
+		registers.lh = static_cast<unsigned short>(bytes[6] | bytes[7] << 8);
+
+		system->SetRegisters(registers);
+		system->SetSP(static_cast<unsigned short>(bytes[8] | bytes[9] << 8));
+		system->SetPC(static_cast<unsigned short>(bytes[10] | bytes[11] << 8));
+
+		SendPacket("OK");
+
+		break;
+	}
+	case 'p':
+	case 'P':
+	{
+		unsigned long index = ParseHex(packet, position);
+		Registers registers = system->GetRegisters();
+		unsigned short* fields[4] = { &registers.fa, &registers.cb, &registers.ed, &registers.lh };
+
+		if (packet[0] == 'p')
+		{
+			std::string reply;
+
+			if (index < 4)
+				PutHex16(reply, *fields[index]);
+			else if (index == 4)
+				PutHex16(reply, system->GetSP());
+			else if (index == 5)
+				PutHex16(reply, system->GetPC());
+			else
+				reply = "xxxx";
+
+			SendPacket(reply);
+			break;
+		}
+
+		unsigned char bytes[2];
+
+		if (position >= packet.size() || packet[position] != '=' || !ParseHexBytes(packet, position + 1, bytes, 2))
+		{
+			SendPacket("E01");
+			break;
+		}
+
+		unsigned short value = static_cast<unsigned short>(bytes[0] | bytes[1] << 8);
+
+		if (index < 4)
+		{
+			*fields[index] = value;
+			system->SetRegisters(registers);
+		}
+		else if (index == 4)
+			system->SetSP(value);
+		else if (index == 5)
+			system->SetPC(value);
+
+		// Registers GDB knows from the z80 target but the CPU lacks are ignored
+		SendPacket("OK");
+
+		break;
+	}
+	case 'm':
+	case 'M':
+	{
+		unsigned long address = ParseHex(packet, position);
+
+		if (position >= packet.size() || packet[position] != ',')
+		{
+			SendPacket("E01");
+			break;
+		}
+
+		++position;
+		unsigned long length = ParseHex(packet, position);
+
+		if (address > 0xFFFF || length > max_packet_size / 2 - 4)
+		{
+			SendPacket("E01");
+			break;
+		}
+
+		unsigned char bytes[max_packet_size / 2];
+
+		if (packet[0] == 'm')
+		{
+			system->ReadMemoryBlock(static_cast<unsigned short>(address), length, bytes);
+
+			std::string reply;
+
+			for (unsigned long i = 0; i < length; ++i)
+				PutHex8(reply, bytes[i]);
+
+			SendPacket(reply);
+			break;
+		}
+
+		if (position >= packet.size() || packet[position] != ':' || !ParseHexBytes(packet, position + 1, bytes, length))
+		{
+			SendPacket("E01");
+			break;
+		}
+
+		system->WriteMemoryBlock(static_cast<unsigned short>(address), length, bytes);
+
+		SendPacket("OK");
+
+		break;
+	}
+	case 'c':
+	case 's':
+	{
+		// An optional address to resume at
+		if (position < packet.size())
+			system->SetPC(static_cast<unsigned short>(ParseHex(packet, position)));
+
+		system->Resume(packet[0] == 's');
+		running = true;
+
+		break;
+	}
+	case 'Z':
+	case 'z':
+	{
+		int type = position < packet.size() ? HexValue(packet[position]) : -1;
+		position += 2;
+
+		unsigned long address = ParseHex(packet, position);
+		++position;
+		unsigned long length = ParseHex(packet, position);
+
+		if (type < 0 || type > 4 || address > 0xFFFF)
+		{
+			SendPacket("");
+			break;
+		}
+
+		bool add = packet[0] == 'Z';
+
+		// Software and hardware breakpoints are the same thing here
+		if (type <= 1)
+		{
+			if (add)
+				system->AddBreakpoint(static_cast<unsigned short>(address));
+			else
+				system->RemoveBreakpoint(static_cast<unsigned short>(address));
+		}
+		else
+		{
+			static constexpr WatchType watch_types[3] = { Watch_Write, Watch_Read, Watch_Access };
+
+			unsigned short watch_length = static_cast<unsigned short>(length == 0 ? 1 : length);
+
+			if (add)
+				system->AddWatchpoint(static_cast<unsigned short>(address), watch_length, watch_types[type - 2]);
+			else
+				system->RemoveWatchpoint(static_cast<unsigned short>(address), watch_length, watch_types[type - 2]);
+		}
+
+		SendPacket("OK");
+
+		break;
+	}
+	case 'D':
+	{
+		SendPacket("OK");
+		Detach();
+
+		break;
+	}
+	case 'k':
+	{
+		Detach();
+
+		break;
+	}
+	case 'H':
+	case 'T':
+	{
+		// There is a single thread
+		SendPacket("OK");
+
+		break;
+	}
+	case 'q':
+	{
+		if (packet.starts_with("qSupported"))
+			SendPacket("PacketSize=" + std::to_string(max_packet_size));
+		else if (packet == "qAttached")
+			SendPacket("1");
+		else if (packet == "qC")
+			SendPacket("QC1");
+		else if (packet == "qfThreadInfo")
+			SendPacket("m1");
+		else if (packet == "qsThreadInfo")
+			SendPacket("l");
+		else
+			SendPacket("");
+
+		break;
+	}
+	case 'Q':
+	{
+		if (packet == "QStartNoAckMode")
+		{
+			// The OK is still acknowledged
+			SendPacket("OK");
+			no_ack = true;
+		}
+		else
+			SendPacket("");
+
+		break;
+	}
+	default:
+		// Unsupported, GDB falls back to something else
+		SendPacket("");
+
+		break;
+	}
+}
+
+void GdbServer::SendPacket(const std::string& payload)
+{
+	unsigned char checksum = 0;
+
+	for (char c : payload)
+		checksum += static_cast<unsigned char>(c);
+
+	std::string packet = "$" + payload + "#";
+	PutHex8(packet, checksum);
+
+	SendRaw(packet.data(), packet.size());
+}
+
+void GdbServer::SendRaw(const char* data, size_t length)
+{
+	SocketHandle handle = static_cast<SocketHandle>(client_socket);
+
+	while (length > 0 && client_socket != -1)
+	{
+		int sent = send(handle, data, static_cast<int>(length), send_flags);
+
+		if (sent > 0)
+		{
+			data += sent;
+			length -= sent;
+		}
+		else if (sent < 0 && WouldBlock())
+			std::this_thread::yield();
+		else
+		{
+			// Also a client that closed the connection (EPIPE)
+			Detach();
+			return;
+		}
+	}
+}
+
+std::string GdbServer::StopReply()
+{
+	if (system->GetStopReason() != Stop_Watchpoint)
+		return "S05";
+
+	std::string reply = system->GetWatchType() == Watch_Write ? "T05watch:" : "T05rwatch:";
+
+	unsigned short address = system->GetWatchAddress();
+	PutHex8(reply, static_cast<unsigned char>(address >> 8));
+	PutHex8(reply, static_cast<unsigned char>(address & 0xFF));
+
+	return reply + ";";
+}
+
+void GdbServer::Detach()
+{
+	if (client_socket == -1)
+		return;
+
+	CloseSocket(static_cast<SocketHandle>(client_socket));
+	client_socket = -1;
+	running = false;
+
+	// Leave nothing behind that could stop the CPU with nobody to resume it
+	system->ClearBreakpoints();
+	system->ClearWatchpoints();
+
+	if (system->GetStopReason() != Stop_None)
+		system->Resume();
+
+	logger->Log<LOG_INFO>("GDB client detached");
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "FileLogger.h"
+#include "System.h"
+
+// GDB remote serial protocol stub on a localhost TCP port. Poll services the
+// connection from the emulation thread between frames, so the CPU state is
+// never touched while an instruction runs and a run without a client only
+// pays for one non-blocking accept per frame.
+//
+// There is no SM83 target in GDB, the registers are reported in the order of
+// its z80 target: AF, BC, DE, HL, SP, PC. Connect with
+//
+//   gdb-multiarch -ex "set architecture z80" -ex "target remote localhost:<port>"
+//
+// Supported: registers (g/G/p/P), memory (m/M), continue and step (c/s),
+// breakpoints and watchpoints (Z0-Z4/z0-z4), Ctrl-C, detach and no-ack mode.
+class GdbServer
+{
+public:
+	static constexpr size_t max_packet_size = 4096;
+
+	GdbServer(System* system, FileLogger* logger);
+	~GdbServer();
+
+	bool Listen(unsigned short port);
+	// Called once per frame. While the client holds the CPU stopped it keeps
+	// answering packets as long as they arrive within a few milliseconds.
+	void Poll();
+
+	bool IsAttached();
+
+private:
+	void Accept();
+	// Reads what the client sent, false if it hung up
+	bool Receive(int timeout_ms);
+	void ProcessInput();
+	void HandlePacket(const std::string& packet);
+	void SendPacket(const std::string& payload);
+	void SendRaw(const char* data, size_t length);
+	std::string StopReply();
+	void Detach();
+
+	System* system;
+	FileLogger* logger;
+
+	// Native socket handles, -1 when closed
+	std::intptr_t listen_socket = -1;
+	std::intptr_t client_socket = -1;
+
+	// Received bytes not yet parsed into packets
+	std::string input;
+	bool no_ack = false;
+	// A continue or step is running, its stop still has to be reported
+	bool running = false;
+};
\ No newline at end of file
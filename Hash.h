@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <vector>
+
+// Fast non-cryptographic 64-bit hashing used for state and frame fingerprints.
+
+inline unsigned long long HashMix(unsigned long long value)
+{
+	value ^= value >> 33;
+	value *= 0xFF51AFD7ED558CCDull;
+	value ^= value >> 33;
+	value *= 0xC4CEB9FE1A85EC53ull;
+	value ^= value >> 33;
+
+	return value;
+}
+
+inline unsigned long long HashCombine(unsigned long long seed, unsigned long long value)
+{
+	return HashMix(seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2)));
+}
+
+inline unsigned long long HashBytes(const unsigned char* data, size_t size, unsigned long long seed = 0)
+{
+	unsigned long long hash = seed ^ (size * 0x9E3779B97F4A7C15ull);
+	size_t i = 0;
+
+	for (; i + 8 <= size; i += 8)
+	{
+		unsigned long long word;
+		std::memcpy(&word, data + i, 8);
+
+		hash = (hash ^ HashMix(word)) * 0x100000001B3ull;
+	}
+
+	unsigned long long tail = 0;
+
+	for (size_t shift = 0; i < size; ++i, shift += 8)
+		tail |= static_cast<unsigned long long>(data[i]) << shift;
+
+	return HashMix(hash ^ tail);
+}
+
+
+// 64-bit average hash of a shade image (one byte per pixel): the image is
+// cut into an 8x8 grid and a bit is set for every cell darker than the mean.
+// Small changes flip few bits, so the Hamming distance between two hashes
+// tells a shifted sprite from a broken screen. Width and height must be
+// multiples of 8.
+inline unsigned long long PerceptualHash(const unsigned char* shades, unsigned int width, unsigned int height)
+{
+	unsigned int sums[64]{};
+	unsigned int cell_width = width / 8;
+	unsigned int cell_height = height / 8;
+
+	// Columns are summed down a row of cells first, a plain loop over bytes
+	// the compiler vectorizes, then folded into the eight cells of the row
+	std::vector<unsigned short> columns(width);
+
+	for (unsigned int cell_row = 0; cell_row < 8; ++cell_row)
+	{
+		std::fill(columns.begin(), columns.end(), 0);
+
+		for (unsigned int y = cell_row * cell_height; y < (cell_row + 1) * cell_height; ++y)
+		{
+			const unsigned char* row = shades + y * width;
+
+			for (unsigned int x = 0; x < width; ++x)
+				columns[x] += row[x];
+		}
+
+		for (unsigned int x = 0; x < width; ++x)
+			sums[cell_row * 8 + x / cell_width] += columns[x];
+	}
+
+	unsigned int total = 0;
+
+	for (unsigned int sum : sums)
+		total += sum;
+
+	// sum > total / 64 without losing the remainder
+	unsigned long long hash = 0;
+
+	for (unsigned int cell = 0; cell < 64; ++cell)
+	{
+		if (sums[cell] * 64 > total)
+			hash |= 1ull << cell;
+	}
+
+	return hash;
+}
+
+inline unsigned int HammingDistance(unsigned long long a, unsigned long long b)
+{
+	return static_cast<unsigned int>(std::popcount(a ^ b));
+}
\ No newline at end of file
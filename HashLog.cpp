@@ -0,0 +1,124 @@
+#include "HashLog.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const char hash_log_magic[4] = { 'G', 'B', 'E', 'H' };
+
+HashLog::HashLog(FileLogger* logger)
+{
+	this->logger = logger;
+}
+
+HashLog::~HashLog()
+{
+	Close();
+}
+
+bool HashLog::Create(std::string path, unsigned long long rom_hash)
+{
+	Close();
+
+	output.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if (!output)
+	{
+		logger->Log<LOG_ERROR>("Unable to create hash log: " + path);
+		return false;
+	}
+
+	this->rom_hash = rom_hash;
+	hashes.clear();
+	hashes.reserve(block_size);
+
+	output.write(hash_log_magic, sizeof(hash_log_magic));
+	output.write(reinterpret_cast<const char*>(&version), sizeof(version));
+	output.write(reinterpret_cast<const char*>(&rom_hash), sizeof(rom_hash));
+
+	return true;
+}
+
+void HashLog::Append(unsigned long long hash)
+{
+	if (!output.is_open())
+		return;
+
+	hashes.push_back(hash);
+
+	if (hashes.size() == block_size)
+		Flush();
+}
+
+void HashLog::Flush()
+{
+	output.write(reinterpret_cast<const char*>(hashes.data()), hashes.size() * sizeof(hashes[0]));
+	hashes.clear();
+}
+
+void HashLog::Close()
+{
+	if (!output.is_open())
+		return;
+
+	Flush();
+	output.close();
+}
+
+bool HashLog::Load(std::string path)
+{
+	std::ifstream input(path, std::ios::in | std::ios::binary | std::ios::ate);
+
+	if (!input)
+	{
+		logger->Log<LOG_ERROR>("Unable to open hash log: " + path);
+		return false;
+	}
+
+	size_t size = static_cast<size_t>(input.tellg());
+	input.seekg(0);
+
+	char magic[4]{};
+	unsigned int file_version = 0;
+	size_t header_size = sizeof(magic) + sizeof(file_version) + sizeof(rom_hash);
+
+	input.read(magic, sizeof(magic));
+	input.read(reinterpret_cast<char*>(&file_version), sizeof(file_version));
+	input.read(reinterpret_cast<char*>(&rom_hash), sizeof(rom_hash));
+
+	if (!input || std::memcmp(magic, hash_log_magic, sizeof(magic)) != 0 || file_version != version)
+	{
+		logger->Log<LOG_ERROR>("Not a supported hash log: " + path);
+		return false;
+	}
+
+	// A log cut short by a crash still holds every complete hash
+	hashes.resize((size - header_size) / sizeof(hashes[0]));
+	input.read(reinterpret_cast<char*>(hashes.data()), hashes.size() * sizeof(hashes[0]));
+
+	return static_cast<bool>(input);
+}
+
+const std::vector<unsigned long long>& HashLog::GetHashes()
+{
+	return hashes;
+}
+unsigned long long HashLog::GetRomHash()
+{
+	return rom_hash;
+}
+
+size_t HashLog::FindDivergence(const std::vector<unsigned long long>& a, const std::vector<unsigned long long>& b)
+{
+	size_t length = std::min(a.size(), b.size());
+
+	// Compare whole blocks first, most logs agree for a long time
+	size_t frame = 0;
+
+	while (frame + block_size <= length && std::memcmp(&a[frame], &b[frame], block_size * sizeof(a[0])) == 0)
+		frame += block_size;
+
+	while (frame < length && a[frame] == b[frame])
+		++frame;
+
+	return frame;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+
+// Binary log of one state hash per frame, written by headless runs and
+// compared between builds to find the first frame where they diverge.
+//
+// File layout: "GBEH", version, ROM hash, then one 64-bit hash per frame.
+class HashLog
+{
+public:
+	HashLog(FileLogger* logger);
+	~HashLog();
+
+	bool Create(std::string path, unsigned long long rom_hash);
+	void Append(unsigned long long hash);
+	void Close();
+
+	bool Load(std::string path);
+
+	const std::vector<unsigned long long>& GetHashes();
+	unsigned long long GetRomHash();
+
+	// First frame where the logs differ, the length of the shorter log if one is a prefix of the other
+	static size_t FindDivergence(const std::vector<unsigned long long>& a, const std::vector<unsigned long long>& b);
+
+private:
+	static constexpr unsigned int version = 1;
+	// Hashes are written out in blocks rather than one by one
+	static constexpr size_t block_size = 4096;
+
+	void Flush();
+
+	std::ofstream output;
+	std::vector<unsigned long long> hashes;
+	unsigned long long rom_hash{};
+
+	FileLogger* logger;
+};
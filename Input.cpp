@@ -1,44 +1,91 @@
 #include "Input.h"
 
+struct KeyBinding
+{
+	SDL_Keycode keycode;
+	JoypadButtons button;
+};
+
+static constexpr KeyBinding key_bindings[] =
+{
+	{ SDLK_d, Joypad_Right },
+	{ SDLK_a, Joypad_Left },
+	{ SDLK_w, Joypad_Up },
+	{ SDLK_s, Joypad_Down },
+	{ SDLK_k, Joypad_A },
+	{ SDLK_j, Joypad_B },
+	{ SDLK_n, Joypad_Select },
+	{ SDLK_m, Joypad_Start }
+};
+
 Input::Input(System* system, FileLogger* logger)
 {
 	this->system = system;
 	this->logger = logger;
 
-	SDL_Init(SDL_INIT_EVENTS);
 	if (SDL_Init(SDL_INIT_EVENTS) < 0)
-		logger->Log(LOG_ERROR, "Unable to initialize SDL - Events.");
+		logger->Log<LOG_ERROR>("Unable to initialize SDL - Events.");
+
+	SDL_AddEventWatch(&Input::OnEvent, this);
 }
 
-void Input::UpdateKeymap()
+Input::~Input()
 {
-	SDL_PumpEvents();
+	SDL_DelEventWatch(&Input::OnEvent, this);
+}
 
-	unsigned char joypad = system->GetInputRegister();
+int Input::OnEvent(void* userdata, SDL_Event* event)
+{
+	// Repeats of a held key change nothing
+	if ((event->type == SDL_KEYDOWN || event->type == SDL_KEYUP) && event->key.repeat == 0)
+		static_cast<Input*>(userdata)->OnKey(event->key.keysym.sym, event->type == SDL_KEYDOWN);
 
-	if ((joypad & (1 << 5)) == 0)
-	{
-		joypad &= 0xFF & GetKey(SDLK_d) << 0;
-		joypad &= 0xFF & GetKey(SDLK_a) << 1;
-		joypad &= 0xFF & GetKey(SDLK_w) << 2;
-		joypad &= 0xFF & GetKey(SDLK_s) << 3;
-	}
-	else if ((joypad & (1 << 4)) == 0)
+	return 0;
+}
+
+void Input::OnKey(SDL_Keycode keycode, bool pressed)
+{
+	for (const KeyBinding& binding : key_bindings)
 	{
-		joypad &= 0xFF & GetKey(SDLK_k) << 0;
-		joypad &= 0xFF & GetKey(SDLK_j) << 1;
-		joypad &= 0xFF & GetKey(SDLK_n) << 2;
-		joypad &= 0xFF & GetKey(SDLK_m) << 3;
+		if (binding.keycode != keycode)
+			continue;
+
+		unsigned char mask = static_cast<unsigned char>(1 << binding.button);
+
+		if (pressed)
+			buttons.fetch_or(mask, std::memory_order_relaxed);
+		else
+			buttons.fetch_and(static_cast<unsigned char>(~mask), std::memory_order_relaxed);
+
+		return;
 	}
 
-	system->SetInputRegister(joypad);
+	if (keycode == SDLK_BACKSPACE)
+		rewind_held.store(pressed, std::memory_order_relaxed);
+	else if (keycode == SDLK_F12)
+		flight_dump_held.store(pressed, std::memory_order_relaxed);
 }
 
-unsigned char Input::GetKey(SDL_Keycode keycode)
+void Input::UpdateKeymap()
 {
-	SDL_Scancode scancode = SDL_GetScancodeFromKey(keycode);
+	// Runs the event watch on whatever arrived since the last frame, the
+	// events stay queued for the Renderer
+	SDL_PumpEvents();
 
-	const Uint8* boyboard_state = SDL_GetKeyboardState(NULL);
+	system->SetJoypad(GetButtons());
+}
 
-	return boyboard_state[scancode] ^ 1;
+unsigned char Input::GetButtons()
+{
+	return buttons.load(std::memory_order_relaxed);
+}
+
+bool Input::IsRewinding()
+{
+	return rewind_held.load(std::memory_order_relaxed);
+}
+
+bool Input::IsFlightDumpRequested()
+{
+	return flight_dump_held.load(std::memory_order_relaxed);
 }
\ No newline at end of file
@@ -2,19 +2,40 @@
 
 #include "SDL.h"
 
+#include <atomic>
+
 #include "System.h"
 #include "FileLogger.h"
 
+// Keyboard input for the emulated joypad. Key events are caught by an SDL
+// event watch as they are pumped, so the held buttons are a byte that only
+// changes when a key goes down or up, and the Renderer still gets every event
+// from the queue. UpdateKeymap hands that byte to the System once per frame,
+// nothing in the instruction loop touches SDL.
 class Input
 {
 public:
 	Input(System* system, FileLogger* logger);
+	~Input();
+
+	// Pumps pending events and passes the held buttons on to the System
 	void UpdateKeymap();
+	// Held buttons as a mask of JoypadButtons bits
+	unsigned char GetButtons();
+	// Rewind is held on backspace
+	bool IsRewinding();
+	// F12 asks for a flight recorder dump
+	bool IsFlightDumpRequested();
 
 private:
-	unsigned char GetKey(SDL_Keycode keycode);
+	// SDL may call watches from the thread that pushed the event
+	static int OnEvent(void* userdata, SDL_Event* event);
+	void OnKey(SDL_Keycode keycode, bool pressed);
+
+	std::atomic<unsigned char> buttons{};
+	std::atomic<bool> rewind_held{};
+	std::atomic<bool> flight_dump_held{};
 
 	System* system{};
 	FileLogger* logger{};
-};
-
+};
\ No newline at end of file
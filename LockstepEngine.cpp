@@ -0,0 +1,502 @@
+#include "LockstepEngine.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GBE_LOCKSTEP_SSE2
+#include <emmintrin.h>
+#endif
+
+// 16 x 8-bit vector helpers, SSE2 with a plain loop fallback
+#ifdef GBE_LOCKSTEP_SSE2
+typedef __m128i Lanes;
+
+static inline Lanes LanesLoad(const unsigned char* p) { return _mm_load_si128(reinterpret_cast<const __m128i*>(p)); }
+static inline void LanesStore(unsigned char* p, Lanes v) { _mm_store_si128(reinterpret_cast<__m128i*>(p), v); }
+static inline Lanes LanesSet(unsigned char x) { return _mm_set1_epi8(static_cast<char>(x)); }
+static inline Lanes LanesAdd(Lanes a, Lanes b) { return _mm_add_epi8(a, b); }
+static inline Lanes LanesSub(Lanes a, Lanes b) { return _mm_sub_epi8(a, b); }
+static inline Lanes LanesAddSat(Lanes a, Lanes b) { return _mm_adds_epu8(a, b); }
+static inline Lanes LanesSubSat(Lanes a, Lanes b) { return _mm_subs_epu8(a, b); }
+static inline Lanes LanesAnd(Lanes a, Lanes b) { return _mm_and_si128(a, b); }
+static inline Lanes LanesOr(Lanes a, Lanes b) { return _mm_or_si128(a, b); }
+static inline Lanes LanesXor(Lanes a, Lanes b) { return _mm_xor_si128(a, b); }
+// ~a & b
+static inline Lanes LanesAndNot(Lanes a, Lanes b) { return _mm_andnot_si128(a, b); }
+// 0xFF where equal
+static inline Lanes LanesEq(Lanes a, Lanes b) { return _mm_cmpeq_epi8(a, b); }
+#else
+struct Lanes
+{
+	unsigned char v[16];
+};
+
+#define LANES_OP(name, expr) \
+	static inline Lanes name(Lanes a, Lanes b) { Lanes r; for (int i = 0; i < 16; ++i) r.v[i] = static_cast<unsigned char>(expr); return r; }
+
+static inline Lanes LanesLoad(const unsigned char* p) { Lanes r; std::memcpy(r.v, p, 16); return r; }
+static inline void LanesStore(unsigned char* p, Lanes v) { std::memcpy(p, v.v, 16); }
+static inline Lanes LanesSet(unsigned char x) { Lanes r; std::memset(r.v, x, 16); return r; }
+LANES_OP(LanesAdd, a.v[i] + b.v[i])
+LANES_OP(LanesSub, a.v[i] - b.v[i])
+LANES_OP(LanesAddSat, a.v[i] + b.v[i] > 0xFF ? 0xFF : a.v[i] + b.v[i])
+LANES_OP(LanesSubSat, a.v[i] < b.v[i] ? 0 : a.v[i] - b.v[i])
+LANES_OP(LanesAnd, a.v[i] & b.v[i])
+LANES_OP(LanesOr, a.v[i] | b.v[i])
+LANES_OP(LanesXor, a.v[i] ^ b.v[i])
+LANES_OP(LanesAndNot, ~a.v[i] & b.v[i])
+LANES_OP(LanesEq, a.v[i] == b.v[i] ? 0xFF : 0)
+
+#undef LANES_OP
+#endif
+
+static const unsigned char flag_z = 1 << Zero;
+static const unsigned char flag_n = 1 << Subtract;
+static const unsigned char flag_h = 1 << Half_Carry;
+static const unsigned char flag_c = 1 << Carry;
+
+// Flags of the 8-bit ALU ops, matching System::AsmADD_A and friends bit for bit
+static inline Lanes ZeroFlag(Lanes value)
+{
+	return LanesAnd(LanesEq(value, LanesSet(0)), LanesSet(flag_z));
+}
+static inline Lanes CarryInBits(Lanes f)
+{
+	return LanesAnd(LanesEq(LanesAnd(f, LanesSet(flag_c)), LanesSet(flag_c)), LanesSet(1));
+}
+static inline void AddFlags(Lanes a, Lanes value, Lanes& h, Lanes& c)
+{
+	Lanes low = LanesAdd(LanesAnd(a, LanesSet(0x0F)), LanesAnd(value, LanesSet(0x0F)));
+	Lanes high_a = LanesAnd(a, LanesSet(0xF0));
+	Lanes high_value = LanesAnd(value, LanesSet(0xF0));
+
+	h = LanesAnd(LanesEq(LanesAnd(low, LanesSet(0x10)), LanesSet(0x10)), LanesSet(flag_h));
+	c = LanesAndNot(LanesEq(LanesAdd(high_a, high_value), LanesAddSat(high_a, high_value)), LanesSet(flag_c));
+}
+static inline void SubFlags(Lanes a, Lanes value, Lanes& h, Lanes& c)
+{
+	Lanes low = LanesSub(LanesAnd(a, LanesSet(0x0F)), LanesAnd(value, LanesSet(0x0F)));
+	Lanes high_a = LanesAnd(a, LanesSet(0xF0));
+	Lanes high_value = LanesAnd(value, LanesSet(0xF0));
+
+	h = LanesAnd(LanesEq(LanesAnd(low, LanesSet(0x10)), LanesSet(0x10)), LanesSet(flag_h));
+	c = LanesAndNot(LanesEq(LanesSubSat(high_value, high_a), LanesSet(0)), LanesSet(flag_c));
+}
+
+LockstepEngine::LockstepEngine(FileLogger* logger, unsigned int lane_count)
+{
+	if (lane_count > max_lanes)
+		lane_count = max_lanes;
+
+	this->lane_count = lane_count;
+
+	for (unsigned int lane = 0; lane < lane_count; ++lane)
+		systems[lane] = new System(logger);
+}
+
+LockstepEngine::~LockstepEngine()
+{
+	for (unsigned int lane = 0; lane < lane_count; ++lane)
+		delete systems[lane];
+}
+
+void LockstepEngine::LoadRom(const unsigned char* data, size_t size)
+{
+	for (unsigned int lane = 0; lane < lane_count; ++lane)
+		systems[lane]->LoadRom(data, size);
+
+	lanes_loaded = false;
+	vector_cycles = 0;
+}
+
+void LockstepEngine::SetJoypad(unsigned int lane, unsigned char buttons)
+{
+	systems[lane]->SetJoypad(buttons);
+}
+
+System* LockstepEngine::GetSystem(unsigned int lane)
+{
+	if (lanes_loaded)
+		StoreLanes();
+
+	return systems[lane];
+}
+
+unsigned int LockstepEngine::GetLaneCount()
+{
+	return lane_count;
+}
+
+void LockstepEngine::RunFrame()
+{
+	for (unsigned int lane = 0; lane < lane_count; ++lane)
+		frame_target[lane] = systems[lane]->frame_count + 1;
+
+	while (true)
+	{
+		if (!lanes_loaded && CanVectorize())
+			LoadLanes();
+
+		if (lanes_loaded)
+		{
+			if (VectorStep())
+				continue;
+
+			StoreLanes();
+		}
+
+		bool any_active = false;
+		bool diverged = false;
+
+		ScalarStep(any_active, diverged);
+
+		if (!any_active)
+			break;
+
+		++scalar_steps;
+
+		if (diverged)
+			++divergent_steps;
+	}
+}
+
+bool LockstepEngine::IsVectorizable(unsigned char op)
+{
+	unsigned int x = (op >> 3) & 7;
+	unsigned int y = op & 7;
+
+	return op == 0x00 ||
+		(op >= 0x40 && op < 0x80 && x != 6 && y != 6) ||
+		(op >= 0x80 && op < 0xC0 && y != 6) ||
+		((op & 0xC7) == 0x04 && x != 6) ||
+		((op & 0xC7) == 0x05 && x != 6) ||
+		((op & 0xC7) == 0x06 && x != 6) ||
+		(op & 0xC7) == 0xC6 ||
+		((op & 0xCF) == 0x03 && op != 0x33) ||
+		((op & 0xCF) == 0x0B && op != 0x3B);
+}
+
+bool LockstepEngine::CanVectorize()
+{
+	unsigned short shared_pc = systems[0]->pc;
+
+	// Cheap early out before looking at every lane
+	if (!IsVectorizable(systems[0]->ReadMemoryUnwatched(shared_pc)))
+		return false;
+
+	for (unsigned int lane = 0; lane < lane_count; ++lane)
+	{
+		System* system = systems[lane];
+
+		if (!system->running || system->halted || system->frame_count >= frame_target[lane])
+			return false;
+		if (system->pc != shared_pc)
+			return false;
+		// An interrupt will be dispatched after the next instruction
+		if (system->IME && (system->ReadMemoryUnwatched(0xFF0F) & system->ReadMemoryUnwatched(0xFFFF) & 0x1F) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+void LockstepEngine::LoadLanes()
+{
+	pc = systems[0]->pc;
+	line_budget = System::cycles_per_line;
+
+	for (unsigned int lane = 0; lane < lane_count; ++lane)
+	{
+		System* system = systems[lane];
+
+		regs[0][lane] = system->registers.b;
+		regs[1][lane] = system->registers.c;
+		regs[2][lane] = system->registers.d;
+		regs[3][lane] = system->registers.e;
+		regs[4][lane] = system->registers.h;
+		regs[5][lane] = system->registers.l;
+		regs[reg_f][lane] = system->registers.f;
+		regs[reg_a][lane] = system->registers.a;
+		sp[lane] = system->sp;
+
+		unsigned int budget = System::cycles_per_line - system->frame_cycles % System::cycles_per_line;
+
+		if (budget < line_budget)
+			line_budget = budget;
+	}
+
+	vector_cycles = 0;
+	lanes_loaded = true;
+}
+
+void LockstepEngine::StoreLanes()
+{
+	for (unsigned int lane = 0; lane < lane_count; ++lane)
+	{
+		System* system = systems[lane];
+
+		system->registers.b = regs[0][lane];
+		system->registers.c = regs[1][lane];
+		system->registers.d = regs[2][lane];
+		system->registers.e = regs[3][lane];
+		system->registers.h = regs[4][lane];
+		system->registers.l = regs[5][lane];
+		system->registers.f = regs[reg_f][lane];
+		system->registers.a = regs[reg_a][lane];
+		system->sp = sp[lane];
+		system->pc = pc;
+
+		// No LCD line was crossed in lockstep, so LY and the interrupt flags are still valid
+		system->cycles += vector_cycles;
+		system->frame_cycles += vector_cycles;
+
+		if (vector_cycles != 0)
+			system->opcode = last_opcode;
+	}
+
+	vector_cycles = 0;
+	lanes_loaded = false;
+}
+
+void LockstepEngine::ScalarStep(bool& any_active, bool& diverged)
+{
+	unsigned short first_pc = 0;
+	bool first = true;
+
+	for (unsigned int lane = 0; lane < lane_count; ++lane)
+	{
+		System* system = systems[lane];
+
+		if (!system->running || system->frame_count >= frame_target[lane])
+			continue;
+
+		if (first)
+			first_pc = system->pc;
+		else if (system->pc != first_pc)
+			diverged = true;
+
+		first = false;
+		any_active = true;
+
+		system->EmulateCycle();
+
+		++lane_instructions;
+	}
+}
+
+void LockstepEngine::Alu(unsigned int operation, unsigned char* value)
+{
+	Lanes a = LanesLoad(regs[reg_a]);
+	Lanes f = LanesLoad(regs[reg_f]);
+	Lanes v = LanesLoad(value);
+	Lanes h, c;
+
+	// Flag bits below the four CPU flags are preserved like SetBitflag/ClearBitflag do
+	Lanes low_bits = LanesAnd(f, LanesSet(0x0F));
+
+	switch (operation)
+	{
+	// ADD
+	case 0:
+	{
+		AddFlags(a, v, h, c);
+		a = LanesAdd(a, v);
+		f = LanesOr(LanesOr(low_bits, ZeroFlag(a)), LanesOr(h, c));
+
+		break;
+	}
+	// ADC, the result adds the carry flag as updated by this instruction
+	case 1:
+	{
+		AddFlags(a, LanesAdd(v, CarryInBits(f)), h, c);
+		a = LanesAdd(a, LanesAdd(v, CarryInBits(c)));
+		f = LanesOr(LanesOr(low_bits, ZeroFlag(a)), LanesOr(h, c));
+
+		break;
+	}
+	// SUB
+	case 2:
+	{
+		SubFlags(a, v, h, c);
+		a = LanesSub(a, v);
+		f = LanesOr(LanesOr(low_bits, ZeroFlag(a)), LanesOr(LanesSet(flag_n), LanesOr(h, c)));
+
+		break;
+	}
+	// SBC
+	case 3:
+	{
+		SubFlags(a, LanesAdd(v, CarryInBits(f)), h, c);
+		a = LanesSub(a, LanesAdd(v, CarryInBits(c)));
+		f = LanesOr(LanesOr(low_bits, ZeroFlag(a)), LanesOr(LanesSet(flag_n), LanesOr(h, c)));
+
+		break;
+	}
+	// AND
+	case 4:
+	{
+		a = LanesAnd(a, v);
+		f = LanesOr(LanesOr(low_bits, ZeroFlag(a)), LanesSet(flag_h));
+
+		break;
+	}
+	// XOR
+	case 5:
+	{
+		a = LanesXor(a, v);
+		f = LanesOr(low_bits, ZeroFlag(a));
+
+		break;
+	}
+	// OR
+	case 6:
+	{
+		a = LanesOr(a, v);
+		f = LanesOr(low_bits, ZeroFlag(a));
+
+		break;
+	}
+	// CP
+	case 7:
+	{
+		SubFlags(a, v, h, c);
+		// Unlike SUB, CP derives the carry from the full 8-bit comparison
+		c = LanesAndNot(LanesEq(LanesSubSat(v, a), LanesSet(0)), LanesSet(flag_c));
+		f = LanesOr(LanesOr(low_bits, LanesAnd(LanesEq(a, v), LanesSet(flag_z))), LanesOr(LanesSet(flag_n), LanesOr(h, c)));
+
+		break;
+	}
+	}
+
+	LanesStore(regs[reg_a], a);
+	LanesStore(regs[reg_f], f);
+}
+
+bool LockstepEngine::VectorStep()
+{
+	unsigned char op = systems[0]->ReadMemoryUnwatched(pc);
+
+	for (unsigned int lane = 1; lane < lane_count; ++lane)
+	{
+		if (systems[lane]->ReadMemoryUnwatched(pc) != op)
+			return false;
+	}
+
+	if (!IsVectorizable(op))
+		return false;
+
+	unsigned int x = (op >> 3) & 7;
+	unsigned int y = op & 7;
+	unsigned int length = 1;
+
+	unsigned int cycles = System::opcode_cycles[op];
+
+	// Crossing an LCD line changes LY and may raise VBlank, leave that to System
+	if (vector_cycles + cycles >= line_budget)
+		return false;
+
+	alignas(16) unsigned char immediate[max_lanes]{};
+
+	if ((op & 0xC7) == 0x06 || (op & 0xC7) == 0xC6)
+	{
+		length = 2;
+
+		for (unsigned int lane = 0; lane < lane_count; ++lane)
+			immediate[lane] = systems[lane]->ReadMemoryUnwatched(static_cast<unsigned short>(pc + 1));
+	}
+
+	if (op == 0x00)
+	{
+		// NOP
+	}
+	else if (op >= 0x40 && op < 0x80)
+	{
+		// LD r,r'
+		LanesStore(regs[x], LanesLoad(regs[y]));
+	}
+	else if (op >= 0x80 && op < 0xC0)
+	{
+		Alu(x, regs[y]);
+	}
+	else if ((op & 0xC7) == 0xC6)
+	{
+		Alu(x, immediate);
+	}
+	else if ((op & 0xC7) == 0x06)
+	{
+		// LD r,n
+		LanesStore(regs[x], LanesLoad(immediate));
+	}
+	else if ((op & 0xC7) == 0x04)
+	{
+		// INC r
+		Lanes value = LanesLoad(regs[x]);
+		Lanes f = LanesLoad(regs[reg_f]);
+		Lanes h = LanesAnd(LanesEq(LanesAnd(value, LanesSet(0x0F)), LanesSet(0x0F)), LanesSet(flag_h));
+
+		value = LanesAdd(value, LanesSet(1));
+		f = LanesOr(LanesAnd(f, LanesSet(0x0F | flag_c)), LanesOr(ZeroFlag(value), h));
+
+		LanesStore(regs[x], value);
+		LanesStore(regs[reg_f], f);
+	}
+	else if ((op & 0xC7) == 0x05)
+	{
+		// DEC r
+		Lanes value = LanesLoad(regs[x]);
+		Lanes f = LanesLoad(regs[reg_f]);
+		Lanes h = LanesAnd(LanesEq(LanesAnd(value, LanesSet(0x0F)), LanesSet(0)), LanesSet(flag_h));
+
+		value = LanesSub(value, LanesSet(1));
+		f = LanesOr(LanesAnd(f, LanesSet(0x0F | flag_c)), LanesOr(LanesOr(ZeroFlag(value), h), LanesSet(flag_n)));
+
+		LanesStore(regs[x], value);
+		LanesStore(regs[reg_f], f);
+	}
+	else
+	{
+		// INC rr / DEC rr on BC, DE, HL: the high byte moves when the low byte wraps
+		unsigned char* high = regs[(op >> 4) * 2];
+		unsigned char* low = regs[(op >> 4) * 2 + 1];
+		Lanes lo = LanesLoad(low);
+		Lanes hi = LanesLoad(high);
+
+		if ((op & 0x0F) == 0x03)
+		{
+			lo = LanesAdd(lo, LanesSet(1));
+			hi = LanesSub(hi, LanesEq(lo, LanesSet(0)));
+		}
+		else
+		{
+			hi = LanesAdd(hi, LanesEq(lo, LanesSet(0)));
+			lo = LanesSub(lo, LanesSet(1));
+		}
+
+		LanesStore(low, lo);
+		LanesStore(high, hi);
+	}
+
+	pc += length;
+	vector_cycles += cycles;
+	last_opcode = op;
+
+	++vector_steps;
+	lane_instructions += lane_count;
+
+	return true;
+}
+
+unsigned long long LockstepEngine::GetVectorSteps()
+{
+	return vector_steps;
+}
+unsigned long long LockstepEngine::GetScalarSteps()
+{
+	return scalar_steps;
+}
+unsigned long long LockstepEngine::GetDivergentSteps()
+{
+	return divergent_steps;
+}
+unsigned long long LockstepEngine::GetLaneInstructions()
+{
+	return lane_instructions;
+}
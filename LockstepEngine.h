@@ -0,0 +1,74 @@
+#pragma once
+
+#include "FileLogger.h"
+#include "System.h"
+
+// Experimental engine that runs up to 16 instances of the same ROM in lockstep.
+//
+// While every instance sits at the same PC and the next instruction only works
+// on registers, it is executed once for all instances on structure-of-arrays
+// CPU state with SIMD (one byte lane per instance). Anything else - memory
+// access, control flow, interrupts, LCD line changes or instances at different
+// PCs - falls back to System::EmulateCycle on each instance, so results are
+// identical to running the instances independently.
+class LockstepEngine
+{
+public:
+	static constexpr unsigned int max_lanes = 16;
+
+	LockstepEngine(FileLogger* logger, unsigned int lane_count);
+	~LockstepEngine();
+
+	void LoadRom(const unsigned char* data, size_t size);
+	void SetJoypad(unsigned int lane, unsigned char buttons);
+
+	// Runs every instance until it has completed one more frame
+	void RunFrame();
+
+	System* GetSystem(unsigned int lane);
+	unsigned int GetLaneCount();
+
+	// Instructions issued once for all lanes
+	unsigned long long GetVectorSteps();
+	// Steps where the lanes ran one by one
+	unsigned long long GetScalarSteps();
+	// Scalar steps caused by lanes being at different PCs
+	unsigned long long GetDivergentSteps();
+	// Instructions retired summed over all lanes
+	unsigned long long GetLaneInstructions();
+
+private:
+	static bool IsVectorizable(unsigned char op);
+	bool CanVectorize();
+	bool VectorStep();
+	void ScalarStep(bool& any_active, bool& diverged);
+	void LoadLanes();
+	void StoreLanes();
+	void Alu(unsigned int operation, unsigned char* value);
+
+	// Registers indexed like the opcode encoding: B C D E H L F A (F takes the (HL) slot)
+	static constexpr unsigned int reg_f = 6;
+	static constexpr unsigned int reg_a = 7;
+
+	alignas(16) unsigned char regs[8][max_lanes]{};
+	unsigned short sp[max_lanes]{};
+	// Shared program counter while the lanes are converged
+	unsigned short pc{};
+
+	// True while the structure-of-arrays state is authoritative instead of the Systems
+	bool lanes_loaded = false;
+	// Clock ticks run in lockstep that have not been applied to the Systems yet
+	unsigned int vector_cycles{};
+	// Ticks until the first lane reaches its next LCD line
+	unsigned int line_budget{};
+	unsigned char last_opcode{};
+
+	unsigned int lane_count{};
+	System* systems[max_lanes]{};
+	unsigned long long frame_target[max_lanes]{};
+
+	unsigned long long vector_steps{};
+	unsigned long long scalar_steps{};
+	unsigned long long divergent_steps{};
+	unsigned long long lane_instructions{};
+};
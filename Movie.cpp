@@ -0,0 +1,297 @@
+#include "Movie.h"
+
+#include "Rewind.h"
+
+static const char movie_magic[4] = { 'G', 'B', 'E', 'M' };
+
+Movie::Movie(FileLogger* logger)
+{
+	this->logger = logger;
+}
+
+void Movie::StartRecording(System* system, unsigned int keyframe_interval)
+{
+	inputs.clear();
+	keyframes.clear();
+
+	this->keyframe_interval = keyframe_interval > 0 ? keyframe_interval : default_keyframe_interval;
+
+	rom_hash = system->GetRomHash();
+	final_hash = system->GetStateHash();
+	position = 0;
+	frame_pending = false;
+	recording = true;
+}
+
+void Movie::RecordFrame(System* system)
+{
+	// A CPU stopped by the debugger runs nothing that could be recorded
+	if (!recording || system->GetStopReason() != Stop_None)
+		return;
+
+	// A frame cut short by a breakpoint is finished with the input it started with
+	if (frame_pending)
+		system->SetJoypad(inputs.back());
+	else
+	{
+		if (position % keyframe_interval == 0)
+			AddKeyframe(system);
+
+		inputs.push_back(system->GetJoypad());
+	}
+
+	unsigned long long frame = system->GetFrameCount();
+
+	system->RunFrame();
+
+	frame_pending = system->GetFrameCount() == frame;
+
+	if (frame_pending)
+		return;
+
+	++position;
+
+	// Kept for a recording that stops inside the next frame
+	final_hash = system->GetStateHash();
+}
+
+void Movie::StopRecording(System* system)
+{
+	if (!recording)
+		return;
+
+	// Playback could not stop inside a frame, so a frame a breakpoint cut short
+	// is left out and the movie ends on the last completed one
+	if (frame_pending)
+	{
+		logger->Log<LOG_WARNING>("Recording stopped inside a frame, the movie ends before it.");
+
+		inputs.pop_back();
+		frame_pending = false;
+	}
+
+	// An empty movie still needs its starting state
+	if (keyframes.empty())
+		AddKeyframe(system);
+
+	recording = false;
+	last_keyframe.clear();
+}
+
+void Movie::AddKeyframe(System* system)
+{
+	Keyframe keyframe{ position, {} };
+
+	if (keyframes.empty())
+	{
+		system->SaveState(keyframe.data);
+		last_keyframe = keyframe.data;
+	}
+	else
+	{
+		system->SaveState(scratch);
+
+		// Keyframes are far apart, so every page is compared rather than
+		// taking the dirty pages Rewind relies on
+		DirtyPages pages;
+		std::fill(std::begin(pages.bits), std::end(pages.bits), ~0ull);
+
+		keyframe.data.resize(System::state_size + 32);
+		keyframe.data.resize(Rewind::Encode(scratch.data(), last_keyframe.data(), pages, keyframe.data.data()));
+		keyframe.data.shrink_to_fit();
+
+		last_keyframe.swap(scratch);
+	}
+
+	keyframes.push_back(std::move(keyframe));
+}
+
+bool Movie::DecodeKeyframes(size_t last, std::vector<unsigned char>& state)
+{
+	state = keyframes[0].data;
+
+	for (size_t i = 1; i <= last; ++i)
+	{
+		if (!Rewind::Decode(keyframes[i].data.data(), keyframes[i].data.size(), state.data()))
+			return false;
+	}
+
+	return true;
+}
+
+bool Movie::Save(std::string path)
+{
+	std::ofstream output(path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if (!output)
+	{
+		logger->Log<LOG_ERROR>("Unable to create movie: " + path);
+		return false;
+	}
+
+	unsigned int frame_count = static_cast<unsigned int>(inputs.size());
+	unsigned int keyframe_count = static_cast<unsigned int>(keyframes.size());
+
+	output.write(movie_magic, sizeof(movie_magic));
+	output.write(reinterpret_cast<const char*>(&version), sizeof(version));
+	output.write(reinterpret_cast<const char*>(&rom_hash), sizeof(rom_hash));
+	output.write(reinterpret_cast<const char*>(&final_hash), sizeof(final_hash));
+	output.write(reinterpret_cast<const char*>(&frame_count), sizeof(frame_count));
+	output.write(reinterpret_cast<const char*>(&keyframe_interval), sizeof(keyframe_interval));
+	output.write(reinterpret_cast<const char*>(&keyframe_count), sizeof(keyframe_count));
+
+	output.write(reinterpret_cast<const char*>(inputs.data()), inputs.size());
+
+	for (auto& keyframe : keyframes)
+	{
+		unsigned int size = static_cast<unsigned int>(keyframe.data.size());
+
+		output.write(reinterpret_cast<const char*>(&keyframe.frame), sizeof(keyframe.frame));
+		output.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		output.write(reinterpret_cast<const char*>(keyframe.data.data()), size);
+	}
+
+	return static_cast<bool>(output);
+}
+
+bool Movie::Load(std::string path)
+{
+	std::ifstream input(path, std::ios::in | std::ios::binary);
+
+	if (!input)
+	{
+		logger->Log<LOG_ERROR>("Unable to open movie: " + path);
+		return false;
+	}
+
+	char magic[4]{};
+	unsigned int file_version = 0;
+	unsigned int frame_count = 0;
+	unsigned int keyframe_count = 0;
+
+	input.read(magic, sizeof(magic));
+	input.read(reinterpret_cast<char*>(&file_version), sizeof(file_version));
+
+	if (!input || std::memcmp(magic, movie_magic, sizeof(magic)) != 0 || file_version != version)
+	{
+		logger->Log<LOG_ERROR>("Not a supported movie file: " + path);
+		return false;
+	}
+
+	input.read(reinterpret_cast<char*>(&rom_hash), sizeof(rom_hash));
+	input.read(reinterpret_cast<char*>(&final_hash), sizeof(final_hash));
+	input.read(reinterpret_cast<char*>(&frame_count), sizeof(frame_count));
+	input.read(reinterpret_cast<char*>(&keyframe_interval), sizeof(keyframe_interval));
+	input.read(reinterpret_cast<char*>(&keyframe_count), sizeof(keyframe_count));
+
+	inputs.resize(frame_count);
+	input.read(reinterpret_cast<char*>(inputs.data()), frame_count);
+
+	keyframes.clear();
+	keyframes.reserve(keyframe_count);
+
+	for (unsigned int i = 0; i < keyframe_count && input; ++i)
+	{
+		Keyframe keyframe;
+		unsigned int size = 0;
+
+		input.read(reinterpret_cast<char*>(&keyframe.frame), sizeof(keyframe.frame));
+		input.read(reinterpret_cast<char*>(&size), sizeof(size));
+
+		// The first keyframe is a whole state, a delta is at most one literal run over it
+		if (i == 0 ? size != System::state_size : size > System::state_size + 32)
+			break;
+
+		keyframe.data.resize(size);
+		input.read(reinterpret_cast<char*>(keyframe.data.data()), size);
+
+		keyframes.push_back(std::move(keyframe));
+	}
+
+	// Seek relies on the keyframes being sorted, with the first one at frame 0
+	bool sorted = std::is_sorted(keyframes.begin(), keyframes.end(), [](const Keyframe& a, const Keyframe& b) { return a.frame < b.frame; });
+
+	if (!input || keyframes.size() != keyframe_count || keyframes.empty() || keyframes[0].frame != 0 || !sorted || !DecodeKeyframes(keyframes.size() - 1, scratch))
+	{
+		logger->Log<LOG_ERROR>("Corrupt movie file: " + path);
+		return false;
+	}
+
+	position = 0;
+	recording = false;
+
+	return true;
+}
+
+bool Movie::StartPlayback(System* system)
+{
+	if (system->GetRomHash() != rom_hash)
+	{
+		logger->Log<LOG_ERROR>("Movie was recorded with a different rom.");
+		return false;
+	}
+
+	return Seek(system, 0);
+}
+
+bool Movie::PlayFrame(System* system)
+{
+	if (position >= inputs.size())
+		return false;
+
+	system->SetJoypad(inputs[position]);
+	system->RunFrame();
+
+	++position;
+
+	return true;
+}
+
+bool Movie::Seek(System* system, unsigned int frame)
+{
+	if (keyframes.empty() || frame > inputs.size())
+		return false;
+
+	// Start from the last keyframe before the target so at least one frame is
+	// replayed and the framebuffer shows the frame just before the target
+	auto keyframe = std::lower_bound(keyframes.begin(), keyframes.end(), frame, [](const Keyframe& k, unsigned int f) { return k.frame < f; });
+
+	if (keyframe != keyframes.begin())
+		--keyframe;
+
+	if (!DecodeKeyframes(keyframe - keyframes.begin(), scratch) || !system->LoadState(scratch.data(), scratch.size()))
+		return false;
+
+	position = keyframe->frame;
+
+	bool rendering = system->IsRenderingEnabled();
+
+	system->SetRenderingEnabled(false);
+
+	while (position + 1 < frame)
+		PlayFrame(system);
+
+	system->SetRenderingEnabled(rendering);
+
+	if (position < frame)
+		PlayFrame(system);
+
+	return true;
+}
+
+unsigned int Movie::GetFrameCount()
+{
+	return static_cast<unsigned int>(inputs.size());
+}
+unsigned int Movie::GetPosition()
+{
+	return position;
+}
+size_t Movie::GetKeyframeCount()
+{
+	return keyframes.size();
+}
+unsigned long long Movie::GetFinalHash()
+{
+	return final_hash;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+#include "System.h"
+
+// Recording of a session as one joypad byte per frame plus save state keyframes.
+//
+// Playback is bit-exact because the core only sees input through
+// System::SetJoypad, once per frame. Keyframes are taken every
+// keyframe_interval frames so Seek only has to replay a short stretch from the
+// nearest keyframe. The first keyframe is the state recording started from, so
+// a movie does not have to begin at power on. Every later keyframe is stored
+// as a Rewind delta against the one before it, and Seek decodes the chain up
+// to the keyframe it starts from.
+//
+// File layout: header, frame_count input bytes, keyframe_count keyframes of
+// { frame, size, save state or delta }.
+class Movie
+{
+public:
+	static constexpr unsigned int default_keyframe_interval = 300;
+
+	Movie(FileLogger* logger);
+
+	void StartRecording(System* system, unsigned int keyframe_interval = default_keyframe_interval);
+	// Runs one frame with the joypad state currently set on the System and records it.
+	// Does nothing while the debugger holds the CPU, and a frame a breakpoint
+	// cut short is only counted once a later call has finished it.
+	void RecordFrame(System* system);
+	void StopRecording(System* system);
+
+	bool Save(std::string path);
+	bool Load(std::string path);
+
+	// Restores the first keyframe, fails if the System runs a different ROM
+	bool StartPlayback(System* system);
+	// Runs the next recorded frame, returns false once the movie has ended
+	bool PlayFrame(System* system);
+	// Puts the System in the state right before the given frame is played
+	bool Seek(System* system, unsigned int frame);
+
+	unsigned int GetFrameCount();
+	unsigned int GetPosition();
+	size_t GetKeyframeCount();
+	// State hash after the last recorded frame, playback should end on the same hash
+	unsigned long long GetFinalHash();
+
+private:
+	struct Keyframe
+	{
+		unsigned int frame{};
+		// A whole save state for the first keyframe, a delta for the others
+		std::vector<unsigned char> data;
+	};
+
+	void AddKeyframe(System* system);
+	// Rebuilds the save state of keyframes[last] into state, false on a bad delta
+	bool DecodeKeyframes(size_t last, std::vector<unsigned char>& state);
+
+	static constexpr unsigned int version = 2;
+
+	std::vector<unsigned char> inputs;
+	std::vector<Keyframe> keyframes;
+	// State of the newest keyframe while recording, the next delta is taken against it
+	std::vector<unsigned char> last_keyframe;
+	std::vector<unsigned char> scratch;
+
+	unsigned long long rom_hash{};
+	unsigned long long final_hash{};
+	unsigned int keyframe_interval = default_keyframe_interval;
+	unsigned int position{};
+	bool frame_pending = false;
+	bool recording = false;
+
+	FileLogger* logger;
+};
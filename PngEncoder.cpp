@@ -0,0 +1,331 @@
+#include "PngEncoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+static constexpr std::array<unsigned int, 256> crc_table = []
+{
+	std::array<unsigned int, 256> table{};
+
+	for (unsigned int i = 0; i < 256; ++i)
+	{
+		unsigned int crc = i;
+
+		for (int bit = 0; bit < 8; ++bit)
+			crc = (crc & 1) != 0 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+
+		table[i] = crc;
+	}
+
+	return table;
+}();
+
+// Deflate length codes 257-285 and distance codes 0-29
+static constexpr unsigned short length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static constexpr unsigned char length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static constexpr unsigned short distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static constexpr unsigned char distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static constexpr unsigned int min_match = 3;
+static constexpr unsigned int max_match = 258;
+
+// Deflate packs values starting at the least significant bit, Huffman codes
+// starting at their most significant one
+class BitWriter
+{
+public:
+	BitWriter(std::vector<unsigned char>& output) : output(output) {}
+
+	void Put(unsigned int value, unsigned int length)
+	{
+		bits |= value << count;
+		count += length;
+
+		while (count >= 8)
+		{
+			output.push_back(static_cast<unsigned char>(bits));
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+
+	void PutCode(unsigned int code, unsigned int length)
+	{
+		unsigned int reversed = 0;
+
+		for (unsigned int i = 0; i < length; ++i)
+			reversed |= ((code >> i) & 1) << (length - 1 - i);
+
+		Put(reversed, length);
+	}
+
+	void Finish()
+	{
+		if (count > 0)
+			output.push_back(static_cast<unsigned char>(bits));
+
+		bits = 0;
+		count = 0;
+	}
+
+private:
+	std::vector<unsigned char>& output;
+	unsigned int bits{};
+	unsigned int count{};
+};
+
+// Literal/length symbols with the fixed Huffman code
+static void PutSymbol(BitWriter& writer, unsigned int symbol)
+{
+	if (symbol < 144)
+		writer.PutCode(0x30 + symbol, 8);
+	else if (symbol < 256)
+		writer.PutCode(0x190 + symbol - 144, 9);
+	else if (symbol < 280)
+		writer.PutCode(symbol - 256, 7);
+	else
+		writer.PutCode(0xC0 + symbol - 280, 8);
+}
+
+static void PutMatch(BitWriter& writer, unsigned int length, unsigned int distance)
+{
+	unsigned int code = 28;
+
+	while (length_base[code] > length)
+		--code;
+
+	PutSymbol(writer, 257 + code);
+	writer.Put(length - length_base[code], length_extra[code]);
+
+	code = 29;
+
+	while (distance_base[code] > distance)
+		--code;
+
+	writer.PutCode(code, 5);
+	writer.Put(distance - distance_base[code], distance_extra[code]);
+}
+
+static void PutBigEndian(std::vector<unsigned char>& output, unsigned int value)
+{
+	output.push_back(static_cast<unsigned char>(value >> 24));
+	output.push_back(static_cast<unsigned char>(value >> 16));
+	output.push_back(static_cast<unsigned char>(value >> 8));
+	output.push_back(static_cast<unsigned char>(value));
+}
+
+// Length, type, data, and a CRC over type and data
+static void BeginChunk(std::vector<unsigned char>& output, const char* type, unsigned int length)
+{
+	PutBigEndian(output, length);
+	output.insert(output.end(), type, type + 4);
+}
+
+static void EndChunk(std::vector<unsigned char>& output, size_t chunk_start)
+{
+	// The type starts after the length
+	PutBigEndian(output, PngEncoder::Crc32(output.data() + chunk_start + 4, output.size() - chunk_start - 4));
+}
+
+PngEncoder::PngEncoder()
+{
+	head = new int[1 << hash_bits];
+	previous = new int[window_size];
+}
+
+PngEncoder::~PngEncoder()
+{
+	delete[] head;
+	delete[] previous;
+}
+
+void PngEncoder::EncodeIndexed(const unsigned char* indices, unsigned int width, unsigned int height, const unsigned int* colors, unsigned int color_count, std::vector<unsigned char>& output)
+{
+	color_count = std::clamp(color_count, 1u, max_colors);
+
+	unsigned int bit_depth = color_count <= 2 ? 1 : color_count <= 4 ? 2 : color_count <= 16 ? 4 : 8;
+	unsigned int per_byte = 8 / bit_depth;
+	unsigned int row_size = (width + per_byte - 1) / per_byte;
+
+	// Filter type 0 on every row, deflate finds the repeats by itself
+	raw.assign((row_size + 1) * height, 0);
+
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		const unsigned char* row = indices + y * width;
+		unsigned char* packed = raw.data() + y * (row_size + 1) + 1;
+
+		for (unsigned int x = 0; x < width; ++x)
+			packed[x / per_byte] |= row[x] << (8 - bit_depth - (x % per_byte) * bit_depth);
+	}
+
+	static constexpr unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	output.assign(signature, signature + sizeof(signature));
+
+	size_t chunk = output.size();
+	BeginChunk(output, "IHDR", 13);
+	PutBigEndian(output, width);
+	PutBigEndian(output, height);
+	// Bit depth, palette color type, deflate, adaptive filtering, no interlace
+	output.insert(output.end(), { static_cast<unsigned char>(bit_depth), 3, 0, 0, 0 });
+	EndChunk(output, chunk);
+
+	chunk = output.size();
+	BeginChunk(output, "PLTE", color_count * 3);
+
+	for (unsigned int i = 0; i < color_count; ++i)
+		output.insert(output.end(), { static_cast<unsigned char>(colors[i] >> 16), static_cast<unsigned char>(colors[i] >> 8), static_cast<unsigned char>(colors[i]) });
+
+	EndChunk(output, chunk);
+
+	// The length is patched in once the data is compressed
+	chunk = output.size();
+	BeginChunk(output, "IDAT", 0);
+
+	size_t data_start = output.size();
+
+	output.push_back(0x78);
+	output.push_back(0x01);
+	Deflate(raw.data(), raw.size(), output);
+	PutBigEndian(output, Adler32(raw.data(), raw.size()));
+
+	unsigned int data_length = static_cast<unsigned int>(output.size() - data_start);
+
+	for (int i = 0; i < 4; ++i)
+		output[chunk + i] = static_cast<unsigned char>(data_length >> (24 - i * 8));
+
+	EndChunk(output, chunk);
+
+	chunk = output.size();
+	BeginChunk(output, "IEND", 0);
+	EndChunk(output, chunk);
+}
+
+void PngEncoder::Deflate(const unsigned char* data, size_t size, std::vector<unsigned char>& output)
+{
+	std::fill(head, head + (1 << hash_bits), -1);
+
+	auto hash = [&](size_t position)
+	{
+		unsigned int key = data[position] | (data[position + 1] << 8) | (data[position + 2] << 16);
+
+		return (key * 2654435761u) >> (32 - hash_bits);
+	};
+
+	auto insert = [&](size_t position)
+	{
+		unsigned int key = hash(position);
+
+		previous[position & (window_size - 1)] = head[key];
+		head[key] = static_cast<int>(position);
+	};
+
+	BitWriter writer(output);
+
+	// One final block with the fixed codes
+	writer.Put(1, 1);
+	writer.Put(1, 2);
+
+	size_t position = 0;
+
+	while (position < size)
+	{
+		unsigned int best_length = 0;
+		unsigned int best_distance = 0;
+
+		if (position + min_match <= size)
+		{
+			unsigned int limit = static_cast<unsigned int>(std::min<size_t>(max_match, size - position));
+			int candidate = head[hash(position)];
+
+			for (unsigned int chain = 0; candidate >= 0 && chain < max_chain; ++chain)
+			{
+				size_t distance = position - candidate;
+
+				if (distance > window_size)
+					break;
+
+				unsigned int length = 0;
+
+				while (length < limit && data[candidate + length] == data[position + length])
+					++length;
+
+				if (length > best_length)
+				{
+					best_length = length;
+					best_distance = static_cast<unsigned int>(distance);
+
+					if (length == limit)
+						break;
+				}
+
+				// Older slots get reused by newer positions, a link that does
+				// not lead further back has been overwritten
+				int next = previous[candidate & (window_size - 1)];
+
+				if (next >= candidate)
+					break;
+
+				candidate = next;
+			}
+
+			insert(position);
+		}
+
+		if (best_length >= min_match)
+		{
+			PutMatch(writer, best_length, best_distance);
+
+			for (size_t i = position + 1; i < position + best_length && i + min_match <= size; ++i)
+				insert(i);
+
+			position += best_length;
+		}
+		else
+		{
+			PutSymbol(writer, data[position]);
+			++position;
+		}
+	}
+
+	PutSymbol(writer, 256);
+	writer.Finish();
+}
+
+unsigned int PngEncoder::Crc32(const unsigned char* data, size_t size, unsigned int crc)
+{
+	crc = ~crc;
+
+	for (size_t i = 0; i < size; ++i)
+		crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+unsigned int PngEncoder::Adler32(const unsigned char* data, size_t size, unsigned int adler)
+{
+	unsigned int a = adler & 0xFFFF;
+	unsigned int b = adler >> 16;
+
+	// The largest run that cannot overflow b before the modulo
+	static constexpr size_t block = 5552;
+
+	while (size > 0)
+	{
+		size_t length = std::min(size, block);
+		size -= length;
+
+		for (size_t i = 0; i < length; ++i)
+		{
+			a += *data++;
+			b += a;
+		}
+
+		a %= 65521;
+		b %= 65521;
+	}
+
+	return (b << 16) | a;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Writes palette PNGs without zlib. The image data is compressed with a
+// small deflate encoder: LZ77 over a hash chain, coded with the fixed
+// Huffman tables. Game Boy frames are a few shades in long runs and repeated
+// rows, which that already compresses well.
+//
+// An encoder keeps its hash tables and row buffers between images, use one
+// per thread.
+class PngEncoder
+{
+public:
+	static constexpr unsigned int max_colors = 256;
+
+	PngEncoder();
+	~PngEncoder();
+
+	PngEncoder(const PngEncoder&) = delete;
+	PngEncoder& operator=(const PngEncoder&) = delete;
+
+	// Indices are one byte per pixel and below color_count, colors are
+	// 0xAARRGGBB. The bit depth is the smallest that holds color_count.
+	// Replaces the contents of output.
+	void EncodeIndexed(const unsigned char* indices, unsigned int width, unsigned int height, const unsigned int* colors, unsigned int color_count, std::vector<unsigned char>& output);
+
+	static unsigned int Crc32(const unsigned char* data, size_t size, unsigned int crc = 0);
+	static unsigned int Adler32(const unsigned char* data, size_t size, unsigned int adler = 1);
+
+private:
+	static constexpr unsigned int hash_bits = 12;
+	static constexpr unsigned int window_size = 32768;
+	static constexpr unsigned int max_chain = 32;
+
+	void Deflate(const unsigned char* data, size_t size, std::vector<unsigned char>& output);
+
+	// Filter bytes and packed rows, the zlib stream's input
+	std::vector<unsigned char> raw;
+	int* head{};
+	int* previous{};
+};
\ No newline at end of file
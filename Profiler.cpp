@@ -0,0 +1,201 @@
+#include "Profiler.h"
+
+#include <algorithm>
+
+Profiler::Profiler()
+{
+	Reset();
+}
+
+void Profiler::Reset()
+{
+	std::fill(&opcode_counts[0][0], &opcode_counts[0][0] + 2 * 256, 0);
+	std::fill(&opcode_cycles[0][0], &opcode_cycles[0][0] + 2 * 256, 0);
+	total_cycles = 0;
+
+	pc_samples.assign(0x10000, PcSample{});
+
+	stack_nodes.clear();
+	stack_nodes.push_back(StackNode{});
+	stack_children.clear();
+	current_node = root_node;
+	overflow_depth = 0;
+}
+
+void Profiler::OnInstruction(unsigned char bank, unsigned short pc, bool prefixed, unsigned char opcode, unsigned int cycles)
+{
+	opcode_counts[prefixed][opcode] += 1;
+	opcode_cycles[prefixed][opcode] += cycles;
+	total_cycles += cycles;
+
+	size_t index = (static_cast<size_t>(bank) << 16) | pc;
+
+	if (index >= pc_samples.size())
+		pc_samples.resize((static_cast<size_t>(bank) + 1) << 16);
+
+	pc_samples[index].count += 1;
+	pc_samples[index].cycles += cycles;
+
+	stack_nodes[current_node].self_cycles += cycles;
+}
+
+void Profiler::OnCall(unsigned char bank, unsigned short address)
+{
+	current_node = EnterFrame((static_cast<unsigned int>(bank) << 16) | address);
+}
+
+void Profiler::OnInterrupt(unsigned short address)
+{
+	current_node = EnterFrame(interrupt_frame | address);
+}
+
+void Profiler::OnReturn()
+{
+	if (overflow_depth > 0)
+	{
+		--overflow_depth;
+		return;
+	}
+
+	// A RET without a matching CALL (e.g. stack manipulation) keeps us at the root
+	if (current_node != root_node)
+		current_node = stack_nodes[current_node].parent;
+}
+
+unsigned int Profiler::EnterFrame(unsigned int frame)
+{
+	if (stack_nodes[current_node].depth >= max_stack_depth)
+	{
+		++overflow_depth;
+		return current_node;
+	}
+
+	unsigned long long key = (static_cast<unsigned long long>(current_node) << 32) | frame;
+
+	auto it = stack_children.find(key);
+
+	if (it != stack_children.end())
+		return it->second;
+
+	unsigned int node = static_cast<unsigned int>(stack_nodes.size());
+
+	stack_nodes.push_back(StackNode{ current_node, frame, stack_nodes[current_node].depth + 1, 0 });
+	stack_children.emplace(key, node);
+
+	return node;
+}
+
+std::string Profiler::FrameName(unsigned int frame)
+{
+	std::ostringstream ss;
+
+	if ((frame & interrupt_frame) == interrupt_frame)
+		ss << "int_" << std::setfill('0') << std::setw(2) << std::hex << (frame & 0xFFFF);
+	else
+		ss << std::setfill('0') << std::setw(2) << std::hex << (frame >> 16) << ":" << std::setw(4) << (frame & 0xFFFF);
+
+	return ss.str();
+}
+
+bool Profiler::WriteCollapsedStacks(std::string path)
+{
+	std::ofstream output(path, std::ios::out | std::ios::trunc);
+
+	if (!output)
+		return false;
+
+	std::vector<std::string> names;
+
+	for (unsigned int node = 0; node < stack_nodes.size(); ++node)
+	{
+		if (stack_nodes[node].self_cycles == 0)
+			continue;
+
+		names.clear();
+
+		for (unsigned int n = node; n != root_node; n = stack_nodes[n].parent)
+			names.push_back(FrameName(stack_nodes[n].frame));
+
+		output << "reset";
+
+		for (auto name = names.rbegin(); name != names.rend(); ++name)
+			output << ";" << *name;
+
+		output << " " << stack_nodes[node].self_cycles << "\n";
+	}
+
+	return true;
+}
+
+bool Profiler::WriteReport(std::string path, size_t top_count)
+{
+	std::ofstream output(path, std::ios::out | std::ios::trunc);
+
+	if (!output)
+		return false;
+
+	output << "Total cycles: " << total_cycles << "\n\n";
+
+	std::vector<unsigned int> opcodes;
+
+	for (unsigned int i = 0; i < 2 * 256; ++i)
+	{
+		if (opcode_counts[i >> 8][i & 0xFF] != 0)
+			opcodes.push_back(i);
+	}
+
+	std::sort(opcodes.begin(), opcodes.end(), [this](unsigned int a, unsigned int b)
+		{
+			return opcode_cycles[a >> 8][a & 0xFF] > opcode_cycles[b >> 8][b & 0xFF];
+		});
+
+	output << "Opcode      Count            Cycles\n";
+
+	for (size_t i = 0; i < opcodes.size() && i < top_count; ++i)
+	{
+		unsigned int op = opcodes[i];
+
+		output << ((op >> 8) ? "CB " : "   ") << std::setfill('0') << std::setw(2) << std::hex << (op & 0xFF) << std::dec
+			<< std::setfill(' ') << std::setw(14) << opcode_counts[op >> 8][op & 0xFF]
+			<< std::setw(18) << opcode_cycles[op >> 8][op & 0xFF] << "\n";
+	}
+
+	std::vector<size_t> addresses;
+
+	for (size_t i = 0; i < pc_samples.size(); ++i)
+	{
+		if (pc_samples[i].count != 0)
+			addresses.push_back(i);
+	}
+
+	std::sort(addresses.begin(), addresses.end(), [this](size_t a, size_t b)
+		{
+			return pc_samples[a].cycles > pc_samples[b].cycles;
+		});
+
+	output << "\nAddress     Count            Cycles\n";
+
+	for (size_t i = 0; i < addresses.size() && i < top_count; ++i)
+	{
+		size_t addr = addresses[i];
+
+		output << std::setfill('0') << std::hex << std::setw(2) << (addr >> 16) << ":" << std::setw(4) << (addr & 0xFFFF) << std::dec
+			<< std::setfill(' ') << std::setw(10) << pc_samples[addr].count
+			<< std::setw(18) << pc_samples[addr].cycles << "\n";
+	}
+
+	return true;
+}
+
+unsigned long long Profiler::GetOpcodeCount(bool prefixed, unsigned char opcode)
+{
+	return opcode_counts[prefixed][opcode];
+}
+unsigned long long Profiler::GetOpcodeCycles(bool prefixed, unsigned char opcode)
+{
+	return opcode_cycles[prefixed][opcode];
+}
+unsigned long long Profiler::GetTotalCycles()
+{
+	return total_cycles;
+}
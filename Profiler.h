@@ -0,0 +1,75 @@
+#pragma once
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The profiler is compiled in only when GBE_PROFILER is defined, so the
+// instruction loop carries no extra code in normal builds.
+#ifdef GBE_PROFILER
+#define PROFILER_HOOK(call) if (profiler) profiler->call
+#else
+#define PROFILER_HOOK(call)
+#endif
+
+class Profiler
+{
+public:
+	Profiler();
+
+	void Reset();
+
+	void OnInstruction(unsigned char bank, unsigned short pc, bool prefixed, unsigned char opcode, unsigned int cycles);
+	void OnCall(unsigned char bank, unsigned short address);
+	void OnInterrupt(unsigned short address);
+	void OnReturn();
+
+	// Writes "frame;frame;frame cycles" lines as consumed by flamegraph.pl / inferno
+	bool WriteCollapsedStacks(std::string path);
+	// Writes a plain text summary of the hottest opcodes and addresses
+	bool WriteReport(std::string path, size_t top_count = 32);
+
+	unsigned long long GetOpcodeCount(bool prefixed, unsigned char opcode);
+	unsigned long long GetOpcodeCycles(bool prefixed, unsigned char opcode);
+	unsigned long long GetTotalCycles();
+
+private:
+	struct PcSample
+	{
+		unsigned long long count{};
+		unsigned long long cycles{};
+	};
+
+	struct StackNode
+	{
+		unsigned int parent{};
+		unsigned int frame{};
+		unsigned int depth{};
+		unsigned long long self_cycles{};
+	};
+
+	static constexpr unsigned int root_node = 0;
+	// Frames of interrupt handlers are tagged so they can be told apart from plain calls
+	static constexpr unsigned int interrupt_frame = 1u << 24;
+	// Calls that never return (e.g. code that pops its return address) would grow the stack forever
+	static constexpr unsigned int max_stack_depth = 64;
+
+	unsigned int EnterFrame(unsigned int frame);
+	std::string FrameName(unsigned int frame);
+
+	unsigned long long opcode_counts[2][256]{};
+	unsigned long long opcode_cycles[2][256]{};
+	unsigned long long total_cycles{};
+
+	// Indexed by (bank << 16) | pc, grown when a new bank shows up
+	std::vector<PcSample> pc_samples;
+
+	// Shadow call stack stored as a tree of unique stacks
+	std::vector<StackNode> stack_nodes;
+	std::unordered_map<unsigned long long, unsigned int> stack_children;
+	unsigned int current_node = root_node;
+	unsigned int overflow_depth{};
+};
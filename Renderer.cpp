@@ -1,12 +1,53 @@
 #include "Renderer.h"
 
-Renderer::Renderer(System* system, FileLogger* logger)
+// Shades 0 (white) to 3 (black) of the DMG screen
+static constexpr float palette[4][3] =
+{
+	{ 1.0f, 1.0f, 1.0f },
+	{ 0.667f, 0.667f, 0.667f },
+	{ 0.333f, 0.333f, 0.333f },
+	{ 0.0f, 0.0f, 0.0f }
+};
+
+static const char* vertex_shader_source =
+	"#version 120\n"
+	"attribute vec2 position;\n"
+	"varying vec2 uv;\n"
+	"void main()\n"
+	"{\n"
+	"	uv = vec2(position.x + 1.0, 1.0 - position.y) * 0.5;\n"
+	"	gl_Position = vec4(position, 0.0, 1.0);\n"
+	"}\n";
+
+static const char* fragment_shader_source =
+	"#version 120\n"
+	"uniform sampler2D screen;\n"
+	"uniform vec3 palette[4];\n"
+	"varying vec2 uv;\n"
+	"void main()\n"
+	"{\n"
+	"	int shade = int(texture2D(screen, uv).r * 255.0 + 0.5);\n"
+	"	gl_FragColor = vec4(palette[shade], 1.0);\n"
+	"}\n";
+
+// For frames the Scaler already colored
+static const char* color_fragment_shader_source =
+	"#version 120\n"
+	"uniform sampler2D screen;\n"
+	"varying vec2 uv;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = vec4(texture2D(screen, uv).rgb, 1.0);\n"
+	"}\n";
+
+Renderer::Renderer(System* system, FileLogger* logger, unsigned int scale, bool threaded, ScaleFilter filter)
 {
 	this->system = system;
 	this->logger = logger;
+	this->threaded = threaded;
 
 	if (SDL_Init(SDL_INIT_VIDEO) < 0)
-		logger->Log(LOG_ERROR, "Unable to initialize SDL - Video.");
+		logger->Log<LOG_ERROR>("Unable to initialize SDL - Video.");
 
 	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
 	SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
@@ -15,24 +56,393 @@ Renderer::Renderer(System* system, FileLogger* logger)
 	SDL_GL_SetAttribute(SDL_GL_BUFFER_SIZE, 32);
 	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
 
-	window = SDL_CreateWindow("GBE", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 600, 400, SDL_WINDOW_OPENGL);
+	if (scale == 0)
+		scale = 1;
+
+	if (filter == ScaleFilter_Smooth)
+		scaler = new Scaler(std::clamp(scale, 2u, Scaler::max_factor), filter);
+
+	window = SDL_CreateWindow("GBE", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, System::screen_width * scale, System::screen_height * scale, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
 	gl_context = SDL_GL_CreateContext(window);
 
 	GLenum err = glewInit();
 
 	if (err != GLEW_OK)
-		logger->Log(LOG_ERROR, glewGetErrorString(err));
+		logger->Log<LOG_ERROR>(glewGetErrorString(err));
+
+	SDL_GL_SetSwapInterval(swap_interval);
+
+	resources_ready = CreateResources();
+
+	if (threaded)
+	{
+		// The render thread makes the context current for itself
+		SDL_GL_MakeCurrent(window, nullptr);
+		render_thread = std::thread(&Renderer::RenderLoop, this);
+	}
+}
+
+Renderer::~Renderer()
+{
+	if (threaded)
+	{
+		stopping.store(true, std::memory_order_release);
+		render_thread.join();
+	}
+	else
+		DeleteResources();
+
+	SDL_GL_DeleteContext(gl_context);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+
+	delete scaler;
+}
 
-	 // logger->Log("Initialized OpenGL version ", glGetString(GL_VERSION));
+void Renderer::DeleteResources()
+{
+	if (!resources_ready)
+		return;
+
+	glDeleteProgram(program);
+	glDeleteBuffers(1, &vertex_buffer);
+	glDeleteBuffers(2, pixel_buffers);
+	glDeleteTextures(1, &texture);
+}
+
+bool Renderer::CreateResources()
+{
+	GLuint vertex_shader = CompileShader(GL_VERTEX_SHADER, vertex_shader_source);
+	GLuint fragment_shader = CompileShader(GL_FRAGMENT_SHADER, scaler != nullptr ? color_fragment_shader_source : fragment_shader_source);
+
+	if (vertex_shader == 0 || fragment_shader == 0)
+		return false;
+
+	program = glCreateProgram();
+	glAttachShader(program, vertex_shader);
+	glAttachShader(program, fragment_shader);
+	glLinkProgram(program);
+	glDeleteShader(vertex_shader);
+	glDeleteShader(fragment_shader);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+	if (linked != GL_TRUE)
+	{
+		char message[512]{};
+		glGetProgramInfoLog(program, sizeof(message), nullptr, message);
+		logger->Log<LOG_ERROR>("Unable to link the screen shader: ", message);
+
+		glDeleteProgram(program);
+		return false;
+	}
+
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "screen"), 0);
+
+	if (scaler == nullptr)
+		glUniform3fv(glGetUniformLocation(program, "palette"), 4, &palette[0][0]);
+
+	position_location = glGetAttribLocation(program, "position");
+
+	// The quad always covers the viewport, scaling is done by placing the viewport
+	static constexpr float quad[8] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+
+	glGenBuffers(1, &vertex_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// One byte per pixel, rows of 160 are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// 0xAARRGGBB words are BGRA bytes
+	if (scaler != nullptr)
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, GetTextureWidth(), GetTextureHeight(), 0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, nullptr);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, System::screen_width, System::screen_height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+
+	glGenBuffers(2, pixel_buffers);
+
+	for (GLuint pixel_buffer : pixel_buffers)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, GetTextureWidth() * GetTextureHeight() * (scaler != nullptr ? 4 : 1), nullptr, GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	return glGetError() == GL_NO_ERROR;
+}
+
+GLuint Renderer::CompileShader(GLenum type, const char* source)
+{
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, nullptr);
+	glCompileShader(shader);
+
+	GLint compiled = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+
+	if (compiled != GL_TRUE)
+	{
+		char message[512]{};
+		glGetShaderInfoLog(shader, sizeof(message), nullptr, message);
+		logger->Log<LOG_ERROR>("Unable to compile the screen shader: ", message);
+
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
 }
 
 void Renderer::Update()
 {
 	HandleWindowEvents();
 
-	Clear();
+	bool new_frame = system->GetFrameCount() != published_frame;
+	published_frame = system->GetFrameCount();
+
+	if (!threaded)
+	{
+		Present(system->GetFramebuffer(), new_frame);
+		return;
+	}
+
+	if (!new_frame)
+		return;
+
+	Frame& frame = frames.GetBack();
+	frame.number = published_frame;
+	std::memcpy(frame.pixels, system->GetFramebuffer(), sizeof(frame.pixels));
+
+	frames.Publish();
+}
+
+void Renderer::RenderLoop()
+{
+	SDL_GL_MakeCurrent(window, gl_context);
+
+	// Swap intervals belong to the context, set it once on this thread
+	int current_swap_interval = -1;
+	unsigned long long presented_frame = ~0ull;
+
+	while (!stopping.load(std::memory_order_acquire))
+	{
+		if (swap_interval != current_swap_interval)
+		{
+			current_swap_interval = swap_interval;
+			SDL_GL_SetSwapInterval(current_swap_interval);
+		}
+
+		bool fresh;
+		const Frame& frame = frames.Acquire(fresh);
+
+		// Without vsync nothing paces the loop, only present new frames
+		if (frame.number == ~0ull || (!fresh && current_swap_interval == 0))
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		if (!fresh)
+			duplicated_count.fetch_add(1, std::memory_order_relaxed);
+		else if (presented_frame != ~0ull && frame.number > presented_frame + 1)
+			dropped_count.fetch_add(frame.number - presented_frame - 1, std::memory_order_relaxed);
+
+		presented_frame = frame.number;
+
+		Present(frame.pixels, fresh);
+	}
+
+	DeleteResources();
+	SDL_GL_MakeCurrent(window, nullptr);
+}
+
+void Renderer::Present(const unsigned char* pixels, bool new_frame)
+{
+	if (!resources_ready)
+	{
+		Clear();
+		SDL_GL_SwapWindow(window);
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (new_frame)
+	{
+		UploadFrame(pixels);
+
+		auto uploaded = std::chrono::steady_clock::now();
+		upload_nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(uploaded - start).count(), std::memory_order_relaxed);
+		upload_count.fetch_add(1, std::memory_order_relaxed);
+		start = uploaded;
+	}
 
+	DrawScreen();
 	SDL_GL_SwapWindow(window);
+
+	present_nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+	present_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Renderer::UploadFrame(const unsigned char* pixels)
+{
+	GLsizeiptr frame_size = GetTextureWidth() * GetTextureHeight() * (scaler != nullptr ? 4 : 1);
+
+	// Alternate between the buffers so the one written now is not the one
+	// the driver may still be copying into the texture from the last frame.
+	// Invalidating it lets the driver hand out fresh storage instead of waiting.
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffers[next_pixel_buffer]);
+	next_pixel_buffer ^= 1;
+
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frame_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	if (mapped != nullptr)
+	{
+		if (scaler != nullptr)
+			scaler->Scale(pixels, static_cast<unsigned int*>(mapped), scaler->GetWidth());
+		else
+			std::memcpy(mapped, pixels, frame_size);
+
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		// Sources from the bound buffer, returns without waiting for the copy
+		glBindTexture(GL_TEXTURE_2D, texture);
+
+		if (scaler != nullptr)
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, GetTextureWidth(), GetTextureHeight(), GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, nullptr);
+		else
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, System::screen_width, System::screen_height, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+unsigned int Renderer::GetTextureWidth()
+{
+	return scaler != nullptr ? scaler->GetWidth() : System::screen_width;
+}
+
+unsigned int Renderer::GetTextureHeight()
+{
+	return scaler != nullptr ? scaler->GetHeight() : System::screen_height;
+}
+
+void Renderer::DrawScreen()
+{
+	int width;
+	int height;
+	SDL_GL_GetDrawableSize(window, &width, &height);
+
+	int screen_width;
+	int screen_height;
+
+	if (integer_scaling)
+	{
+		int scale = std::max(1, std::min(width / static_cast<int>(System::screen_width), height / static_cast<int>(System::screen_height)));
+
+		screen_width = System::screen_width * scale;
+		screen_height = System::screen_height * scale;
+	}
+	else
+	{
+		double scale = std::min(static_cast<double>(width) / System::screen_width, static_cast<double>(height) / System::screen_height);
+
+		screen_width = static_cast<int>(System::screen_width * scale + 0.5);
+		screen_height = static_cast<int>(System::screen_height * scale + 0.5);
+	}
+
+	// Black borders around the centered screen
+	glViewport(0, 0, width, height);
+	Clear();
+
+	glViewport((width - screen_width) / 2, (height - screen_height) / 2, screen_width, screen_height);
+
+	glUseProgram(program);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+	glEnableVertexAttribArray(position_location);
+	glVertexAttribPointer(position_location, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	glDisableVertexAttribArray(position_location);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Renderer::SetIntegerScaling(bool enabled)
+{
+	integer_scaling = enabled;
+}
+
+void Renderer::SetVSync(bool enabled)
+{
+	swap_interval = enabled ? 1 : 0;
+
+	// Threaded, the render thread applies it to its context
+	if (!threaded)
+		SDL_GL_SetSwapInterval(swap_interval);
+}
+
+bool Renderer::IsThreaded()
+{
+	return threaded;
+}
+
+double Renderer::GetAverageUploadTime()
+{
+	unsigned long long count = upload_count;
+
+	return count == 0 ? 0.0 : upload_nanoseconds / 1e6 / count;
+}
+
+double Renderer::GetAveragePresentTime()
+{
+	unsigned long long count = present_count;
+
+	return count == 0 ? 0.0 : present_nanoseconds / 1e6 / count;
+}
+
+unsigned long long Renderer::GetUploadedFrameCount()
+{
+	return upload_count;
+}
+
+unsigned long long Renderer::GetDroppedFrameCount()
+{
+	return dropped_count;
+}
+
+unsigned long long Renderer::GetDuplicatedFrameCount()
+{
+	return duplicated_count;
+}
+
+unsigned long long Renderer::GetPresentCount()
+{
+	return present_count;
+}
+
+void Renderer::ResetTimings()
+{
+	upload_nanoseconds = 0;
+	present_nanoseconds = 0;
+	upload_count = 0;
+	present_count = 0;
+	dropped_count = 0;
+	duplicated_count = 0;
 }
 
 void Renderer::HandleWindowEvents()
@@ -45,7 +455,6 @@ void Renderer::HandleWindowEvents()
 		{
 		case SDL_QUIT:
 		{
-			SDL_Quit();
 			system->SetRunning(false);
 
 			break;
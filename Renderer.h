@@ -4,22 +4,109 @@
 #define GLEW_STATIC
 #include <GL/glew.h>
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include "System.h"
 #include "FileLogger.h"
+#include "Scaler.h"
+#include "TripleBuffer.h"
 
+// Shows the emulated screen in an OpenGL window. Each new frame is written
+// into one of two pixel buffer objects and the screen texture is updated from
+// it, so the copy to the GPU happens asynchronously and never waits for the
+// previous frame's upload. The texture holds the raw shades, a fragment
+// shader turns them into colors while drawing the screen quad.
+//
+// Threaded, the GL context belongs to a render thread. Update only copies a
+// finished frame into a triple buffer, the render thread presents the newest
+// one at the display's pace, so vsync or a slow compositor no longer hold up
+// the emulation. Window events are still handled by Update, SDL wants them on
+// the thread that created the window.
+//
+// With ScaleFilter_Smooth the shades are scaled and colored on the CPU by a
+// Scaler, on the presenting thread, straight into the pixel buffer, and the
+// texture holds the finished colors. The scale picks the factor, 2x to 4x.
 class Renderer
 {
 public:
-	Renderer(System* system, FileLogger* logger);
+	static constexpr unsigned int default_scale = 4;
+
+	Renderer(System* system, FileLogger* logger, unsigned int scale = default_scale, bool threaded = true, ScaleFilter filter = ScaleFilter_Nearest);
+	~Renderer();
+
+	// Hands over the frame if the System finished a new one since the last
+	// call. Synchronous, it also uploads and presents it.
 	void Update();
 
+	// Whole multiples of 160x144 keep the pixels square and sharp, otherwise
+	// the screen fills the window keeping its aspect ratio
+	void SetIntegerScaling(bool enabled);
+	void SetVSync(bool enabled);
+	bool IsThreaded();
+
+	// Average milliseconds spent uploading and presenting since the last reset
+	double GetAverageUploadTime();
+	double GetAveragePresentTime();
+	unsigned long long GetUploadedFrameCount();
+	// Threaded: frames overwritten before the render thread took them, and
+	// presents that showed an already presented frame again
+	unsigned long long GetDroppedFrameCount();
+	unsigned long long GetDuplicatedFrameCount();
+	unsigned long long GetPresentCount();
+	void ResetTimings();
+
 private:
+	struct Frame
+	{
+		unsigned long long number = ~0ull;
+		unsigned char pixels[System::screen_width * System::screen_height];
+	};
+
 	void HandleWindowEvents();
 	void Clear();
+	bool CreateResources();
+	void DeleteResources();
+	void RenderLoop();
+	void Present(const unsigned char* pixels, bool new_frame);
+	void UploadFrame(const unsigned char* pixels);
+	void DrawScreen();
+	GLuint CompileShader(GLenum type, const char* source);
+	unsigned int GetTextureWidth();
+	unsigned int GetTextureHeight();
 
 	SDL_Window* window;
 	SDL_GLContext gl_context;
 
+	GLuint texture{};
+	GLuint pixel_buffers[2]{};
+	unsigned int next_pixel_buffer{};
+	GLuint program{};
+	GLuint vertex_buffer{};
+	GLint position_location = -1;
+	bool resources_ready = false;
+
+	// Only with ScaleFilter_Smooth
+	Scaler* scaler{};
+
+	std::atomic<bool> integer_scaling = true;
+	std::atomic<int> swap_interval = 1;
+	unsigned long long published_frame = ~0ull;
+
+	bool threaded;
+	TripleBuffer<Frame> frames;
+	std::thread render_thread;
+	std::atomic<bool> stopping = false;
+
+	// Written by whichever thread presents
+	std::atomic<long long> upload_nanoseconds{};
+	std::atomic<long long> present_nanoseconds{};
+	std::atomic<unsigned long long> upload_count{};
+	std::atomic<unsigned long long> present_count{};
+	std::atomic<unsigned long long> dropped_count{};
+	std::atomic<unsigned long long> duplicated_count{};
+
 	System* system;
 	FileLogger* logger;
 };
\ No newline at end of file
@@ -0,0 +1,283 @@
+#include "Rewind.h"
+
+#include <cstring>
+
+static unsigned long long LoadWord(const unsigned char* data)
+{
+	unsigned long long word;
+	std::memcpy(&word, data, sizeof(word));
+	return word;
+}
+
+static unsigned char* PutVarint(unsigned char* output, size_t value)
+{
+	while (value >= 0x80)
+	{
+		*output++ = static_cast<unsigned char>(value | 0x80);
+		value >>= 7;
+	}
+
+	*output++ = static_cast<unsigned char>(value);
+
+	return output;
+}
+
+// Returns nullptr when the varint runs past end or does not fit a size_t
+static const unsigned char* GetVarint(const unsigned char* input, const unsigned char* end, size_t& value)
+{
+	value = 0;
+
+	for (unsigned int shift = 0; input < end && shift < 64; shift += 7)
+	{
+		unsigned char byte = *input++;
+
+		value |= static_cast<size_t>(byte & 0x7F) << shift;
+
+		if ((byte & 0x80) == 0)
+			return input;
+	}
+
+	return nullptr;
+}
+
+Rewind::Rewind(size_t capacity)
+{
+	ring.resize(capacity);
+	current.resize(System::state_size);
+	scratch.resize(System::state_size);
+	// Worst case is a single literal run over the whole state
+	encoded.resize(System::state_size + 32);
+}
+
+void Rewind::Clear()
+{
+	deltas.clear();
+	head = 0;
+	bytes_used = 0;
+	has_current = false;
+	push_count = 0;
+	push_microseconds = 0.0;
+}
+
+void Rewind::Push(System* system)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	DirtyPages pages;
+
+	system->TakeDirtyPages(pages);
+
+	if (!has_current)
+	{
+		system->SaveState(current);
+		scratch = current;
+		has_current = true;
+	}
+	else
+	{
+		system->UpdateState(scratch, pages);
+
+		// Encodes new ^ previous, which turns the new snapshot back into the old one
+		size_t size = Encode(scratch.data(), current.data(), pages, encoded.data());
+
+		Store(encoded.data(), size);
+
+		system->UpdateState(current, pages);
+	}
+
+	push_microseconds += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	++push_count;
+}
+
+bool Rewind::StepBack(System* system)
+{
+	if (deltas.empty())
+		return false;
+
+	// The framebuffer is not part of the state. Going back one snapshot
+	// further and replaying the frame from it redraws the screen, the way
+	// Movie::Seek does, as long as there is a snapshot to replay from.
+	bool redraw = system->IsRenderingEnabled() && deltas.size() >= 2;
+	unsigned char buttons = 0;
+
+	Pop();
+
+	if (redraw)
+	{
+		// Buttons are set between frames, the replay needs the ones the
+		// restored frame was run with
+		if (!system->LoadState(current.data(), current.size()))
+			return false;
+
+		buttons = system->GetJoypad();
+		Pop();
+	}
+
+	// Loading marks every page dirty, so the next Push rebuilds scratch completely
+	if (!system->LoadState(current.data(), current.size()))
+		return false;
+
+	if (redraw)
+	{
+		system->SetJoypad(buttons);
+		system->RunFrame();
+		Push(system);
+	}
+
+	return true;
+}
+
+void Rewind::Pop()
+{
+	Delta delta = deltas.back();
+	deltas.pop_back();
+
+	Decode(&ring[delta.offset], delta.size, current.data());
+
+	head = delta.offset;
+	bytes_used -= delta.size;
+}
+
+bool Rewind::MayDiffer(size_t word, const DirtyPages& pages)
+{
+	return word < header_words || pages.IsSet(static_cast<unsigned int>((word - header_words) / page_words));
+}
+
+size_t Rewind::Encode(const unsigned char* current, const unsigned char* previous, const DirtyPages& pages, unsigned char* output)
+{
+	unsigned char* cursor = output;
+	size_t word = 0;
+
+	while (word < state_words)
+	{
+		size_t zero_start = word;
+
+		while (word < state_words)
+		{
+			// Pages nobody wrote to are equal without looking at them
+			if (!MayDiffer(word, pages))
+			{
+				word = header_words + ((word - header_words) / page_words + 1) * page_words;
+				continue;
+			}
+
+			if (LoadWord(current + word * 8) != LoadWord(previous + word * 8))
+				break;
+
+			++word;
+		}
+
+		size_t literal_start = word;
+
+		while (word < state_words && MayDiffer(word, pages) && LoadWord(current + word * 8) != LoadWord(previous + word * 8))
+			++word;
+
+		cursor = PutVarint(cursor, literal_start - zero_start);
+		cursor = PutVarint(cursor, word - literal_start);
+
+		for (size_t i = literal_start; i < word; ++i)
+		{
+			unsigned long long value = LoadWord(current + i * 8) ^ LoadWord(previous + i * 8);
+
+			std::memcpy(cursor, &value, sizeof(value));
+			cursor += sizeof(value);
+		}
+	}
+
+	return cursor - output;
+}
+
+bool Rewind::Decode(const unsigned char* input, size_t size, unsigned char* state)
+{
+	const unsigned char* end = input + size;
+	size_t word = 0;
+
+	while (input < end)
+	{
+		size_t zeros = 0;
+		size_t literals = 0;
+
+		input = GetVarint(input, end, zeros);
+
+		if (input != nullptr)
+			input = GetVarint(input, end, literals);
+
+		// Movies store deltas in files, so the counts are checked before writing
+		if (input == nullptr || zeros > state_words - word || literals > state_words - word - zeros || literals > static_cast<size_t>(end - input) / 8)
+			return false;
+
+		word += zeros;
+
+		for (size_t i = 0; i < literals; ++i, ++word)
+		{
+			unsigned long long value = LoadWord(state + word * 8) ^ LoadWord(input);
+
+			std::memcpy(state + word * 8, &value, sizeof(value));
+			input += sizeof(value);
+		}
+	}
+
+	return true;
+}
+
+void Rewind::Store(const unsigned char* data, size_t size)
+{
+	if (size > ring.size())
+	{
+		deltas.clear();
+		bytes_used = 0;
+		return;
+	}
+
+	size_t offset = head;
+
+	if (offset + size > ring.size())
+	{
+		// Skip the end of the ring, the deltas stored there are the oldest ones
+		while (!deltas.empty() && deltas.front().offset >= head)
+		{
+			bytes_used -= deltas.front().size;
+			deltas.pop_front();
+		}
+
+		offset = 0;
+	}
+
+	while (!deltas.empty() && deltas.front().offset < offset + size && deltas.front().offset + deltas.front().size > offset)
+	{
+		bytes_used -= deltas.front().size;
+		deltas.pop_front();
+	}
+
+	std::memcpy(&ring[offset], data, size);
+
+	deltas.push_back(Delta{ offset, size });
+	head = offset + size;
+	bytes_used += size;
+}
+
+size_t Rewind::GetFrameCount()
+{
+	return deltas.size();
+}
+size_t Rewind::GetBytesUsed()
+{
+	return bytes_used;
+}
+size_t Rewind::GetCapacity()
+{
+	return ring.size();
+}
+double Rewind::GetBytesPerSecond()
+{
+	if (deltas.empty())
+		return 0.0;
+
+	double frames_per_second = static_cast<double>(System::clock_rate) / System::cycles_per_frame;
+
+	return static_cast<double>(bytes_used) / deltas.size() * frames_per_second;
+}
+double Rewind::GetAveragePushMicroseconds()
+{
+	return push_count > 0 ? push_microseconds / push_count : 0.0;
+}
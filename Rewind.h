@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include "System.h"
+
+// Rewind history kept as backward deltas in a fixed size ring buffer.
+//
+// Push saves the System state once per frame and stores it as the XOR against
+// the previous snapshot, so mostly unchanged memory becomes runs of zero
+// words. Only the header and the pages the System reports as written are
+// copied and compared, the rest is known to be zero. Push takes the System's
+// dirty pages, so nothing else may consume them. Only the newest snapshot is
+// kept whole. StepBack decodes the newest delta into it, which yields the
+// snapshot before, and loads that. With rendering enabled it goes back one
+// more and replays that frame, so the screen shows the restored state. When
+// the ring is full the oldest deltas are dropped, shortening the history.
+//
+// Encoded deltas are a sequence of (zero words, literal words, literals)
+// tokens with varint counts, the literals being the XOR of the two states.
+class Rewind
+{
+public:
+	static constexpr size_t default_capacity = 32 * 1024 * 1024;
+
+	Rewind(size_t capacity = default_capacity);
+
+	void Clear();
+	// Snapshots the System, call once per frame
+	void Push(System* system);
+	// Restores the System to the snapshot before the newest one, false when the history is used up
+	bool StepBack(System* system);
+
+	// Frames that can be stepped back
+	size_t GetFrameCount();
+	size_t GetBytesUsed();
+	size_t GetCapacity();
+	// Ring memory needed per second of history at the current compression ratio
+	double GetBytesPerSecond();
+	// Average time spent in Push
+	double GetAveragePushMicroseconds();
+
+	// Writes current ^ previous for two System::state_size states to output,
+	// which needs state_size + 32 bytes. Only the header and the given pages
+	// are compared.
+	static size_t Encode(const unsigned char* current, const unsigned char* previous, const DirtyPages& pages, unsigned char* output);
+	// XORs an encoded delta into state, false if it does not fit a state
+	static bool Decode(const unsigned char* input, size_t size, unsigned char* state);
+
+private:
+	struct Delta
+	{
+		size_t offset{};
+		size_t size{};
+	};
+
+	static bool MayDiffer(size_t word, const DirtyPages& pages);
+	void Store(const unsigned char* data, size_t size);
+	// Decodes the newest delta into current and drops it
+	void Pop();
+
+	static constexpr size_t state_words = System::state_size / 8;
+	static constexpr size_t header_words = System::state_header_size / 8;
+	static constexpr size_t page_words = System::page_size / 8;
+	static_assert(System::state_size % 8 == 0 && System::state_header_size % 8 == 0, "Deltas are encoded in whole words");
+
+	std::vector<unsigned char> ring;
+	std::deque<Delta> deltas;
+	size_t head{};
+	size_t bytes_used{};
+
+	// Newest snapshot, the one StepBack decodes from. Between pushes scratch
+	// holds the same state, so both can be brought up to date page by page.
+	std::vector<unsigned char> current;
+	std::vector<unsigned char> scratch;
+	std::vector<unsigned char> encoded;
+	bool has_current = false;
+
+	unsigned long long push_count{};
+	double push_microseconds{};
+};
@@ -0,0 +1,611 @@
+#include "Scaler.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define GBE_SCALER_X86
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GBE_SCALER_SSE2
+#include <emmintrin.h>
+#endif
+
+// MSVC compiles AVX2 intrinsics anywhere, GCC and Clang only in functions
+// marked for it. Either way they only run after the CPU was checked.
+#ifdef GBE_SCALER_X86
+#define GBE_SCALER_AVX2
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define GBE_TARGET_AVX2
+#else
+#define GBE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+typedef void (*ExpandFunction)(const unsigned char* shades, unsigned int* output, unsigned int width, const unsigned int* palette);
+typedef void (*Scale2xFunction)(const unsigned char* source, unsigned int stride, unsigned int width, unsigned char* top, unsigned char* bottom);
+typedef void (*Scale3xFunction)(const unsigned char* source, unsigned int stride, unsigned int width, unsigned char* top, unsigned char* middle, unsigned char* bottom);
+
+// Neighbours of E:  A B C
+//                   D E F
+//                   G H I
+// A pixel only takes a neighbour's shade where two edges meet, B != H and
+// D != F, so straight lines and flat areas stay as they are.
+
+static void Scale2xRowScalar(const unsigned char* source, unsigned int stride, unsigned int width, unsigned char* top, unsigned char* bottom)
+{
+	for (unsigned int x = 0; x < width; ++x)
+	{
+		const unsigned char* e = source + x;
+		unsigned char b = e[-static_cast<int>(stride)];
+		unsigned char d = e[-1];
+		unsigned char f = e[1];
+		unsigned char h = e[stride];
+		bool corner = b != h && d != f;
+
+		top[x * 2] = corner && d == b ? d : *e;
+		top[x * 2 + 1] = corner && b == f ? f : *e;
+		bottom[x * 2] = corner && d == h ? d : *e;
+		bottom[x * 2 + 1] = corner && h == f ? f : *e;
+	}
+}
+
+static void Scale3xRowScalar(const unsigned char* source, unsigned int stride, unsigned int width, unsigned char* top, unsigned char* middle, unsigned char* bottom)
+{
+	for (unsigned int x = 0; x < width; ++x)
+	{
+		const unsigned char* p = source + x;
+		int s = static_cast<int>(stride);
+		unsigned char a = p[-s - 1], b = p[-s], c = p[-s + 1];
+		unsigned char d = p[-1], e = p[0], f = p[1];
+		unsigned char g = p[s - 1], h = p[s], i = p[s + 1];
+		bool corner = b != h && d != f;
+
+		top[x * 3] = corner && d == b ? d : e;
+		top[x * 3 + 1] = corner && ((d == b && e != c) || (b == f && e != a)) ? b : e;
+		top[x * 3 + 2] = corner && b == f ? f : e;
+		middle[x * 3] = corner && ((d == b && e != g) || (d == h && e != a)) ? d : e;
+		middle[x * 3 + 1] = e;
+		middle[x * 3 + 2] = corner && ((b == f && e != i) || (h == f && e != c)) ? f : e;
+		bottom[x * 3] = corner && d == h ? d : e;
+		bottom[x * 3 + 1] = corner && ((d == h && e != i) || (h == f && e != g)) ? h : e;
+		bottom[x * 3 + 2] = corner && h == f ? f : e;
+	}
+}
+
+template<unsigned int factor>
+static void ExpandRowScalar(const unsigned char* shades, unsigned int* output, unsigned int width, const unsigned int* palette)
+{
+	for (unsigned int x = 0; x < width; ++x)
+	{
+		unsigned int color = palette[shades[x]];
+
+		for (unsigned int i = 0; i < factor; ++i)
+			*output++ = color;
+	}
+}
+
+// Writes the three rows of 16 or 32 Scale3x results, byte shuffles across
+// three vectors cost more than the plain stores
+static inline void Interleave3(const unsigned char* first, const unsigned char* second, const unsigned char* third, unsigned int count, unsigned char* output)
+{
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		output[i * 3] = first[i];
+		output[i * 3 + 1] = second[i];
+		output[i * 3 + 2] = third[i];
+	}
+}
+
+#ifdef GBE_SCALER_SSE2
+static inline __m128i LoadSSE2(const unsigned char* p)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+static inline void StoreSSE2(void* p, __m128i v)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+}
+
+// mask ? a : b
+static inline __m128i SelectSSE2(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static void Scale2xRowSSE2(const unsigned char* source, unsigned int stride, unsigned int width, unsigned char* top, unsigned char* bottom)
+{
+	for (unsigned int x = 0; x < width; x += 16)
+	{
+		const unsigned char* p = source + x;
+		__m128i b = LoadSSE2(p - stride);
+		__m128i d = LoadSSE2(p - 1);
+		__m128i e = LoadSSE2(p);
+		__m128i f = LoadSSE2(p + 1);
+		__m128i h = LoadSSE2(p + stride);
+
+		// Set where the pixel is not on a corner
+		__m128i flat = _mm_or_si128(_mm_cmpeq_epi8(b, h), _mm_cmpeq_epi8(d, f));
+
+		__m128i e0 = SelectSSE2(_mm_andnot_si128(flat, _mm_cmpeq_epi8(d, b)), d, e);
+		__m128i e1 = SelectSSE2(_mm_andnot_si128(flat, _mm_cmpeq_epi8(b, f)), f, e);
+		__m128i e2 = SelectSSE2(_mm_andnot_si128(flat, _mm_cmpeq_epi8(d, h)), d, e);
+		__m128i e3 = SelectSSE2(_mm_andnot_si128(flat, _mm_cmpeq_epi8(h, f)), f, e);
+
+		StoreSSE2(top + x * 2, _mm_unpacklo_epi8(e0, e1));
+		StoreSSE2(top + x * 2 + 16, _mm_unpackhi_epi8(e0, e1));
+		StoreSSE2(bottom + x * 2, _mm_unpacklo_epi8(e2, e3));
+		StoreSSE2(bottom + x * 2 + 16, _mm_unpackhi_epi8(e2, e3));
+	}
+}
+
+static void Scale3xRowSSE2(const unsigned char* source, unsigned int stride, unsigned int width, unsigned char* top, unsigned char* middle, unsigned char* bottom)
+{
+	alignas(16) unsigned char results[9][16];
+
+	for (unsigned int x = 0; x < width; x += 16)
+	{
+		const unsigned char* p = source + x;
+		__m128i a = LoadSSE2(p - stride - 1), b = LoadSSE2(p - stride), c = LoadSSE2(p - stride + 1);
+		__m128i d = LoadSSE2(p - 1), e = LoadSSE2(p), f = LoadSSE2(p + 1);
+		__m128i g = LoadSSE2(p + stride - 1), h = LoadSSE2(p + stride), i = LoadSSE2(p + stride + 1);
+
+		__m128i flat = _mm_or_si128(_mm_cmpeq_epi8(b, h), _mm_cmpeq_epi8(d, f));
+		__m128i db = _mm_andnot_si128(flat, _mm_cmpeq_epi8(d, b));
+		__m128i bf = _mm_andnot_si128(flat, _mm_cmpeq_epi8(b, f));
+		__m128i dh = _mm_andnot_si128(flat, _mm_cmpeq_epi8(d, h));
+		__m128i hf = _mm_andnot_si128(flat, _mm_cmpeq_epi8(h, f));
+		__m128i ea = _mm_cmpeq_epi8(e, a), ec = _mm_cmpeq_epi8(e, c), eg = _mm_cmpeq_epi8(e, g), ei = _mm_cmpeq_epi8(e, i);
+
+		StoreSSE2(results[0], SelectSSE2(db, d, e));
+		StoreSSE2(results[1], SelectSSE2(_mm_or_si128(_mm_andnot_si128(ec, db), _mm_andnot_si128(ea, bf)), b, e));
+		StoreSSE2(results[2], SelectSSE2(bf, f, e));
+		StoreSSE2(results[3], SelectSSE2(_mm_or_si128(_mm_andnot_si128(eg, db), _mm_andnot_si128(ea, dh)), d, e));
+		StoreSSE2(results[4], e);
+		StoreSSE2(results[5], SelectSSE2(_mm_or_si128(_mm_andnot_si128(ei, bf), _mm_andnot_si128(ec, hf)), f, e));
+		StoreSSE2(results[6], SelectSSE2(dh, d, e));
+		StoreSSE2(results[7], SelectSSE2(_mm_or_si128(_mm_andnot_si128(ei, dh), _mm_andnot_si128(eg, hf)), h, e));
+		StoreSSE2(results[8], SelectSSE2(hf, f, e));
+
+		Interleave3(results[0], results[1], results[2], 16, top + x * 3);
+		Interleave3(results[3], results[4], results[5], 16, middle + x * 3);
+		Interleave3(results[6], results[7], results[8], 16, bottom + x * 3);
+	}
+}
+
+// Works a color channel at a time on 16 shades: with the shade's two bits as
+// masks, channel = c0 ^ (bit 0 & (c0 ^ c1)) ^ (bit 1 & (c0 ^ c2)) ^ (both &
+// (c0 ^ c1 ^ c2 ^ c3)). Interleaving the four channel vectors gives the colors.
+template<unsigned int factor>
+static void ExpandRowSSE2(const unsigned char* shades, unsigned int* output, unsigned int width, const unsigned int* palette)
+{
+	__m128i base[4];
+	__m128i bit0[4];
+	__m128i bit1[4];
+	__m128i both[4];
+
+	for (int channel = 0; channel < 4; ++channel)
+	{
+		unsigned int shift = channel * 8;
+		unsigned char c0 = static_cast<unsigned char>(palette[0] >> shift);
+		unsigned char c1 = static_cast<unsigned char>(palette[1] >> shift);
+		unsigned char c2 = static_cast<unsigned char>(palette[2] >> shift);
+		unsigned char c3 = static_cast<unsigned char>(palette[3] >> shift);
+
+		base[channel] = _mm_set1_epi8(static_cast<char>(c0));
+		bit0[channel] = _mm_set1_epi8(static_cast<char>(c0 ^ c1));
+		bit1[channel] = _mm_set1_epi8(static_cast<char>(c0 ^ c2));
+		both[channel] = _mm_set1_epi8(static_cast<char>(c0 ^ c1 ^ c2 ^ c3));
+	}
+
+	__m128i one = _mm_set1_epi8(1);
+	__m128i two = _mm_set1_epi8(2);
+
+	for (unsigned int x = 0; x < width; x += 16)
+	{
+		__m128i shade = LoadSSE2(shades + x);
+		__m128i mask0 = _mm_cmpeq_epi8(_mm_and_si128(shade, one), one);
+		__m128i mask1 = _mm_cmpeq_epi8(_mm_and_si128(shade, two), two);
+		__m128i mask3 = _mm_and_si128(mask0, mask1);
+		__m128i channels[4];
+
+		for (int channel = 0; channel < 4; ++channel)
+		{
+			channels[channel] = _mm_xor_si128(_mm_xor_si128(base[channel], _mm_and_si128(mask0, bit0[channel])),
+				_mm_xor_si128(_mm_and_si128(mask1, bit1[channel]), _mm_and_si128(mask3, both[channel])));
+		}
+
+		// Bytes of 0xAARRGGBB in memory order
+		__m128i low[2] = { _mm_unpacklo_epi8(channels[0], channels[1]), _mm_unpacklo_epi8(channels[2], channels[3]) };
+		__m128i high[2] = { _mm_unpackhi_epi8(channels[0], channels[1]), _mm_unpackhi_epi8(channels[2], channels[3]) };
+		__m128i pixels[4] =
+		{
+			_mm_unpacklo_epi16(low[0], low[1]),
+			_mm_unpackhi_epi16(low[0], low[1]),
+			_mm_unpacklo_epi16(high[0], high[1]),
+			_mm_unpackhi_epi16(high[0], high[1])
+		};
+
+		for (__m128i color : pixels)
+		{
+			if constexpr (factor == 1)
+				StoreSSE2(output, color);
+			else if constexpr (factor == 2)
+			{
+				StoreSSE2(output, _mm_unpacklo_epi32(color, color));
+				StoreSSE2(output + 4, _mm_unpackhi_epi32(color, color));
+			}
+			else if constexpr (factor == 3)
+			{
+				StoreSSE2(output, _mm_shuffle_epi32(color, _MM_SHUFFLE(1, 0, 0, 0)));
+				StoreSSE2(output + 4, _mm_shuffle_epi32(color, _MM_SHUFFLE(2, 2, 1, 1)));
+				StoreSSE2(output + 8, _mm_shuffle_epi32(color, _MM_SHUFFLE(3, 3, 3, 2)));
+			}
+			else
+			{
+				StoreSSE2(output, _mm_shuffle_epi32(color, _MM_SHUFFLE(0, 0, 0, 0)));
+				StoreSSE2(output + 4, _mm_shuffle_epi32(color, _MM_SHUFFLE(1, 1, 1, 1)));
+				StoreSSE2(output + 8, _mm_shuffle_epi32(color, _MM_SHUFFLE(2, 2, 2, 2)));
+				StoreSSE2(output + 12, _mm_shuffle_epi32(color, _MM_SHUFFLE(3, 3, 3, 3)));
+			}
+
+			output += 4 * factor;
+		}
+	}
+}
+#endif
+
+#ifdef GBE_SCALER_AVX2
+GBE_TARGET_AVX2 static inline __m256i LoadAVX2(const unsigned char* p)
+{
+	return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+}
+
+GBE_TARGET_AVX2 static inline void StoreAVX2(void* p, __m256i v)
+{
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+}
+
+GBE_TARGET_AVX2 static inline __m256i SelectAVX2(__m256i mask, __m256i a, __m256i b)
+{
+	return _mm256_blendv_epi8(b, a, mask);
+}
+
+// Unpacks work within 128-bit lanes, put the halves back in order
+GBE_TARGET_AVX2 static inline void StoreInterleavedAVX2(unsigned char* p, __m256i first, __m256i second)
+{
+	__m256i low = _mm256_unpacklo_epi8(first, second);
+	__m256i high = _mm256_unpackhi_epi8(first, second);
+
+	StoreAVX2(p, _mm256_permute2x128_si256(low, high, 0x20));
+	StoreAVX2(p + 32, _mm256_permute2x128_si256(low, high, 0x31));
+}
+
+GBE_TARGET_AVX2 static void Scale2xRowAVX2(const unsigned char* source, unsigned int stride, unsigned int width, unsigned char* top, unsigned char* bottom)
+{
+	for (unsigned int x = 0; x < width; x += 32)
+	{
+		const unsigned char* p = source + x;
+		__m256i b = LoadAVX2(p - stride);
+		__m256i d = LoadAVX2(p - 1);
+		__m256i e = LoadAVX2(p);
+		__m256i f = LoadAVX2(p + 1);
+		__m256i h = LoadAVX2(p + stride);
+
+		__m256i flat = _mm256_or_si256(_mm256_cmpeq_epi8(b, h), _mm256_cmpeq_epi8(d, f));
+
+		__m256i e0 = SelectAVX2(_mm256_andnot_si256(flat, _mm256_cmpeq_epi8(d, b)), d, e);
+		__m256i e1 = SelectAVX2(_mm256_andnot_si256(flat, _mm256_cmpeq_epi8(b, f)), f, e);
+		__m256i e2 = SelectAVX2(_mm256_andnot_si256(flat, _mm256_cmpeq_epi8(d, h)), d, e);
+		__m256i e3 = SelectAVX2(_mm256_andnot_si256(flat, _mm256_cmpeq_epi8(h, f)), f, e);
+
+		StoreInterleavedAVX2(top + x * 2, e0, e1);
+		StoreInterleavedAVX2(bottom + x * 2, e2, e3);
+	}
+}
+
+GBE_TARGET_AVX2 static void Scale3xRowAVX2(const unsigned char* source, unsigned int stride, unsigned int width, unsigned char* top, unsigned char* middle, unsigned char* bottom)
+{
+	alignas(32) unsigned char results[9][32];
+
+	for (unsigned int x = 0; x < width; x += 32)
+	{
+		const unsigned char* p = source + x;
+		__m256i a = LoadAVX2(p - stride - 1), b = LoadAVX2(p - stride), c = LoadAVX2(p - stride + 1);
+		__m256i d = LoadAVX2(p - 1), e = LoadAVX2(p), f = LoadAVX2(p + 1);
+		__m256i g = LoadAVX2(p + stride - 1), h = LoadAVX2(p + stride), i = LoadAVX2(p + stride + 1);
+
+		__m256i flat = _mm256_or_si256(_mm256_cmpeq_epi8(b, h), _mm256_cmpeq_epi8(d, f));
+		__m256i db = _mm256_andnot_si256(flat, _mm256_cmpeq_epi8(d, b));
+		__m256i bf = _mm256_andnot_si256(flat, _mm256_cmpeq_epi8(b, f));
+		__m256i dh = _mm256_andnot_si256(flat, _mm256_cmpeq_epi8(d, h));
+		__m256i hf = _mm256_andnot_si256(flat, _mm256_cmpeq_epi8(h, f));
+		__m256i ea = _mm256_cmpeq_epi8(e, a), ec = _mm256_cmpeq_epi8(e, c), eg = _mm256_cmpeq_epi8(e, g), ei = _mm256_cmpeq_epi8(e, i);
+
+		StoreAVX2(results[0], SelectAVX2(db, d, e));
+		StoreAVX2(results[1], SelectAVX2(_mm256_or_si256(_mm256_andnot_si256(ec, db), _mm256_andnot_si256(ea, bf)), b, e));
+		StoreAVX2(results[2], SelectAVX2(bf, f, e));
+		StoreAVX2(results[3], SelectAVX2(_mm256_or_si256(_mm256_andnot_si256(eg, db), _mm256_andnot_si256(ea, dh)), d, e));
+		StoreAVX2(results[4], e);
+		StoreAVX2(results[5], SelectAVX2(_mm256_or_si256(_mm256_andnot_si256(ei, bf), _mm256_andnot_si256(ec, hf)), f, e));
+		StoreAVX2(results[6], SelectAVX2(dh, d, e));
+		StoreAVX2(results[7], SelectAVX2(_mm256_or_si256(_mm256_andnot_si256(ei, dh), _mm256_andnot_si256(eg, hf)), h, e));
+		StoreAVX2(results[8], SelectAVX2(hf, f, e));
+
+		Interleave3(results[0], results[1], results[2], 32, top + x * 3);
+		Interleave3(results[3], results[4], results[5], 32, middle + x * 3);
+		Interleave3(results[6], results[7], results[8], 32, bottom + x * 3);
+	}
+}
+
+// The palette sits in the low four lanes of a vector, a lane permute looks
+// eight shades up at once and a second one repeats each color factor times
+template<unsigned int factor>
+GBE_TARGET_AVX2 static void ExpandRowAVX2(const unsigned char* shades, unsigned int* output, unsigned int width, const unsigned int* palette)
+{
+	__m256i colors = _mm256_setr_epi32(static_cast<int>(palette[0]), static_cast<int>(palette[1]), static_cast<int>(palette[2]), static_cast<int>(palette[3]),
+		static_cast<int>(palette[0]), static_cast<int>(palette[1]), static_cast<int>(palette[2]), static_cast<int>(palette[3]));
+
+	__m256i repeat[factor];
+
+	for (unsigned int i = 0; i < factor; ++i)
+	{
+		alignas(32) int lanes[8];
+
+		for (unsigned int lane = 0; lane < 8; ++lane)
+			lanes[lane] = static_cast<int>((i * 8 + lane) / factor);
+
+		repeat[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes));
+	}
+
+	for (unsigned int x = 0; x < width; x += 8)
+	{
+		__m256i shade = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(shades + x)));
+		__m256i color = _mm256_permutevar8x32_epi32(colors, shade);
+
+		if constexpr (factor == 1)
+			StoreAVX2(output, color);
+		else
+		{
+			for (unsigned int i = 0; i < factor; ++i)
+				StoreAVX2(output + i * 8, _mm256_permutevar8x32_epi32(color, repeat[i]));
+		}
+
+		output += 8 * factor;
+	}
+}
+
+static bool CpuSupportsAVX2()
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+
+	if (info[0] < 7)
+		return false;
+
+	// The OS has to save the YMM registers too
+	__cpuid(info, 1);
+
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+struct KernelFunctions
+{
+	ExpandFunction expand[Scaler::max_factor];
+	Scale2xFunction scale2x;
+	Scale3xFunction scale3x;
+};
+
+static const KernelFunctions kernel_functions[ScalerKernel_Count] =
+{
+	{ { ExpandRowScalar<1>, ExpandRowScalar<2>, ExpandRowScalar<3>, ExpandRowScalar<4> }, Scale2xRowScalar, Scale3xRowScalar },
+#ifdef GBE_SCALER_SSE2
+	{ { ExpandRowSSE2<1>, ExpandRowSSE2<2>, ExpandRowSSE2<3>, ExpandRowSSE2<4> }, Scale2xRowSSE2, Scale3xRowSSE2 },
+#else
+	{},
+#endif
+#ifdef GBE_SCALER_AVX2
+	{ { ExpandRowAVX2<1>, ExpandRowAVX2<2>, ExpandRowAVX2<3>, ExpandRowAVX2<4> }, Scale2xRowAVX2, Scale3xRowAVX2 },
+#else
+	{},
+#endif
+};
+
+Scaler::Scaler(unsigned int factor, ScaleFilter filter)
+{
+	this->factor = factor < 1 ? 1 : factor > max_factor ? max_factor : factor;
+	this->filter = filter;
+	kernel = GetBestKernel();
+	std::memcpy(palette, default_palette, sizeof(palette));
+
+	if (filter == ScaleFilter_Smooth && this->factor > 1)
+	{
+		source.Allocate(System::screen_width, System::screen_height);
+
+		if (this->factor == 4)
+			doubled.Allocate(System::screen_width * 2, System::screen_height * 2);
+
+		rows = new unsigned char[GetWidth() * 3];
+	}
+}
+
+Scaler::~Scaler()
+{
+	delete[] source.data;
+	delete[] doubled.data;
+	delete[] rows;
+}
+
+void Scaler::PaddedImage::Allocate(unsigned int width, unsigned int height)
+{
+	this->width = width;
+	this->height = height;
+	stride = width + padding * 2;
+	data = new unsigned char[stride * (height + 2)]();
+}
+
+unsigned char* Scaler::PaddedImage::Row(unsigned int y)
+{
+	return data + (y + 1) * stride + padding;
+}
+
+void Scaler::PaddedImage::FillBorder()
+{
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		unsigned char* row = Row(y);
+		row[-1] = row[0];
+		row[width] = row[width - 1];
+	}
+
+	std::memcpy(Row(0) - stride - 1, Row(0) - 1, width + 2);
+	std::memcpy(Row(height - 1) + stride - 1, Row(height - 1) - 1, width + 2);
+}
+
+void Scaler::Scale(const unsigned char* shades, unsigned int* output, unsigned int pitch)
+{
+	const KernelFunctions& functions = kernel_functions[kernel];
+	unsigned int width = System::screen_width;
+
+	if (filter == ScaleFilter_Nearest || factor == 1)
+	{
+		for (unsigned int y = 0; y < System::screen_height; ++y)
+		{
+			unsigned int* row = output + y * factor * pitch;
+
+			functions.expand[factor - 1](shades + y * width, row, width, palette);
+
+			for (unsigned int i = 1; i < factor; ++i)
+				std::memcpy(row + i * pitch, row, GetWidth() * sizeof(unsigned int));
+		}
+
+		return;
+	}
+
+	for (unsigned int y = 0; y < System::screen_height; ++y)
+		std::memcpy(source.Row(y), shades + y * width, width);
+
+	source.FillBorder();
+
+	if (factor == 3)
+	{
+		unsigned int scaled_width = width * 3;
+
+		for (unsigned int y = 0; y < System::screen_height; ++y)
+		{
+			functions.scale3x(source.Row(y), source.stride, width, rows, rows + scaled_width, rows + scaled_width * 2);
+
+			for (unsigned int i = 0; i < 3; ++i)
+				functions.expand[0](rows + i * scaled_width, output + (y * 3 + i) * pitch, scaled_width, palette);
+		}
+
+		return;
+	}
+
+	// 4x smooths the smoothed 2x image again
+	PaddedImage& input = factor == 4 ? doubled : source;
+
+	if (factor == 4)
+	{
+		for (unsigned int y = 0; y < System::screen_height; ++y)
+			functions.scale2x(source.Row(y), source.stride, width, doubled.Row(y * 2), doubled.Row(y * 2 + 1));
+
+		doubled.FillBorder();
+	}
+
+	unsigned int scaled_width = input.width * 2;
+
+	for (unsigned int y = 0; y < input.height; ++y)
+	{
+		functions.scale2x(input.Row(y), input.stride, input.width, rows, rows + scaled_width);
+
+		functions.expand[0](rows, output + y * 2 * pitch, scaled_width, palette);
+		functions.expand[0](rows + scaled_width, output + (y * 2 + 1) * pitch, scaled_width, palette);
+	}
+}
+
+void Scaler::SetPalette(const unsigned int colors[4])
+{
+	std::memcpy(palette, colors, sizeof(palette));
+}
+
+void Scaler::SetKernel(ScalerKernel kernel)
+{
+	this->kernel = IsKernelSupported(kernel) ? kernel : GetBestKernel();
+}
+
+ScalerKernel Scaler::GetKernel()
+{
+	return kernel;
+}
+
+unsigned int Scaler::GetWidth()
+{
+	return System::screen_width * factor;
+}
+
+unsigned int Scaler::GetHeight()
+{
+	return System::screen_height * factor;
+}
+
+unsigned int Scaler::GetFactor()
+{
+	return factor;
+}
+
+ScaleFilter Scaler::GetFilter()
+{
+	return filter;
+}
+
+ScalerKernel Scaler::GetBestKernel()
+{
+	static const ScalerKernel best = IsKernelSupported(ScalerKernel_AVX2) ? ScalerKernel_AVX2 : IsKernelSupported(ScalerKernel_SSE2) ? ScalerKernel_SSE2 : ScalerKernel_Scalar;
+
+	return best;
+}
+
+bool Scaler::IsKernelSupported(ScalerKernel kernel)
+{
+	switch (kernel)
+	{
+	case ScalerKernel_Scalar:
+		return true;
+#ifdef GBE_SCALER_SSE2
+	case ScalerKernel_SSE2:
+		return true;
+#endif
+#ifdef GBE_SCALER_AVX2
+	case ScalerKernel_AVX2:
+	{
+		static const bool supported = CpuSupportsAVX2();
+		return supported;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+const char* Scaler::GetKernelName(ScalerKernel kernel)
+{
+	static constexpr const char* names[ScalerKernel_Count] = { "scalar", "sse2", "avx2" };
+
+	return kernel < ScalerKernel_Count ? names[kernel] : "unknown";
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "System.h"
+
+enum ScaleFilter
+{
+	// Every pixel becomes a factor x factor block
+	ScaleFilter_Nearest,
+	// Scale2x / Scale3x edge smoothing, 4x applies Scale2x twice
+	ScaleFilter_Smooth
+};
+
+enum ScalerKernel
+{
+	ScalerKernel_Scalar,
+	ScalerKernel_SSE2,
+	ScalerKernel_AVX2,
+	ScalerKernel_Count
+};
+
+// Scales the emulated screen on the CPU, for outputs without a GPU: turns the
+// 160x144 shades of a framebuffer into 32-bit 0xAARRGGBB colors at 1x to 4x.
+// Smoothing works on the shades before the palette is applied, so comparing
+// pixels is comparing bytes and 16 or 32 of them are handled per instruction.
+//
+// Every filter has a plain loop, an SSE2 and an AVX2 kernel producing
+// identical output. The best kernel the CPU supports is picked at
+// construction, AVX2 is only compiled in for x86 and checked at run time.
+class Scaler
+{
+public:
+	static constexpr unsigned int max_factor = 4;
+	static constexpr unsigned int default_palette[4] = { 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555, 0xFF000000 };
+
+	Scaler(unsigned int factor = 2, ScaleFilter filter = ScaleFilter_Nearest);
+	~Scaler();
+
+	Scaler(const Scaler&) = delete;
+	Scaler& operator=(const Scaler&) = delete;
+
+	// Shades are 0 to 3. Pitch is the distance between output rows in
+	// pixels, at least GetWidth().
+	void Scale(const unsigned char* shades, unsigned int* output, unsigned int pitch);
+
+	// Colors of shades 0 (white) to 3 (black)
+	void SetPalette(const unsigned int colors[4]);
+	// Falls back to the best supported kernel if the CPU lacks this one
+	void SetKernel(ScalerKernel kernel);
+	ScalerKernel GetKernel();
+
+	unsigned int GetWidth();
+	unsigned int GetHeight();
+	unsigned int GetFactor();
+	ScaleFilter GetFilter();
+
+	static ScalerKernel GetBestKernel();
+	static bool IsKernelSupported(ScalerKernel kernel);
+	static const char* GetKernelName(ScalerKernel kernel);
+
+private:
+	// Shades with a one pixel border repeating the edges, so the neighbours
+	// of edge pixels need no special case. Rows start padding bytes in.
+	struct PaddedImage
+	{
+		static constexpr unsigned int padding = 32;
+
+		unsigned char* data{};
+		unsigned int width{};
+		unsigned int height{};
+		unsigned int stride{};
+
+		void Allocate(unsigned int width, unsigned int height);
+		unsigned char* Row(unsigned int y);
+		void FillBorder();
+	};
+
+	unsigned int factor;
+	ScaleFilter filter;
+	ScalerKernel kernel;
+	unsigned int palette[4];
+
+	PaddedImage source;
+	// Output of the first Scale2x pass at 4x
+	PaddedImage doubled;
+	// Scaled shade rows waiting for the palette
+	unsigned char* rows{};
+};
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "SymbolTable.h"
+
+#include <algorithm>
+#include <numeric>
+
+static bool ParseHexField(const std::string& line, size_t& position, char terminator, unsigned int& value)
+{
+	size_t start = position;
+	value = 0;
+
+	for (; position < line.size() && line[position] != terminator; ++position)
+	{
+		char digit = line[position];
+
+		if (digit >= '0' && digit <= '9')
+			value = value << 4 | (digit - '0');
+		else if (digit >= 'a' && digit <= 'f')
+			value = value << 4 | (digit - 'a' + 10);
+		else if (digit >= 'A' && digit <= 'F')
+			value = value << 4 | (digit - 'A' + 10);
+		else
+			return false;
+	}
+
+	return position > start && position < line.size();
+}
+
+bool SymbolTable::Load(std::string path)
+{
+	std::ifstream input(path);
+
+	if (!input)
+		return false;
+
+	Clear();
+
+	std::vector<unsigned int> unsorted_keys;
+	std::vector<unsigned int> unsorted_offsets;
+	std::string line;
+
+	while (std::getline(input, line))
+	{
+		size_t position = 0;
+		unsigned int bank;
+		unsigned int address;
+
+		if (line.empty() || line[0] == ';')
+			continue;
+
+		if (!ParseHexField(line, position, ':', bank) || !ParseHexField(line, ++position, ' ', address) || bank > 0xFFFF || address > 0xFFFF)
+			continue;
+
+		size_t name_start = line.find_first_not_of(" \t", position);
+		size_t name_end = line.find_first_of(" \t\r;", name_start);
+
+		if (name_start == std::string::npos)
+			continue;
+
+		unsorted_keys.push_back(bank << 16 | address);
+		unsorted_offsets.push_back(static_cast<unsigned int>(names.size()));
+
+		names.append(line, name_start, name_end == std::string::npos ? std::string::npos : name_end - name_start);
+		names += '\0';
+	}
+
+	std::vector<unsigned int> order(unsorted_keys.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return unsorted_keys[a] < unsorted_keys[b]; });
+
+	keys.reserve(order.size());
+	name_offsets.reserve(order.size());
+
+	for (unsigned int index : order)
+	{
+		keys.push_back(unsorted_keys[index]);
+		name_offsets.push_back(unsorted_offsets[index]);
+	}
+
+	return true;
+}
+
+void SymbolTable::Clear()
+{
+	keys.clear();
+	name_offsets.clear();
+	names.clear();
+}
+
+const char* SymbolTable::Find(unsigned short bank, unsigned short address) const
+{
+	unsigned int key = static_cast<unsigned int>(bank) << 16 | address;
+
+	auto found = std::lower_bound(keys.begin(), keys.end(), key);
+
+	if (found == keys.end() || *found != key)
+		return nullptr;
+
+	return names.data() + name_offsets[found - keys.begin()];
+}
+
+bool SymbolTable::FindAddress(const std::string& name, unsigned short& bank, unsigned short& address) const
+{
+	// Only used when typing commands, a linear scan is fine
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		if (name == names.data() + name_offsets[i])
+		{
+			bank = static_cast<unsigned short>(keys[i] >> 16);
+			address = static_cast<unsigned short>(keys[i] & 0xFFFF);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+size_t SymbolTable::GetCount() const
+{
+	return keys.size();
+}
\ No newline at end of file
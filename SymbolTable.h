@@ -0,0 +1,31 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Labels from an RGBDS .sym file ("BB:AAAA Name" per line, ';' comments).
+// Entries are kept as a sorted array of (bank << 16 | address) keys with the
+// names packed into one string, so a lookup is a binary search over a few
+// cache lines instead of a walk through a node based map.
+class SymbolTable
+{
+public:
+	bool Load(std::string path);
+	void Clear();
+
+	// Name of the label at exactly (bank, address), nullptr if there is none.
+	// Of several labels on one address the first in the file wins.
+	const char* Find(unsigned short bank, unsigned short address) const;
+	// Looks a label up by name, false if it is unknown
+	bool FindAddress(const std::string& name, unsigned short& bank, unsigned short& address) const;
+
+	size_t GetCount() const;
+
+private:
+	std::vector<unsigned int> keys;
+	// Offsets into names, parallel to keys
+	std::vector<unsigned int> name_offsets;
+	// Every name followed by a terminating zero
+	std::string names;
+};
\ No newline at end of file
@@ -1,44 +1,446 @@
 #include "System.h"
+#include "FlightRecorder.h"
+#include "TraceWriter.h"
+
+// Machine cycles (in clock ticks) per instruction. Conditional jumps, calls and
+// returns list the not-taken cost, the taken penalty is added where the branch happens.
+const unsigned char System::opcode_cycles[256] =
+{
+	 4, 12,  8,  8,  4,  4,  8,  4, 20,  8,  8,  8,  4,  4,  8,  4,
+	 4, 12,  8,  8,  4,  4,  8,  4, 12,  8,  8,  8,  4,  4,  8,  4,
+	 8, 12,  8,  8,  4,  4,  8,  4,  8,  8,  8,  8,  4,  4,  8,  4,
+	 8, 12,  8,  8, 12, 12, 12,  4,  8,  8,  8,  8,  4,  4,  8,  4,
+	 4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,
+	 4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,
+	 4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,
+	 8,  8,  8,  8,  8,  8,  4,  8,  4,  4,  4,  4,  4,  4,  8,  4,
+	 4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,
+	 4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,
+	 4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,
+	 4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4,
+	 8, 12, 12, 16, 12, 16,  8, 16,  8, 16, 12,  4, 12, 24,  8, 16,
+	 8, 12, 12,  4, 12, 16,  8, 16,  8, 16, 12,  4, 12,  4,  8, 16,
+	12, 12,  8,  4,  4, 16,  8, 16, 16,  4, 16,  4,  4,  4,  8, 16,
+	12, 12,  8,  4,  4, 16,  8, 16, 12,  8, 16,  4,  4,  4,  8, 16
+};
+// Includes the 0xCB prefix itself
+const unsigned char System::cb_opcode_cycles[256] =
+{
+	 8,  8,  8,  8,  8,  8, 16,  8,  8,  8,  8,  8,  8,  8, 16,  8,
+	 8,  8,  8,  8,  8,  8, 16,  8,  8,  8,  8,  8,  8,  8, 16,  8,
+	 8,  8,  8,  8,  8,  8, 16,  8,  8,  8,  8,  8,  8,  8, 16,  8,
+	 8,  8,  8,  8,  8,  8, 16,  8,  8,  8,  8,  8,  8,  8, 16,  8,
+	 8,  8,  8,  8,  8,  8, 12,  8,  8,  8,  8,  8,  8,  8, 12,  8,
+	 8,  8,  8,  8,  8,  8, 12,  8,  8,  8,  8,  8,  8,  8, 12,  8,
+	 8,  8,  8,  8,  8,  8, 12,  8,  8,  8,  8,  8,  8,  8, 12,  8,
+	 8,  8,  8,  8,  8,  8, 12,  8,  8,  8,  8,  8,  8,  8, 12,  8,
+	 8,  8,  8,  8,  8,  8, 16,  8,  8,  8,  8,  8,  8,  8, 16,  8,
+	 8,  8,  8,  8,  8,  8, 16,  8,  8,  8,  8,  8,  8,  8, 16,  8,
+	 8,  8,  8,  8,  8,  8, 16,  8,  8,  8,  8,  8,  8,  8, 16,  8,
+	 8,  8,  8,  8,  8,  8, 16,  8,  8,  8,  8,  8,  8,  8, 16,  8,
+	 8,  8,  8,  8,  8,  8, 16,  8,  8,  8,  8,  8,  8,  8, 16,  8,
+	 8,  8,  8,  8,  8,  8, 16,  8,  8,  8,  8,  8,  8,  8, 16,  8,
+	 8,  8,  8,  8,  8,  8, 16,  8,  8,  8,  8,  8,  8,  8, 16,  8,
+	 8,  8,  8,  8,  8,  8, 16,  8,  8,  8,  8,  8,  8,  8, 16,  8
+};
 
 System::System(FileLogger* logger)
 {
 	this->logger = logger;
+
+	for (auto& page : memory_pages)
+		page = new MemoryPage();
+}
+
+System::~System()
+{
+	for (MemoryPage* page : memory_pages)
+		ReleasePage(page);
+
+	delete[] framebuffer_data;
+	delete debug_points;
+}
+
+System* System::Clone()
+{
+	// Pages only hold their hash while clean, rehash before they are shared
+	UpdateMemoryHash();
+
+	// Copies the CPU, timing and page table, the pages themselves are shared
+	System* child = new System(*this);
+
+	for (MemoryPage* page : child->memory_pages)
+		page->references.fetch_add(1, std::memory_order_relaxed);
+
+	child->framebuffer_data = nullptr;
+	child->framebuffer = nullptr;
+	child->profiler = nullptr;
+	child->trace_writer = nullptr;
+	child->flight_recorder = nullptr;
+
+	// Breakpoints and watchpoints belong to the debugger of the parent
+	child->debug_points = nullptr;
+	std::memset(child->watched_pages, 0, sizeof(child->watched_pages));
+	child->debug_active = false;
+	child->debug_pending = false;
+	child->single_step = false;
+	child->skip_breakpoint = false;
+	child->stop_reason = Stop_None;
+
+	// The cached page hashes stay valid, only snapshot consumers start over
+	for (auto& bits : child->dirty_pages.bits)
+		bits = ~0ull;
+
+	return child;
 }
 
 void System::Initialize()
 {
-	std::memset(main_memory, 0, sizeof(main_memory));
+	for (unsigned int page = 0; page < page_count; ++page)
+		std::memset(GetWritablePage(page)->data, 0, page_size);
 
-	// registers = {0};
+	MarkAllPagesDirty();
+
+	// Everything the CPU carries over from a previous run, so a reset
+	// instance runs exactly like a new one
+	registers = Registers{};
 	pc = 0x0000;
 	sp = 0xFFFE;
+	opcode = 0;
+	IME = false;
+	halted = false;
+	instruction_cycles = 0;
+	rom_bank = 1;
+	cycles = 0;
+	frame_cycles = 0;
+	frame_count = 0;
+
+	// Held buttons stay held across a reset
+	WriteMemoryUnwatched(0xFF00, BuildJoypadRegister(0));
+
+	// Breakpoints survive a reset, a pending stop does not
+	stop_reason = Stop_None;
+	single_step = false;
+	skip_breakpoint = false;
+	UpdateDebugPoints();
 
 	running = true;
 }
 
 void System::LoadRom(std::string path)
 {
-	Initialize();
-
 	std::ifstream input(path, std::ios::in | std::ios::binary);
 
 	std::vector<unsigned char> buffer(std::istreambuf_iterator<char>(input), {});
 
-	for (int i = 0; i < 0x8000; ++i)
-	{
-		main_memory[i] = buffer[i];
-	}
+	LoadRom(buffer.data(), buffer.size());
 
-	logger->Log(LOG_INFO, "Loaded Rom of size: ", buffer.size());
+	logger->Log<LOG_INFO>("Loaded Rom of size: ", buffer.size());
+}
+void System::LoadRom(const unsigned char* data, size_t size)
+{
+	Initialize();
+
+	rom_hash = HashBytes(data, size);
+
+	WriteMemoryBlock(0x0000, static_cast<unsigned int>(size < 0x8000 ? size : 0x8000), data);
 }
 
 unsigned char System::GetInputRegister()
 {
-	return main_memory[0xFF00];
+	return ReadMemoryUnwatched(0xFF00);
 }
 void System::SetInputRegister(unsigned char keypad)
 {
-	main_memory[0xFF00] = keypad;
+	WriteMemoryUnwatched(0xFF00, BuildJoypadRegister(keypad));
+}
+void System::SetJoypad(unsigned char buttons)
+{
+	if (buttons == joypad_buttons)
+		return;
+
+	joypad_buttons = buttons;
+	WriteMemoryUnwatched(0xFF00, BuildJoypadRegister(ReadMemoryUnwatched(0xFF00)));
+}
+unsigned char System::GetJoypad()
+{
+	return joypad_buttons;
+}
+unsigned char System::BuildJoypadRegister(unsigned char select)
+{
+	// Keep the group select bits, unused bits and released buttons read as 1
+	unsigned char joypad = select | 0xCF;
+
+	if ((joypad & (1 << 4)) == 0)
+		joypad &= ~(joypad_buttons & 0x0F);
+	if ((joypad & (1 << 5)) == 0)
+		joypad &= ~(joypad_buttons >> 4);
+
+	// A P10-P13 line going from high to low should request the joypad
+	// interrupt (IF bit 4). It is held back until the core runs interrupt
+	// handlers correctly: with 16-bit operands still read byte-swapped, both
+	// bundled games reach STOP on the first button press once it fires.
+
+	return joypad;
+}
+
+void System::ReadMemoryBlock(unsigned short address, unsigned int length, unsigned char* output)
+{
+	while (length > 0)
+	{
+		unsigned int offset = address % page_size;
+		unsigned int chunk = page_size - offset;
+
+		if (chunk > length)
+			chunk = length;
+
+		std::memcpy(output, memory_pages[address / page_size]->data + offset, chunk);
+
+		output += chunk;
+		length -= chunk;
+		address = static_cast<unsigned short>(address + chunk);
+	}
+}
+
+void System::WriteMemoryBlock(unsigned short address, unsigned int length, const unsigned char* input)
+{
+	while (length > 0)
+	{
+		unsigned int offset = address % page_size;
+		unsigned int chunk = page_size - offset;
+
+		if (chunk > length)
+			chunk = length;
+
+		std::memcpy(GetWritablePage(address / page_size)->data + offset, input, chunk);
+		MarkPageDirty(address);
+
+		input += chunk;
+		length -= chunk;
+		address = static_cast<unsigned short>(address + chunk);
+	}
+}
+
+const unsigned char* System::GetFramebuffer()
+{
+	if (framebuffer == nullptr)
+		AllocateFramebuffer();
+
+	return framebuffer;
+}
+void System::SetFramebufferTarget(unsigned char* target)
+{
+	framebuffer = target != nullptr ? target : framebuffer_data;
+}
+void System::AllocateFramebuffer()
+{
+	if (framebuffer_data == nullptr)
+		framebuffer_data = new unsigned char[screen_width * screen_height]();
+
+	framebuffer = framebuffer_data;
+}
+void System::SetRenderingEnabled(bool enabled)
+{
+	rendering_enabled = enabled;
+}
+bool System::IsRenderingEnabled()
+{
+	return rendering_enabled;
+}
+
+static const unsigned char state_magic[4] = { 'G', 'B', 'E', 'S' };
+static const unsigned int state_version = 1;
+
+void System::SaveState(std::vector<unsigned char>& output)
+{
+	output.resize(state_size);
+
+	WriteStateHeader(output.data());
+
+	unsigned char* memory = output.data() + state_header_size;
+
+	for (unsigned int page = 0; page < page_count; ++page)
+		std::memcpy(memory + page * page_size, memory_pages[page]->data, page_size);
+}
+
+void System::UpdateState(std::vector<unsigned char>& state, const DirtyPages& pages)
+{
+	if (state.size() != state_size)
+	{
+		SaveState(state);
+		return;
+	}
+
+	WriteStateHeader(state.data());
+
+	unsigned char* memory = state.data() + state_header_size;
+
+	for (unsigned int page = 0; page < page_count; ++page)
+	{
+		if (pages.IsSet(page))
+			std::memcpy(memory + page * page_size, memory_pages[page]->data, page_size);
+	}
+}
+
+void System::WriteStateHeader(unsigned char* output)
+{
+	unsigned char* cursor = output;
+	auto put = [&cursor](const void* value, size_t size)
+	{
+		std::memcpy(cursor, value, size);
+		cursor += size;
+	};
+
+	unsigned char flags = (running << 0) | (halted << 1) | (IME << 2);
+	unsigned int padding = 0;
+
+	put(state_magic, sizeof(state_magic));
+	put(&state_version, sizeof(state_version));
+	put(&registers, sizeof(registers));
+	put(&pc, sizeof(pc));
+	put(&sp, sizeof(sp));
+	put(&flags, sizeof(flags));
+	put(&opcode, sizeof(opcode));
+	put(&joypad_buttons, sizeof(joypad_buttons));
+	put(&rom_bank, sizeof(rom_bank));
+	put(&cycles, sizeof(cycles));
+	put(&frame_cycles, sizeof(frame_cycles));
+	put(&padding, sizeof(padding));
+	put(&frame_count, sizeof(frame_count));
+}
+
+bool System::LoadState(const unsigned char* data, size_t size)
+{
+	if (size != state_size || std::memcmp(data, state_magic, sizeof(state_magic)) != 0)
+	{
+		logger->Log<LOG_ERROR>("Invalid save state.");
+		return false;
+	}
+
+	const unsigned char* cursor = data + sizeof(state_magic);
+	auto get = [&cursor](void* value, size_t size)
+	{
+		std::memcpy(value, cursor, size);
+		cursor += size;
+	};
+
+	unsigned int version = 0;
+	get(&version, sizeof(version));
+
+	if (version != state_version)
+	{
+		logger->Log<LOG_ERROR>("Unsupported save state version.");
+		return false;
+	}
+
+	unsigned char flags = 0;
+	unsigned int padding = 0;
+
+	get(&registers, sizeof(registers));
+	get(&pc, sizeof(pc));
+	get(&sp, sizeof(sp));
+	get(&flags, sizeof(flags));
+	get(&opcode, sizeof(opcode));
+	get(&joypad_buttons, sizeof(joypad_buttons));
+	get(&rom_bank, sizeof(rom_bank));
+	get(&cycles, sizeof(cycles));
+	get(&frame_cycles, sizeof(frame_cycles));
+	get(&padding, sizeof(padding));
+	get(&frame_count, sizeof(frame_count));
+
+	for (unsigned int page = 0; page < page_count; ++page)
+		get(GetWritablePage(page)->data, page_size);
+
+	MarkAllPagesDirty();
+
+	running = (flags & (1 << 0)) != 0;
+	halted = (flags & (1 << 1)) != 0;
+	IME = (flags & (1 << 2)) != 0;
+
+	return true;
+}
+
+void System::TakeDirtyPages(DirtyPages& pages)
+{
+	pages = dirty_pages;
+	dirty_pages = DirtyPages{};
+}
+
+void System::MarkAllPagesDirty()
+{
+	for (auto& bits : dirty_pages.bits)
+		bits = ~0ull;
+	for (auto& bits : hash_dirty_pages.bits)
+		bits = ~0ull;
+}
+
+unsigned int System::GetOwnedPageCount()
+{
+	unsigned int count = 0;
+
+	for (MemoryPage* page : memory_pages)
+		count += page->references.load(std::memory_order_relaxed) == 1;
+
+	return count;
+}
+
+MemoryPage* System::UnsharePage(unsigned int page)
+{
+	MemoryPage* copy = new MemoryPage;
+
+	std::memcpy(copy->data, memory_pages[page]->data, page_size);
+	copy->hash = memory_pages[page]->hash;
+	ReleasePage(memory_pages[page]);
+
+	memory_pages[page] = copy;
+
+	return copy;
+}
+
+void System::ReleasePage(MemoryPage* page)
+{
+	if (page->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		delete page;
+}
+
+unsigned long long System::GetRomHash()
+{
+	return rom_hash;
+}
+
+unsigned long long System::GetStateHash()
+{
+	UpdateMemoryHash();
+
+	unsigned long long hash = memory_hash;
+
+	hash = HashCombine(hash, registers.fa);
+	hash = HashCombine(hash, registers.cb);
+	hash = HashCombine(hash, registers.ed);
+	hash = HashCombine(hash, registers.lh);
+	hash = HashCombine(hash, (static_cast<unsigned long long>(pc) << 16) | sp);
+	hash = HashCombine(hash, (IME << 1) | halted);
+
+	return hash;
+}
+
+void System::UpdateMemoryHash()
+{
+	for (unsigned int word = 0; word < 4; ++word)
+	{
+		for (unsigned long long bits = hash_dirty_pages.bits[word]; bits != 0; bits &= bits - 1)
+		{
+			unsigned int index = word * 64 + std::countr_zero(bits);
+			// Written pages are private, so the hash can be updated in place
+			MemoryPage* page = memory_pages[index];
+			unsigned long long page_hash = HashBytes(page->data, page_size, index);
+
+			memory_hash ^= page->hash ^ page_hash;
+			page->hash = page_hash;
+		}
+	}
+
+	hash_dirty_pages = DirtyPages{};
 }
 
 bool System::IsRunning()
@@ -55,7 +457,7 @@ unsigned char System::GetLastOpcode()
 }
 unsigned char System::GetNextOpcode()
 {
-	return main_memory[pc];
+	return ReadMemoryUnwatched(pc);
 }
 Registers System::GetRegisters()
 {
@@ -69,29 +471,301 @@ unsigned short System::GetSP()
 {
 	return sp;
 }
+void System::SetRegisters(const Registers& registers)
+{
+	this->registers = registers;
+}
+void System::SetPC(unsigned short pc)
+{
+	this->pc = pc;
+}
+void System::SetSP(unsigned short sp)
+{
+	this->sp = sp;
+}
+unsigned long long System::GetCycles()
+{
+	return cycles;
+}
+unsigned long long System::GetFrameCount()
+{
+	return frame_count;
+}
+unsigned char System::GetBank(unsigned short address)
+{
+	if (address < 0x4000)
+		return 0;
+	if (address < 0x8000)
+		return rom_bank;
 
-void System::EmulateCycle()
+	return 0;
+}
+void System::SetProfiler(Profiler* profiler)
 {
-	if (!halted)
+	this->profiler = profiler;
+}
+void System::SetTraceWriter(TraceWriter* trace_writer)
+{
+	this->trace_writer = trace_writer;
+}
+void System::SetFlightRecorder(FlightRecorder* flight_recorder)
+{
+	this->flight_recorder = flight_recorder;
+}
+
+void System::AddBreakpoint(unsigned short address, unsigned short bank)
+{
+	if (debug_points == nullptr)
+		debug_points = new DebugPoints();
+
+	std::pair<unsigned short, unsigned short> breakpoint(address, bank);
+
+	if (std::find(debug_points->breakpoints.begin(), debug_points->breakpoints.end(), breakpoint) == debug_points->breakpoints.end())
+		debug_points->breakpoints.push_back(breakpoint);
+
+	UpdateDebugPoints();
+}
+void System::RemoveBreakpoint(unsigned short address, unsigned short bank)
+{
+	if (debug_points == nullptr)
+		return;
+
+	std::erase(debug_points->breakpoints, std::pair<unsigned short, unsigned short>(address, bank));
+
+	UpdateDebugPoints();
+}
+void System::ClearBreakpoints()
+{
+	if (debug_points == nullptr)
+		return;
+
+	debug_points->breakpoints.clear();
+
+	UpdateDebugPoints();
+}
+
+void System::AddWatchpoint(unsigned short address, unsigned short length, WatchType type)
+{
+	if (length == 0)
+		return;
+
+	if (debug_points == nullptr)
+		debug_points = new DebugPoints();
+
+	debug_points->watchpoints.push_back(Watchpoint{ address, length, type });
+
+	UpdateDebugPoints();
+}
+void System::RemoveWatchpoint(unsigned short address, unsigned short length, WatchType type)
+{
+	if (debug_points == nullptr)
+		return;
+
+	std::erase_if(debug_points->watchpoints, [&](const Watchpoint& watchpoint)
+	{
+		return watchpoint.address == address && watchpoint.length == length && watchpoint.type == type;
+	});
+
+	UpdateDebugPoints();
+}
+void System::ClearWatchpoints()
+{
+	if (debug_points == nullptr)
+		return;
+
+	debug_points->watchpoints.clear();
+
+	UpdateDebugPoints();
+}
+
+StopReason System::GetStopReason()
+{
+	return stop_reason;
+}
+unsigned short System::GetWatchAddress()
+{
+	return watch_address;
+}
+WatchType System::GetWatchType()
+{
+	return watch_type;
+}
+void System::Resume(bool step)
+{
+	stop_reason = Stop_None;
+	skip_breakpoint = true;
+	single_step = step;
+
+	UpdateDebugPoints();
+}
+
+void System::Stop()
+{
+	if (stop_reason != Stop_None)
+		return;
+
+	stop_reason = Stop_Request;
+
+	UpdateDebugPoints();
+}
+
+bool System::CheckDebugStop()
+{
+	if (stop_reason != Stop_None)
+		return true;
+
+	// The instruction a Resume continues from runs regardless of its breakpoint
+	if (skip_breakpoint)
+	{
+		skip_breakpoint = false;
+		UpdateDebugPoints();
+
+		return false;
+	}
+
+	if (single_step)
+	{
+		single_step = false;
+		stop_reason = Stop_Step;
+
+		return true;
+	}
+
+	if (halted || ((debug_points->breakpoint_bits[pc / 64] >> (pc % 64)) & 1) == 0)
+		return false;
+
+	unsigned short bank = GetBank(pc);
+
+	for (auto& [address, breakpoint_bank] : debug_points->breakpoints)
 	{
-		if (pc > sizeof(main_memory))
+		if (address == pc && (breakpoint_bank == any_bank || breakpoint_bank == bank))
 		{
-			logger->Log(LOG_ERROR, "PC points out of memory.");
+			stop_reason = Stop_Breakpoint;
+			debug_pending = true;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void System::OnWatchedAccess(unsigned short address, WatchType type)
+{
+	// The first hit of an instruction is the one reported
+	if (stop_reason != Stop_None || debug_points == nullptr)
+		return;
+
+	for (const Watchpoint& watchpoint : debug_points->watchpoints)
+	{
+		if ((watchpoint.type & type) != 0 && static_cast<unsigned short>(address - watchpoint.address) < watchpoint.length)
+		{
+			stop_reason = Stop_Watchpoint;
+			watch_address = address;
+			watch_type = type;
+			debug_active = true;
+			debug_pending = true;
+
 			return;
 		}
+	}
+}
+
+void System::UpdateDebugPoints()
+{
+	std::memset(watched_pages, 0, sizeof(watched_pages));
+
+	bool has_breakpoints = false;
+
+	if (debug_points != nullptr)
+	{
+		std::memset(debug_points->breakpoint_bits, 0, sizeof(debug_points->breakpoint_bits));
+
+		for (auto& [address, bank] : debug_points->breakpoints)
+			debug_points->breakpoint_bits[address / 64] |= 1ull << (address % 64);
+
+		for (const Watchpoint& watchpoint : debug_points->watchpoints)
+		{
+			unsigned int last = watchpoint.address + watchpoint.length - 1u;
+
+			for (unsigned int page = watchpoint.address / page_size; page <= last / page_size; ++page)
+				watched_pages[page % page_count] |= watchpoint.type;
+		}
+
+		has_breakpoints = !debug_points->breakpoints.empty();
+	}
+
+	debug_pending = single_step || skip_breakpoint || stop_reason != Stop_None;
+	debug_active = has_breakpoints || debug_pending;
+}
+
+void System::RunFrame()
+{
+	unsigned long long frame = frame_count;
+
+	while (running && frame_count == frame && stop_reason == Stop_None)
+		EmulateCycle();
+}
+
+void System::EmulateCycle()
+{
+	unsigned long long start_cycles = cycles;
+
+	// Only breakpoints on this address or a pending stop leave the fast path
+	if (debug_active && (debug_pending || ((debug_points->breakpoint_bits[pc / 64] >> (pc % 64)) & 1)) && CheckDebugStop())
+		return;
+
+	if (!halted)
+	{
+		if (trace_writer != nullptr)
+			trace_writer->OnInstruction(this);
 
 		FetchOpcode();
+
+		if (flight_recorder != nullptr)
+			flight_recorder->Record(registers, pc, sp, opcode, GetBank(pc), cycles);
+
 		ExecuteOpcode();
 	}
+	else
+	{
+		cycles += 4;
+	}
 
 	if (IME)
 		ProcessInterrupts();
+
+	UpdateLCD(static_cast<unsigned int>(cycles - start_cycles));
+}
+
+void System::UpdateLCD(unsigned int elapsed)
+{
+	frame_cycles += elapsed;
+
+	if (frame_cycles >= cycles_per_frame)
+		frame_cycles -= cycles_per_frame;
+
+	unsigned char line = static_cast<unsigned char>(frame_cycles / cycles_per_line);
+
+	if (line != ReadMemoryUnwatched(0xFF44))
+	{
+		WriteMemoryUnwatched(0xFF44, line);
+
+		if (line < vblank_line && rendering_enabled)
+			RenderLine(line);
+
+		if (line == vblank_line)
+		{
+			// Request the VBlank interrupt
+			WriteMemoryUnwatched(0xFF0F, ReadMemoryUnwatched(0xFF0F) | 1);
+			++frame_count;
+		}
+	}
 }
 
 void System::ProcessInterrupts()
 {
-	unsigned char IF = main_memory[0xFF0F];
-	unsigned char IE = main_memory[0xFFFF];
+	unsigned char IF = ReadMemoryUnwatched(0xFF0F);
+	unsigned char IE = ReadMemoryUnwatched(0xFFFF);
 	unsigned char mask = 1;
 
 	for (int i = 0; i <= 4; ++i)
@@ -100,8 +774,8 @@ void System::ProcessInterrupts()
 		{
 			if ((IE & mask) == mask)
 			{
-				// main_memory[0xFF0F] = 0;
-				main_memory[0xFF0F] ^= mask;
+				// WriteMemory(0xFF0F, 0);
+				WriteMemoryUnwatched(0xFF0F, ReadMemoryUnwatched(0xFF0F) ^ mask);
 
 				if (halted)
 				{
@@ -111,7 +785,11 @@ void System::ProcessInterrupts()
 
 				IME = false;
 
-				AsmCALLInterrupt(interrupt_addresses[1]);
+				PROFILER_HOOK(OnInterrupt(interrupt_addresses[i]));
+
+				AsmCALLInterrupt(interrupt_addresses[i]);
+
+				cycles += 20;
 
 				break;
 			}
@@ -121,13 +799,137 @@ void System::ProcessInterrupts()
 	}
 }
 
+void System::RenderLine(unsigned char line)
+{
+	if (framebuffer == nullptr)
+		AllocateFramebuffer();
+
+	unsigned char lcdc = ReadMemoryUnwatched(0xFF40);
+	unsigned char* row = framebuffer + line * screen_width;
+
+	if ((lcdc & 0x80) == 0)
+	{
+		std::memset(row, 0, screen_width);
+		return;
+	}
+
+	// Raw background colour indices, sprites with priority flag only draw over index 0
+	unsigned char background[screen_width]{};
+
+	if ((lcdc & 0x01) != 0)
+	{
+		unsigned char scy = ReadMemoryUnwatched(0xFF42);
+		unsigned char scx = ReadMemoryUnwatched(0xFF43);
+		unsigned char wy = ReadMemoryUnwatched(0xFF4A);
+		unsigned char wx = ReadMemoryUnwatched(0xFF4B);
+		unsigned char palette = ReadMemoryUnwatched(0xFF47);
+		bool window = (lcdc & 0x20) != 0 && line >= wy && wx <= 166;
+
+		for (unsigned int x = 0; x < screen_width; ++x)
+		{
+			unsigned short map;
+			unsigned char px;
+			unsigned char py;
+
+			if (window && x + 7 >= wx)
+			{
+				map = (lcdc & 0x40) != 0 ? 0x9C00 : 0x9800;
+				px = static_cast<unsigned char>(x + 7 - wx);
+				py = static_cast<unsigned char>(line - wy);
+			}
+			else
+			{
+				map = (lcdc & 0x08) != 0 ? 0x9C00 : 0x9800;
+				px = static_cast<unsigned char>(x + scx);
+				py = static_cast<unsigned char>(line + scy);
+			}
+
+			unsigned char tile = ReadMemoryUnwatched(map + (py / 8) * 32 + px / 8);
+			unsigned short address = (lcdc & 0x10) != 0 ? 0x8000 + tile * 16 : 0x9000 + static_cast<signed char>(tile) * 16;
+
+			address += (py % 8) * 2;
+
+			unsigned char bit = 7 - px % 8;
+			unsigned char color = (((ReadMemoryUnwatched(address + 1) >> bit) & 1) << 1) | ((ReadMemoryUnwatched(address) >> bit) & 1);
+
+			background[x] = color;
+			row[x] = (palette >> (color * 2)) & 3;
+		}
+	}
+	else
+	{
+		std::memset(row, 0, screen_width);
+	}
+
+	if ((lcdc & 0x02) == 0)
+		return;
+
+	unsigned int height = (lcdc & 0x04) != 0 ? 16 : 8;
+	unsigned char sprites[10];
+	unsigned int sprite_count = 0;
+
+	for (unsigned int i = 0; i < 40 && sprite_count < 10; ++i)
+	{
+		int y = ReadMemoryUnwatched(0xFE00 + i * 4) - 16;
+
+		if (line >= y && line < y + static_cast<int>(height))
+			sprites[sprite_count++] = static_cast<unsigned char>(i);
+	}
+
+	// Drawn back to front so lower OAM entries end up on top
+	while (sprite_count > 0)
+	{
+		unsigned short oam = 0xFE00 + sprites[--sprite_count] * 4;
+		int y = ReadMemoryUnwatched(oam) - 16;
+		int x = ReadMemoryUnwatched(oam + 1) - 8;
+		unsigned char tile = ReadMemoryUnwatched(oam + 2);
+		unsigned char attributes = ReadMemoryUnwatched(oam + 3);
+		unsigned char palette = ReadMemoryUnwatched((attributes & 0x10) != 0 ? 0xFF49 : 0xFF48);
+		unsigned int tile_row = line - y;
+
+		if ((attributes & 0x40) != 0)
+			tile_row = height - 1 - tile_row;
+		if (height == 16)
+			tile &= 0xFE;
+
+		unsigned short address = 0x8000 + tile * 16 + tile_row * 2;
+		unsigned char low = ReadMemoryUnwatched(address);
+		unsigned char high = ReadMemoryUnwatched(address + 1);
+
+		for (int px = 0; px < 8; ++px)
+		{
+			int sx = x + px;
+
+			if (sx < 0 || sx >= static_cast<int>(screen_width))
+				continue;
+
+			unsigned char bit = (attributes & 0x20) != 0 ? px : 7 - px;
+			unsigned char color = (((high >> bit) & 1) << 1) | ((low >> bit) & 1);
+
+			if (color == 0)
+				continue;
+			if ((attributes & 0x80) != 0 && background[sx] != 0)
+				continue;
+
+			row[sx] = (palette >> (color * 2)) & 3;
+		}
+	}
+}
+
 void System::FetchOpcode()
 {
-	opcode = main_memory[pc];
+	opcode = ReadMemoryUnwatched(pc);
 }
 
 void System::ExecuteOpcode()
 {
+#ifdef GBE_PROFILER
+	unsigned short instruction_pc = pc;
+	bool prefixed = false;
+#endif
+
+	instruction_cycles = opcode_cycles[opcode];
+
 	switch (opcode)
 	{
 		// NOP
@@ -138,14 +940,14 @@ void System::ExecuteOpcode()
 	// LD BC,nn
 	case 0x01:
 	{
-		registers.cb = (main_memory[++pc] << 8) | main_memory[++pc];
+		registers.cb = (ReadMemory(++pc) << 8) | ReadMemory(++pc);
 
 		break;
 	}
 	// LD (BC),A
 	case 0x02:
 	{
-		main_memory[registers.cb] = registers.a;
+		WriteMemory(registers.cb, registers.a);
 
 		break;
 	}
@@ -173,7 +975,7 @@ void System::ExecuteOpcode()
 	// LD B,n
 	case 0x06:
 	{
-		registers.b = main_memory[++pc];
+		registers.b = ReadMemory(++pc);
 
 		break;
 	}
@@ -199,9 +1001,9 @@ void System::ExecuteOpcode()
 	// LD (nn),SP
 	case 0x08:
 	{
-		unsigned short addr = (main_memory[++pc] << 8) | main_memory[++pc];
-		main_memory[addr] = static_cast<unsigned char>(sp >> 8);
-		main_memory[addr + 1] = static_cast<unsigned char>(sp & 0xFF);
+		unsigned short addr = (ReadMemory(++pc) << 8) | ReadMemory(++pc);
+		WriteMemory(addr, static_cast<unsigned char>(sp >> 8));
+		WriteMemory(addr + 1, static_cast<unsigned char>(sp & 0xFF));
 
 		break;
 	}
@@ -227,7 +1029,7 @@ void System::ExecuteOpcode()
 	// LD A,(BC)
 	case 0x0A:
 	{
-		registers.a = main_memory[registers.cb];
+		registers.a = ReadMemory(registers.cb);
 
 		break;
 	}
@@ -255,7 +1057,7 @@ void System::ExecuteOpcode()
 	// LD C,n
 	case 0x0E:
 	{
-		registers.c = main_memory[++pc];
+		registers.c = ReadMemory(++pc);
 
 		break;
 	}
@@ -288,14 +1090,14 @@ void System::ExecuteOpcode()
 	// LD DE,nn
 	case 0x11:
 	{
-		registers.ed = (main_memory[++pc] << 8) | main_memory[++pc];
+		registers.ed = (ReadMemory(++pc) << 8) | ReadMemory(++pc);
 
 		break;
 	}
 	// LD (DE),A
 	case 0x12:
 	{
-		main_memory[registers.ed] = registers.a;
+		WriteMemory(registers.ed, registers.a);
 
 		break;
 	}
@@ -323,7 +1125,7 @@ void System::ExecuteOpcode()
 	// LD D,n
 	case 0x16:
 	{
-		registers.d = main_memory[++pc];
+		registers.d = ReadMemory(++pc);
 
 		break;
 	}
@@ -350,7 +1152,7 @@ void System::ExecuteOpcode()
 	// JR n
 	case 0x18:
 	{
-		pc += main_memory[pc + 1];
+		pc += ReadMemory(pc + 1);
 		--pc;
 
 		break;
@@ -377,7 +1179,7 @@ void System::ExecuteOpcode()
 	// LD A,(DE)
 	case 0x1A:
 	{
-		registers.a = main_memory[registers.ed];
+		registers.a = ReadMemory(registers.ed);
 
 		break;
 	}
@@ -405,7 +1207,7 @@ void System::ExecuteOpcode()
 	// LD E,n
 	case 0x1E:
 	{
-		registers.e = main_memory[++pc];
+		registers.e = ReadMemory(++pc);
 
 		break;
 	}
@@ -434,7 +1236,8 @@ void System::ExecuteOpcode()
 	{
 		if (GetBitflag(Zero) == 0)
 		{
-			pc += main_memory[pc + 1];
+			instruction_cycles += 4;
+			pc += ReadMemory(pc + 1);
 			--pc;
 		}
 
@@ -443,14 +1246,14 @@ void System::ExecuteOpcode()
 	// LD HL,nn
 	case 0x21:
 	{
-		registers.lh = (main_memory[++pc] << 8) | main_memory[++pc];
+		registers.lh = (ReadMemory(++pc) << 8) | ReadMemory(++pc);
 
 		break;
 	}
 	// LDI (HL),A
 	case 0x22:
 	{
-		main_memory[registers.lh] = registers.a;
+		WriteMemory(registers.lh, registers.a);
 		++registers.lh;
 
 		break;
@@ -479,7 +1282,7 @@ void System::ExecuteOpcode()
 	// LD H,n
 	case 0x26:
 	{
-		registers.h = main_memory[++pc];
+		registers.h = ReadMemory(++pc);
 
 		break;
 	}
@@ -503,7 +1306,8 @@ void System::ExecuteOpcode()
 	{
 		if (GetBitflag(Zero) == 1)
 		{
-			pc += main_memory[pc + 1];
+			instruction_cycles += 4;
+			pc += ReadMemory(pc + 1);
 			--pc;
 		}
 
@@ -531,7 +1335,7 @@ void System::ExecuteOpcode()
 	// LDI A,(HL)
 	case 0x2A:
 	{
-		registers.a = main_memory[registers.lh];
+		registers.a = ReadMemory(registers.lh);
 		++registers.lh;
 
 		break;
@@ -560,7 +1364,7 @@ void System::ExecuteOpcode()
 	// LD L,n
 	case 0x2E:
 	{
-		registers.l = main_memory[++pc];
+		registers.l = ReadMemory(++pc);
 
 		break;
 	}
@@ -579,7 +1383,8 @@ void System::ExecuteOpcode()
 	{
 		if (GetBitflag(Carry) == 0)
 		{
-			pc += main_memory[pc + 1];
+			instruction_cycles += 4;
+			pc += ReadMemory(pc + 1);
 			--pc;
 		}
 
@@ -588,14 +1393,14 @@ void System::ExecuteOpcode()
 	// LD SP,nn
 	case 0x31:
 	{
-		sp = (main_memory[++pc] << 8) | main_memory[++pc];
+		sp = (ReadMemory(++pc) << 8) | ReadMemory(++pc);
 
 		break;
 	}
 	// LDD (HL),A
 	case 0x32:
 	{
-		main_memory[registers.lh] = registers.a;
+		WriteMemory(registers.lh, registers.a);
 		--registers.lh;
 
 		break;
@@ -610,21 +1415,21 @@ void System::ExecuteOpcode()
 	// INC (HL)
 	case 0x34:
 	{
-		AsmINC_s(&main_memory[registers.lh]);
+		ModifyMemory(registers.lh, [this](unsigned char* value) { AsmINC_s(value); });
 
 		break;
 	}
 	// DEC (HL)
 	case 0x35:
 	{
-		AsmDEC_s(&main_memory[registers.lh]);
+		ModifyMemory(registers.lh, [this](unsigned char* value) { AsmDEC_s(value); });
 
 		break;
 	}
 	// LD (HL),n
 	case 0x36:
 	{
-		main_memory[registers.lh] = main_memory[++pc];
+		WriteMemory(registers.lh, ReadMemory(++pc));
 
 		break;
 	}
@@ -640,7 +1445,8 @@ void System::ExecuteOpcode()
 	{
 		if (GetBitflag(Carry) == 1)
 		{
-			pc += main_memory[pc + 1];
+			instruction_cycles += 4;
+			pc += ReadMemory(pc + 1);
 			--pc;
 		}
 
@@ -668,7 +1474,7 @@ void System::ExecuteOpcode()
 	// LDD A,(HL)
 	case 0x3A:
 	{
-		registers.a = main_memory[registers.lh];
+		registers.a = ReadMemory(registers.lh);
 		--registers.lh;
 
 		break;
@@ -697,7 +1503,7 @@ void System::ExecuteOpcode()
 	// LD A,n
 	case 0x3E:
 	{
-		registers.a = main_memory[++pc];
+		registers.a = ReadMemory(++pc);
 
 		break;
 	}
@@ -753,7 +1559,7 @@ void System::ExecuteOpcode()
 	// LD B,(HL) 	
 	case 0x46:
 	{
-		registers.b = main_memory[registers.lh];
+		registers.b = ReadMemory(registers.lh);
 
 		break;
 	}
@@ -809,7 +1615,7 @@ void System::ExecuteOpcode()
 	// LD C,(HL)
 	case 0x4E:
 	{
-		registers.c = main_memory[registers.lh];
+		registers.c = ReadMemory(registers.lh);
 
 		break;
 	}
@@ -865,7 +1671,7 @@ void System::ExecuteOpcode()
 	// LD D,(HL)
 	case 0x56:
 	{
-		registers.d = main_memory[registers.lh];
+		registers.d = ReadMemory(registers.lh);
 
 		break;
 	}
@@ -921,7 +1727,7 @@ void System::ExecuteOpcode()
 	// LD E,(HL)
 	case 0x5E:
 	{
-		registers.e = main_memory[registers.lh];
+		registers.e = ReadMemory(registers.lh);
 
 		break;
 	}
@@ -977,7 +1783,7 @@ void System::ExecuteOpcode()
 	// LD H,(HL) 	
 	case 0x66:
 	{
-		registers.h = main_memory[registers.lh];
+		registers.h = ReadMemory(registers.lh);
 
 		break;
 	}
@@ -1033,7 +1839,7 @@ void System::ExecuteOpcode()
 	// LD L,(HL)
 	case 0x6E:
 	{
-		registers.l = main_memory[registers.lh];
+		registers.l = ReadMemory(registers.lh);
 
 		break;
 	}
@@ -1047,42 +1853,42 @@ void System::ExecuteOpcode()
 	// LD (HL),B
 	case 0x70:
 	{
-		main_memory[registers.lh] = registers.b;
+		WriteMemory(registers.lh, registers.b);
 
 		break;
 	}
 	// LD (HL),C
 	case 0x71:
 	{
-		main_memory[registers.lh] = registers.c;
+		WriteMemory(registers.lh, registers.c);
 
 		break;
 	}
 	// LD (HL),D
 	case 0x72:
 	{
-		main_memory[registers.lh] = registers.d;
+		WriteMemory(registers.lh, registers.d);
 
 		break;
 	}
 	// LD (HL),E
 	case 0x73:
 	{
-		main_memory[registers.lh] = registers.e;
+		WriteMemory(registers.lh, registers.e);
 
 		break;
 	}
 	// LD (HL),H
 	case 0x74:
 	{
-		main_memory[registers.lh] = registers.h;
+		WriteMemory(registers.lh, registers.h);
 
 		break;
 	}
 	// LD (HL),L
 	case 0x75:
 	{
-		main_memory[registers.lh] = registers.l;
+		WriteMemory(registers.lh, registers.l);
 
 		break;
 	}
@@ -1096,7 +1902,7 @@ void System::ExecuteOpcode()
 	// LD (HL),A
 	case 0x77:
 	{
-		main_memory[registers.lh] = registers.a;
+		WriteMemory(registers.lh, registers.a);
 
 		break;
 	}
@@ -1145,7 +1951,7 @@ void System::ExecuteOpcode()
 	// LD A,(HL)
 	case 0x7E:
 	{
-		registers.a = main_memory[registers.lh];
+		registers.a = ReadMemory(registers.lh);
 
 		break;
 	}
@@ -1201,7 +2007,7 @@ void System::ExecuteOpcode()
 	// ADD A,(HL)
 	case 0x86:
 	{
-		AsmADD_A(main_memory[registers.lh]);
+		AsmADD_A(ReadMemory(registers.lh));
 
 		break;
 	}
@@ -1257,7 +2063,7 @@ void System::ExecuteOpcode()
 	// ADC A,(HL)
 	case 0x8E:
 	{
-		AsmADC_A(main_memory[registers.lh]);
+		AsmADC_A(ReadMemory(registers.lh));
 
 		break;
 	}
@@ -1313,7 +2119,7 @@ void System::ExecuteOpcode()
 	// SUB A,(HL)
 	case 0x96:
 	{
-		AsmSUB_A(main_memory[registers.lh]);
+		AsmSUB_A(ReadMemory(registers.lh));
 
 		break;
 	}
@@ -1369,7 +2175,7 @@ void System::ExecuteOpcode()
 	// SBC A,(HL)
 	case 0x9E:
 	{
-		AsmSBC_A(main_memory[registers.lh]);
+		AsmSBC_A(ReadMemory(registers.lh));
 
 		break;
 	}
@@ -1425,7 +2231,7 @@ void System::ExecuteOpcode()
 	// AND (HL)
 	case 0xA6:
 	{
-		AsmAND_A(main_memory[registers.lh]);
+		AsmAND_A(ReadMemory(registers.lh));
 
 		break;
 	}
@@ -1481,7 +2287,7 @@ void System::ExecuteOpcode()
 	// XOR (HL)
 	case 0xAE:
 	{
-		AsmXOR_A(main_memory[registers.lh]);
+		AsmXOR_A(ReadMemory(registers.lh));
 
 		break;
 	}
@@ -1537,7 +2343,7 @@ void System::ExecuteOpcode()
 	// OR (HL)
 	case 0xB6:
 	{
-		AsmOR_A(main_memory[registers.lh]);
+		AsmOR_A(ReadMemory(registers.lh));
 
 		break;
 	}
@@ -1593,7 +2399,7 @@ void System::ExecuteOpcode()
 	// CP (HL)
 	case 0xBE:
 	{
-		AsmCP_A(main_memory[registers.lh]);
+		AsmCP_A(ReadMemory(registers.lh));
 
 		break;
 	}
@@ -1609,6 +2415,7 @@ void System::ExecuteOpcode()
 	{
 		if (GetBitflag(Zero) == 0)
 		{
+			instruction_cycles += 12;
 			AsmReturn();
 		}
 
@@ -1627,7 +2434,8 @@ void System::ExecuteOpcode()
 	{
 		if (GetBitflag(Zero) == 0)
 		{
-			pc = (main_memory[pc + 1] << 8) | main_memory[pc + 2];
+			instruction_cycles += 4;
+			pc = (ReadMemory(pc + 1) << 8) | ReadMemory(pc + 2);
 			--pc;
 		}
 
@@ -1636,7 +2444,7 @@ void System::ExecuteOpcode()
 	// JP nn
 	case 0xC3:
 	{
-		pc = (main_memory[pc + 1] << 8) | main_memory[pc + 2];
+		pc = (ReadMemory(pc + 1) << 8) | ReadMemory(pc + 2);
 		--pc;
 
 		break;
@@ -1645,22 +2453,25 @@ void System::ExecuteOpcode()
 	case 0xC4:
 	{
 		if (GetBitflag(Zero) == 0)
+		{
+			instruction_cycles += 12;
 			AsmCALLnn();
+		}
 
 		break;
 	}
 	// PUSH BC
 	case 0xC5:
 	{
-		main_memory[--sp] = registers.b;
-		main_memory[--sp] = registers.c;
+		WriteMemory(--sp, registers.b);
+		WriteMemory(--sp, registers.c);
 
 		break;
 	}
 	// ADD A, n
 	case 0xC6:
 	{
-		AsmADD_A(main_memory[++pc]);
+		AsmADD_A(ReadMemory(++pc));
 
 		break;
 	}
@@ -1675,7 +2486,10 @@ void System::ExecuteOpcode()
 	case 0xC8:
 	{
 		if (GetBitflag(Zero) == 1)
+		{
+			instruction_cycles += 12;
 			AsmReturn();
+		}
 
 		break;
 	}
@@ -1691,7 +2505,8 @@ void System::ExecuteOpcode()
 	{
 		if (GetBitflag(Zero) == 1)
 		{
-			pc = (main_memory[pc + 1] << 8) | main_memory[pc + 2];
+			instruction_cycles += 4;
+			pc = (ReadMemory(pc + 1) << 8) | ReadMemory(pc + 2);
 			--pc;
 		}
 
@@ -1700,7 +2515,12 @@ void System::ExecuteOpcode()
 	// Extended Operations
 	case 0xCB:
 	{
-		opcode = main_memory[++pc];
+		opcode = ReadMemory(++pc);
+		instruction_cycles = cb_opcode_cycles[opcode];
+
+#ifdef GBE_PROFILER
+		prefixed = true;
+#endif
 
 		switch (opcode)
 		{
@@ -1749,7 +2569,7 @@ void System::ExecuteOpcode()
 		// RLC (HL)
 		case 0x06:
 		{
-			AsmRLC(&main_memory[registers.lh]);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmRLC(value); });
 
 			break;
 		}
@@ -1805,7 +2625,7 @@ void System::ExecuteOpcode()
 		// RRC (HL)
 		case 0x0E:
 		{
-			AsmRRC(&main_memory[registers.lh]);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmRRC(value); });
 
 			break;
 		}
@@ -1861,7 +2681,7 @@ void System::ExecuteOpcode()
 		// RL (HL)
 		case 0x16:
 		{
-			AsmRL(&main_memory[registers.lh]);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmRL(value); });
 
 			break;
 		}
@@ -1917,7 +2737,7 @@ void System::ExecuteOpcode()
 		// RR (HL)
 		case 0x1E:
 		{
-			AsmRR(&main_memory[registers.lh]);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmRR(value); });
 
 			break;
 		}
@@ -1973,7 +2793,7 @@ void System::ExecuteOpcode()
 		// SLA (HL)
 		case 0x26:
 		{
-			AsmSLA(&main_memory[registers.lh]);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmSLA(value); });
 
 			break;
 		}
@@ -2029,7 +2849,7 @@ void System::ExecuteOpcode()
 		// SRA (HL)
 		case 0x2E:
 		{
-			AsmSRA(&main_memory[registers.lh]);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmSRA(value); });
 
 			break;
 		}
@@ -2085,7 +2905,7 @@ void System::ExecuteOpcode()
 		// SWAP (HL)
 		case 0x36:
 		{
-			AsmSWAP(&main_memory[registers.lh]);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmSWAP(value); });
 
 			break;
 		}
@@ -2141,7 +2961,7 @@ void System::ExecuteOpcode()
 		// SRL (HL)
 		case 0x3E:
 		{
-			AsmSRL(&main_memory[registers.b]);
+			ModifyMemory(registers.b, [this](unsigned char* value) { AsmSRL(value); });
 
 			break;
 		}
@@ -2197,7 +3017,7 @@ void System::ExecuteOpcode()
 		// BIT 0, (HL)
 		case 0x46:
 		{
-			AsmBIT(main_memory[registers.lh], 0);
+			AsmBIT(ReadMemory(registers.lh), 0);
 
 			break;
 		}
@@ -2253,7 +3073,7 @@ void System::ExecuteOpcode()
 		// BIT 1, (HL)
 		case 0x4E:
 		{
-			AsmBIT(main_memory[registers.lh], 1);
+			AsmBIT(ReadMemory(registers.lh), 1);
 
 			break;
 		}
@@ -2309,7 +3129,7 @@ void System::ExecuteOpcode()
 		// BIT 2, (HL)
 		case 0x56:
 		{
-			AsmBIT(main_memory[registers.lh], 2);
+			AsmBIT(ReadMemory(registers.lh), 2);
 
 			break;
 		}
@@ -2365,7 +3185,7 @@ void System::ExecuteOpcode()
 		// BIT 3, (HL)
 		case 0x5E:
 		{
-			AsmBIT(main_memory[registers.lh], 3);
+			AsmBIT(ReadMemory(registers.lh), 3);
 
 			break;
 		}
@@ -2421,7 +3241,7 @@ void System::ExecuteOpcode()
 		// BIT 4, (HL)
 		case 0x66:
 		{
-			AsmBIT(main_memory[registers.lh], 4);
+			AsmBIT(ReadMemory(registers.lh), 4);
 
 			break;
 		}
@@ -2477,7 +3297,7 @@ void System::ExecuteOpcode()
 		// BIT 5, (HL)
 		case 0x6E:
 		{
-			AsmBIT(main_memory[registers.lh], 5);
+			AsmBIT(ReadMemory(registers.lh), 5);
 
 			break;
 		}
@@ -2533,7 +3353,7 @@ void System::ExecuteOpcode()
 		// BIT 6, (HL)
 		case 0x76:
 		{
-			AsmBIT(main_memory[registers.lh], 6);
+			AsmBIT(ReadMemory(registers.lh), 6);
 
 			break;
 		}
@@ -2589,7 +3409,7 @@ void System::ExecuteOpcode()
 		// BIT 7, (HL)
 		case 0x7E:
 		{
-			AsmBIT(main_memory[registers.lh], 7);
+			AsmBIT(ReadMemory(registers.lh), 7);
 
 			break;
 		}
@@ -2645,7 +3465,7 @@ void System::ExecuteOpcode()
 		// RES 0, (HL)
 		case 0x86:
 		{
-			AsmRES(&main_memory[registers.lh], 0);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmRES(value, 0); });
 
 			break;
 		}
@@ -2701,7 +3521,7 @@ void System::ExecuteOpcode()
 		// RES 1, (HL)
 		case 0x8E:
 		{
-			AsmRES(&main_memory[registers.lh], 1);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmRES(value, 1); });
 
 			break;
 		}
@@ -2757,7 +3577,7 @@ void System::ExecuteOpcode()
 		// RES 2, (HL)
 		case 0x96:
 		{
-			AsmRES(&main_memory[registers.lh], 2);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmRES(value, 2); });
 
 			break;
 		}
@@ -2813,7 +3633,7 @@ void System::ExecuteOpcode()
 		// RES 3, (HL)
 		case 0x9E:
 		{
-			AsmRES(&main_memory[registers.lh], 3);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmRES(value, 3); });
 
 			break;
 		}
@@ -2869,7 +3689,7 @@ void System::ExecuteOpcode()
 		// RES 4, (HL)
 		case 0xA6:
 		{
-			AsmRES(&main_memory[registers.lh], 4);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmRES(value, 4); });
 
 			break;
 		}
@@ -2925,7 +3745,7 @@ void System::ExecuteOpcode()
 		// RES 5, (HL)
 		case 0xAE:
 		{
-			AsmRES(&main_memory[registers.lh], 5);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmRES(value, 5); });
 
 			break;
 		}
@@ -2981,7 +3801,7 @@ void System::ExecuteOpcode()
 		// RES 6, (HL)
 		case 0xB6:
 		{
-			AsmRES(&main_memory[registers.lh], 6);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmRES(value, 6); });
 
 			break;
 		}
@@ -3037,7 +3857,7 @@ void System::ExecuteOpcode()
 		// RES 7, (HL)
 		case 0xBE:
 		{
-			AsmRES(&main_memory[registers.lh], 7);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmRES(value, 7); });
 
 			break;
 		}
@@ -3093,7 +3913,7 @@ void System::ExecuteOpcode()
 		// SET 0, (HL)
 		case 0xC6:
 		{
-			AsmSET(&main_memory[registers.lh], 0);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmSET(value, 0); });
 
 			break;
 		}
@@ -3149,7 +3969,7 @@ void System::ExecuteOpcode()
 		// SET 1, (HL)
 		case 0xCE:
 		{
-			AsmSET(&main_memory[registers.lh], 1);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmSET(value, 1); });
 
 			break;
 		}
@@ -3205,7 +4025,7 @@ void System::ExecuteOpcode()
 		// SET 2, (HL)
 		case 0xD6:
 		{
-			AsmSET(&main_memory[registers.lh], 2);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmSET(value, 2); });
 
 			break;
 		}
@@ -3261,7 +4081,7 @@ void System::ExecuteOpcode()
 		// SET 3, (HL)
 		case 0xDE:
 		{
-			AsmSET(&main_memory[registers.lh], 3);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmSET(value, 3); });
 
 			break;
 		}
@@ -3317,7 +4137,7 @@ void System::ExecuteOpcode()
 		// SET 4, (HL)
 		case 0xE6:
 		{
-			AsmSET(&main_memory[registers.lh], 4);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmSET(value, 4); });
 
 			break;
 		}
@@ -3373,7 +4193,7 @@ void System::ExecuteOpcode()
 		// SET 5, (HL)
 		case 0xEE:
 		{
-			AsmSET(&main_memory[registers.lh], 5);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmSET(value, 5); });
 
 			break;
 		}
@@ -3429,7 +4249,7 @@ void System::ExecuteOpcode()
 		// SET 6, (HL)
 		case 0xF6:
 		{
-			AsmSET(&main_memory[registers.lh], 6);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmSET(value, 6); });
 
 			break;
 		}
@@ -3485,7 +4305,7 @@ void System::ExecuteOpcode()
 		// SET 7, (HL)
 		case 0xFE:
 		{
-			AsmSET(&main_memory[registers.lh], 7);
+			ModifyMemory(registers.lh, [this](unsigned char* value) { AsmSET(value, 7); });
 
 			break;
 		}
@@ -3499,10 +4319,10 @@ void System::ExecuteOpcode()
 
 		default:
 		{
-			std::stringstream ss;
-			ss << "Unknown Extended(BC) Opcode: " << std::hex << static_cast<int>(opcode);
+			logger->Record<LogFormat_Unknown_CB_Opcode>(opcode, pc - 1);
 
-			logger->Log(LOG_WARNING, ss.str());
+			if (flight_recorder != nullptr)
+				flight_recorder->OnError();
 		}
 		}
 
@@ -3512,7 +4332,10 @@ void System::ExecuteOpcode()
 	case 0xCC:
 	{
 		if (GetBitflag(Zero) == 1)
+		{
+			instruction_cycles += 12;
 			AsmCALLnn();
+		}
 
 		break;
 	}
@@ -3526,7 +4349,7 @@ void System::ExecuteOpcode()
 	// ADC A, n
 	case 0xCE:
 	{
-		AsmADC_A(main_memory[++pc]);
+		AsmADC_A(ReadMemory(++pc));
 
 		break;
 	}
@@ -3541,7 +4364,10 @@ void System::ExecuteOpcode()
 	case 0xD0:
 	{
 		if (GetBitflag(Carry) == 0)
+		{
+			instruction_cycles += 12;
 			AsmReturn();
+		}
 
 		break;
 	}
@@ -3558,7 +4384,8 @@ void System::ExecuteOpcode()
 	{
 		if (GetBitflag(Carry) == 0)
 		{
-			pc = (main_memory[pc + 1] << 8) | main_memory[pc + 2];
+			instruction_cycles += 4;
+			pc = (ReadMemory(pc + 1) << 8) | ReadMemory(pc + 2);
 			--pc;
 		}
 
@@ -3573,22 +4400,25 @@ void System::ExecuteOpcode()
 	case 0xD4:
 	{
 		if (GetBitflag(Carry) == 0)
+		{
+			instruction_cycles += 12;
 			AsmCALLnn();
+		}
 
 		break;
 	}
 	// PUSH DE
 	case 0xD5:
 	{
-		main_memory[--sp] = registers.d;
-		main_memory[--sp] = registers.e;
+		WriteMemory(--sp, registers.d);
+		WriteMemory(--sp, registers.e);
 
 		break;
 	}
 	// SUB A,n
 	case 0xD6:
 	{
-		AsmSUB_A(main_memory[++pc]);
+		AsmSUB_A(ReadMemory(++pc));
 
 		break;
 	}
@@ -3603,7 +4433,10 @@ void System::ExecuteOpcode()
 	case 0xD8:
 	{
 		if (GetBitflag(Carry) == 1)
+		{
+			instruction_cycles += 12;
 			AsmReturn();
+		}
 
 		break;
 	}
@@ -3621,7 +4454,8 @@ void System::ExecuteOpcode()
 	{
 		if (GetBitflag(Carry) == 1)
 		{
-			pc = (main_memory[pc + 1] << 8) | main_memory[pc + 2];
+			instruction_cycles += 4;
+			pc = (ReadMemory(pc + 1) << 8) | ReadMemory(pc + 2);
 			--pc;
 		}
 
@@ -3636,7 +4470,10 @@ void System::ExecuteOpcode()
 	case 0xDC:
 	{
 		if (GetBitflag(Carry) == 1)
+		{
+			instruction_cycles += 12;
 			AsmCALLnn();
+		}
 
 		break;
 	}
@@ -3648,7 +4485,7 @@ void System::ExecuteOpcode()
 	// SBC A,n
 	case 0xDE:
 	{
-		AsmSBC_A(main_memory[++pc]);
+		AsmSBC_A(ReadMemory(++pc));
 
 		break;
 	}
@@ -3658,8 +4495,10 @@ void System::ExecuteOpcode()
 	{
 		++pc;
 
-		main_memory[--sp] = static_cast<unsigned char>((pc & 0xFF00) >> 8);
-		main_memory[--sp] = static_cast<unsigned char>(pc & 0x00FF);
+		WriteMemory(--sp, static_cast<unsigned char>((pc & 0xFF00) >> 8));
+		WriteMemory(--sp, static_cast<unsigned char>(pc & 0x00FF));
+
+		PROFILER_HOOK(OnCall(GetBank(0x0018), 0x0018));
 
 		pc = 0x0018;
 
@@ -3668,9 +4507,9 @@ void System::ExecuteOpcode()
 	// LDH (n),A
 	case 0xE0:
 	{
-		unsigned char n = main_memory[++pc];
+		unsigned char n = ReadMemory(++pc);
 
-		main_memory[0xFF00 + n] = registers.a;
+		WriteMemory(0xFF00 + n, registers.a);
 
 		break;
 	}
@@ -3685,7 +4524,7 @@ void System::ExecuteOpcode()
 	// LDH (C),A
 	case 0xE2:
 	{
-		main_memory[0xFF00 + registers.c] = registers.a;
+		WriteMemory(0xFF00 + registers.c, registers.a);
 
 		break;
 	}
@@ -3702,15 +4541,15 @@ void System::ExecuteOpcode()
 	// PUSH HL
 	case 0xE5:
 	{
-		main_memory[--sp] = registers.h;
-		main_memory[--sp] = registers.l;
+		WriteMemory(--sp, registers.h);
+		WriteMemory(--sp, registers.l);
 
 		break;
 	}
 	// AND n
 	case 0xE6:
 	{
-		AsmAND_A(main_memory[++pc]);
+		AsmAND_A(ReadMemory(++pc));
 
 		break;
 	}
@@ -3725,7 +4564,7 @@ void System::ExecuteOpcode()
 	case 0xE8:
 	{
 		// TODO: Signed value
-		unsigned char n = main_memory[++pc];
+		unsigned char n = ReadMemory(++pc);
 
 		if ((((sp & 0xF00) + (n & 0xF00)) & 0x1000) == 0x1000)
 			SetBitflag(Half_Carry);
@@ -3747,7 +4586,7 @@ void System::ExecuteOpcode()
 	// JP (HL)
 	case 0xE9:
 	{
-		pc = main_memory[registers.lh];
+		pc = ReadMemory(registers.lh);
 		--pc;
 
 		break;
@@ -3755,9 +4594,9 @@ void System::ExecuteOpcode()
 	// LD (nn),A
 	case 0xEA:
 	{
-		unsigned short addr = (main_memory[++pc] << 8) | main_memory[++pc];
+		unsigned short addr = (ReadMemory(++pc) << 8) | ReadMemory(++pc);
 
-		main_memory[addr] = registers.a;
+		WriteMemory(addr, registers.a);
 
 		break;
 	}
@@ -3779,7 +4618,7 @@ void System::ExecuteOpcode()
 	// XOR n
 	case 0xEE:
 	{
-		AsmXOR_A(main_memory[++pc]);
+		AsmXOR_A(ReadMemory(++pc));
 
 		break;
 	}
@@ -3793,9 +4632,9 @@ void System::ExecuteOpcode()
 	// LDH A,(n)
 	case 0xF0:
 	{
-		unsigned char n = main_memory[++pc];
+		unsigned char n = ReadMemory(++pc);
 
-		registers.a = main_memory[0xFF00 + n];
+		registers.a = ReadMemory(0xFF00 + n);
 
 		break;
 	}
@@ -3815,8 +4654,8 @@ void System::ExecuteOpcode()
 	// DI (Disable Interrupts)
 	case 0xF3:
 	{
-		main_memory[0xFF0F] = 0;
-		main_memory[0xFFFF] = 0;
+		WriteMemory(0xFF0F, 0);
+		WriteMemory(0xFFFF, 0);
 		IME = false;
 
 		break;
@@ -3829,15 +4668,15 @@ void System::ExecuteOpcode()
 	// PUSH AF
 	case 0xF5:
 	{
-		main_memory[--sp] = registers.a;
-		main_memory[--sp] = registers.f;
+		WriteMemory(--sp, registers.a);
+		WriteMemory(--sp, registers.f);
 
 		break;
 	}
 	// OR n
 	case 0xF6:
 	{
-		AsmOR_A(main_memory[++pc]);
+		AsmOR_A(ReadMemory(++pc));
 
 		break;
 	}
@@ -3851,7 +4690,7 @@ void System::ExecuteOpcode()
 	// LDHL SP,d
 	case 0xF8:
 	{
-		unsigned char n = main_memory[++pc];
+		unsigned char n = ReadMemory(++pc);
 
 		if ((((sp & 0xF00) + (n & 0xF00)) & 0x1000) == 0x1000)
 			SetBitflag(Half_Carry);
@@ -3880,7 +4719,7 @@ void System::ExecuteOpcode()
 	// LD A,(nn)
 	case 0xFA:
 	{
-		registers.a = (main_memory[++pc] << 8) | main_memory[++pc];
+		registers.a = (ReadMemory(++pc) << 8) | ReadMemory(++pc);
 
 		break;
 	}
@@ -3904,7 +4743,7 @@ void System::ExecuteOpcode()
 	// CP n
 	case 0xFE:
 	{
-		AsmCP_A(main_memory[++pc]);
+		AsmCP_A(ReadMemory(++pc));
 
 		break;
 	}
@@ -3918,15 +4757,19 @@ void System::ExecuteOpcode()
 
 	default:
 	{
-		std::stringstream ss;
-		ss << "Unknown Opcode: " << std::hex << static_cast<int>(opcode);
+		logger->Record<LogFormat_Unknown_Opcode>(opcode, pc);
 
-		logger->Log(LOG_WARNING, ss.str());
+		if (flight_recorder != nullptr)
+			flight_recorder->OnError();
 
 		break;
 	}
 	}
 
+	PROFILER_HOOK(OnInstruction(GetBank(instruction_pc), instruction_pc, prefixed, opcode, instruction_cycles));
+
+	cycles += instruction_cycles;
+
 	++pc;
 }
 
@@ -3976,34 +4819,39 @@ void System::AsmDEC_s(unsigned char* val)
 }
 void System::AsmReturn()
 {
-	unsigned short addr = main_memory[sp] << 8;
-	main_memory[sp] = 0;
-	addr |= main_memory[++sp];
-	main_memory[sp] = 0;
+	unsigned short addr = ReadMemory(sp) << 8;
+	WriteMemory(sp, 0);
+	addr |= ReadMemory(++sp);
+	WriteMemory(sp, 0);
 	++sp;
 
+	PROFILER_HOOK(OnReturn());
+
 	pc = addr;
 	--pc;
 }
 void System::AsmCALLInterrupt(short addr)
 {
-	main_memory[--sp] = static_cast<unsigned char>((pc) & 0x00FF);
-	main_memory[--sp] = static_cast<unsigned char>(((pc) & 0xFF00) >> 8);
+	WriteMemory(--sp, static_cast<unsigned char>((pc) & 0x00FF));
+	WriteMemory(--sp, static_cast<unsigned char>(((pc) & 0xFF00) >> 8));
 
 	pc = addr;
 }
 void System::AsmCALLnn()
 {
-	main_memory[--sp] = static_cast<unsigned char>((pc + 3) & 0x00FF);
-	main_memory[--sp] = static_cast<unsigned char>(((pc + 3) & 0xFF00) >> 8);
+	WriteMemory(--sp, static_cast<unsigned char>((pc + 3) & 0x00FF));
+	WriteMemory(--sp, static_cast<unsigned char>(((pc + 3) & 0xFF00) >> 8));
+
+	pc = (ReadMemory(pc + 1) << 8) | ReadMemory(pc + 2);
+
+	PROFILER_HOOK(OnCall(GetBank(pc), pc));
 
-	pc = (main_memory[pc + 1] << 8) | main_memory[pc + 2];
 	--pc;
 }
 unsigned char System::AsmPOP()
 {
-	unsigned char val = main_memory[sp];
-	main_memory[sp] = 0;
+	unsigned char val = ReadMemory(sp);
+	WriteMemory(sp, 0);
 	++sp;
 
 	return val;
@@ -4012,8 +4860,10 @@ void System::AsmRST(unsigned short addr)
 {
 	++pc;
 
-	main_memory[--sp] = static_cast<unsigned char>((pc & 0xFF00) >> 8);
-	main_memory[--sp] = static_cast<unsigned char>(pc & 0x00FF);
+	WriteMemory(--sp, static_cast<unsigned char>((pc & 0xFF00) >> 8));
+	WriteMemory(--sp, static_cast<unsigned char>(pc & 0x00FF));
+
+	PROFILER_HOOK(OnCall(GetBank(addr), addr));
 
 	pc = addr;
 }
@@ -1,13 +1,22 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cstring>
 #include <fstream>
 #include <limits>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "FileLogger.h"
+#include "Hash.h"
+#include "Profiler.h"
+
+class FlightRecorder;
+class TraceWriter;
 
 struct Registers
 {
@@ -57,12 +66,100 @@ enum BitFlags
 	Zero = 7
 };
 
+enum JoypadButtons
+{
+	Joypad_Right = 0,
+	Joypad_Left = 1,
+	Joypad_Up = 2,
+	Joypad_Down = 3,
+	Joypad_A = 4,
+	Joypad_B = 5,
+	Joypad_Select = 6,
+	Joypad_Start = 7
+};
+
+// Why the CPU stopped, see System::Resume
+enum StopReason
+{
+	Stop_None = 0,
+	Stop_Breakpoint = 1,
+	Stop_Watchpoint = 2,
+	Stop_Step = 3,
+	Stop_Request = 4
+};
+
+enum WatchType
+{
+	Watch_Read = 1,
+	Watch_Write = 2,
+	Watch_Access = Watch_Read | Watch_Write
+};
+
+// Bitmap of 256 byte memory pages
+struct DirtyPages
+{
+	unsigned long long bits[4]{};
+
+	bool IsSet(unsigned int page) const
+	{
+		return (bits[page >> 6] >> (page & 63)) & 1;
+	}
+	unsigned int Count() const
+	{
+		return std::popcount(bits[0]) + std::popcount(bits[1]) + std::popcount(bits[2]) + std::popcount(bits[3]);
+	}
+};
+
+// Reference counted block of memory, shared by a System and its clones until one of them writes to it
+struct MemoryPage
+{
+	std::atomic<unsigned int> references{ 1 };
+	unsigned char data[256];
+	// Hash of data as of the owner's last state hash, shared with the page.
+	// Only rewritten while the page is private.
+	unsigned long long hash{};
+};
+
 class System
 {
 public:
+	// LCD timing in clock ticks, a frame ends when the LCD enters VBlank
+	static constexpr unsigned int clock_rate = 4194304;
+	static constexpr unsigned int cycles_per_line = 456;
+	static constexpr unsigned int cycles_per_frame = cycles_per_line * 154;
+	static constexpr unsigned char vblank_line = 144;
+
+	// Framebuffer holds one shade (0 = white .. 3 = black) per pixel
+	static constexpr unsigned int screen_width = 160;
+	static constexpr unsigned int screen_height = 144;
+
+	// Save states are a fixed size header with the CPU and timing state followed by the address space
+	static constexpr size_t state_header_size = 48;
+	static constexpr size_t state_size = state_header_size + 0x10000;
+
+	// Granularity of write tracking
+	static constexpr unsigned int page_size = 256;
+	static constexpr unsigned int page_count = 0x10000 / page_size;
+
+	static const unsigned char opcode_cycles[256];
+	static const unsigned char cb_opcode_cycles[256];
+
 	System(FileLogger* logger);
+	~System();
+
+	System& operator=(const System&) = delete;
+
+	// Creates an independent copy of this System that shares its memory pages
+	// copy-on-write, so cloning costs a page table rather than the address
+	// space. Parent and clone can then run on different threads. The clone
+	// renders into its own framebuffer and has no profiler or trace attached.
+	System* Clone();
+	// Pages not shared with any other System
+	unsigned int GetOwnedPageCount();
 	void LoadRom(std::string path);
+	void LoadRom(const unsigned char* data, size_t size);
 	void EmulateCycle();
+	void RunFrame();
 	void FetchOpcode();
 	void ExecuteOpcode();
 	void ProcessInterrupts();
@@ -74,11 +171,90 @@ public:
 	Registers GetRegisters();
 	unsigned short GetPC();
 	unsigned short GetSP();
+	// For test harnesses and debuggers that need to put the CPU in a given state
+	void SetRegisters(const Registers& registers);
+	void SetPC(unsigned short pc);
+	void SetSP(unsigned short sp);
+	unsigned long long GetCycles();
+	unsigned long long GetFrameCount();
+	unsigned char GetBank(unsigned short address);
+
+	// Only has an effect in builds with GBE_PROFILER defined
+	void SetProfiler(Profiler* profiler);
+	// Logs every instruction before it executes, nullptr to stop
+	void SetTraceWriter(TraceWriter* trace_writer);
+	// Keeps the last instructions for crash dumps, nullptr to stop
+	void SetFlightRecorder(FlightRecorder* flight_recorder);
 
+	// P1 as the CPU reads it. Only the group select bits of a new value are
+	// kept, the button lines follow from SetJoypad.
 	unsigned char GetInputRegister();
 	void SetInputRegister(unsigned char joypad);
 
+	// Pressed buttons as a mask of JoypadButtons bits. P1 is rebuilt only when
+	// they change or the CPU selects a group, never per instruction.
+	void SetJoypad(unsigned char buttons);
+	unsigned char GetJoypad();
+
+	void SaveState(std::vector<unsigned char>& output);
+	bool LoadState(const unsigned char* data, size_t size);
+
+	// Pages written since the last call, then starts tracking anew. Loading a
+	// ROM or a state marks every page. There is one set of tracking bits, so
+	// only one snapshot consumer per System should take them.
+	void TakeDirtyPages(DirtyPages& pages);
+	// Brings a buffer holding an earlier SaveState of this System up to date,
+	// copying the header and only the given pages of memory
+	void UpdateState(std::vector<unsigned char>& state, const DirtyPages& pages);
+
+	// Hash of the image passed to LoadRom, identifies the game for movies and save states
+	unsigned long long GetRomHash();
+
+	// Copies length bytes of the address space starting at address (wrapping at 0xFFFF)
+	void ReadMemoryBlock(unsigned short address, unsigned int length, unsigned char* output);
+	void WriteMemoryBlock(unsigned short address, unsigned int length, const unsigned char* input);
+
+	const unsigned char* GetFramebuffer();
+	// Renders into the given screen_width * screen_height buffer instead of the internal one, nullptr to reset
+	void SetFramebufferTarget(unsigned char* target);
+	// Headless runs that never look at the screen can skip drawing scanlines
+	void SetRenderingEnabled(bool enabled);
+	bool IsRenderingEnabled();
+
+	// Hash of the CPU registers and the whole address space. Page hashes are
+	// cached and only pages written since the previous call are rehashed.
+	unsigned long long GetStateHash();
+
+	// Execution breakpoints on (bank, address), any_bank matches whichever
+	// bank is mapped. They are looked up in a 64 Kbit bitmap, and the
+	// instruction loop only looks at all while a breakpoint is set.
+	static constexpr unsigned short any_bank = 0x100;
+	void AddBreakpoint(unsigned short address, unsigned short bank = any_bank);
+	void RemoveBreakpoint(unsigned short address, unsigned short bank = any_bank);
+	void ClearBreakpoints();
+
+	// Stops after the instruction that reads or writes the given range. Pages
+	// holding a watchpoint are flagged so that only accesses to them take the
+	// slow path. Instruction fetches and the LCD's own reads are not watched.
+	void AddWatchpoint(unsigned short address, unsigned short length, WatchType type);
+	void RemoveWatchpoint(unsigned short address, unsigned short length, WatchType type);
+	void ClearWatchpoints();
+
+	// While stopped RunFrame returns early and EmulateCycle does nothing
+	StopReason GetStopReason();
+	// Address and kind of the access that stopped the CPU at a watchpoint
+	unsigned short GetWatchAddress();
+	WatchType GetWatchType();
+	// Continues after a stop. The instruction at PC runs even if it has a
+	// breakpoint; with step set the CPU stops again right after it.
+	void Resume(bool step = false);
+	// Stops before the next instruction, for a debugger breaking into a running CPU
+	void Stop();
+
 private:
+	// Executes instructions of many instances in lockstep on their CPU state
+	friend class LockstepEngine;
+
 	bool running = false;
 	bool halted = false;
 	unsigned char opcode{};
@@ -87,17 +263,166 @@ private:
 	// Interrupt Master Enable Flag
 	bool IME = false;
 
-	// Memory
-	unsigned char main_memory[0xFFFF + 1]{};
+	// Memory, split into pages that clones share until they are written
+	MemoryPage* memory_pages[page_count]{};
+	DirtyPages dirty_pages;
+
+	// Incremental state hash: XOR of the page hashes, refreshed for the pages in hash_dirty_pages
+	unsigned long long memory_hash{};
+	DirtyPages hash_dirty_pages;
 
 	// CPU Registers
 	Registers registers;
 	unsigned short pc{};
 	unsigned short sp{};
 
+	// Clock ticks of the instruction being executed and since power on
+	unsigned int instruction_cycles{};
+	unsigned long long cycles{};
+
+	// Position of the LCD within the current frame
+	unsigned int frame_cycles{};
+	unsigned long long frame_count{};
+
+	unsigned char joypad_buttons{};
+
+	// Allocated on first use, so headless instances and clones do not carry a screen
+	unsigned char* framebuffer_data{};
+	unsigned char* framebuffer{};
+	bool rendering_enabled = true;
+
+	// Switchable ROM bank mapped at 0x4000-0x7FFF (fixed until an MBC is emulated)
+	unsigned char rom_bank = 1;
+	unsigned long long rom_hash{};
+
 	FileLogger* logger;
+	Profiler* profiler{};
+	TraceWriter* trace_writer{};
+	FlightRecorder* flight_recorder{};
+
+	// Breakpoints and watchpoints, allocated when the first one is set
+	struct Watchpoint
+	{
+		unsigned short address{};
+		unsigned short length{};
+		WatchType type{};
+	};
+	struct DebugPoints
+	{
+		unsigned long long breakpoint_bits[0x10000 / 64]{};
+		std::vector<std::pair<unsigned short, unsigned short>> breakpoints;
+		std::vector<Watchpoint> watchpoints;
+	};
+	DebugPoints* debug_points{};
+	// Watch_Read and Watch_Write bits of the watchpoints on each page
+	unsigned char watched_pages[page_count]{};
+	// Set while anything can stop the CPU, the only debugger check on the fast path
+	bool debug_active = false;
+	// A stop or a resume is in progress, CheckDebugStop runs regardless of breakpoints
+	bool debug_pending = false;
+	bool single_step = false;
+	bool skip_breakpoint = false;
+	StopReason stop_reason = Stop_None;
+	unsigned short watch_address{};
+	WatchType watch_type = Watch_Read;
+
+	// Used by Clone, shares the pages without taking references
+	System(const System& parent) = default;
 
 	void Initialize();
+	// Memory accessors are defined here so the instruction loop can inline them
+	// CPU accesses, checked against watchpoints
+	unsigned char ReadMemory(unsigned short address)
+	{
+		if (watched_pages[address / page_size] & Watch_Read) [[unlikely]]
+			OnWatchedAccess(address, Watch_Read);
+
+		return ReadMemoryUnwatched(address);
+	}
+	void WriteMemory(unsigned short address, unsigned char value)
+	{
+		unsigned char* target = GetWritableMemory(address);
+
+		// P1 only takes the group select bits, the button lines follow from them
+		if (address == 0xFF00) [[unlikely]]
+			value = BuildJoypadRegister(value);
+
+		*target = value;
+	}
+	// Read-modify-write instructions, the operation changes the byte in place.
+	// P1 is changed on a copy and stored like a write, so the button lines and
+	// the interrupt edge follow from the old value.
+	template <typename Operation>
+	void ModifyMemory(unsigned short address, Operation operation)
+	{
+		unsigned char* target = GetWritableMemory(address);
+
+		if (address == 0xFF00) [[unlikely]]
+		{
+			unsigned char value = *target;
+
+			operation(&value);
+			*target = BuildJoypadRegister(value);
+
+			return;
+		}
+
+		operation(target);
+	}
+	// Checks the watchpoints and marks the page as written
+	unsigned char* GetWritableMemory(unsigned short address)
+	{
+		if (watched_pages[address / page_size] & Watch_Write) [[unlikely]]
+			OnWatchedAccess(address, Watch_Write);
+
+		return GetWritableMemoryUnwatched(address);
+	}
+	// Accesses by the fetch, the LCD, interrupts and the joypad, which watchpoints ignore
+	unsigned char ReadMemoryUnwatched(unsigned short address)
+	{
+		return memory_pages[address / page_size]->data[address % page_size];
+	}
+	void WriteMemoryUnwatched(unsigned short address, unsigned char value)
+	{
+		*GetWritableMemoryUnwatched(address) = value;
+	}
+	unsigned char* GetWritableMemoryUnwatched(unsigned short address)
+	{
+		MarkPageDirty(address);
+
+		return &GetWritablePage(address / page_size)->data[address % page_size];
+	}
+	MemoryPage* GetWritablePage(unsigned int page)
+	{
+		MemoryPage* current = memory_pages[page];
+
+		// Still shared with a clone, take a private copy before the first write
+		if (current->references.load(std::memory_order_acquire) != 1)
+			current = UnsharePage(page);
+
+		return current;
+	}
+	MemoryPage* UnsharePage(unsigned int page);
+	void MarkPageDirty(unsigned short address)
+	{
+		unsigned long long bit = 1ull << ((address >> 8) & 63);
+
+		dirty_pages.bits[address >> 14] |= bit;
+		hash_dirty_pages.bits[address >> 14] |= bit;
+	}
+	void UpdateMemoryHash();
+	// Slow paths of the debugger, only reached while something is set
+	bool CheckDebugStop();
+	void OnWatchedAccess(unsigned short address, WatchType type);
+	void UpdateDebugPoints();
+	static void ReleasePage(MemoryPage* page);
+	void MarkAllPagesDirty();
+	void WriteStateHeader(unsigned char* output);
+	void AllocateFramebuffer();
+	void UpdateLCD(unsigned int elapsed);
+	void RenderLine(unsigned char line);
+	// P1 for the given select bits and the held buttons
+	unsigned char BuildJoypadRegister(unsigned char select);
 	void SetBitflag(BitFlags flag);
 	void ClearBitflag(BitFlags flag);
 	void ToggleBitflag(BitFlags flag);
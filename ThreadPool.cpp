@@ -0,0 +1,126 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int thread_count)
+{
+	if (thread_count == 0)
+		thread_count = std::thread::hardware_concurrency();
+	if (thread_count == 0)
+		thread_count = 1;
+
+	this->thread_count = thread_count;
+
+	workers = new Worker[thread_count];
+
+	for (unsigned int i = 0; i < thread_count; ++i)
+		threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		stopping = true;
+	}
+
+	wake.notify_all();
+
+	for (auto& thread : threads)
+		thread.join();
+
+	delete[] workers;
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	++unfinished;
+
+	Worker& worker = workers[next_worker++ % thread_count];
+
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> lock(wake_mutex);
+		++queued;
+	}
+
+	wake.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(wake_mutex);
+
+	idle.wait(lock, [this] { return unfinished == 0; });
+}
+
+unsigned int ThreadPool::GetThreadCount()
+{
+	return thread_count;
+}
+
+bool ThreadPool::PopTask(unsigned int index, std::function<void()>& task)
+{
+	{
+		Worker& own = workers[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+
+		if (!own.tasks.empty())
+		{
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+
+			return true;
+		}
+	}
+
+	for (unsigned int i = 1; i < thread_count; ++i)
+	{
+		Worker& victim = workers[(index + i) % thread_count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+
+		if (!victim.tasks.empty())
+		{
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::WorkerLoop(unsigned int index)
+{
+	while (true)
+	{
+		std::function<void()> task;
+
+		if (PopTask(index, task))
+		{
+			{
+				std::lock_guard<std::mutex> lock(wake_mutex);
+				--queued;
+			}
+
+			task();
+
+			if (--unfinished == 0)
+			{
+				std::lock_guard<std::mutex> lock(wake_mutex);
+				idle.notify_all();
+			}
+
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(wake_mutex);
+
+		wake.wait(lock, [this] { return stopping || queued > 0; });
+
+		if (stopping && queued <= 0)
+			return;
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool: every worker owns a task deque, takes work from
+// its own back and steals from the front of the others when it runs dry.
+class ThreadPool
+{
+public:
+	// A thread count of 0 uses every hardware thread
+	ThreadPool(unsigned int thread_count = 0);
+	~ThreadPool();
+
+	void Submit(std::function<void()> task);
+	// Blocks until every submitted task has finished
+	void Wait();
+
+	unsigned int GetThreadCount();
+
+private:
+	struct Worker
+	{
+		std::deque<std::function<void()>> tasks;
+		std::mutex mutex;
+	};
+
+	void WorkerLoop(unsigned int index);
+	bool PopTask(unsigned int index, std::function<void()>& task);
+
+	unsigned int thread_count{};
+	Worker* workers{};
+	std::vector<std::thread> threads;
+
+	std::mutex wake_mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	int queued{};
+	bool stopping = false;
+
+	std::atomic<unsigned int> next_worker{};
+	std::atomic<unsigned int> unfinished{};
+};
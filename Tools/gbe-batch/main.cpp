@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BatchRunner.h"
+#include "FileLogger.h"
+#include "FrameDumper.h"
+
+static void PrintUsage()
+{
+	std::cout << "Usage: gbe-batch <manifest> [options]\n"
+		<< "  -j <threads>       Worker threads (default: all cores)\n"
+		<< "  -o <file>          Per-job results (default: batch_results.txt)\n"
+		<< "  --frame-hashes <file>  Also write the state hash of every frame\n"
+		<< "  --scaling          Run the batch with 1..N threads and report scaling\n"
+		<< "  --dump <directory> Save frames as <directory>/<job>_<frame>.png\n"
+		<< "  --dump-every <n>   Only dump every Nth frame (default: 1)\n";
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::string manifest = argv[1];
+	std::string results_path = "batch_results.txt";
+	std::string frame_hashes_path;
+	std::string dump_directory;
+	unsigned int dump_interval = 1;
+	unsigned int thread_count = std::thread::hardware_concurrency();
+	bool scaling = false;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "-j" && i + 1 < argc)
+			thread_count = std::stoul(argv[++i]);
+		else if (arg == "-o" && i + 1 < argc)
+			results_path = argv[++i];
+		else if (arg == "--frame-hashes" && i + 1 < argc)
+			frame_hashes_path = argv[++i];
+		else if (arg == "--scaling")
+			scaling = true;
+		else if (arg == "--dump" && i + 1 < argc)
+			dump_directory = argv[++i];
+		else if (arg == "--dump-every" && i + 1 < argc)
+			dump_interval = std::stoul(argv[++i]);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (thread_count == 0)
+		thread_count = 1;
+
+	FileLogger* logger = new FileLogger();
+	BatchRunner* runner = new BatchRunner(logger);
+
+	if (!runner->LoadManifest(manifest))
+	{
+		std::cerr << "Unable to load manifest " << manifest << ", see debug.log\n";
+
+		delete runner;
+		delete logger;
+
+		return 1;
+	}
+
+	std::cout << std::fixed << std::setprecision(1);
+
+	if (scaling)
+	{
+		double single_thread_fps = 0.0;
+
+		std::cout << "Threads   Seconds    Frames/s   Speedup\n";
+
+		std::vector<unsigned int> steps;
+
+		for (unsigned int threads = 1; threads < thread_count; threads *= 2)
+			steps.push_back(threads);
+
+		steps.push_back(thread_count);
+
+		for (unsigned int threads : steps)
+		{
+			double seconds = runner->Run(threads, false);
+			double fps = runner->GetTotalFrames() / seconds;
+
+			if (threads == 1)
+				single_thread_fps = fps;
+
+			std::cout << std::setw(7) << threads << std::setw(10) << std::setprecision(3) << seconds
+				<< std::setw(12) << std::setprecision(1) << fps << std::setw(9) << std::setprecision(2) << fps / single_thread_fps << "x\n";
+		}
+	}
+
+	// Only the final run dumps, the scaling runs would overwrite the same files
+	FrameDumper* dumper = nullptr;
+
+	if (!dump_directory.empty())
+	{
+		std::error_code error;
+		std::filesystem::create_directories(dump_directory, error);
+
+		dumper = new FrameDumper(logger, dump_interval, std::max(thread_count / 2, 1u));
+		runner->SetFrameDumper(dumper, dump_directory);
+	}
+
+	double seconds = runner->Run(thread_count, !frame_hashes_path.empty());
+
+	std::cout << runner->GetJobCount() << " jobs, " << runner->GetTotalFrames() << " frames in " << std::setprecision(3) << seconds << "s ("
+		<< std::setprecision(1) << runner->GetTotalFrames() / seconds << " frames/s on " << thread_count << " threads)\n";
+
+	int result = 0;
+
+	if (!runner->WriteResults(results_path))
+	{
+		std::cerr << "Unable to write " << results_path << ", see debug.log\n";
+		result = 1;
+	}
+
+	if (!frame_hashes_path.empty() && !runner->WriteFrameHashes(frame_hashes_path))
+	{
+		std::cerr << "Unable to write " << frame_hashes_path << ", see debug.log\n";
+		result = 1;
+	}
+
+	if (dumper != nullptr)
+	{
+		std::cout << dumper->GetDumpedCount() << " frames dumped to " << dump_directory << "\n";
+
+		if (dumper->GetFailedCount() > 0)
+			std::cerr << dumper->GetFailedCount() << " frames could not be written, see debug.log\n";
+	}
+
+	delete runner;
+	delete dumper;
+	delete logger;
+
+	return result;
+}
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+#include "System.h"
+
+// Measures what breakpoints and watchpoints cost the core: none set, a
+// breakpoint that is never reached, a watchpoint on a page nothing touches and
+// a watchpoint on a busy page that stops the CPU and is resumed on every hit.
+
+struct Configuration
+{
+	const char* name;
+	void (*apply)(System* system);
+};
+
+static const Configuration configurations[] =
+{
+	{ "none", [](System*) {} },
+	{ "breakpoint", [](System* system) { system->AddBreakpoint(0x7FFF); } },
+	{ "idle watch", [](System* system) { system->AddWatchpoint(0xA000, 1, Watch_Access); } },
+	{ "busy watch", [](System* system) { system->AddWatchpoint(0xC000, 0x100, Watch_Write); } },
+};
+
+static double RunFrames(System* system, const std::vector<unsigned char>& rom, unsigned int frames, unsigned long long& stops)
+{
+	system->LoadRom(rom.data(), rom.size());
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (unsigned int i = 0; i < frames && system->IsRunning(); ++i)
+	{
+		unsigned long long frame = system->GetFrameCount();
+
+		while (true)
+		{
+			system->RunFrame();
+
+			if (system->GetStopReason() == Stop_None || system->GetFrameCount() != frame)
+				break;
+
+			system->Resume();
+			++stops;
+		}
+	}
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: gbe-breakpoints <rom> [frames=600]\n";
+		return 1;
+	}
+
+	unsigned int frames = argc > 2 ? std::stoul(argv[2]) : 600;
+
+	std::ifstream input(argv[1], std::ios::in | std::ios::binary);
+	std::vector<unsigned char> rom((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+	if (rom.empty())
+	{
+		std::cerr << "Unable to open " << argv[1] << "\n";
+		return 1;
+	}
+
+	FileLogger* logger = new FileLogger();
+
+	static constexpr int runs = 5;
+
+	std::vector<System*> systems;
+
+	for (const Configuration& configuration : configurations)
+	{
+		System* system = new System(logger);
+
+		system->SetRenderingEnabled(false);
+		configuration.apply(system);
+
+		systems.push_back(system);
+	}
+
+	// Configurations are interleaved and the best run of each kept, so load
+	// changes on the machine hit all of them alike
+	std::vector<double> best(systems.size(), 1e30);
+	std::vector<unsigned long long> stops(systems.size());
+
+	for (int run = 0; run < runs; ++run)
+		for (size_t i = 0; i < systems.size(); ++i)
+			best[i] = std::min(best[i], RunFrames(systems[i], rom, frames, stops[i]));
+
+	std::cout << "Configuration   Seconds  Stops/run   Overhead\n" << std::fixed;
+
+	for (size_t i = 0; i < systems.size(); ++i)
+	{
+		std::cout << std::left << std::setw(13) << configurations[i].name << std::right << std::setw(10) << std::setprecision(3) << best[i]
+			<< std::setw(11) << stops[i] / runs << std::setw(10) << std::setprecision(1) << (best[i] / best[0] - 1.0) * 100.0 << "%\n";
+
+		delete systems[i];
+	}
+
+	delete logger;
+
+	return 0;
+}
\ No newline at end of file
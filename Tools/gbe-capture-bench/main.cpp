@@ -0,0 +1,173 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+#include "System.h"
+#include "VideoCapture.h"
+
+// Runs a ROM headless without capture, then recording Y4M and raw RGB, and
+// reports emulation speed, how often the emulation thread had to wait for
+// the writer and the writer's time per frame. The SSE2 YUV conversion is
+// checked against the plain loop first.
+
+struct CaptureRun
+{
+	std::string name;
+	bool capture = false;
+	CaptureFormat format = CaptureFormat_Y4M;
+	std::string path;
+};
+
+static bool CheckConversion()
+{
+	static constexpr unsigned int width = 640;
+	static constexpr unsigned int height = 576;
+
+	std::mt19937 random(1);
+	std::vector<unsigned int> pixels(width * height);
+
+	for (unsigned int& color : pixels)
+		color = 0xFF000000 | (random() & 0xFFFFFF);
+
+	std::vector<unsigned char> scalar(width * height * 3 / 2);
+	std::vector<unsigned char> vectorized(width * height * 3 / 2);
+
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		std::vector<unsigned char>& planes = pass == 0 ? scalar : vectorized;
+		VideoCapture::ConvertToYUV420(pixels.data(), width, height, width, planes.data(), planes.data() + width * height, planes.data() + width * height * 5 / 4, pass == 1);
+	}
+
+	return scalar == vectorized;
+}
+
+static double TimeConversion(bool vectorized)
+{
+	static constexpr unsigned int width = 640;
+	static constexpr unsigned int height = 576;
+
+	std::vector<unsigned int> pixels(width * height, 0xFFAAAAAA);
+	std::vector<unsigned char> planes(width * height * 3 / 2);
+
+	unsigned int count = 0;
+	auto start = std::chrono::steady_clock::now();
+	double seconds = 0.0;
+
+	while (seconds < 0.25)
+	{
+		VideoCapture::ConvertToYUV420(pixels.data(), width, height, width, planes.data(), planes.data() + width * height, planes.data() + width * height * 5 / 4, vectorized);
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		++count;
+	}
+
+	return seconds * 1e3 / count;
+}
+
+int main(int argc, char** argv)
+{
+	std::string rom_path;
+	std::string output_path = "capture-bench";
+	unsigned int frames = 3000;
+	unsigned int factor = 1;
+	bool keep = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--frames" && i + 1 < argc)
+			frames = std::stoul(argv[++i]);
+		else if (arg == "--scale" && i + 1 < argc)
+			factor = std::stoul(argv[++i]);
+		else if (arg == "-o" && i + 1 < argc)
+			output_path = argv[++i];
+		else if (arg == "--keep")
+			keep = true;
+		else
+			rom_path = arg;
+	}
+
+	if (rom_path.empty())
+	{
+		std::cout << "Usage: gbe-capture-bench <rom> [--frames <count>] [--scale <1-4>] [-o <path without extension>] [--keep]\n";
+		return 1;
+	}
+
+	std::ifstream input(rom_path, std::ios::in | std::ios::binary);
+	std::vector<unsigned char> rom((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+	if (rom.empty())
+	{
+		std::cerr << "Unable to open " << rom_path << "\n";
+		return 1;
+	}
+
+	if (!CheckConversion())
+	{
+		std::cerr << "SSE2 YUV conversion does not match the scalar output\n";
+		return 2;
+	}
+
+	std::cout << std::fixed << std::setprecision(3) << "YUV 4:2:0 640x576: scalar " << TimeConversion(false) << " ms, sse2 " << TimeConversion(true) << " ms\n";
+
+	std::vector<CaptureRun> runs =
+	{
+		{ "off", false, CaptureFormat_Y4M, "" },
+		{ "y4m", true, CaptureFormat_Y4M, output_path + ".y4m" },
+		{ "rgb", true, CaptureFormat_RGB, output_path + ".rgb" }
+	};
+
+	std::cout << "Capture   Emu fps   Written    Stalls  Encode ms\n";
+
+	FileLogger* logger = new FileLogger();
+
+	for (const CaptureRun& run : runs)
+	{
+		System* system = new System(logger);
+		VideoCapture* capture = new VideoCapture(logger);
+
+		system->LoadRom(rom.data(), rom.size());
+
+		if (run.capture && !capture->Open(run.path, run.format, factor))
+		{
+			std::cerr << "Unable to create " << run.path << "\n";
+			return 1;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int i = 0; i < frames; ++i)
+		{
+			system->RunFrame();
+			capture->PushFrame(system->GetFramebuffer());
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		unsigned long long stalls = capture->GetStallCount();
+
+		// Written counts the frames still queued at the end as well
+		capture->Close();
+
+		std::cout << std::setw(7) << run.name << std::setw(10) << std::setprecision(1) << frames / seconds
+			<< std::setw(10) << capture->GetWrittenFrameCount() << std::setw(10) << stalls
+			<< std::setw(11) << std::setprecision(3) << capture->GetAverageEncodeTime() << "\n";
+
+		delete capture;
+		delete system;
+
+		if (run.capture && !keep)
+			std::remove(run.path.c_str());
+	}
+
+	delete logger;
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+#include "System.h"
+
+// Measures System::Clone for tree search: creates many live branches from one
+// game state, advances each by a frame with its own input and reports the
+// time and memory per branch against copying the whole System.
+
+static double MicrosecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: gbe-clone <rom> [branches=10000] [warmup frames=600]\n";
+		return 1;
+	}
+
+	std::string rom_path = argv[1];
+	unsigned int branch_count = argc > 2 ? std::stoul(argv[2]) : 10000;
+	unsigned int warmup = argc > 3 ? std::stoul(argv[3]) : 600;
+
+	FileLogger* logger = new FileLogger();
+	System* root = new System(logger);
+
+	root->SetRenderingEnabled(false);
+	root->LoadRom(rom_path);
+
+	for (unsigned int frame = 0; frame < warmup; ++frame)
+		root->RunFrame();
+
+	std::vector<System*> branches(branch_count);
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (auto& branch : branches)
+		branch = root->Clone();
+
+	double clone_us = MicrosecondsSince(start);
+
+	// The same number of full copies through a save state, for comparison
+	std::vector<unsigned char> state;
+	std::vector<System*> copies(branch_count);
+
+	start = std::chrono::steady_clock::now();
+
+	for (auto& copy : copies)
+	{
+		root->SaveState(state);
+
+		copy = new System(logger);
+		copy->LoadState(state.data(), state.size());
+	}
+
+	double copy_us = MicrosecondsSince(start);
+
+	for (System* copy : copies)
+		delete copy;
+
+	start = std::chrono::steady_clock::now();
+
+	for (unsigned int i = 0; i < branch_count; ++i)
+	{
+		branches[i]->SetJoypad(static_cast<unsigned char>(i));
+		branches[i]->RunFrame();
+	}
+
+	double step_us = MicrosecondsSince(start);
+
+	unsigned long long owned_pages = 0;
+
+	for (System* branch : branches)
+		owned_pages += branch->GetOwnedPageCount();
+
+	double pages_per_branch = static_cast<double>(owned_pages) / branch_count;
+	double bytes_per_branch = sizeof(System) + pages_per_branch * sizeof(MemoryPage);
+	double full_bytes = sizeof(System) + System::page_count * sizeof(MemoryPage);
+
+	std::cout << std::fixed << std::setprecision(2)
+		<< "Branches:          " << branch_count << " from frame " << warmup << "\n"
+		<< "Clone:             " << clone_us / branch_count << " us/branch\n"
+		<< "Full copy:         " << copy_us / branch_count << " us/branch\n"
+		<< "One frame:         " << step_us / branch_count << " us/branch\n"
+		<< "Private pages:     " << pages_per_branch << " of " << System::page_count << " per branch after one frame\n"
+		<< "Memory per branch: " << bytes_per_branch / 1024.0 << " KiB (full copy " << full_bytes / 1024.0 << " KiB), "
+		<< bytes_per_branch * branch_count / 1024.0 / 1024.0 << " MiB for all branches\n";
+
+	for (System* branch : branches)
+		delete branch;
+
+	delete root;
+	delete logger;
+
+	return 0;
+}
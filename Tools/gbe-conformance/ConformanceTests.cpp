@@ -0,0 +1,730 @@
+#include "ConformanceTests.h"
+
+// Synthetic single-instruction tests. Expected results come from the reference
+// model below, written from the documented instruction behaviour rather than
+// from the core, so the two can disagree.
+
+static constexpr int reg_b = 0;
+static constexpr int reg_c = 1;
+static constexpr int reg_d = 2;
+static constexpr int reg_e = 3;
+static constexpr int reg_h = 4;
+static constexpr int reg_l = 5;
+static constexpr int reg_f = 6;
+static constexpr int reg_a = 7;
+
+static constexpr unsigned char flag_z = 0x80;
+static constexpr unsigned char flag_n = 0x40;
+static constexpr unsigned char flag_h = 0x20;
+static constexpr unsigned char flag_c = 0x10;
+
+static const char* const register_names[8] = { "B", "C", "D", "E", "H", "L", "(HL)", "A" };
+static const char* const pair_names[4] = { "BC", "DE", "HL", "SP" };
+static const char* const stack_pair_names[4] = { "BC", "DE", "HL", "AF" };
+static const char* const alu_names[8] = { "ADD A,", "ADC A,", "SUB ", "SBC A,", "AND ", "XOR ", "OR ", "CP " };
+static const char* const shift_names[8] = { "RLC ", "RRC ", "RL ", "RR ", "SLA ", "SRA ", "SWAP ", "SRL " };
+static const char* const condition_names[4] = { "NZ", "Z", "NC", "C" };
+
+static TestState DefaultState()
+{
+	TestState state;
+
+	state.regs[reg_b] = 0x12;
+	state.regs[reg_c] = 0x34;
+	state.regs[reg_d] = 0x56;
+	state.regs[reg_e] = 0x78;
+	state.regs[reg_h] = 0xC0;
+	state.regs[reg_l] = 0x00;
+	state.regs[reg_f] = 0x00;
+	state.regs[reg_a] = 0x9A;
+	state.sp = 0xDFF0;
+	state.pc = code_address;
+	state.memory = 0x5C;
+
+	return state;
+}
+
+// Test with the default state, expecting only PC to move past the code
+static ConformanceTest MakeTest(std::string name, std::vector<unsigned char> code)
+{
+	ConformanceTest test;
+
+	test.name = std::move(name);
+	test.code = std::move(code);
+	test.initial = DefaultState();
+	test.expected = test.initial;
+	test.expected.pc = static_cast<unsigned short>(code_address + test.code.size());
+
+	return test;
+}
+
+static unsigned short GetPair(const TestState& state, int high)
+{
+	return static_cast<unsigned short>(state.regs[high] << 8 | state.regs[high + 1]);
+}
+static void SetPair(TestState& state, int high, unsigned short value)
+{
+	state.regs[high] = static_cast<unsigned char>(value >> 8);
+	state.regs[high + 1] = static_cast<unsigned char>(value);
+}
+
+// Register r in opcode encoding, 6 being (HL) which the tests always point at memory_address
+static unsigned char GetOperand(const TestState& state, int r)
+{
+	return r == 6 ? state.memory : state.regs[r];
+}
+static void SetOperand(TestState& state, int r, unsigned char value)
+{
+	if (r == 6)
+		state.memory = value;
+	else
+		state.regs[r] = value;
+}
+
+static bool Condition(unsigned char f, int condition)
+{
+	switch (condition)
+	{
+	case 0: return (f & flag_z) == 0;
+	case 1: return (f & flag_z) != 0;
+	case 2: return (f & flag_c) == 0;
+	default: return (f & flag_c) != 0;
+	}
+}
+
+static void Alu(int op, unsigned char& a, unsigned char& f, unsigned char value)
+{
+	unsigned int carry = (f & flag_c) ? 1 : 0;
+	unsigned int result = a;
+
+	switch (op)
+	{
+	case 0:
+	case 1:
+		if (op == 0)
+			carry = 0;
+		result = a + value + carry;
+		f = ((a & 0x0F) + (value & 0x0F) + carry > 0x0F ? flag_h : 0) | (result > 0xFF ? flag_c : 0);
+		break;
+	case 2:
+	case 3:
+	case 7:
+		if (op != 3)
+			carry = 0;
+		result = a - value - carry;
+		f = flag_n | ((a & 0x0F) < (value & 0x0F) + carry ? flag_h : 0) | (a < value + carry ? flag_c : 0);
+		break;
+	case 4:
+		result = a & value;
+		f = flag_h;
+		break;
+	case 5:
+		result = a ^ value;
+		f = 0;
+		break;
+	case 6:
+		result = a | value;
+		f = 0;
+		break;
+	}
+
+	if ((result & 0xFF) == 0)
+		f |= flag_z;
+
+	if (op != 7)
+		a = static_cast<unsigned char>(result);
+}
+
+// CB prefixed rotates and shifts, the unprefixed RLCA family uses the same
+// result with Z cleared
+static unsigned char Shift(int op, unsigned char value, unsigned char& f)
+{
+	unsigned int carry_in = (f & flag_c) ? 1 : 0;
+	unsigned int carry = 0;
+	unsigned int result = 0;
+
+	switch (op)
+	{
+	case 0: carry = value >> 7; result = value << 1 | carry; break;
+	case 1: carry = value & 1; result = value >> 1 | carry << 7; break;
+	case 2: carry = value >> 7; result = value << 1 | carry_in; break;
+	case 3: carry = value & 1; result = value >> 1 | carry_in << 7; break;
+	case 4: carry = value >> 7; result = value << 1; break;
+	case 5: carry = value & 1; result = value >> 1 | (value & 0x80); break;
+	case 6: result = (value << 4 | value >> 4); break;
+	case 7: carry = value & 1; result = value >> 1; break;
+	}
+
+	result &= 0xFF;
+	f = (result == 0 ? flag_z : 0) | (carry ? flag_c : 0);
+
+	return static_cast<unsigned char>(result);
+}
+
+static void AddLoadTests(std::vector<ConformanceTest>& tests)
+{
+	for (int r = 0; r < 8; ++r)
+	{
+		ConformanceTest test = MakeTest(std::string("LD ") + register_names[r] + ",n", { static_cast<unsigned char>(0x06 | r << 3), 0xA5 });
+		SetOperand(test.expected, r, 0xA5);
+		tests.push_back(test);
+	}
+
+	for (int dst = 0; dst < 8; ++dst)
+	{
+		for (int src = 0; src < 8; ++src)
+		{
+			// 0x76 is HALT
+			if (dst == 6 && src == 6)
+				continue;
+
+			ConformanceTest test = MakeTest(std::string("LD ") + register_names[dst] + "," + register_names[src], { static_cast<unsigned char>(0x40 | dst << 3 | src) });
+			SetOperand(test.expected, dst, GetOperand(test.initial, src));
+			tests.push_back(test);
+		}
+	}
+
+	for (int p = 0; p < 4; ++p)
+	{
+		ConformanceTest test = MakeTest(std::string("LD ") + pair_names[p] + ",nn", { static_cast<unsigned char>(0x01 | p << 4), 0xEF, 0xBE });
+		if (p == 3)
+			test.expected.sp = 0xBEEF;
+		else
+			SetPair(test.expected, p * 2, 0xBEEF);
+		tests.push_back(test);
+	}
+
+	// Indirect loads through BC and DE, which are pointed at memory_address
+	for (int p = 0; p < 2; ++p)
+	{
+		ConformanceTest store = MakeTest(std::string("LD (") + pair_names[p] + "),A", { static_cast<unsigned char>(0x02 | p << 4) });
+		SetPair(store.initial, p * 2, 0xC000);
+		store.expected = store.initial;
+		store.expected.pc = code_address + 1;
+		store.expected.memory = store.initial.regs[reg_a];
+		tests.push_back(store);
+
+		ConformanceTest load = MakeTest(std::string("LD A,(") + pair_names[p] + ")", { static_cast<unsigned char>(0x0A | p << 4) });
+		SetPair(load.initial, p * 2, 0xC000);
+		load.expected = load.initial;
+		load.expected.pc = code_address + 1;
+		load.expected.regs[reg_a] = load.initial.memory;
+		tests.push_back(load);
+	}
+
+	// LDI and LDD
+	for (int i = 0; i < 2; ++i)
+	{
+		unsigned short hl = i == 0 ? 0xC001 : 0xBFFF;
+		const char* suffix = i == 0 ? "+" : "-";
+
+		ConformanceTest store = MakeTest(std::string("LD (HL") + suffix + "),A", { static_cast<unsigned char>(0x22 | i << 4) });
+		store.expected.memory = store.initial.regs[reg_a];
+		SetPair(store.expected, reg_h, hl);
+		tests.push_back(store);
+
+		ConformanceTest load = MakeTest(std::string("LD A,(HL") + suffix + ")", { static_cast<unsigned char>(0x2A | i << 4) });
+		load.expected.regs[reg_a] = load.initial.memory;
+		SetPair(load.expected, reg_h, hl);
+		tests.push_back(load);
+	}
+
+	ConformanceTest test = MakeTest("LD (nn),A", { 0xEA, 0x00, 0xC0 });
+	test.expected.memory = test.initial.regs[reg_a];
+	tests.push_back(test);
+
+	test = MakeTest("LD A,(nn)", { 0xFA, 0x00, 0xC0 });
+	test.expected.regs[reg_a] = test.initial.memory;
+	tests.push_back(test);
+
+	// High page loads, checked on HRAM
+	test = MakeTest("LDH (n),A", { 0xE0, 0x80 });
+	test.memory_address = 0xFF80;
+	test.expected.memory = test.initial.regs[reg_a];
+	tests.push_back(test);
+
+	test = MakeTest("LDH A,(n)", { 0xF0, 0x80 });
+	test.memory_address = 0xFF80;
+	test.expected.regs[reg_a] = test.initial.memory;
+	tests.push_back(test);
+
+	test = MakeTest("LD (C),A", { 0xE2 });
+	test.memory_address = 0xFF80;
+	test.initial.regs[reg_c] = 0x80;
+	test.expected = test.initial;
+	test.expected.pc = code_address + 1;
+	test.expected.memory = test.initial.regs[reg_a];
+	tests.push_back(test);
+
+	test = MakeTest("LD A,(C)", { 0xF2 });
+	test.memory_address = 0xFF80;
+	test.initial.regs[reg_c] = 0x80;
+	test.expected = test.initial;
+	test.expected.pc = code_address + 1;
+	test.expected.regs[reg_a] = test.initial.memory;
+	tests.push_back(test);
+
+	// Only the low byte of SP lands on memory_address
+	test = MakeTest("LD (nn),SP", { 0x08, 0x00, 0xC0 });
+	test.expected.memory = static_cast<unsigned char>(test.initial.sp);
+	tests.push_back(test);
+
+	test = MakeTest("LD SP,HL", { 0xF9 });
+	test.expected.sp = GetPair(test.initial, reg_h);
+	tests.push_back(test);
+}
+
+static void AddAluTests(std::vector<ConformanceTest>& tests)
+{
+	struct Operands
+	{
+		unsigned char a;
+		unsigned char value;
+		unsigned char f;
+	};
+
+	// Plain, half carry, carry and zero results, the last with the carry flag
+	// set going in for ADC and SBC
+	static const Operands operands[] = {
+		{ 0x12, 0x34, 0x00 },
+		{ 0x0F, 0x01, 0x00 },
+		{ 0xF0, 0x20, 0x00 },
+		{ 0x80, 0x80, flag_c },
+	};
+
+	for (int op = 0; op < 8; ++op)
+	{
+		for (int r = 0; r < 8; ++r)
+		{
+			for (size_t i = 0; i < std::size(operands); ++i)
+			{
+				ConformanceTest test = MakeTest(std::string(alu_names[op]) + register_names[r] + " #" + std::to_string(i + 1), { static_cast<unsigned char>(0x80 | op << 3 | r) });
+
+				// With A as the operand both sides are the same value
+				test.initial.regs[reg_a] = operands[i].a;
+				test.initial.regs[reg_f] = operands[i].f;
+				if (r != reg_a)
+					SetOperand(test.initial, r, operands[i].value);
+
+				test.expected = test.initial;
+				test.expected.pc = code_address + 1;
+				Alu(op, test.expected.regs[reg_a], test.expected.regs[reg_f], GetOperand(test.initial, r));
+				tests.push_back(test);
+			}
+		}
+
+		for (size_t i = 0; i < std::size(operands); ++i)
+		{
+			ConformanceTest test = MakeTest(std::string(alu_names[op]) + "n #" + std::to_string(i + 1), { static_cast<unsigned char>(0xC6 | op << 3), operands[i].value });
+
+			test.initial.regs[reg_a] = operands[i].a;
+			test.initial.regs[reg_f] = operands[i].f;
+			test.expected = test.initial;
+			test.expected.pc = code_address + 2;
+			Alu(op, test.expected.regs[reg_a], test.expected.regs[reg_f], operands[i].value);
+			tests.push_back(test);
+		}
+	}
+
+	// INC and DEC keep the carry flag, which is set going in to check that
+	static const unsigned char values[] = { 0x41, 0x0F, 0xFF, 0x00 };
+
+	for (int r = 0; r < 8; ++r)
+	{
+		for (size_t i = 0; i < std::size(values); ++i)
+		{
+			for (int dec = 0; dec < 2; ++dec)
+			{
+				ConformanceTest test = MakeTest(std::string(dec ? "DEC " : "INC ") + register_names[r] + " #" + std::to_string(i + 1), { static_cast<unsigned char>(0x04 | r << 3 | dec) });
+
+				SetOperand(test.initial, r, values[i]);
+				test.initial.regs[reg_f] = flag_c;
+				test.expected = test.initial;
+				test.expected.pc = code_address + 1;
+
+				unsigned char value = values[i];
+				unsigned char result = static_cast<unsigned char>(dec ? value - 1 : value + 1);
+				unsigned char half = dec ? (value & 0x0F) == 0x00 : (value & 0x0F) == 0x0F;
+
+				SetOperand(test.expected, r, result);
+				test.expected.regs[reg_f] = flag_c | (result == 0 ? flag_z : 0) | (dec ? flag_n : 0) | (half ? flag_h : 0);
+				tests.push_back(test);
+			}
+		}
+	}
+
+	ConformanceTest test = MakeTest("CPL", { 0x2F });
+	test.expected.regs[reg_a] = static_cast<unsigned char>(~test.initial.regs[reg_a]);
+	test.expected.regs[reg_f] = flag_n | flag_h;
+	tests.push_back(test);
+
+	test = MakeTest("SCF", { 0x37 });
+	test.initial.regs[reg_f] = flag_z | flag_n | flag_h;
+	test.expected.regs[reg_f] = flag_z | flag_c;
+	tests.push_back(test);
+
+	for (int carry = 0; carry < 2; ++carry)
+	{
+		test = MakeTest(std::string("CCF #") + std::to_string(carry + 1), { 0x3F });
+		test.initial.regs[reg_f] = flag_n | flag_h | (carry ? flag_c : 0);
+		test.expected.regs[reg_f] = carry ? 0 : flag_c;
+		tests.push_back(test);
+	}
+
+	// DAA after additions and subtractions, A and F as the previous op left them
+	static const Operands daa[] = {
+		{ 0x3C, 0, 0x00 },
+		{ 0x9A, 0, 0x00 },
+		{ 0x42, 0, flag_h },
+		{ 0x20, 0, flag_c },
+		{ 0x0F, 0, flag_n | flag_h },
+		{ 0xA0, 0, flag_n | flag_c },
+		{ 0x00, 0, flag_z },
+	};
+
+	for (size_t i = 0; i < std::size(daa); ++i)
+	{
+		test = MakeTest("DAA #" + std::to_string(i + 1), { 0x27 });
+		test.initial.regs[reg_a] = daa[i].a;
+		test.initial.regs[reg_f] = daa[i].f;
+
+		unsigned int a = daa[i].a;
+		bool carry = (daa[i].f & flag_c) != 0;
+
+		if ((daa[i].f & flag_n) == 0)
+		{
+			if (carry || a > 0x99)
+			{
+				a += 0x60;
+				carry = true;
+			}
+			if ((daa[i].f & flag_h) || (a & 0x0F) > 0x09)
+				a += 0x06;
+		}
+		else
+		{
+			if (carry)
+				a -= 0x60;
+			if (daa[i].f & flag_h)
+				a -= 0x06;
+		}
+
+		test.expected.regs[reg_a] = static_cast<unsigned char>(a);
+		test.expected.regs[reg_f] = ((a & 0xFF) == 0 ? flag_z : 0) | (daa[i].f & flag_n) | (carry ? flag_c : 0);
+		tests.push_back(test);
+	}
+}
+
+static void AddWordTests(std::vector<ConformanceTest>& tests)
+{
+	static const unsigned short values[] = { 0x1234, 0xFFFF };
+
+	for (int p = 0; p < 4; ++p)
+	{
+		for (size_t i = 0; i < std::size(values); ++i)
+		{
+			for (int dec = 0; dec < 2; ++dec)
+			{
+				ConformanceTest test = MakeTest(std::string(dec ? "DEC " : "INC ") + pair_names[p] + " #" + std::to_string(i + 1), { static_cast<unsigned char>(0x03 | p << 4 | dec << 3) });
+				unsigned short value = dec ? static_cast<unsigned short>(values[i] + 1) : values[i];
+				unsigned short result = static_cast<unsigned short>(dec ? value - 1 : value + 1);
+
+				if (p == 3)
+				{
+					test.initial.sp = value;
+					test.expected.sp = result;
+				}
+				else
+				{
+					SetPair(test.initial, p * 2, value);
+					SetPair(test.expected, p * 2, result);
+				}
+				tests.push_back(test);
+			}
+		}
+	}
+
+	// ADD HL,rr leaves Z alone, which is set going in
+	struct Operands
+	{
+		unsigned short hl;
+		unsigned short value;
+	};
+
+	static const Operands operands[] = {
+		{ 0x0FFF, 0x0001 },
+		{ 0x8000, 0x8000 },
+	};
+
+	for (int p = 0; p < 4; ++p)
+	{
+		for (size_t i = 0; i < std::size(operands); ++i)
+		{
+			ConformanceTest test = MakeTest(std::string("ADD HL,") + pair_names[p] + " #" + std::to_string(i + 1), { static_cast<unsigned char>(0x09 | p << 4) });
+
+			if (p == 3)
+				test.initial.sp = operands[i].value;
+			else if (p != 2)
+				SetPair(test.initial, p * 2, operands[i].value);
+			SetPair(test.initial, reg_h, operands[i].hl);
+			test.initial.regs[reg_f] = flag_z | flag_n;
+
+			unsigned int hl = operands[i].hl;
+			unsigned int value = p == 2 ? hl : operands[i].value;
+
+			test.expected = test.initial;
+			test.expected.pc = code_address + 1;
+			SetPair(test.expected, reg_h, static_cast<unsigned short>(hl + value));
+			test.expected.regs[reg_f] = flag_z | ((hl & 0x0FFF) + (value & 0x0FFF) > 0x0FFF ? flag_h : 0) | (hl + value > 0xFFFF ? flag_c : 0);
+			tests.push_back(test);
+		}
+	}
+
+	// SP plus a signed offset, flags come from the low byte
+	struct Offsets
+	{
+		unsigned short sp;
+		unsigned char offset;
+	};
+
+	static const Offsets offsets[] = {
+		{ 0xDFF0, 0x05 },
+		{ 0xDFF8, 0x08 },
+		{ 0xDFFF, 0x01 },
+		{ 0xDFF0, 0xFE },
+	};
+
+	for (int add = 0; add < 2; ++add)
+	{
+		for (size_t i = 0; i < std::size(offsets); ++i)
+		{
+			ConformanceTest test = MakeTest(std::string(add ? "ADD SP,e #" : "LD HL,SP+e #") + std::to_string(i + 1), { static_cast<unsigned char>(add ? 0xE8 : 0xF8), offsets[i].offset });
+			unsigned int sp = offsets[i].sp;
+			unsigned int offset = offsets[i].offset;
+			unsigned short result = static_cast<unsigned short>(sp + static_cast<signed char>(offsets[i].offset));
+
+			test.initial.sp = offsets[i].sp;
+			test.initial.regs[reg_f] = flag_z | flag_n;
+			test.expected = test.initial;
+			test.expected.pc = code_address + 2;
+			test.expected.regs[reg_f] = ((sp & 0x0F) + (offset & 0x0F) > 0x0F ? flag_h : 0) | ((sp & 0xFF) + offset > 0xFF ? flag_c : 0);
+
+			if (add)
+				test.expected.sp = result;
+			else
+				SetPair(test.expected, reg_h, result);
+			tests.push_back(test);
+		}
+	}
+
+	// PUSH checks the high byte at SP - 1, POP reads memory_address into the
+	// low byte with zeroed RAM above it
+	for (int p = 0; p < 4; ++p)
+	{
+		int high = p == 3 ? reg_a : p * 2;
+
+		ConformanceTest push = MakeTest(std::string("PUSH ") + stack_pair_names[p], { static_cast<unsigned char>(0xC5 | p << 4) });
+		push.memory_address = push.initial.sp - 1;
+		push.initial.regs[reg_f] = flag_z | flag_c;
+		push.expected = push.initial;
+		push.expected.pc = code_address + 1;
+		push.expected.sp -= 2;
+		push.expected.memory = push.initial.regs[high];
+		tests.push_back(push);
+
+		ConformanceTest pop = MakeTest(std::string("POP ") + stack_pair_names[p], { static_cast<unsigned char>(0xC1 | p << 4) });
+		pop.memory_address = pop.initial.sp;
+		pop.initial.memory = 0xF7;
+		pop.expected = pop.initial;
+		pop.expected.pc = code_address + 1;
+		pop.expected.sp += 2;
+
+		if (p == 3)
+		{
+			pop.expected.regs[reg_a] = 0x00;
+			pop.expected.regs[reg_f] = 0xF0;
+		}
+		else
+			SetPair(pop.expected, p * 2, 0x00F7);
+		tests.push_back(pop);
+	}
+}
+
+static void AddRotateTests(std::vector<ConformanceTest>& tests)
+{
+	static const unsigned char values[] = { 0x85, 0x00 };
+
+	// Unprefixed accumulator rotates
+	for (int op = 0; op < 4; ++op)
+	{
+		for (size_t i = 0; i < std::size(values); ++i)
+		{
+			static const char* const names[4] = { "RLCA", "RRCA", "RLA", "RRA" };
+
+			ConformanceTest test = MakeTest(std::string(names[op]) + " #" + std::to_string(i + 1), { static_cast<unsigned char>(0x07 | op << 3) });
+			test.initial.regs[reg_a] = values[i];
+			test.initial.regs[reg_f] = i == 0 ? flag_c : flag_z;
+			test.expected = test.initial;
+			test.expected.pc = code_address + 1;
+			test.expected.regs[reg_a] = Shift(op, values[i], test.expected.regs[reg_f]);
+			test.expected.regs[reg_f] &= ~flag_z;
+			tests.push_back(test);
+		}
+	}
+
+	// Every CB opcode, once with bits and carry set and once with zeroes
+	for (int opcode = 0; opcode < 256; ++opcode)
+	{
+		int r = opcode & 7;
+		int group = opcode >> 6;
+		int y = opcode >> 3 & 7;
+
+		for (size_t i = 0; i < std::size(values); ++i)
+		{
+			std::string name;
+
+			if (group == 0)
+				name = shift_names[y];
+			else
+				name = std::string(group == 1 ? "BIT " : group == 2 ? "RES " : "SET ") + std::to_string(y) + ",";
+
+			ConformanceTest test = MakeTest(name + register_names[r] + " #" + std::to_string(i + 1), { 0xCB, static_cast<unsigned char>(opcode) });
+
+			SetOperand(test.initial, r, values[i]);
+			test.initial.regs[reg_f] = i == 0 ? flag_c | flag_n : 0;
+			test.expected = test.initial;
+			test.expected.pc = code_address + 2;
+
+			unsigned char value = values[i];
+			unsigned char& f = test.expected.regs[reg_f];
+
+			switch (group)
+			{
+			case 0:
+				SetOperand(test.expected, r, Shift(y, value, f));
+				break;
+			case 1:
+				f = (f & flag_c) | flag_h | ((value >> y & 1) == 0 ? flag_z : 0);
+				break;
+			case 2:
+				SetOperand(test.expected, r, static_cast<unsigned char>(value & ~(1 << y)));
+				break;
+			case 3:
+				SetOperand(test.expected, r, static_cast<unsigned char>(value | 1 << y));
+				break;
+			}
+			tests.push_back(test);
+		}
+	}
+}
+
+static void AddControlTests(std::vector<ConformanceTest>& tests)
+{
+	ConformanceTest test = MakeTest("NOP", { 0x00 });
+	tests.push_back(test);
+
+	test = MakeTest("JP nn", { 0xC3, 0x34, 0x12 });
+	test.expected.pc = 0x1234;
+	tests.push_back(test);
+
+	test = MakeTest("JP (HL)", { 0xE9 });
+	test.expected.pc = GetPair(test.initial, reg_h);
+	tests.push_back(test);
+
+	test = MakeTest("JR e #1", { 0x18, 0x10 });
+	test.expected.pc = code_address + 2 + 0x10;
+	tests.push_back(test);
+
+	test = MakeTest("JR e #2", { 0x18, 0xF0 });
+	test.expected.pc = code_address + 2 - 0x10;
+	tests.push_back(test);
+
+	// Calls check the low byte of the return address at SP - 2
+	test = MakeTest("CALL nn", { 0xCD, 0x34, 0x12 });
+	test.memory_address = test.initial.sp - 2;
+	test.expected.pc = 0x1234;
+	test.expected.sp -= 2;
+	test.expected.memory = static_cast<unsigned char>(code_address + 3);
+	tests.push_back(test);
+
+	// Returns pop memory_address as the low byte with zeroed RAM above it
+	for (int reti = 0; reti < 2; ++reti)
+	{
+		test = MakeTest(reti ? "RETI" : "RET", { static_cast<unsigned char>(reti ? 0xD9 : 0xC9) });
+		test.memory_address = test.initial.sp;
+		test.initial.memory = 0x34;
+		test.expected = test.initial;
+		test.expected.pc = 0x0034;
+		test.expected.sp += 2;
+		tests.push_back(test);
+	}
+
+	for (int n = 1; n < 8; ++n)
+	{
+		char name[8];
+		std::snprintf(name, sizeof(name), "RST %02X", n * 8);
+
+		test = MakeTest(name, { static_cast<unsigned char>(0xC7 | n << 3) });
+		test.memory_address = test.initial.sp - 2;
+		test.expected.pc = static_cast<unsigned short>(n * 8);
+		test.expected.sp -= 2;
+		test.expected.memory = static_cast<unsigned char>(code_address + 1);
+		tests.push_back(test);
+	}
+
+	static const unsigned char flags[] = { 0x00, flag_z | flag_c };
+
+	for (int condition = 0; condition < 4; ++condition)
+	{
+		for (size_t i = 0; i < std::size(flags); ++i)
+		{
+			bool taken = Condition(flags[i], condition);
+			std::string suffix = std::string(condition_names[condition]) + (taken ? " taken" : " not taken");
+
+			test = MakeTest("JP " + suffix, { static_cast<unsigned char>(0xC2 | condition << 3), 0x34, 0x12 });
+			test.initial.regs[reg_f] = test.expected.regs[reg_f] = flags[i];
+			if (taken)
+				test.expected.pc = 0x1234;
+			tests.push_back(test);
+
+			test = MakeTest("JR " + suffix, { static_cast<unsigned char>(0x20 | condition << 3), 0xF0 });
+			test.initial.regs[reg_f] = test.expected.regs[reg_f] = flags[i];
+			if (taken)
+				test.expected.pc = code_address + 2 - 0x10;
+			tests.push_back(test);
+
+			test = MakeTest("CALL " + suffix, { static_cast<unsigned char>(0xC4 | condition << 3), 0x34, 0x12 });
+			test.memory_address = test.initial.sp - 2;
+			test.initial.regs[reg_f] = test.expected.regs[reg_f] = flags[i];
+			if (taken)
+			{
+				test.expected.pc = 0x1234;
+				test.expected.sp -= 2;
+				test.expected.memory = static_cast<unsigned char>(code_address + 3);
+			}
+			tests.push_back(test);
+
+			test = MakeTest("RET " + suffix, { static_cast<unsigned char>(0xC0 | condition << 3) });
+			test.memory_address = test.initial.sp;
+			test.initial.memory = 0x34;
+			test.initial.regs[reg_f] = flags[i];
+			test.expected = test.initial;
+			test.expected.pc = code_address + 1;
+			if (taken)
+			{
+				test.expected.pc = 0x0034;
+				test.expected.sp += 2;
+			}
+			tests.push_back(test);
+		}
+	}
+}
+
+void BuildConformanceTests(std::vector<ConformanceTest>& tests)
+{
+	AddLoadTests(tests);
+	AddAluTests(tests);
+	AddWordTests(tests);
+	AddRotateTests(tests);
+	AddControlTests(tests);
+}
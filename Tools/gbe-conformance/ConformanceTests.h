@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// CPU state as seen by a conformance test. Registers are indexed like the
+// opcode encoding, B C D E H L F A, with F in the slot (HL) takes there.
+struct TestState
+{
+	unsigned char regs[8]{};
+	unsigned short sp{};
+	unsigned short pc{};
+	// Byte at the test's memory_address, what (HL) points to in most tests
+	unsigned char memory{};
+};
+
+// A single instruction (or a short sequence) placed at code_address in an
+// otherwise empty ROM. The runner loads the initial state, executes the given
+// number of instructions and compares the result with the expected state,
+// which comes from a small reference model of the documented behaviour.
+struct ConformanceTest
+{
+	std::string name;
+	std::vector<unsigned char> code;
+	unsigned int steps = 1;
+	unsigned short memory_address = 0xC000;
+	TestState initial;
+	TestState expected;
+};
+
+static constexpr unsigned short code_address = 0x0100;
+
+void BuildConformanceTests(std::vector<ConformanceTest>& tests);
@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ConformanceTests.h"
+#include "FileLogger.h"
+#include "System.h"
+#include "ThreadPool.h"
+
+// Runs the synthetic CPU conformance tests in parallel, one System per test.
+//
+// A baseline file records the outcome of every test as "<P|F> <signature>
+// <name>", the signature being a hash of the final state. Runs against a
+// baseline only fail on regressions: tests that passed before and fail now, or
+// known failures whose result changed. baseline.txt next to this file records
+// the core as it is, so CPU fixes show up as fixed and everything else stays quiet.
+
+struct TestResult
+{
+	TestState actual;
+	unsigned long long signature{};
+	bool passed = false;
+};
+
+struct BaselineEntry
+{
+	unsigned long long signature{};
+	bool passed = false;
+};
+
+static void PrintUsage()
+{
+	std::cout << "Usage: gbe-conformance [options]\n"
+		<< "  -j <threads>             Worker threads (default: all cores)\n"
+		<< "  --filter <text>          Only run tests whose name contains text\n"
+		<< "  -v                       Show every failure instead of the first 20\n"
+		<< "  --baseline <file>        Only report changes against a baseline\n"
+		<< "  --write-baseline <file>  Record the results as a baseline\n";
+}
+
+static void RunTest(FileLogger* logger, const ConformanceTest& test, TestResult& result)
+{
+	System* system = new System(logger);
+
+	std::vector<unsigned char> rom(code_address + test.code.size());
+	std::copy(test.code.begin(), test.code.end(), rom.begin() + code_address);
+
+	system->SetRenderingEnabled(false);
+	system->LoadRom(rom.data(), rom.size());
+
+	Registers registers;
+	registers.b = test.initial.regs[0];
+	registers.c = test.initial.regs[1];
+	registers.d = test.initial.regs[2];
+	registers.e = test.initial.regs[3];
+	registers.h = test.initial.regs[4];
+	registers.l = test.initial.regs[5];
+	registers.f = test.initial.regs[6];
+	registers.a = test.initial.regs[7];
+
+	system->SetRegisters(registers);
+	system->SetSP(test.initial.sp);
+	system->SetPC(test.initial.pc);
+	system->WriteMemoryBlock(test.memory_address, 1, &test.initial.memory);
+
+	for (unsigned int i = 0; i < test.steps; ++i)
+		system->EmulateCycle();
+
+	registers = system->GetRegisters();
+
+	TestState& actual = result.actual;
+	actual.regs[0] = registers.b;
+	actual.regs[1] = registers.c;
+	actual.regs[2] = registers.d;
+	actual.regs[3] = registers.e;
+	actual.regs[4] = registers.h;
+	actual.regs[5] = registers.l;
+	actual.regs[6] = registers.f;
+	actual.regs[7] = registers.a;
+	actual.sp = system->GetSP();
+	actual.pc = system->GetPC();
+	system->ReadMemoryBlock(test.memory_address, 1, &actual.memory);
+
+	delete system;
+
+	const TestState& expected = test.expected;
+
+	result.passed = std::equal(std::begin(actual.regs), std::end(actual.regs), std::begin(expected.regs))
+		&& actual.sp == expected.sp && actual.pc == expected.pc && actual.memory == expected.memory;
+
+	// FNV-1a over the observable state
+	unsigned char bytes[13];
+	std::copy(std::begin(actual.regs), std::end(actual.regs), bytes);
+	bytes[8] = static_cast<unsigned char>(actual.sp);
+	bytes[9] = static_cast<unsigned char>(actual.sp >> 8);
+	bytes[10] = static_cast<unsigned char>(actual.pc);
+	bytes[11] = static_cast<unsigned char>(actual.pc >> 8);
+	bytes[12] = actual.memory;
+
+	result.signature = 0xCBF29CE484222325ULL;
+
+	for (unsigned char byte : bytes)
+		result.signature = (result.signature ^ byte) * 0x100000001B3ULL;
+}
+
+static std::string FormatState(const TestState& state, unsigned short memory_address)
+{
+	static const char* const names[8] = { "B", "C", "D", "E", "H", "L", "F", "A" };
+
+	std::ostringstream stream;
+	stream << std::hex << std::uppercase << std::setfill('0');
+
+	for (int i = 0; i < 8; ++i)
+		stream << names[i] << ":" << std::setw(2) << static_cast<int>(state.regs[i]) << " ";
+
+	stream << "SP:" << std::setw(4) << state.sp << " PC:" << std::setw(4) << state.pc
+		<< " (" << std::setw(4) << memory_address << "):" << std::setw(2) << static_cast<int>(state.memory);
+
+	return stream.str();
+}
+
+static void PrintFailure(const ConformanceTest& test, const TestResult& result)
+{
+	std::cout << test.name << " [" << std::hex << std::uppercase << std::setfill('0');
+
+	for (size_t i = 0; i < test.code.size(); ++i)
+		std::cout << (i ? " " : "") << std::setw(2) << static_cast<int>(test.code[i]);
+
+	std::cout << std::dec << std::setfill(' ') << "]\n"
+		<< "  initial  " << FormatState(test.initial, test.memory_address) << "\n"
+		<< "  expected " << FormatState(test.expected, test.memory_address) << "\n"
+		<< "  actual   " << FormatState(result.actual, test.memory_address) << "\n";
+}
+
+static bool LoadBaseline(std::string path, std::unordered_map<std::string, BaselineEntry>& baseline)
+{
+	std::ifstream input(path);
+
+	if (!input)
+		return false;
+
+	std::string line;
+
+	while (std::getline(input, line))
+	{
+		if (line.size() < 4 || (line[0] != 'P' && line[0] != 'F'))
+			continue;
+
+		size_t space = line.find(' ', 2);
+
+		if (space == std::string::npos)
+			continue;
+
+		BaselineEntry entry;
+		entry.passed = line[0] == 'P';
+		entry.signature = std::stoull(line.substr(2, space - 2), nullptr, 16);
+
+		baseline[line.substr(space + 1)] = entry;
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	std::string filter;
+	std::string baseline_path;
+	std::string write_baseline_path;
+	unsigned int thread_count = std::thread::hardware_concurrency();
+	bool verbose = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "-j" && i + 1 < argc)
+			thread_count = std::stoul(argv[++i]);
+		else if (arg == "--filter" && i + 1 < argc)
+			filter = argv[++i];
+		else if (arg == "-v")
+			verbose = true;
+		else if (arg == "--baseline" && i + 1 < argc)
+			baseline_path = argv[++i];
+		else if (arg == "--write-baseline" && i + 1 < argc)
+			write_baseline_path = argv[++i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (thread_count == 0)
+		thread_count = 1;
+
+	std::unordered_map<std::string, BaselineEntry> baseline;
+
+	if (!baseline_path.empty() && !LoadBaseline(baseline_path, baseline))
+	{
+		std::cerr << "Unable to open baseline " << baseline_path << "\n";
+		return 1;
+	}
+
+	std::vector<ConformanceTest> tests;
+	BuildConformanceTests(tests);
+
+	if (!filter.empty())
+		tests.erase(std::remove_if(tests.begin(), tests.end(), [&](const ConformanceTest& test) { return test.name.find(filter) == std::string::npos; }), tests.end());
+
+	std::vector<TestResult> results(tests.size());
+
+	FileLogger* logger = new FileLogger();
+	ThreadPool* pool = new ThreadPool(thread_count);
+
+	auto start = std::chrono::steady_clock::now();
+
+	// A test is a handful of instructions, batch them so tasks outweigh the pool overhead
+	static constexpr size_t batch_size = 32;
+
+	for (size_t first = 0; first < tests.size(); first += batch_size)
+	{
+		pool->Submit([&, first]()
+		{
+			for (size_t i = first; i < first + batch_size && i < tests.size(); ++i)
+				RunTest(logger, tests[i], results[i]);
+		});
+	}
+
+	pool->Wait();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	size_t passed = 0;
+	size_t known = 0;
+	size_t fixed = 0;
+	size_t regressions = 0;
+	size_t shown = 0;
+
+	for (size_t i = 0; i < tests.size(); ++i)
+	{
+		const TestResult& result = results[i];
+
+		if (result.passed)
+			++passed;
+
+		if (baseline_path.empty())
+		{
+			if (!result.passed && (verbose || shown++ < 20))
+				PrintFailure(tests[i], result);
+			continue;
+		}
+
+		auto entry = baseline.find(tests[i].name);
+
+		if (result.passed)
+		{
+			if (entry != baseline.end() && !entry->second.passed)
+			{
+				std::cout << "Fixed: " << tests[i].name << "\n";
+				++fixed;
+			}
+		}
+		else if (entry != baseline.end() && !entry->second.passed && entry->second.signature == result.signature)
+			++known;
+		else
+		{
+			std::cout << "Regression: ";
+			PrintFailure(tests[i], result);
+			++regressions;
+		}
+	}
+
+	std::cout << passed << "/" << tests.size() << " passed";
+
+	if (!baseline_path.empty())
+		std::cout << ", " << known << " known failures, " << fixed << " fixed, " << regressions << " regressions";
+
+	std::cout << " in " << std::fixed << std::setprecision(3) << seconds << "s on " << pool->GetThreadCount() << " threads\n";
+
+	if (!write_baseline_path.empty())
+	{
+		std::ofstream output(write_baseline_path, std::ios::out | std::ios::trunc);
+
+		for (size_t i = 0; i < tests.size(); ++i)
+			output << (results[i].passed ? 'P' : 'F') << " " << std::hex << std::setw(16) << std::setfill('0') << results[i].signature << " " << tests[i].name << "\n";
+
+		if (!output)
+			std::cerr << "Unable to write baseline " << write_baseline_path << "\n";
+	}
+
+	delete pool;
+	delete logger;
+
+	if (!baseline_path.empty())
+		return regressions > 0 ? 2 : 0;
+
+	return passed == tests.size() ? 0 : 2;
+}
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+#include "System.h"
+
+// Reports how many memory pages each frame writes and compares the cost of a
+// full SaveState with bringing the previous snapshot up to date through the
+// dirty page bitmap. Both snapshots are compared every frame, so a write that
+// bypasses the tracking shows up as a mismatch.
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: gbe-dirty-pages <rom> [frames=3600]\n";
+		return 1;
+	}
+
+	std::string rom_path = argv[1];
+	unsigned int frames = argc > 2 ? std::stoul(argv[2]) : 3600;
+
+	FileLogger* logger = new FileLogger();
+	System* system = new System(logger);
+
+	system->SetRenderingEnabled(false);
+	system->LoadRom(rom_path);
+
+	std::vector<unsigned char> full;
+	std::vector<unsigned char> incremental;
+	DirtyPages pages;
+
+	system->SaveState(incremental);
+	system->TakeDirtyPages(pages);
+
+	std::vector<unsigned int> page_counts;
+	unsigned int page_frequency[System::page_count]{};
+	double full_microseconds = 0.0;
+	double incremental_microseconds = 0.0;
+	unsigned int mismatches = 0;
+
+	for (unsigned int frame = 0; frame < frames && system->IsRunning(); ++frame)
+	{
+		system->SetJoypad(static_cast<unsigned char>((frame / 60) % 4 == 1 ? 1 << Joypad_Start : 0));
+		system->RunFrame();
+
+		auto start = std::chrono::steady_clock::now();
+
+		system->SaveState(full);
+
+		auto middle = std::chrono::steady_clock::now();
+
+		system->TakeDirtyPages(pages);
+		system->UpdateState(incremental, pages);
+
+		auto end = std::chrono::steady_clock::now();
+
+		full_microseconds += std::chrono::duration<double, std::micro>(middle - start).count();
+		incremental_microseconds += std::chrono::duration<double, std::micro>(end - middle).count();
+
+		if (std::memcmp(full.data(), incremental.data(), full.size()) != 0)
+			++mismatches;
+
+		page_counts.push_back(pages.Count());
+
+		for (unsigned int page = 0; page < System::page_count; ++page)
+			page_frequency[page] += pages.IsSet(page);
+	}
+
+	if (page_counts.empty())
+		return 1;
+
+	std::vector<unsigned int> sorted = page_counts;
+	std::sort(sorted.begin(), sorted.end());
+
+	double average = 0.0;
+
+	for (unsigned int count : page_counts)
+		average += count;
+
+	average /= page_counts.size();
+
+	std::cout << std::fixed << std::setprecision(2)
+		<< "Frames:       " << page_counts.size() << "\n"
+		<< "Dirty pages:  avg " << average << ", min " << sorted.front() << ", median " << sorted[sorted.size() / 2]
+		<< ", p99 " << sorted[sorted.size() * 99 / 100] << ", max " << sorted.back() << " of " << System::page_count << "\n"
+		<< "Full:         " << full_microseconds / page_counts.size() << " us/frame\n"
+		<< "Incremental:  " << incremental_microseconds / page_counts.size() << " us/frame\n";
+
+	std::cout << "Most written pages:";
+
+	std::vector<unsigned int> hottest(System::page_count);
+
+	for (unsigned int page = 0; page < System::page_count; ++page)
+		hottest[page] = page;
+
+	std::sort(hottest.begin(), hottest.end(), [&](unsigned int a, unsigned int b) { return page_frequency[a] > page_frequency[b]; });
+
+	for (unsigned int i = 0; i < 8 && page_frequency[hottest[i]] > 0; ++i)
+		std::cout << " " << std::hex << std::setw(2) << std::setfill('0') << hottest[i] << "xx" << std::dec << std::setfill(' ')
+			<< " (" << page_frequency[hottest[i]] * 100 / page_counts.size() << "%)";
+
+	std::cout << "\n";
+
+	if (mismatches > 0)
+		std::cout << "MISMATCH: incremental snapshot differed from the full one on " << mismatches << " frames\n";
+
+	delete system;
+	delete logger;
+
+	return mismatches > 0 ? 2 : 0;
+}
@@ -0,0 +1,79 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "Disassembler.h"
+#include "SymbolTable.h"
+
+// Writes a linear sweep disassembly of a whole ROM image, labelled from an
+// RGBDS .sym file when one is given.
+
+int main(int argc, char** argv)
+{
+	std::string rom_path;
+	std::string symbol_path;
+	std::string output_path;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--sym" && i + 1 < argc)
+			symbol_path = argv[++i];
+		else if (arg == "-o" && i + 1 < argc)
+			output_path = argv[++i];
+		else
+			rom_path = arg;
+	}
+
+	if (rom_path.empty())
+	{
+		std::cout << "Usage: gbe-disasm <rom> [--sym <file>] [-o <output>]\n";
+		return 1;
+	}
+
+	std::ifstream input(rom_path, std::ios::in | std::ios::binary);
+	std::vector<unsigned char> rom((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+	if (rom.empty())
+	{
+		std::cerr << "Unable to open " << rom_path << "\n";
+		return 1;
+	}
+
+	SymbolTable symbols;
+
+	if (!symbol_path.empty() && !symbols.Load(symbol_path))
+	{
+		std::cerr << "Unable to open " << symbol_path << "\n";
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::string listing;
+	Disassembler::DisassembleRom(rom.data(), rom.size(), &symbols, listing);
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (output_path.empty())
+		std::cout << listing;
+	else
+	{
+		std::ofstream output(output_path, std::ios::out | std::ios::binary | std::ios::trunc);
+		output.write(listing.data(), listing.size());
+
+		if (!output)
+		{
+			std::cerr << "Unable to write " << output_path << "\n";
+			return 1;
+		}
+	}
+
+	std::cerr << rom.size() / 1024 << " KiB, " << symbols.GetCount() << " symbols, disassembled in " << seconds * 1000.0 << " ms\n";
+
+	return 0;
+}
\ No newline at end of file
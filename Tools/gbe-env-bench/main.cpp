@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "gbe_env.h"
+
+// Measures environment steps per second through the C API at several batch sizes.
+// First checks that a step without observations leaves the buffer of an
+// earlier step alone, the API lets callers free it after the next step, and
+// that a reset instance runs exactly like a newly created one.
+
+static bool CheckObservationRelease(const char* rom_path)
+{
+	static constexpr unsigned int batch_size = 4;
+	static constexpr size_t frame_size = GBE_SCREEN_WIDTH * GBE_SCREEN_HEIGHT;
+
+	gbe_env* env = gbe_env_create(rom_path, batch_size, 0);
+
+	if (env == nullptr)
+		return false;
+
+	std::vector<unsigned char> observations(batch_size * frame_size);
+	gbe_env_step(env, 2, nullptr, observations.data());
+
+	// Stands in for a freed buffer, any write shows up as a changed byte
+	std::fill(observations.begin(), observations.end(), 0xAA);
+	gbe_env_step(env, 2, nullptr, nullptr);
+
+	bool untouched = std::all_of(observations.begin(), observations.end(), [](unsigned char value) { return value == 0xAA; });
+
+	// The frame still has to be there for gbe_env_get_framebuffer
+	std::vector<unsigned char> frames(batch_size * frame_size, 0xAA);
+	gbe_env_get_framebuffer(env, frames.data());
+
+	bool rendered = std::all_of(frames.begin(), frames.end(), [](unsigned char value) { return value <= 3; });
+
+	gbe_env_destroy(env);
+
+	if (!untouched)
+		std::cerr << "A step without observations wrote into the previous observation buffer\n";
+	if (!rendered)
+		std::cerr << "A step without observations did not render into the instance's framebuffer\n";
+
+	return untouched && rendered;
+}
+
+static bool CheckResetMatchesFresh(const char* rom_path)
+{
+	gbe_env* used = gbe_env_create(rom_path, 1, 1);
+	gbe_env* fresh = gbe_env_create(rom_path, 1, 1);
+
+	if (used == nullptr || fresh == nullptr)
+	{
+		gbe_env_destroy(used);
+		gbe_env_destroy(fresh);
+		return false;
+	}
+
+	// Play an episode with some input first, so the CPU is far from power on
+	for (unsigned int step = 0; step < 100; ++step)
+	{
+		unsigned char buttons = static_cast<unsigned char>(1 << (step % 8));
+		gbe_env_step(used, 5, &buttons, nullptr);
+	}
+
+	gbe_env_reset_one(used, 0);
+
+	gbe_env_step(used, 10, nullptr, nullptr);
+	gbe_env_step(fresh, 10, nullptr, nullptr);
+
+	unsigned long long used_hash = 0;
+	unsigned long long fresh_hash = 0;
+
+	gbe_env_get_state_hash(used, &used_hash);
+	gbe_env_get_state_hash(fresh, &fresh_hash);
+
+	gbe_env_destroy(used);
+	gbe_env_destroy(fresh);
+
+	if (used_hash != fresh_hash)
+		std::cerr << "A reset instance differs from a new one after 10 frames: " << std::hex << used_hash << " vs " << fresh_hash << std::dec << "\n";
+
+	return used_hash == fresh_hash;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: gbe-env-bench <rom> [frames per step=4] [steps=200] [threads=0]\n";
+		return 1;
+	}
+
+	const char* rom_path = argv[1];
+	unsigned int frames_per_step = argc > 2 ? std::stoul(argv[2]) : 4;
+	unsigned int steps = argc > 3 ? std::stoul(argv[3]) : 200;
+	unsigned int thread_count = argc > 4 ? std::stoul(argv[4]) : 0;
+
+	if (!CheckObservationRelease(rom_path) || !CheckResetMatchesFresh(rom_path))
+		return 2;
+
+	std::cout << "Batch   Threads   Env-steps/s     Frames/s\n" << std::fixed << std::setprecision(1);
+
+	for (unsigned int batch_size : { 1u, 64u, 1024u })
+	{
+		gbe_env* env = gbe_env_create(rom_path, batch_size, thread_count);
+
+		if (env == nullptr)
+		{
+			std::cerr << "Unable to open " << rom_path << "\n";
+			return 1;
+		}
+
+		std::vector<unsigned char> buttons(batch_size);
+		std::vector<unsigned char> observations(static_cast<size_t>(batch_size) * GBE_SCREEN_WIDTH * GBE_SCREEN_HEIGHT);
+
+		// Large batches get fewer steps so every size runs for a similar time
+		unsigned int batch_steps = batch_size > 64 ? steps / 16 + 1 : steps;
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int step = 0; step < batch_steps; ++step)
+		{
+			for (unsigned int i = 0; i < batch_size; ++i)
+				buttons[i] = static_cast<unsigned char>((step * 31 + i * 17) >> 3);
+
+			gbe_env_step(env, frames_per_step, buttons.data(), observations.data());
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double env_steps = static_cast<double>(batch_steps) * batch_size;
+
+		std::cout << std::setw(5) << batch_size << std::setw(10) << (thread_count == 0 ? std::string("all") : std::to_string(thread_count))
+			<< std::setw(14) << env_steps / seconds << std::setw(13) << env_steps * frames_per_step / seconds << "\n";
+
+		gbe_env_destroy(env);
+	}
+
+	return 0;
+}
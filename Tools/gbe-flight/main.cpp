@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+#include "FlightRecorder.h"
+#include "System.h"
+
+// Shows flight recorder dumps and measures what recording costs the core.
+
+static void PrintUsage()
+{
+	std::cout << "Usage:\n"
+		<< "  gbe-flight show <dump> [entries=64]\n"
+		<< "  gbe-flight bench <rom> [frames=600]\n";
+}
+
+static int Show(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	size_t shown = argc > 3 ? std::stoul(argv[3]) : 64;
+
+	std::vector<FlightRecorder::Entry> entries;
+
+	if (!FlightRecorder::Load(argv[2], entries))
+	{
+		std::cerr << "Not a supported flight recorder dump: " << argv[2] << "\n";
+		return 1;
+	}
+
+	size_t first = entries.size() > shown ? entries.size() - shown : 0;
+
+	std::cout << entries.size() << " entries, showing the last " << entries.size() - first << ", newest last\n\n"
+		<< "      Cycles  Bk:PC    Op\n";
+
+	for (size_t i = first; i < entries.size(); ++i)
+		std::cout << FlightRecorder::FormatEntry(entries[i]) << "\n";
+
+	return 0;
+}
+
+static double RunFrames(System* system, const std::vector<unsigned char>& rom, unsigned int frames)
+{
+	system->LoadRom(rom.data(), rom.size());
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (unsigned int i = 0; i < frames && system->IsRunning(); ++i)
+		system->RunFrame();
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int Bench(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	unsigned int frames = argc > 3 ? std::stoul(argv[3]) : 600;
+
+	std::ifstream input(argv[2], std::ios::in | std::ios::binary);
+	std::vector<unsigned char> rom((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+	if (rom.empty())
+	{
+		std::cerr << "Unable to open " << argv[2] << "\n";
+		return 1;
+	}
+
+	FileLogger* logger = new FileLogger();
+	System* system = new System(logger);
+
+	system->SetRenderingEnabled(false);
+
+	std::cout << "Capacity     Seconds  Instructions   ns/instr   Overhead\n" << std::fixed;
+
+	static constexpr unsigned int capacities[] = { FlightRecorder::min_capacity, FlightRecorder::default_capacity, FlightRecorder::max_capacity };
+	static constexpr int runs = 5;
+
+	FlightRecorder* recorders[std::size(capacities)];
+
+	for (size_t i = 0; i < std::size(capacities); ++i)
+		recorders[i] = new FlightRecorder(capacities[i]);
+
+	// Configurations are interleaved and the best run of each kept, so load
+	// changes on the machine hit all of them alike
+	double baseline = 1e30;
+	double best[std::size(capacities)];
+	std::fill(std::begin(best), std::end(best), 1e30);
+
+	for (int run = 0; run < runs; ++run)
+	{
+		baseline = std::min(baseline, RunFrames(system, rom, frames));
+
+		for (size_t i = 0; i < std::size(capacities); ++i)
+		{
+			system->SetFlightRecorder(recorders[i]);
+			best[i] = std::min(best[i], RunFrames(system, rom, frames));
+			system->SetFlightRecorder(nullptr);
+		}
+	}
+
+	std::cout << std::setw(8) << "off" << std::setw(12) << std::setprecision(3) << baseline << "\n";
+
+	for (size_t i = 0; i < std::size(capacities); ++i)
+	{
+		unsigned long long instructions = recorders[i]->GetRecordedCount() / runs;
+
+		std::cout << std::setw(8) << capacities[i] << std::setw(12) << std::setprecision(3) << best[i] << std::setw(14) << instructions
+			<< std::setw(11) << std::setprecision(2) << best[i] * 1e9 / instructions << std::setw(10) << std::setprecision(1) << (best[i] / baseline - 1.0) * 100.0 << "%\n";
+
+		delete recorders[i];
+	}
+
+	delete system;
+	delete logger;
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::string mode = argv[1];
+
+	if (mode == "show")
+		return Show(argc, argv);
+	if (mode == "bench")
+		return Bench(argc, argv);
+
+	PrintUsage();
+
+	return 1;
+}
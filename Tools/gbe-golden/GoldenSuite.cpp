@@ -0,0 +1,471 @@
+#include "GoldenSuite.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "Hash.h"
+#include "PngEncoder.h"
+#include "PpuPattern.h"
+#include "Scaler.h"
+#include "ThreadPool.h"
+
+static constexpr unsigned int frame_size = System::screen_width * System::screen_height;
+
+static const std::string pattern_rom = "@ppu";
+
+GoldenSuite::GoldenSuite(FileLogger* logger)
+{
+	this->logger = logger;
+}
+
+bool GoldenSuite::ParseChecks(std::string text, std::vector<unsigned int>& checks)
+{
+	std::istringstream ss(text);
+	std::string item;
+
+	while (std::getline(ss, item, ','))
+	{
+		unsigned int first = 0;
+		unsigned int last = 0;
+		unsigned int step = 1;
+
+		// Either "<frame>", "<first>-<last>" or "<first>-<last>/<step>"
+		int fields = std::sscanf(item.c_str(), "%u-%u/%u", &first, &last, &step);
+
+		if (fields == 1)
+			last = first;
+		else if (fields < 1 || step == 0 || last < first)
+			return false;
+
+		for (unsigned int frame = first; frame <= last; frame += step)
+			checks.push_back(frame);
+	}
+
+	std::sort(checks.begin(), checks.end());
+	checks.erase(std::unique(checks.begin(), checks.end()), checks.end());
+
+	return !checks.empty() && checks.front() > 0;
+}
+
+bool GoldenSuite::IsDegenerate(const std::map<unsigned int, GoldenEntry>& entries)
+{
+	if (entries.empty())
+		return false;
+
+	const GoldenEntry& first = entries.begin()->second;
+	bool all_equal = true;
+	bool all_flat = true;
+
+	for (auto& [frame, entry] : entries)
+	{
+		// A zero exact hash is no frame at all
+		if (entry.hash == 0)
+			return true;
+
+		all_equal = all_equal && entry.hash == first.hash;
+		all_flat = all_flat && entry.perceptual == 0;
+	}
+
+	return (entries.size() > 1 && all_equal) || all_flat;
+}
+
+bool GoldenSuite::LoadScenarios(std::string path)
+{
+	std::ifstream input(path);
+
+	if (!input)
+	{
+		logger->Log<LOG_ERROR>("Unable to open golden scenarios: " + path);
+		return false;
+	}
+
+	std::string line;
+	unsigned int line_number = 0;
+
+	while (std::getline(input, line))
+	{
+		++line_number;
+
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream ss(line);
+		GoldenScenario scenario;
+		std::string checks;
+
+		if (!(ss >> scenario.name))
+			continue;
+
+		if (!(ss >> scenario.rom_path >> scenario.input_path >> scenario.frames >> checks) || !ParseChecks(checks, scenario.checks)
+			|| scenario.checks.back() > scenario.frames)
+		{
+			logger->Log<LOG_ERROR>("Malformed scenario line " + std::to_string(line_number));
+			return false;
+		}
+
+		scenario.pattern = scenario.rom_path == pattern_rom;
+
+		if (scenario.pattern && !roms.contains(scenario.rom_path))
+			BuildPpuPatternRom(roms[scenario.rom_path]);
+		else if (!roms.contains(scenario.rom_path))
+		{
+			std::ifstream rom(scenario.rom_path, std::ios::in | std::ios::binary);
+
+			if (!rom)
+			{
+				logger->Log<LOG_ERROR>("Unable to open rom: " + scenario.rom_path);
+				return false;
+			}
+
+			roms[scenario.rom_path] = std::vector<unsigned char>(std::istreambuf_iterator<char>(rom), {});
+		}
+
+		if (scenario.input_path != "-" && !inputs.contains(scenario.input_path))
+		{
+			if (!BatchRunner::ParseInputScript(scenario.input_path, inputs[scenario.input_path]))
+			{
+				logger->Log<LOG_ERROR>("Unable to parse input script: " + scenario.input_path);
+				return false;
+			}
+		}
+
+		scenarios.push_back(scenario);
+	}
+
+	// Map nodes are stable, so the scenarios can keep pointers into them
+	for (auto& scenario : scenarios)
+	{
+		scenario.rom = &roms[scenario.rom_path];
+		scenario.input = scenario.input_path == "-" ? nullptr : &inputs[scenario.input_path];
+	}
+
+	return true;
+}
+
+bool GoldenSuite::LoadManifest(std::string path)
+{
+	std::ifstream input(path);
+
+	if (!input)
+		return false;
+
+	std::string line;
+
+	while (std::getline(input, line))
+	{
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream ss(line);
+		std::string name;
+		unsigned int frame;
+		GoldenEntry entry;
+
+		if (ss >> name >> std::dec >> frame >> std::hex >> entry.hash >> entry.perceptual)
+			manifest[name][frame] = entry;
+	}
+
+	for (auto& [name, entries] : manifest)
+	{
+		if (IsDegenerate(entries))
+		{
+			logger->Log<LOG_ERROR>("Golden frames of " + name + " are all alike or blank: " + path);
+			manifest.clear();
+			return false;
+		}
+	}
+
+	manifest_loaded = true;
+
+	return true;
+}
+
+bool GoldenSuite::WriteManifest(std::string path)
+{
+	// Scenarios that ran replace their old entries, checks may have moved
+	for (size_t i = 0; i < scenarios.size(); ++i)
+	{
+		if (!results[i].ran)
+			continue;
+
+		auto& entries = manifest[scenarios[i].name];
+		entries.clear();
+
+		for (const GoldenCheck& check : results[i].checks)
+			entries[check.frame] = check.actual;
+
+		if (IsDegenerate(entries))
+		{
+			logger->Log<LOG_ERROR>("Golden frames of " + scenarios[i].name + " are all alike or blank, not writing " + path);
+			return false;
+		}
+	}
+
+	std::ofstream output(path, std::ios::out | std::ios::trunc);
+
+	if (!output)
+		return false;
+
+	output << "# scenario frame hash perceptual_hash\n" << std::setfill('0');
+
+	for (auto& [name, entries] : manifest)
+	{
+		for (auto& [frame, entry] : entries)
+			output << name << " " << std::dec << frame << " " << std::hex << std::setw(16) << entry.hash << " " << std::setw(16) << entry.perceptual << "\n";
+	}
+
+	return static_cast<bool>(output);
+}
+
+void GoldenSuite::SetFilter(std::string filter)
+{
+	this->filter = filter;
+}
+
+void GoldenSuite::SetThreshold(unsigned int bits)
+{
+	threshold = bits;
+}
+
+void GoldenSuite::SetDiffDirectory(std::string directory)
+{
+	diff_directory = directory;
+}
+
+void GoldenSuite::SetReferenceDirectory(std::string directory, bool record)
+{
+	reference_directory = directory;
+	record_references = record;
+}
+
+double GoldenSuite::Run(unsigned int thread_count)
+{
+	results.assign(scenarios.size(), GoldenResult{});
+
+	auto start = std::chrono::steady_clock::now();
+
+	{
+		ThreadPool pool(thread_count);
+
+		for (size_t i = 0; i < scenarios.size(); ++i)
+		{
+			if (scenarios[i].name.find(filter) != std::string::npos)
+				pool.Submit([this, i] { RunScenario(i); });
+		}
+
+		pool.Wait();
+	}
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void GoldenSuite::RunScenario(size_t index)
+{
+	const GoldenScenario& scenario = scenarios[index];
+	GoldenResult& result = results[index];
+
+	result.ran = true;
+	result.checks.reserve(scenario.checks.size());
+
+	auto start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::duration check_time{};
+
+	System* system = new System(logger);
+
+	system->LoadRom(scenario.rom->data(), scenario.rom->size());
+
+	if (scenario.pattern)
+		SetupPpuPattern(system);
+
+	size_t next_event = 0;
+	size_t next_check = 0;
+	unsigned int frame = 0;
+
+	// Input events apply from their frame on, like in batch runs
+	while (frame < scenario.frames && system->IsRunning())
+	{
+		while (scenario.input && next_event < scenario.input->size() && (*scenario.input)[next_event].frame <= frame)
+			system->SetJoypad((*scenario.input)[next_event++].buttons);
+
+		if (scenario.pattern)
+			UpdatePpuPattern(system, frame + 1);
+
+		system->RunFrame();
+		++frame;
+
+		if (next_check < scenario.checks.size() && scenario.checks[next_check] == frame)
+		{
+			auto check_start = std::chrono::steady_clock::now();
+
+			GoldenCheck& check = result.checks.emplace_back();
+			check.frame = frame;
+			Check(scenario, system->GetFramebuffer(), check);
+
+			check_time += std::chrono::steady_clock::now() - check_start;
+
+			++next_check;
+		}
+	}
+
+	result.completed = frame == scenario.frames;
+
+	delete system;
+
+	result.check_milliseconds = std::chrono::duration<double, std::milli>(check_time).count();
+	result.emulation_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() - result.check_milliseconds;
+}
+
+void GoldenSuite::Check(const GoldenScenario& scenario, const unsigned char* shades, GoldenCheck& check)
+{
+	check.actual.hash = HashBytes(shades, frame_size);
+	check.actual.perceptual = PerceptualHash(shades, System::screen_width, System::screen_height);
+
+	if (record_references)
+	{
+		// Four pixels per byte, first pixel in the high bits
+		unsigned char packed[frame_size / 4]{};
+
+		for (unsigned int i = 0; i < frame_size; ++i)
+			packed[i / 4] |= (shades[i] & 3) << (6 - (i % 4) * 2);
+
+		std::ofstream output(GetReferencePath(scenario.name, check.frame), std::ios::out | std::ios::binary | std::ios::trunc);
+		output.write(reinterpret_cast<const char*>(packed), sizeof(packed));
+	}
+
+	auto entries = manifest.find(scenario.name);
+
+	if (entries == manifest.end() || !entries->second.contains(check.frame))
+	{
+		check.status = Golden_New;
+		return;
+	}
+
+	const GoldenEntry& golden = entries->second.at(check.frame);
+
+	if (golden.hash == check.actual.hash)
+	{
+		check.status = Golden_Match;
+		return;
+	}
+
+	check.distance = HammingDistance(golden.perceptual, check.actual.perceptual);
+	check.status = check.distance <= threshold ? Golden_Near : Golden_Mismatch;
+
+	if (!diff_directory.empty())
+		check.diff_path = WriteDiff(scenario, check.frame, shades);
+}
+
+std::string GoldenSuite::GetReferencePath(const std::string& name, unsigned int frame)
+{
+	char number[24];
+	std::snprintf(number, sizeof(number), "_%08u.2bpp", frame);
+
+	return reference_directory + "/" + name + number;
+}
+
+std::string GoldenSuite::WriteDiff(const GoldenScenario& scenario, unsigned int frame, const unsigned char* shades)
+{
+	static constexpr unsigned int width = System::screen_width;
+	static constexpr unsigned int height = System::screen_height;
+	static constexpr unsigned int gap = 4;
+
+	// Shades, the same shades faded for unchanged pixels, red, and the gap
+	static constexpr unsigned int color_red = 8;
+	static constexpr unsigned int color_gap = 9;
+
+	unsigned int colors[10];
+
+	for (unsigned int shade = 0; shade < 4; ++shade)
+	{
+		unsigned int color = Scaler::default_palette[shade];
+		unsigned int level = color & 0xFF;
+		unsigned int faded = 0xFF - (0xFF - level) / 4;
+
+		colors[shade] = color;
+		colors[4 + shade] = 0xFF000000 | (faded << 16) | (faded << 8) | faded;
+	}
+
+	colors[color_red] = 0xFFFF0000;
+	colors[color_gap] = 0xFF4060A0;
+
+	// Without the golden frame only the actual one can be shown
+	unsigned char golden[frame_size];
+	bool has_golden = false;
+
+	if (!reference_directory.empty() && !record_references)
+	{
+		unsigned char packed[frame_size / 4];
+		std::ifstream input(GetReferencePath(scenario.name, frame), std::ios::in | std::ios::binary);
+
+		if (input.read(reinterpret_cast<char*>(packed), sizeof(packed)))
+		{
+			for (unsigned int i = 0; i < frame_size; ++i)
+				golden[i] = (packed[i / 4] >> (6 - (i % 4) * 2)) & 3;
+
+			has_golden = true;
+		}
+	}
+
+	unsigned int image_width = has_golden ? width * 3 + gap * 2 : width;
+	std::vector<unsigned char> indices(image_width * height, color_gap);
+
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		const unsigned char* actual_row = shades + y * width;
+		unsigned char* row = indices.data() + y * image_width;
+
+		if (!has_golden)
+		{
+			std::copy(actual_row, actual_row + width, row);
+			continue;
+		}
+
+		const unsigned char* golden_row = golden + y * width;
+
+		std::copy(golden_row, golden_row + width, row);
+		std::copy(actual_row, actual_row + width, row + width + gap);
+
+		unsigned char* diff_row = row + (width + gap) * 2;
+
+		for (unsigned int x = 0; x < width; ++x)
+			diff_row[x] = golden_row[x] == actual_row[x] ? static_cast<unsigned char>(4 + actual_row[x]) : static_cast<unsigned char>(color_red);
+	}
+
+	// Mismatches are rare, an encoder per worker thread is plenty
+	thread_local PngEncoder encoder;
+	std::vector<unsigned char> png;
+
+	encoder.EncodeIndexed(indices.data(), image_width, height, colors, has_golden ? 10 : 4, png);
+
+	char number[24];
+	std::snprintf(number, sizeof(number), "_%08u.png", frame);
+
+	std::string path = diff_directory + "/" + scenario.name + number;
+	std::ofstream output(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	output.write(reinterpret_cast<const char*>(png.data()), png.size());
+
+	if (!output)
+	{
+		logger->Log<LOG_ERROR>("Unable to write diff image: " + path);
+		return "";
+	}
+
+	return path;
+}
+
+const std::vector<GoldenScenario>& GoldenSuite::GetScenarios()
+{
+	return scenarios;
+}
+
+const std::vector<GoldenResult>& GoldenSuite::GetResults()
+{
+	return results;
+}
+
+bool GoldenSuite::HasManifest()
+{
+	return manifest_loaded;
+}
\ No newline at end of file
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "BatchRunner.h"
+#include "FileLogger.h"
+#include "System.h"
+
+// A ROM played for a number of frames with an optional input script, and
+// the frames (counted from 1, after that many RunFrame calls) whose image
+// is checked against the golden manifest.
+struct GoldenScenario
+{
+	std::string name;
+	std::string rom_path;
+	std::string input_path;
+	unsigned int frames{};
+	std::vector<unsigned int> checks;
+
+	const std::vector<unsigned char>* rom{};
+	const std::vector<InputEvent>* input{};
+	// Plays the built-in PPU pattern, the rom is @ppu
+	bool pattern = false;
+};
+
+struct GoldenEntry
+{
+	unsigned long long hash{};
+	unsigned long long perceptual{};
+};
+
+enum GoldenStatus
+{
+	Golden_Match,
+	// Exact hash differs, perceptual hash within the threshold
+	Golden_Near,
+	Golden_Mismatch,
+	// No golden entry for the frame
+	Golden_New
+};
+
+struct GoldenCheck
+{
+	unsigned int frame{};
+	GoldenEntry actual;
+	GoldenStatus status = Golden_New;
+	unsigned int distance{};
+	// Diff image written for the frame, empty when none was
+	std::string diff_path;
+};
+
+struct GoldenResult
+{
+	// False for scenarios left out by the filter
+	bool ran = false;
+	bool completed = false;
+	std::vector<GoldenCheck> checks;
+	double emulation_milliseconds{};
+	double check_milliseconds{};
+};
+
+// Visual regression suite for the PPU. Every scenario runs headless in its
+// own System on a thread pool. Checked frames are hashed twice, exactly with
+// HashBytes and perceptually with PerceptualHash, and compared against the
+// golden manifest as they are produced; hashing a frame costs microseconds,
+// next to the milliseconds of emulating it.
+//
+// Scenario lines are "<name> <rom> <input script|-> <frames> <checks>", where
+// checks is a comma separated list of frames and first-last/step ranges
+// (60,120 or 30-600/30). A rom of @ppu plays the built-in PPU pattern, see
+// PpuPattern.h. Manifest lines are "<name> <frame> <hash> <perceptual hash>"
+// in hex. '#' starts a comment in both.
+//
+// A scenario whose golden frames are all the same image, or all a single
+// shade, cannot catch a regression. Such manifests are neither loaded nor
+// written.
+//
+// Frames are only kept for mismatches. When a reference directory is set the
+// exact golden frames are stored there (2 bits per pixel), and diff images
+// show the golden frame, the actual one and the differing pixels in red.
+class GoldenSuite
+{
+public:
+	GoldenSuite(FileLogger* logger);
+
+	bool LoadScenarios(std::string path);
+	// False when the file is missing or a scenario's entries are degenerate
+	bool LoadManifest(std::string path);
+	// Entries of scenarios that did not run are kept from the loaded manifest,
+	// false without writing when a scenario's entries are degenerate
+	bool WriteManifest(std::string path);
+
+	// Only scenarios whose name contains the text are run
+	void SetFilter(std::string filter);
+	// Exact mismatches within this many perceptual hash bits count as near
+	void SetThreshold(unsigned int bits);
+	// Writes <directory>/<name>_<frame>.png for every frame that is not a match
+	void SetDiffDirectory(std::string directory);
+	// Golden frames are read from the directory, or written to it when
+	// recording a new manifest
+	void SetReferenceDirectory(std::string directory, bool record);
+
+	// Returns the wall clock time of the whole suite in seconds
+	double Run(unsigned int thread_count);
+
+	const std::vector<GoldenScenario>& GetScenarios();
+	const std::vector<GoldenResult>& GetResults();
+	bool HasManifest();
+
+private:
+	void RunScenario(size_t index);
+	void Check(const GoldenScenario& scenario, const unsigned char* shades, GoldenCheck& check);
+	std::string WriteDiff(const GoldenScenario& scenario, unsigned int frame, const unsigned char* shades);
+	std::string GetReferencePath(const std::string& name, unsigned int frame);
+
+	static bool ParseChecks(std::string text, std::vector<unsigned int>& checks);
+	static bool IsDegenerate(const std::map<unsigned int, GoldenEntry>& entries);
+
+	std::vector<GoldenScenario> scenarios;
+	std::vector<GoldenResult> results;
+
+	// Loaded once and shared read-only by all scenarios
+	std::map<std::string, std::vector<unsigned char>> roms;
+	std::map<std::string, std::vector<InputEvent>> inputs;
+	std::map<std::string, std::map<unsigned int, GoldenEntry>> manifest;
+	bool manifest_loaded = false;
+
+	std::string filter;
+	unsigned int threshold{};
+	std::string diff_directory;
+	std::string reference_directory;
+	bool record_references = false;
+
+	FileLogger* logger;
+};
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "PpuPattern.h"
+
+static constexpr unsigned int tile_count = 8;
+static constexpr unsigned int map_size = 32 * 32;
+
+static void SetRegister(System* system, unsigned short address, unsigned char value)
+{
+	system->WriteMemoryBlock(address, 1, &value);
+}
+
+static void BuildTiles(unsigned char* tiles)
+{
+	for (unsigned int row = 0; row < 8; ++row)
+	{
+		unsigned char* tile = tiles + row * 2;
+
+		// 0 is blank, 1 solid shade 3
+		tile[1 * 16] = 0xFF;
+		tile[1 * 16 + 1] = 0xFF;
+
+		// 2 is a checkerboard of shades 0 and 1
+		tile[2 * 16] = (row / 2) % 2 == 0 ? 0xCC : 0x33;
+
+		// 3 is a diagonal line of shade 2 on shade 1
+		tile[3 * 16] = static_cast<unsigned char>(~(0x80 >> row));
+		tile[3 * 16 + 1] = static_cast<unsigned char>(0x80 >> row);
+
+		// 4 is a box of shade 2
+		tile[4 * 16 + 1] = row == 0 || row == 7 ? 0xFF : 0x81;
+
+		// 5 is a left to right ramp through all four shades
+		tile[5 * 16] = 0x33;
+		tile[5 * 16 + 1] = 0x0F;
+
+		// 6 is a sprite arrow pointing right, shade 3 edge on shade 1, transparent around it
+		static constexpr unsigned char arrow[8] = { 0xC0, 0xF0, 0xFC, 0xFF, 0xFF, 0xFC, 0xF0, 0xC0 };
+		tile[6 * 16] = arrow[row];
+		tile[6 * 16 + 1] = static_cast<unsigned char>(arrow[row] & 0xC3);
+
+		// 7 is a sprite ring of shade 3 with a shade 1 centre
+		static constexpr unsigned char ring[8] = { 0x3C, 0x42, 0x81, 0x81, 0x81, 0x81, 0x42, 0x3C };
+		static constexpr unsigned char centre[8] = { 0x00, 0x3C, 0x7E, 0x7E, 0x7E, 0x7E, 0x3C, 0x00 };
+		tile[7 * 16] = ring[row] | centre[row];
+		tile[7 * 16 + 1] = ring[row];
+	}
+}
+
+void BuildPpuPatternRom(std::vector<unsigned char>& rom)
+{
+	// JP 0000, the same address whichever byte order the operand is read in
+	rom.assign(0x8000, 0);
+	rom[0] = 0xC3;
+}
+
+void SetupPpuPattern(System* system)
+{
+	unsigned char tiles[tile_count * 16]{};
+	unsigned char inverted[tile_count * 16];
+	unsigned char background[map_size];
+	unsigned char window[map_size];
+
+	BuildTiles(tiles);
+
+	for (unsigned int i = 0; i < sizeof(tiles); ++i)
+		inverted[i] = static_cast<unsigned char>(~tiles[i]);
+
+	for (unsigned int y = 0; y < 32; ++y)
+	{
+		for (unsigned int x = 0; x < 32; ++x)
+		{
+			// Two by two blocks of the six background tiles, no two rows alike
+			background[y * 32 + x] = static_cast<unsigned char>((x / 2 + (y / 2) * 3 + (x * y) % 5) % 6);
+
+			// A bordered panel
+			window[y * 32 + x] = static_cast<unsigned char>(y == 0 || x == 0 || x == 19 ? 4 : (x + y) % 2 == 0 ? 5 : 1);
+		}
+	}
+
+	// Y, X, tile, attributes: flips, the second palette and background priority
+	static constexpr unsigned char sprites[][4] =
+	{
+		{ 40, 8, 6, 0x00 },
+		{ 140, 60, 7, 0x10 },
+		{ 60, 80, 6, 0x20 },
+		{ 60, 84, 7, 0x00 },
+		{ 100, 120, 6, 0x40 },
+		{ 110, 30, 7, 0x80 },
+		{ 120, 150, 6, 0x30 },
+		{ 80, 50, 7, 0x90 },
+	};
+
+	system->WriteMemoryBlock(0x8000, sizeof(tiles), tiles);
+	system->WriteMemoryBlock(0x9000, sizeof(inverted), inverted);
+	system->WriteMemoryBlock(0x9800, map_size, background);
+	system->WriteMemoryBlock(0x9C00, map_size, window);
+	system->WriteMemoryBlock(0xFE00, sizeof(sprites), &sprites[0][0]);
+
+	SetRegister(system, 0xFF47, 0xE4);
+	SetRegister(system, 0xFF48, 0xD2);
+	SetRegister(system, 0xFF49, 0x1B);
+
+	UpdatePpuPattern(system, 1);
+}
+
+void UpdatePpuPattern(System* system, unsigned int frame)
+{
+	// LCD, window map at 9C00, tiles at 8000, sprites and background on
+	unsigned char lcdc = 0xD3;
+
+	if ((frame / 64) % 2 == 1)
+		lcdc |= 0x20;
+	if ((frame / 96) % 3 == 2)
+		lcdc |= 0x04;
+	if ((frame / 256) % 2 == 1)
+		lcdc &= ~0x10;
+
+	SetRegister(system, 0xFF40, lcdc);
+	SetRegister(system, 0xFF42, static_cast<unsigned char>(frame / 2));
+	SetRegister(system, 0xFF43, static_cast<unsigned char>(frame));
+	SetRegister(system, 0xFF4A, static_cast<unsigned char>(80 + frame % 32));
+	SetRegister(system, 0xFF4B, static_cast<unsigned char>(7 + (frame / 2) % 64));
+
+	// Every 128 frames each shade moves one palette entry along
+	unsigned int shift = (frame / 128) % 4 * 2;
+	SetRegister(system, 0xFF47, static_cast<unsigned char>((0xE4 << shift | 0xE4 >> (8 - shift)) & 0xFF));
+
+	// The first sprite crosses the screen to the right, the second upwards
+	SetRegister(system, 0xFE01, static_cast<unsigned char>(8 + frame % 168));
+	SetRegister(system, 0xFE04, static_cast<unsigned char>(160 - frame % 176));
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <vector>
+
+#include "System.h"
+
+// Built-in test pattern for the golden suite, played by scenarios whose rom
+// is @ppu. The bundled games never turn the LCD on in this core, so the
+// pattern drives the PPU from the host instead: the ROM only loops on
+// JP 0000 with interrupts off, and the tiles, maps, sprites and LCD
+// registers are written between frames with WriteMemoryBlock.
+//
+// Every frame scrolls the background and moves two sprites. The window,
+// 8x16 sprites, the signed tile area (holding inverted tiles) and a
+// rotated background palette each switch on for part of a longer cycle, so
+// over a few hundred frames every RenderLine path draws something.
+void BuildPpuPatternRom(std::vector<unsigned char>& rom);
+// Writes the tiles, maps and sprite table and turns the LCD on, after LoadRom
+void SetupPpuPattern(System* system);
+// Sets the registers for the frame, counted from 1, before it runs
+void UpdatePpuPattern(System* system, unsigned int frame);
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "FileLogger.h"
+#include "GoldenSuite.h"
+
+// Runs the golden-image scenarios and reports frames whose image no longer
+// matches the manifest. golden.txt next to this file records the core as it
+// is, so a PPU change shows exactly which frames it touched. Run from the
+// repository root, scenario paths are relative to it.
+
+static void PrintUsage()
+{
+	std::cout << "Usage: gbe-golden [options]\n"
+		<< "  -s <file>                Scenarios (default: Tools/gbe-golden/scenarios.txt)\n"
+		<< "  -m <file>                Golden manifest (default: Tools/gbe-golden/golden.txt)\n"
+		<< "  -j <threads>             Worker threads (default: all cores)\n"
+		<< "  --filter <text>          Only run scenarios whose name contains text\n"
+		<< "  --threshold <bits>       Perceptual distance still reported as near, not failed (default: 0)\n"
+		<< "  --diff <directory>       Diff images for mismatches (default: golden-diff)\n"
+		<< "  --references <directory> Golden frames to draw diffs against\n"
+		<< "  --write                  Record the results as the new manifest, and the\n"
+		<< "                           frames into the reference directory if one is given\n";
+}
+
+int main(int argc, char** argv)
+{
+	std::string scenarios_path = "Tools/gbe-golden/scenarios.txt";
+	std::string manifest_path = "Tools/gbe-golden/golden.txt";
+	std::string diff_directory = "golden-diff";
+	std::string reference_directory;
+	std::string filter;
+	unsigned int threshold = 0;
+	unsigned int thread_count = std::thread::hardware_concurrency();
+	bool write = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "-s" && i + 1 < argc)
+			scenarios_path = argv[++i];
+		else if (arg == "-m" && i + 1 < argc)
+			manifest_path = argv[++i];
+		else if (arg == "-j" && i + 1 < argc)
+			thread_count = std::stoul(argv[++i]);
+		else if (arg == "--filter" && i + 1 < argc)
+			filter = argv[++i];
+		else if (arg == "--threshold" && i + 1 < argc)
+			threshold = std::stoul(argv[++i]);
+		else if (arg == "--diff" && i + 1 < argc)
+			diff_directory = argv[++i];
+		else if (arg == "--references" && i + 1 < argc)
+			reference_directory = argv[++i];
+		else if (arg == "--write")
+			write = true;
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (thread_count == 0)
+		thread_count = 1;
+
+	FileLogger* logger = new FileLogger();
+	GoldenSuite* suite = new GoldenSuite(logger);
+
+	if (!suite->LoadScenarios(scenarios_path))
+	{
+		std::cerr << "Unable to load scenarios " << scenarios_path << ", see debug.log\n";
+
+		delete suite;
+		delete logger;
+
+		return 1;
+	}
+
+	// A missing or degenerate manifest is fine when recording a new one
+	if (!suite->LoadManifest(manifest_path) && !write)
+	{
+		std::cerr << "Unable to load manifest " << manifest_path << ", see debug.log\n";
+
+		delete suite;
+		delete logger;
+
+		return 1;
+	}
+
+	std::error_code error;
+
+	if (!reference_directory.empty())
+	{
+		if (write)
+			std::filesystem::create_directories(reference_directory, error);
+
+		suite->SetReferenceDirectory(reference_directory, write);
+	}
+
+	if (!write)
+	{
+		std::filesystem::create_directories(diff_directory, error);
+		suite->SetDiffDirectory(diff_directory);
+	}
+
+	suite->SetFilter(filter);
+	suite->SetThreshold(threshold);
+
+	double seconds = suite->Run(thread_count);
+
+	const auto& scenarios = suite->GetScenarios();
+	const auto& results = suite->GetResults();
+
+	size_t checked = 0;
+	size_t matched = 0;
+	size_t near_matched = 0;
+	size_t mismatched = 0;
+	size_t added = 0;
+	size_t incomplete = 0;
+	double emulation_milliseconds = 0.0;
+	double check_milliseconds = 0.0;
+
+	for (size_t i = 0; i < scenarios.size(); ++i)
+	{
+		const GoldenResult& result = results[i];
+
+		if (!result.ran)
+			continue;
+
+		emulation_milliseconds += result.emulation_milliseconds;
+		check_milliseconds += result.check_milliseconds;
+
+		// A stopped core never reaches the later checks
+		if (!result.completed)
+		{
+			std::cout << "Incomplete: " << scenarios[i].name << " stopped after " << result.checks.size() << " of " << scenarios[i].checks.size() << " checks\n";
+			++incomplete;
+		}
+
+		for (const GoldenCheck& check : result.checks)
+		{
+			++checked;
+
+			switch (check.status)
+			{
+			case Golden_Match:
+				++matched;
+				continue;
+			case Golden_New:
+				++added;
+				continue;
+			case Golden_Near:
+				std::cout << "Near:     ";
+				++near_matched;
+				break;
+			case Golden_Mismatch:
+				std::cout << "Mismatch: ";
+				++mismatched;
+				break;
+			}
+
+			std::cout << scenarios[i].name << " frame " << check.frame << ", perceptual distance " << check.distance;
+
+			if (!check.diff_path.empty())
+				std::cout << " -> " << check.diff_path;
+
+			std::cout << "\n";
+		}
+	}
+
+	std::cout << checked << " frames checked: " << matched << " match, " << near_matched << " near, " << mismatched << " mismatch";
+
+	if (added > 0)
+		std::cout << ", " << added << " not in the manifest";
+
+	std::cout << "\n" << std::fixed << std::setprecision(3) << seconds << "s on " << thread_count << " threads, "
+		<< std::setprecision(1) << emulation_milliseconds << " ms emulating, " << std::setprecision(3) << check_milliseconds << " ms checking ("
+		<< std::setprecision(2) << (emulation_milliseconds > 0.0 ? check_milliseconds / emulation_milliseconds * 100.0 : 0.0) << "%)\n";
+
+	bool written = false;
+
+	if (write)
+	{
+		written = suite->WriteManifest(manifest_path);
+
+		if (written)
+			std::cout << "Wrote " << manifest_path << "\n";
+		else
+			std::cerr << "Unable to write manifest " << manifest_path << ", see debug.log\n";
+	}
+
+	delete suite;
+	delete logger;
+
+	if (write)
+		return written ? 0 : 1;
+
+	return mismatched > 0 || incomplete > 0 ? 2 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+#include "HashLog.h"
+
+// Compares two per-frame state hash logs and reports the first frame where
+// they diverge, with a few frames of context around it.
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::cout << "Usage: gbe-hashcmp <log a> <log b> [context frames=3]\n";
+		return 1;
+	}
+
+	size_t context = argc > 3 ? std::stoul(argv[3]) : 3;
+
+	FileLogger* logger = new FileLogger();
+	HashLog* log_a = new HashLog(logger);
+	HashLog* log_b = new HashLog(logger);
+
+	int result = 1;
+
+	if (!log_a->Load(argv[1]) || !log_b->Load(argv[2]))
+		std::cerr << "Unable to load hash logs, see debug.log\n";
+	else
+	{
+		const std::vector<unsigned long long>& a = log_a->GetHashes();
+		const std::vector<unsigned long long>& b = log_b->GetHashes();
+
+		if (log_a->GetRomHash() != log_b->GetRomHash())
+			std::cout << "Warning: the logs were recorded with different roms\n";
+
+		size_t frame = HashLog::FindDivergence(a, b);
+
+		if (frame == a.size() && frame == b.size())
+		{
+			std::cout << "Identical, " << frame << " frames\n";
+			result = 0;
+		}
+		else if (frame == a.size() || frame == b.size())
+		{
+			std::cout << "Identical for " << frame << " frames, then " << (frame == a.size() ? argv[1] : argv[2]) << " ends ("
+				<< a.size() << " vs " << b.size() << " frames)\n";
+			result = 0;
+		}
+		else
+		{
+			std::cout << "First divergence at frame " << frame << "\n\n"
+				<< "   Frame  " << std::setw(16) << "A" << "  " << std::setw(16) << "B" << "\n";
+
+			size_t first = frame > context ? frame - context : 0;
+
+			for (size_t i = first; i <= frame + context && i < a.size() && i < b.size(); ++i)
+			{
+				std::cout << std::setw(8) << std::dec << std::setfill(' ') << i << "  " << std::hex << std::setfill('0')
+					<< std::setw(16) << a[i] << "  " << std::setw(16) << b[i] << (a[i] != b[i] ? "  *" : "") << "\n";
+			}
+
+			result = 2;
+		}
+	}
+
+	delete log_b;
+	delete log_a;
+	delete logger;
+
+	return result;
+}
@@ -0,0 +1,120 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+#include "LockstepEngine.h"
+#include "System.h"
+
+// Compares the lockstep engine against running the same instances one after
+// another on a single core, with a different random input schedule per instance.
+
+static unsigned char LaneInput(unsigned int lane, unsigned int frame, unsigned int seed)
+{
+	// Lane 0 never presses anything, the others pick new buttons every 30 frames
+	if (lane == 0)
+		return 0;
+
+	std::mt19937 random(seed * 7919 + lane * 104729 + frame / 30);
+
+	return static_cast<unsigned char>(random() & 0xFF);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: gbe-lockstep <rom> [lanes=16] [frames=600] [seed=1]\n";
+		return 1;
+	}
+
+	std::string rom_path = argv[1];
+	unsigned int lanes = argc > 2 ? std::stoul(argv[2]) : LockstepEngine::max_lanes;
+	unsigned int frames = argc > 3 ? std::stoul(argv[3]) : 600;
+	unsigned int seed = argc > 4 ? std::stoul(argv[4]) : 1;
+
+	if (lanes == 0 || lanes > LockstepEngine::max_lanes)
+		lanes = LockstepEngine::max_lanes;
+
+	std::ifstream rom_file(rom_path, std::ios::in | std::ios::binary);
+
+	if (!rom_file)
+	{
+		std::cerr << "Unable to open " << rom_path << "\n";
+		return 1;
+	}
+
+	std::vector<unsigned char> rom(std::istreambuf_iterator<char>(rom_file), {});
+
+	FileLogger* logger = new FileLogger();
+
+	// Independent instances, one after another
+	std::vector<unsigned long long> independent_hashes;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (unsigned int lane = 0; lane < lanes; ++lane)
+	{
+		System* system = new System(logger);
+		system->LoadRom(rom.data(), rom.size());
+
+		for (unsigned int frame = 0; frame < frames; ++frame)
+		{
+			system->SetJoypad(LaneInput(lane, frame, seed));
+			system->RunFrame();
+		}
+
+		independent_hashes.push_back(system->GetStateHash());
+
+		delete system;
+	}
+
+	double independent_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// Lockstep
+	LockstepEngine* engine = new LockstepEngine(logger, lanes);
+	engine->LoadRom(rom.data(), rom.size());
+
+	start = std::chrono::steady_clock::now();
+
+	for (unsigned int frame = 0; frame < frames; ++frame)
+	{
+		for (unsigned int lane = 0; lane < lanes; ++lane)
+			engine->SetJoypad(lane, LaneInput(lane, frame, seed));
+
+		engine->RunFrame();
+	}
+
+	double lockstep_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	unsigned int mismatches = 0;
+
+	for (unsigned int lane = 0; lane < lanes; ++lane)
+	{
+		if (engine->GetSystem(lane)->GetStateHash() != independent_hashes[lane])
+			++mismatches;
+	}
+
+	unsigned long long instructions = engine->GetLaneInstructions();
+	unsigned long long vector_steps = engine->GetVectorSteps();
+	unsigned long long scalar_steps = engine->GetScalarSteps();
+	unsigned long long steps = vector_steps + scalar_steps;
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << lanes << " lanes, " << frames << " frames, " << instructions << " instructions\n";
+	std::cout << "Independent:  " << std::setw(8) << independent_seconds << "s  " << std::setw(10) << instructions / independent_seconds / 1e6 << " M instructions/s\n";
+	std::cout << "Lockstep:     " << std::setw(8) << lockstep_seconds << "s  " << std::setw(10) << instructions / lockstep_seconds / 1e6 << " M instructions/s\n";
+	std::cout << "Speedup:      " << independent_seconds / lockstep_seconds << "x\n";
+	std::cout << "Vector steps: " << vector_steps << " (" << 100.0 * vector_steps * lanes / instructions << "% of instructions)\n";
+	std::cout << "Divergence:   " << 100.0 * engine->GetDivergentSteps() / steps << "% of steps had lanes at different PCs\n";
+	std::cout << "State check:  " << (mismatches == 0 ? "all lanes match independent runs" : std::to_string(mismatches) + " lanes differ") << "\n";
+
+	delete engine;
+	delete logger;
+
+	return mismatches == 0 ? 0 : 2;
+}
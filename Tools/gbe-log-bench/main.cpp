@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FileLogger.h"
+
+// Measures FileLogger throughput and the time a Log call takes on the calling
+// thread, with 1..N threads logging the same kind of message as the unknown
+// opcode warning in System::ExecuteOpcode.
+
+// Log calls with several arguments from several threads at once must neither
+// block each other for good nor lose messages when the queue has room. Run
+// on detached threads so a deadlock fails the check instead of hanging it.
+static bool CheckConcurrentLog(FileLogger* logger)
+{
+	static constexpr unsigned int thread_count = 4;
+	static constexpr unsigned int calls = 256;
+
+	auto finished = std::make_shared<std::atomic<unsigned int>>(0);
+
+	unsigned long long dropped_before = logger->GetDroppedCount();
+
+	for (unsigned int t = 0; t < thread_count; ++t)
+	{
+		std::thread([logger, finished, t]()
+		{
+			for (unsigned int i = 0; i < calls; ++i)
+				logger->Log<LOG_INFO>("Log check ", t, ": ", i, " of ", calls);
+
+			finished->fetch_add(1, std::memory_order_release);
+		}).detach();
+	}
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+	while (finished->load(std::memory_order_acquire) < thread_count)
+	{
+		if (std::chrono::steady_clock::now() > deadline)
+		{
+			std::cerr << "Log calls from " << thread_count << " threads did not finish, the logger deadlocked\n";
+			return false;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	logger->Flush();
+
+	// thread_count * calls stays below the queue size, nothing may be dropped
+	if (logger->GetDroppedCount() != dropped_before)
+	{
+		std::cerr << "Log calls were dropped with room left in the queue\n";
+		return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int calls = argc > 1 ? std::stoul(argv[1]) : 200000;
+	unsigned int max_threads = argc > 2 ? std::stoul(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+
+	FileLogger* logger = new FileLogger();
+
+	if (!CheckConcurrentLog(logger))
+	{
+		// A deadlocked logger cannot be destroyed
+		std::quick_exit(2);
+	}
+
+	std::cout << "Threads     Calls/s   p50 ns   p99 ns   max ns    Dropped\n" << std::fixed;
+
+	for (unsigned int thread_count = 1; thread_count <= max_threads; thread_count *= 2)
+	{
+		std::vector<std::vector<unsigned int>> latencies(thread_count, std::vector<unsigned int>(calls));
+		std::vector<std::thread> threads;
+
+		unsigned long long dropped_before = logger->GetDroppedCount();
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int t = 0; t < thread_count; ++t)
+		{
+			threads.emplace_back([&, t]()
+			{
+				for (unsigned int i = 0; i < calls; ++i)
+				{
+					auto call_start = std::chrono::steady_clock::now();
+
+					logger->Log<LOG_WARNING>("Unknown opcode: ", i & 0xFF, " at PC ", i, " thread ", t);
+
+					latencies[t][i] = static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - call_start).count());
+				}
+			});
+		}
+
+		for (auto& thread : threads)
+			thread.join();
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		logger->Flush();
+
+		std::vector<unsigned int> all;
+
+		for (auto& thread_latencies : latencies)
+			all.insert(all.end(), thread_latencies.begin(), thread_latencies.end());
+
+		std::sort(all.begin(), all.end());
+
+		std::cout << std::setw(7) << thread_count << std::setw(12) << std::setprecision(0) << all.size() / seconds
+			<< std::setw(9) << all[all.size() / 2] << std::setw(9) << all[all.size() * 99 / 100] << std::setw(9) << all.back()
+			<< std::setw(11) << logger->GetDroppedCount() - dropped_before << "\n";
+	}
+
+	delete logger;
+
+	return 0;
+}
@@ -0,0 +1,60 @@
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+
+// Turns a binary log record file, written by a FileLogger given a record path,
+// into the text debug.log would have held, prefixed with the time since the
+// first record.
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: gbe-logdecode <records>\n";
+		return 1;
+	}
+
+	std::ifstream input(argv[1], std::ios::in | std::ios::binary);
+
+	char magic[4]{};
+	unsigned int version = 0;
+
+	input.read(magic, sizeof(magic));
+	input.read(reinterpret_cast<char*>(&version), sizeof(version));
+
+	if (!input || std::memcmp(magic, FileLogger::record_file_magic, sizeof(magic)) != 0 || version != FileLogger::record_file_version)
+	{
+		std::cerr << "Not a supported log record file: " << argv[1] << "\n";
+		return 1;
+	}
+
+	std::vector<LogRecord> records(4096);
+	unsigned long long first_timestamp = 0;
+	unsigned long long count = 0;
+
+	std::cout << std::fixed << std::setprecision(6);
+
+	while (input)
+	{
+		input.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(LogRecord));
+
+		size_t read = static_cast<size_t>(input.gcount()) / sizeof(LogRecord);
+
+		for (size_t i = 0; i < read; ++i, ++count)
+		{
+			if (count == 0)
+				first_timestamp = records[i].timestamp;
+
+			std::cout << std::setw(12) << (records[i].timestamp - first_timestamp) / 1e9 << "  " << FileLogger::FormatRecord(records[i]) << "\n";
+		}
+	}
+
+	std::cerr << count << " records\n";
+
+	return 0;
+}
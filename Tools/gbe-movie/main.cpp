@@ -0,0 +1,215 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "BatchRunner.h"
+#include "FileLogger.h"
+#include "HashLog.h"
+#include "Movie.h"
+#include "System.h"
+
+// Headless movie tool: records a movie from an input script, plays one back
+// and checks it ends on the recorded state, or times a seek.
+
+static void PrintUsage()
+{
+	std::cout << "Usage:\n"
+		<< "  gbe-movie record <rom> <input script|-> <frames> <movie> [keyframe interval]\n"
+		<< "  gbe-movie play <rom> <movie>\n"
+		<< "  gbe-movie seek <rom> <movie> <frame> [--verify]\n"
+		<< "Record and play take --hash-log <file> to write the state hash of every frame.\n";
+}
+
+static double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int Record(System* system, Movie* movie, HashLog* hash_log, int argc, char** argv)
+{
+	if (argc < 6)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::string input_path = argv[3];
+	unsigned int frames = std::stoul(argv[4]);
+	std::string movie_path = argv[5];
+	unsigned int interval = argc > 6 ? std::stoul(argv[6]) : Movie::default_keyframe_interval;
+
+	std::vector<InputEvent> events;
+
+	if (input_path != "-" && !BatchRunner::ParseInputScript(input_path, events))
+	{
+		std::cerr << "Unable to parse input script " << input_path << "\n";
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	size_t next_event = 0;
+
+	movie->StartRecording(system, interval);
+
+	for (unsigned int frame = 0; frame < frames && system->IsRunning(); ++frame)
+	{
+		while (next_event < events.size() && events[next_event].frame <= frame)
+			system->SetJoypad(events[next_event++].buttons);
+
+		movie->RecordFrame(system);
+		hash_log->Append(system->GetStateHash());
+	}
+
+	movie->StopRecording(system);
+
+	double seconds = SecondsSince(start);
+
+	if (!movie->Save(movie_path))
+	{
+		std::cerr << "Unable to write " << movie_path << "\n";
+		return 1;
+	}
+
+	std::cout << "Recorded " << movie->GetFrameCount() << " frames with " << movie->GetKeyframeCount() << " keyframes in "
+		<< std::fixed << std::setprecision(3) << seconds << "s, final hash " << std::hex << movie->GetFinalHash() << "\n";
+
+	return 0;
+}
+
+static int Play(System* system, Movie* movie, HashLog* hash_log)
+{
+	if (!movie->StartPlayback(system))
+		return 1;
+
+	auto start = std::chrono::steady_clock::now();
+
+	while (movie->PlayFrame(system))
+		hash_log->Append(system->GetStateHash());
+
+	double seconds = SecondsSince(start);
+	unsigned long long hash = system->GetStateHash();
+
+	std::cout << "Played " << movie->GetFrameCount() << " frames in " << std::fixed << std::setprecision(3) << seconds << "s ("
+		<< std::setprecision(1) << movie->GetFrameCount() / seconds << " frames/s)\n";
+
+	if (hash != movie->GetFinalHash())
+	{
+		std::cout << "DESYNC: final hash " << std::hex << hash << ", recorded " << movie->GetFinalHash() << "\n";
+		return 2;
+	}
+
+	std::cout << "Final hash matches " << std::hex << hash << "\n";
+
+	return 0;
+}
+
+static int Seek(System* system, Movie* movie, int argc, char** argv)
+{
+	if (argc < 5)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	unsigned int frame = std::stoul(argv[4]);
+	bool verify = argc > 5 && std::string(argv[5]) == "--verify";
+
+	if (!movie->StartPlayback(system))
+		return 1;
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (!movie->Seek(system, frame))
+	{
+		std::cerr << "Frame " << frame << " is past the end of the movie (" << movie->GetFrameCount() << " frames)\n";
+		return 1;
+	}
+
+	double seconds = SecondsSince(start);
+	unsigned long long hash = system->GetStateHash();
+
+	std::cout << "Seek to frame " << frame << " took " << std::fixed << std::setprecision(2) << seconds * 1000.0 << "ms, state hash "
+		<< std::hex << hash << std::dec << "\n";
+
+	if (verify)
+	{
+		// Replay from the start and compare against the state Seek produced
+		movie->StartPlayback(system);
+
+		while (movie->GetPosition() < frame)
+			movie->PlayFrame(system);
+
+		if (system->GetStateHash() != hash)
+		{
+			std::cout << "MISMATCH: linear playback reached " << std::hex << system->GetStateHash() << "\n";
+			return 2;
+		}
+
+		std::cout << "Matches linear playback\n";
+	}
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::string mode = argv[1];
+	std::string hash_log_path;
+
+	// Pull out the shared option so the modes only see their positional arguments
+	for (int i = 2; i + 1 < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--hash-log")
+		{
+			hash_log_path = argv[i + 1];
+
+			for (int j = i; j + 2 < argc; ++j)
+				argv[j] = argv[j + 2];
+
+			argc -= 2;
+			break;
+		}
+	}
+
+	FileLogger* logger = new FileLogger();
+	System* system = new System(logger);
+	Movie* movie = new Movie(logger);
+	HashLog* hash_log = new HashLog(logger);
+
+	system->SetRenderingEnabled(false);
+	system->LoadRom(argv[2]);
+
+	int result = 1;
+
+	if (!hash_log_path.empty() && !hash_log->Create(hash_log_path, system->GetRomHash()))
+		std::cerr << "Unable to create " << hash_log_path << "\n";
+	else if (mode == "record")
+		result = Record(system, movie, hash_log, argc, argv);
+	else if (mode == "play" || mode == "seek")
+	{
+		if (!movie->Load(argv[3]))
+			std::cerr << "Unable to load movie " << argv[3] << ", see debug.log\n";
+		else if (mode == "play")
+			result = Play(system, movie, hash_log);
+		else
+			result = Seek(system, movie, argc, argv);
+	}
+	else
+		PrintUsage();
+
+	delete hash_log;
+	delete movie;
+	delete system;
+	delete logger;
+
+	return result;
+}
@@ -0,0 +1,95 @@
+#define SDL_MAIN_HANDLED
+#include <SDL.h>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+#include "Renderer.h"
+#include "System.h"
+
+// Runs a ROM unthrottled with the window open, once presenting on the
+// emulation thread and once on the render thread, and reports emulation
+// speed, frames dropped and duplicated, and upload and present times.
+
+static void Run(const std::vector<unsigned char>& rom, unsigned int frames, bool threaded, bool vsync, bool integer_scaling, ScaleFilter filter)
+{
+	FileLogger* logger = new FileLogger();
+	System* system = new System(logger);
+	Renderer* renderer = new Renderer(system, logger, Renderer::default_scale, threaded, filter);
+
+	renderer->SetVSync(vsync);
+	renderer->SetIntegerScaling(integer_scaling);
+
+	system->LoadRom(rom.data(), rom.size());
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (unsigned int i = 0; i < frames && system->IsRunning(); ++i)
+	{
+		system->RunFrame();
+		renderer->Update();
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << std::fixed << std::setw(9) << (threaded ? "threaded" : "sync") << std::setw(10) << std::setprecision(1) << frames / seconds
+		<< std::setw(10) << renderer->GetPresentCount() << std::setw(10) << renderer->GetDroppedFrameCount() << std::setw(12) << renderer->GetDuplicatedFrameCount()
+		<< std::setw(11) << std::setprecision(3) << renderer->GetAverageUploadTime() << std::setw(11) << renderer->GetAveragePresentTime() << "\n";
+
+	delete renderer;
+	delete system;
+	delete logger;
+}
+
+int main(int argc, char** argv)
+{
+	std::string rom_path;
+	unsigned int frames = 600;
+	bool integer_scaling = true;
+	bool vsync = true;
+	ScaleFilter filter = ScaleFilter_Nearest;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--frames" && i + 1 < argc)
+			frames = std::stoul(argv[++i]);
+		else if (arg == "--aspect")
+			integer_scaling = false;
+		else if (arg == "--no-vsync")
+			vsync = false;
+		else if (arg == "--smooth")
+			filter = ScaleFilter_Smooth;
+		else
+			rom_path = arg;
+	}
+
+	if (rom_path.empty())
+	{
+		std::cout << "Usage: gbe-render-bench <rom> [--frames <count>] [--aspect] [--no-vsync] [--smooth]\n";
+		return 1;
+	}
+
+	std::ifstream input(rom_path, std::ios::in | std::ios::binary);
+	std::vector<unsigned char> rom((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+	if (rom.empty())
+	{
+		std::cerr << "Unable to open " << rom_path << "\n";
+		return 1;
+	}
+
+	std::cout << "Mode      Emu fps  Presents   Dropped  Duplicated  Upload ms Present ms\n";
+
+	Run(rom, frames, false, vsync, integer_scaling, filter);
+	Run(rom, frames, true, vsync, integer_scaling, filter);
+
+	return 0;
+}
\ No newline at end of file
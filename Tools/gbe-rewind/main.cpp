@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+#include "Hash.h"
+#include "Rewind.h"
+#include "System.h"
+#include "../gbe-golden/PpuPattern.h"
+
+// Measures the per-frame cost and memory footprint of the rewind buffer, then
+// steps all the way back and checks every restored state against the hash
+// recorded on the way forward. A second pass with rendering enabled checks
+// that every step back shows the same screen as the forward run did.
+
+static unsigned long long HashFramebuffer(System* system)
+{
+	return HashBytes(system->GetFramebuffer(), System::screen_width * System::screen_height);
+}
+
+// The bundled games never turn the LCD on, so this runs the golden suite's
+// test pattern, which changes the screen every frame. The registers for the
+// next frame are written before each Push, so replaying a frame from its
+// snapshot draws it with the same registers as the forward run.
+static size_t CheckRenderedStepBack(FileLogger* logger, unsigned int frames)
+{
+	std::vector<unsigned char> rom;
+	BuildPpuPatternRom(rom);
+
+	System* system = new System(logger);
+	Rewind* rewind = new Rewind();
+
+	system->SetRenderingEnabled(true);
+	system->LoadRom(rom.data(), rom.size());
+	SetupPpuPattern(system);
+
+	// Line 0 is drawn when LY wraps around, which the first frame after a
+	// reset never does, so the history starts after it
+	system->RunFrame();
+	UpdatePpuPattern(system, 2);
+
+	std::vector<unsigned long long> screens;
+
+	screens.push_back(HashFramebuffer(system));
+	rewind->Push(system);
+
+	for (unsigned int frame = 2; frame <= frames; ++frame)
+	{
+		system->RunFrame();
+		screens.push_back(HashFramebuffer(system));
+
+		UpdatePpuPattern(system, frame + 1);
+		rewind->Push(system);
+	}
+
+	size_t frame = screens.size() - 1;
+	size_t mismatches = 0;
+
+	// The last step lands on the first snapshot without a frame to replay
+	while (rewind->StepBack(system))
+	{
+		if (--frame > 0 && HashFramebuffer(system) != screens[frame])
+			++mismatches;
+	}
+
+	delete rewind;
+	delete system;
+
+	return mismatches;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "Usage: gbe-rewind <rom> [frames=3600] [capacity MiB=32]\n";
+		return 1;
+	}
+
+	std::string rom_path = argv[1];
+	unsigned int frames = argc > 2 ? std::stoul(argv[2]) : 3600;
+	size_t capacity = (argc > 3 ? std::stoul(argv[3]) : Rewind::default_capacity >> 20) << 20;
+
+	FileLogger* logger = new FileLogger();
+	System* system = new System(logger);
+	Rewind* rewind = new Rewind(capacity);
+
+	system->SetRenderingEnabled(false);
+	system->LoadRom(rom_path);
+
+	std::vector<unsigned long long> hashes;
+
+	hashes.push_back(system->GetStateHash());
+	rewind->Push(system);
+
+	for (unsigned int frame = 0; frame < frames && system->IsRunning(); ++frame)
+	{
+		// Press something now and then so the game actually does work
+		system->SetJoypad(static_cast<unsigned char>((frame / 60) % 4 == 1 ? 1 << Joypad_Start : 0));
+		system->RunFrame();
+
+		hashes.push_back(system->GetStateHash());
+		rewind->Push(system);
+	}
+
+	double full_snapshot_rate = static_cast<double>(System::state_size) * System::clock_rate / System::cycles_per_frame;
+
+	std::cout << std::fixed << std::setprecision(2)
+		<< "Push:         " << rewind->GetAveragePushMicroseconds() << " us/frame\n"
+		<< "History:      " << rewind->GetFrameCount() << " frames in " << rewind->GetBytesUsed() / 1024.0 << " KiB of "
+		<< rewind->GetCapacity() / 1024.0 / 1024.0 << " MiB\n"
+		<< "Per frame:    " << static_cast<double>(rewind->GetBytesUsed()) / rewind->GetFrameCount() << " bytes\n"
+		<< "Per second:   " << rewind->GetBytesPerSecond() / 1024.0 << " KiB (" << full_snapshot_rate / 1024.0 << " KiB uncompressed)\n";
+
+	size_t steps = 0;
+	size_t mismatches = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	while (rewind->StepBack(system))
+	{
+		++steps;
+
+		if (system->GetStateHash() != hashes[hashes.size() - 1 - steps])
+			++mismatches;
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "StepBack:     " << seconds * 1e6 / (steps > 0 ? steps : 1) << " us/frame (including state hash) over " << steps << " frames\n";
+
+	if (mismatches > 0)
+		std::cout << "MISMATCH: " << mismatches << " restored states differ\n";
+
+	size_t screen_mismatches = CheckRenderedStepBack(logger, std::min(frames, 600u));
+
+	if (screen_mismatches > 0)
+		std::cout << "MISMATCH: " << screen_mismatches << " rendered steps back differ from the forward run\n";
+
+	delete rewind;
+	delete system;
+	delete logger;
+
+	return mismatches > 0 || screen_mismatches > 0 ? 2 : 0;
+}
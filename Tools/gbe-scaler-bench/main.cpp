@@ -0,0 +1,155 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+#include "Scaler.h"
+#include "System.h"
+
+// Scales frames of a ROM with every filter, factor and kernel the CPU
+// supports and reports output megapixels per second. The SIMD kernels are
+// checked against the plain loops, on the ROM's frames and on noise that
+// puts an edge next to nearly every pixel.
+
+static bool Bench(const std::vector<std::vector<unsigned char>>& frames, ScaleFilter filter, unsigned int factor, double seconds_per_run)
+{
+	std::vector<std::vector<unsigned int>> outputs;
+	bool matched = true;
+
+	for (int kernel = 0; kernel < ScalerKernel_Count; ++kernel)
+	{
+		if (!Scaler::IsKernelSupported(static_cast<ScalerKernel>(kernel)))
+			continue;
+
+		Scaler* scaler = new Scaler(factor, filter);
+		scaler->SetKernel(static_cast<ScalerKernel>(kernel));
+
+		unsigned int pitch = scaler->GetWidth();
+		std::vector<unsigned int> output(pitch * scaler->GetHeight());
+		std::vector<unsigned int> check;
+
+		for (const std::vector<unsigned char>& frame : frames)
+		{
+			scaler->Scale(frame.data(), output.data(), pitch);
+			check.insert(check.end(), output.begin(), output.end());
+		}
+
+		if (outputs.empty())
+			outputs.push_back(check);
+		else if (check != outputs[0])
+			matched = false;
+
+		unsigned long long scaled = 0;
+		auto start = std::chrono::steady_clock::now();
+		double seconds = 0.0;
+
+		while (seconds < seconds_per_run)
+		{
+			for (const std::vector<unsigned char>& frame : frames)
+				scaler->Scale(frame.data(), output.data(), pitch);
+
+			scaled += frames.size();
+			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		double megapixels = static_cast<double>(scaled) * output.size() / seconds / 1e6;
+
+		std::cout << std::setw(8) << (filter == ScaleFilter_Nearest ? "nearest" : "smooth") << std::setw(4) << factor << "x"
+			<< std::setw(8) << Scaler::GetKernelName(static_cast<ScalerKernel>(kernel))
+			<< std::fixed << std::setprecision(1) << std::setw(12) << megapixels
+			<< std::setprecision(3) << std::setw(12) << seconds * 1e6 / scaled
+			<< (kernel == ScalerKernel_Scalar || check == outputs[0] ? "" : "  MISMATCH") << "\n";
+
+		delete scaler;
+	}
+
+	return matched;
+}
+
+int main(int argc, char** argv)
+{
+	std::string rom_path;
+	unsigned int frame_count = 60;
+	double seconds = 0.5;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--frames" && i + 1 < argc)
+			frame_count = std::stoul(argv[++i]);
+		else if (arg == "--seconds" && i + 1 < argc)
+			seconds = std::stod(argv[++i]);
+		else
+			rom_path = arg;
+	}
+
+	if (rom_path.empty())
+	{
+		std::cout << "Usage: gbe-scaler-bench <rom> [--frames <count>] [--seconds <per run>]\n";
+		return 1;
+	}
+
+	std::ifstream input(rom_path, std::ios::in | std::ios::binary);
+	std::vector<unsigned char> rom((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+	if (rom.empty())
+	{
+		std::cerr << "Unable to open " << rom_path << "\n";
+		return 1;
+	}
+
+	FileLogger* logger = new FileLogger();
+	System* system = new System(logger);
+
+	system->LoadRom(rom.data(), rom.size());
+
+	std::vector<std::vector<unsigned char>> frames;
+
+	for (unsigned int i = 0; i < frame_count; ++i)
+	{
+		system->RunFrame();
+
+		const unsigned char* framebuffer = system->GetFramebuffer();
+		frames.emplace_back(framebuffer, framebuffer + System::screen_width * System::screen_height);
+	}
+
+	delete system;
+	delete logger;
+
+	std::mt19937 random(1);
+	std::vector<unsigned char> noise(System::screen_width * System::screen_height);
+
+	for (unsigned char& shade : noise)
+		shade = static_cast<unsigned char>(random() & 3);
+
+	frames.push_back(noise);
+
+	std::cout << "  filter  scale  kernel    MPixel/s   us/frame\n";
+
+	bool matched = true;
+
+	for (ScaleFilter filter : { ScaleFilter_Nearest, ScaleFilter_Smooth })
+	{
+		for (unsigned int factor = 1; factor <= Scaler::max_factor; ++factor)
+		{
+			if (filter == ScaleFilter_Smooth && factor == 1)
+				continue;
+
+			matched &= Bench(frames, filter, factor, seconds);
+		}
+	}
+
+	if (!matched)
+	{
+		std::cerr << "SIMD kernels do not match the scalar output\n";
+		return 2;
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "FileLogger.h"
+#include "System.h"
+#include "TraceReader.h"
+#include "TraceWriter.h"
+
+// Writes gameboy-doctor style instruction traces and compares a trace against
+// a reference log. Both files are streamed, neither is loaded into memory.
+
+static void PrintUsage()
+{
+	std::cout << "Usage:\n"
+		<< "  gbe-trace write <rom> <instructions> <trace>\n"
+		<< "  gbe-trace compare <trace> <reference> [context lines=5]\n";
+}
+
+static int Write(int argc, char** argv)
+{
+	if (argc < 5)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	unsigned long long instructions = std::stoull(argv[3]);
+
+	FileLogger* logger = new FileLogger();
+	System* system = new System(logger);
+	TraceWriter* trace = new TraceWriter(logger);
+
+	int result = 1;
+
+	if (trace->Open(argv[4]))
+	{
+		system->SetRenderingEnabled(false);
+		system->LoadRom(argv[2]);
+		system->SetTraceWriter(trace);
+
+		auto start = std::chrono::steady_clock::now();
+
+		while (system->IsRunning() && trace->GetLineCount() < instructions)
+			system->EmulateCycle();
+
+		trace->Close();
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << trace->GetLineCount() << " lines in " << std::fixed << std::setprecision(3) << seconds << "s ("
+			<< std::setprecision(1) << trace->GetLineCount() / seconds * 60.0 / 1e6 << " M lines/minute)\n";
+
+		result = 0;
+	}
+	else
+		std::cerr << "Unable to create " << argv[4] << "\n";
+
+	delete trace;
+	delete system;
+	delete logger;
+
+	return result;
+}
+
+static std::vector<std::string_view> SplitFields(std::string_view line)
+{
+	std::vector<std::string_view> fields;
+
+	while (!line.empty())
+	{
+		size_t space = line.find(' ');
+
+		fields.push_back(line.substr(0, space));
+		line = space == std::string_view::npos ? std::string_view() : line.substr(space + 1);
+	}
+
+	return fields;
+}
+
+static int Compare(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	size_t context = argc > 4 ? std::stoul(argv[4]) : 5;
+
+	TraceReader trace;
+	TraceReader reference;
+
+	if (!trace.Open(argv[2]) || !reference.Open(argv[3]))
+	{
+		std::cerr << "Unable to open " << argv[2] << " or " << argv[3] << "\n";
+		return 1;
+	}
+
+	// Ring of the last matching lines, shown before a mismatch
+	std::vector<std::string> history(context);
+	size_t history_next = 0;
+
+	std::string_view ours;
+	std::string_view theirs;
+
+	auto start = std::chrono::steady_clock::now();
+
+	while (true)
+	{
+		bool has_ours = trace.NextLine(ours);
+		bool has_theirs = reference.NextLine(theirs);
+
+		if (!has_ours || !has_theirs)
+		{
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			if (has_ours == has_theirs)
+				std::cout << "Identical, " << trace.GetLineNumber() << " lines";
+			else
+				std::cout << "Identical for " << (has_ours ? reference : trace).GetLineNumber() << " lines, then "
+					<< (has_ours ? argv[3] : argv[2]) << " ends";
+
+			std::cout << " (" << std::fixed << std::setprecision(2) << seconds << "s)\n";
+
+			return 0;
+		}
+
+		if (ours != theirs)
+			break;
+
+		if (context > 0)
+		{
+			history[history_next].assign(ours);
+			history_next = (history_next + 1) % context;
+		}
+	}
+
+	unsigned long long line = trace.GetLineNumber();
+
+	std::cout << "First mismatch at line " << line << "\n\n";
+
+	size_t shown = line - 1 < context ? static_cast<size_t>(line - 1) : context;
+
+	for (size_t i = 0; i < shown; ++i)
+		std::cout << std::setw(12) << line - shown + i << "   " << history[(history_next + context - shown + i) % context] << "\n";
+
+	std::cout << std::setw(12) << line << " < " << ours << "\n"
+		<< std::setw(12) << line << " > " << theirs << "\n\nDiffering fields:";
+
+	std::vector<std::string_view> our_fields = SplitFields(ours);
+	std::vector<std::string_view> their_fields = SplitFields(theirs);
+
+	for (size_t i = 0; i < our_fields.size() || i < their_fields.size(); ++i)
+	{
+		std::string_view a = i < our_fields.size() ? our_fields[i] : "-";
+		std::string_view b = i < their_fields.size() ? their_fields[i] : "-";
+
+		if (a != b)
+			std::cout << " " << a << " (expected " << b << ")";
+	}
+
+	std::cout << "\n";
+
+	return 2;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::string mode = argv[1];
+
+	if (mode == "write")
+		return Write(argc, argv);
+	if (mode == "compare")
+		return Compare(argc, argv);
+
+	PrintUsage();
+
+	return 1;
+}
@@ -0,0 +1,88 @@
+#include "TraceReader.h"
+
+#include <cstring>
+
+TraceReader::TraceReader()
+{
+	buffer.resize(buffer_size);
+}
+
+bool TraceReader::Open(std::string path)
+{
+	input.open(path, std::ios::in | std::ios::binary);
+
+	begin = 0;
+	end = 0;
+	eof = false;
+	line_number = 0;
+
+	return static_cast<bool>(input);
+}
+
+bool TraceReader::Refill()
+{
+	if (eof)
+		return false;
+
+	// Keep the partial line at the front and fill up the rest
+	std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+	end -= begin;
+	begin = 0;
+
+	// A single line longer than the buffer makes it grow
+	if (end == buffer.size())
+		buffer.resize(buffer.size() * 2);
+
+	input.read(buffer.data() + end, buffer.size() - end);
+
+	size_t count = static_cast<size_t>(input.gcount());
+
+	end += count;
+	eof = count == 0;
+
+	return count > 0;
+}
+
+bool TraceReader::NextLine(std::string_view& line)
+{
+	size_t position = begin;
+
+	while (true)
+	{
+		const char* newline = static_cast<const char*>(std::memchr(buffer.data() + position, '\n', end - position));
+
+		if (newline != nullptr)
+		{
+			size_t length = newline - (buffer.data() + begin);
+
+			line = std::string_view(buffer.data() + begin, length);
+			begin += length + 1;
+			break;
+		}
+
+		position = end - begin;
+
+		if (!Refill())
+		{
+			// Last line without a trailing newline
+			if (begin == end)
+				return false;
+
+			line = std::string_view(buffer.data() + begin, end - begin);
+			begin = end;
+			break;
+		}
+	}
+
+	if (!line.empty() && line.back() == '\r')
+		line.remove_suffix(1);
+
+	++line_number;
+
+	return true;
+}
+
+unsigned long long TraceReader::GetLineNumber()
+{
+	return line_number;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Reads a text file line by line through a fixed size buffer, so logs of any
+// size can be streamed. Returned lines stay valid until the next call.
+class TraceReader
+{
+public:
+	TraceReader();
+
+	bool Open(std::string path);
+	// False at the end of the file, the line has no newline or carriage return
+	bool NextLine(std::string_view& line);
+
+	unsigned long long GetLineNumber();
+
+private:
+	static constexpr size_t buffer_size = 1 << 20;
+
+	bool Refill();
+
+	std::ifstream input;
+	std::vector<char> buffer;
+	size_t begin{};
+	size_t end{};
+	bool eof = false;
+	unsigned long long line_number{};
+};
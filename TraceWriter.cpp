@@ -0,0 +1,111 @@
+#include "TraceWriter.h"
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static char* PutHex8(char* output, unsigned char value)
+{
+	output[0] = hex_digits[value >> 4];
+	output[1] = hex_digits[value & 0x0F];
+
+	return output + 2;
+}
+
+static char* PutHex16(char* output, unsigned short value)
+{
+	output = PutHex8(output, static_cast<unsigned char>(value >> 8));
+
+	return PutHex8(output, static_cast<unsigned char>(value & 0xFF));
+}
+
+static char* PutText(char* output, const char* text)
+{
+	while (*text != '\0')
+		*output++ = *text++;
+
+	return output;
+}
+
+TraceWriter::TraceWriter(FileLogger* logger)
+{
+	this->logger = logger;
+}
+
+TraceWriter::~TraceWriter()
+{
+	Close();
+}
+
+bool TraceWriter::Open(std::string path)
+{
+	Close();
+
+	output.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if (!output)
+	{
+		logger->Log<LOG_ERROR>("Unable to create trace: " + path);
+		return false;
+	}
+
+	buffer.resize(buffer_size);
+	used = 0;
+	line_count = 0;
+
+	return true;
+}
+
+void TraceWriter::Close()
+{
+	if (!output.is_open())
+		return;
+
+	Flush();
+	output.close();
+}
+
+void TraceWriter::OnInstruction(System* system)
+{
+	if (used + line_length + 1 > buffer.size())
+		Flush();
+
+	unsigned short pc = system->GetPC();
+	unsigned char pcmem[4];
+
+	system->ReadMemoryBlock(pc, 4, pcmem);
+
+	FormatLine(system->GetRegisters(), system->GetSP(), pc, pcmem, &buffer[used]);
+
+	used += line_length;
+	buffer[used++] = '\n';
+
+	++line_count;
+}
+
+void TraceWriter::FormatLine(const Registers& registers, unsigned short sp, unsigned short pc, const unsigned char pcmem[4], char* output)
+{
+	output = PutHex8(PutText(output, "A:"), registers.a);
+	output = PutHex8(PutText(output, " F:"), registers.f);
+	output = PutHex8(PutText(output, " B:"), registers.b);
+	output = PutHex8(PutText(output, " C:"), registers.c);
+	output = PutHex8(PutText(output, " D:"), registers.d);
+	output = PutHex8(PutText(output, " E:"), registers.e);
+	output = PutHex8(PutText(output, " H:"), registers.h);
+	output = PutHex8(PutText(output, " L:"), registers.l);
+	output = PutHex16(PutText(output, " SP:"), sp);
+	output = PutHex16(PutText(output, " PC:"), pc);
+	output = PutHex8(PutText(output, " PCMEM:"), pcmem[0]);
+
+	for (unsigned int i = 1; i < 4; ++i)
+		output = PutHex8(PutText(output, ","), pcmem[i]);
+}
+
+void TraceWriter::Flush()
+{
+	output.write(buffer.data(), used);
+	used = 0;
+}
+
+unsigned long long TraceWriter::GetLineCount()
+{
+	return line_count;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "FileLogger.h"
+#include "System.h"
+
+// Writes one line per executed instruction in the format used by
+// gameboy-doctor and most reference emulator logs:
+//
+//   A:01 F:B0 B:00 C:13 D:00 E:D8 H:01 L:4D SP:FFFE PC:0100 PCMEM:00,C3,13,02
+//
+// The state is captured before the instruction runs. Lines are formatted by
+// hand into a large buffer that is written out in blocks.
+class TraceWriter
+{
+public:
+	static constexpr size_t line_length = 73;
+
+	TraceWriter(FileLogger* logger);
+	~TraceWriter();
+
+	bool Open(std::string path);
+	void Close();
+
+	// Called by System before each instruction while attached with SetTraceWriter
+	void OnInstruction(System* system);
+
+	unsigned long long GetLineCount();
+
+	// Formats a line without the newline into output, which must hold line_length bytes
+	static void FormatLine(const Registers& registers, unsigned short sp, unsigned short pc, const unsigned char pcmem[4], char* output);
+
+private:
+	static constexpr size_t buffer_size = 1 << 20;
+
+	void Flush();
+
+	std::ofstream output;
+	std::vector<char> buffer;
+	size_t used{};
+	unsigned long long line_count{};
+
+	FileLogger* logger;
+};
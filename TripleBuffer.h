@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+
+// Hands the newest value from one producer thread to one consumer thread
+// without either of them waiting. The producer fills the back slot and
+// publishes it by swapping it with the middle slot; the consumer takes the
+// middle slot in exchange for its front slot when something new was
+// published. Values published in between are overwritten, never queued.
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer()
+	{
+		slots = new T[3]{};
+	}
+	~TripleBuffer()
+	{
+		delete[] slots;
+	}
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// Producer only, the slot to fill before Publish
+	T& GetBack()
+	{
+		return slots[back];
+	}
+	void Publish()
+	{
+		back = middle.exchange(back | fresh_bit, std::memory_order_acq_rel) & index_mask;
+	}
+
+	// Consumer only. The newest published value, fresh tells whether it was
+	// published since the previous call.
+	T& Acquire(bool& fresh)
+	{
+		fresh = (middle.load(std::memory_order_relaxed) & fresh_bit) != 0;
+
+		if (fresh)
+			front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+
+		return slots[front];
+	}
+
+private:
+	static constexpr unsigned int index_mask = 3;
+	static constexpr unsigned int fresh_bit = 4;
+
+	T* slots{};
+	unsigned int back = 0;
+	// Index of the middle slot, with fresh_bit set while it holds a value the consumer has not taken
+	std::atomic<unsigned int> middle = 1;
+	unsigned int front = 2;
+};
\ No newline at end of file
@@ -0,0 +1,341 @@
+#include "VideoCapture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GBE_CAPTURE_SSE2
+#include <emmintrin.h>
+#endif
+
+// Full range BT.601 in 8-bit fixed point. Chroma is taken from the sum of
+// each 2x2 block, hence the extra two bits of shift.
+static constexpr int y_r = 77, y_g = 150, y_b = 29;
+static constexpr int u_r = -43, u_g = -85, u_b = 128;
+static constexpr int v_r = 128, v_g = -107, v_b = -21;
+static constexpr int chroma_round = 512;
+
+static inline unsigned char ChromaValue(int sum)
+{
+	return static_cast<unsigned char>(std::clamp(((sum + chroma_round) >> 10) + 128, 0, 255));
+}
+
+static void ConvertRowsScalar(const unsigned int* row0, const unsigned int* row1, unsigned int width, unsigned char* y0, unsigned char* y1, unsigned char* u, unsigned char* v)
+{
+	for (unsigned int x = 0; x < width; x += 2)
+	{
+		int r_sum = 0;
+		int g_sum = 0;
+		int b_sum = 0;
+
+		for (unsigned int i = 0; i < 4; ++i)
+		{
+			unsigned int color = (i < 2 ? row0 : row1)[x + (i & 1)];
+			int r = (color >> 16) & 0xFF;
+			int g = (color >> 8) & 0xFF;
+			int b = color & 0xFF;
+
+			(i < 2 ? y0 : y1)[x + (i & 1)] = static_cast<unsigned char>((y_r * r + y_g * g + y_b * b + 128) >> 8);
+
+			r_sum += r;
+			g_sum += g;
+			b_sum += b;
+		}
+
+		u[x / 2] = ChromaValue(u_r * r_sum + u_g * g_sum + u_b * b_sum);
+		v[x / 2] = ChromaValue(v_r * r_sum + v_g * g_sum + v_b * b_sum);
+	}
+}
+
+#ifdef GBE_CAPTURE_SSE2
+// Splits eight 0xAARRGGBB colors into 16-bit red, green and blue lanes
+static inline void SplitChannelsSSE2(const unsigned int* pixels, __m128i& r, __m128i& g, __m128i& b)
+{
+	__m128i mask = _mm_set1_epi32(0xFF);
+	__m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+	__m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 4));
+
+	r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(first, 16), mask), _mm_and_si128(_mm_srli_epi32(second, 16), mask));
+	g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(first, 8), mask), _mm_and_si128(_mm_srli_epi32(second, 8), mask));
+	b = _mm_packs_epi32(_mm_and_si128(first, mask), _mm_and_si128(second, mask));
+}
+
+// Luma fits 16 bits unsigned, the weights add up to 256
+static inline __m128i LumaSSE2(__m128i r, __m128i g, __m128i b)
+{
+	__m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(y_r)), _mm_mullo_epi16(g, _mm_set1_epi16(y_g))),
+		_mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(y_b)), _mm_set1_epi16(128)));
+
+	return _mm_srli_epi16(sum, 8);
+}
+
+// Four chroma values from the 2x2 sums in the low four 16-bit lanes. The
+// products need 32 bits, madd pairs red with green and blue with the rounding.
+static inline __m128i ChromaSSE2(__m128i r, __m128i g, __m128i b, short cr, short cg, short cb)
+{
+	__m128i red_green = _mm_madd_epi16(_mm_unpacklo_epi16(r, g), _mm_setr_epi16(cr, cg, cr, cg, cr, cg, cr, cg));
+	__m128i blue_round = _mm_madd_epi16(_mm_unpacklo_epi16(b, _mm_set1_epi16(1)), _mm_setr_epi16(cb, chroma_round, cb, chroma_round, cb, chroma_round, cb, chroma_round));
+	__m128i value = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(red_green, blue_round), 10), _mm_set1_epi32(128));
+
+	value = _mm_packs_epi32(value, value);
+
+	return _mm_packus_epi16(value, value);
+}
+
+static void ConvertRowsSSE2(const unsigned int* row0, const unsigned int* row1, unsigned int width, unsigned char* y0, unsigned char* y1, unsigned char* u, unsigned char* v)
+{
+	__m128i ones = _mm_set1_epi16(1);
+
+	for (unsigned int x = 0; x < width; x += 8)
+	{
+		__m128i r0, g0, b0;
+		__m128i r1, g1, b1;
+
+		SplitChannelsSSE2(row0 + x, r0, g0, b0);
+		SplitChannelsSSE2(row1 + x, r1, g1, b1);
+
+		__m128i luma0 = LumaSSE2(r0, g0, b0);
+		__m128i luma1 = LumaSSE2(r1, g1, b1);
+
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(y0 + x), _mm_packus_epi16(luma0, luma0));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(y1 + x), _mm_packus_epi16(luma1, luma1));
+
+		// Add the rows, then neighbouring columns
+		__m128i r_sum = _mm_madd_epi16(_mm_add_epi16(r0, r1), ones);
+		__m128i g_sum = _mm_madd_epi16(_mm_add_epi16(g0, g1), ones);
+		__m128i b_sum = _mm_madd_epi16(_mm_add_epi16(b0, b1), ones);
+
+		r_sum = _mm_packs_epi32(r_sum, r_sum);
+		g_sum = _mm_packs_epi32(g_sum, g_sum);
+		b_sum = _mm_packs_epi32(b_sum, b_sum);
+
+		int u_values = _mm_cvtsi128_si32(ChromaSSE2(r_sum, g_sum, b_sum, u_r, u_g, u_b));
+		int v_values = _mm_cvtsi128_si32(ChromaSSE2(r_sum, g_sum, b_sum, v_r, v_g, v_b));
+
+		std::memcpy(u + x / 2, &u_values, 4);
+		std::memcpy(v + x / 2, &v_values, 4);
+	}
+}
+#endif
+
+VideoCapture::VideoCapture(FileLogger* logger)
+{
+	this->logger = logger;
+}
+
+VideoCapture::~VideoCapture()
+{
+	Close();
+}
+
+bool VideoCapture::Open(std::string path, CaptureFormat format, unsigned int factor, ScaleFilter filter)
+{
+	Close();
+
+	if (path == "-")
+	{
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		output = &std::cout;
+	}
+	else
+	{
+		file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+		if (!file)
+		{
+			logger->Log<LOG_ERROR>("Unable to create capture: " + path);
+			return false;
+		}
+
+		output = &file;
+	}
+
+	this->format = format;
+	scaler = new Scaler(factor, filter);
+
+	if (format == CaptureFormat_Y4M)
+	{
+		std::string header = GetY4MHeader(scaler->GetWidth(), scaler->GetHeight());
+		output->write(header.data(), header.size());
+	}
+
+	frame_count = 0;
+	stall_count = 0;
+	written_count = 0;
+	encode_nanoseconds = 0;
+
+	stopping = false;
+	writer = std::thread(&VideoCapture::WriterLoop, this);
+
+	return true;
+}
+
+void VideoCapture::Close()
+{
+	if (output == nullptr)
+		return;
+
+	stopping.store(true, std::memory_order_release);
+	writer.join();
+
+	output->flush();
+
+	if (file.is_open())
+		file.close();
+
+	output = nullptr;
+
+	delete scaler;
+	scaler = nullptr;
+}
+
+bool VideoCapture::IsOpen()
+{
+	return output != nullptr;
+}
+
+void VideoCapture::PushFrame(const unsigned char* shades)
+{
+	if (output == nullptr)
+		return;
+
+	auto fill = [&](Frame& frame)
+	{
+		std::memcpy(frame.shades, shades, sizeof(frame.shades));
+	};
+
+	if (!frames.Push(fill))
+	{
+		++stall_count;
+
+		while (!frames.Push(fill))
+			std::this_thread::yield();
+	}
+
+	++frame_count;
+}
+
+void VideoCapture::WriterLoop()
+{
+	unsigned int width = scaler->GetWidth();
+	unsigned int height = scaler->GetHeight();
+
+	std::vector<unsigned int> pixels(width * height);
+	std::vector<unsigned char> encoded;
+	bool failed = false;
+
+	// Y4M frames start with their own header line
+	static constexpr char frame_header[] = "FRAME\n";
+	size_t header_size = format == CaptureFormat_Y4M ? sizeof(frame_header) - 1 : 0;
+
+	encoded.resize(header_size + (format == CaptureFormat_Y4M ? width * height * 3 / 2 : width * height * 3));
+	std::memcpy(encoded.data(), frame_header, header_size);
+
+	unsigned char* planes = encoded.data() + header_size;
+
+	while (true)
+	{
+		bool stop = stopping.load(std::memory_order_acquire);
+
+		bool popped = frames.Pop([&](Frame& frame)
+		{
+			auto start = std::chrono::steady_clock::now();
+
+			scaler->Scale(frame.shades, pixels.data(), width);
+
+			if (format == CaptureFormat_Y4M)
+				ConvertToYUV420(pixels.data(), width, height, width, planes, planes + width * height, planes + width * height * 5 / 4);
+			else
+				ConvertToRGB24(pixels.data(), width, height, width, planes);
+
+			encode_nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+		});
+
+		if (popped)
+		{
+			// After a failed write the frames are only drained, the producer must not block
+			if (!failed)
+			{
+				output->write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+
+				if (!*output)
+				{
+					logger->Log<LOG_ERROR>("Unable to write capture frame ", written_count.load(), ", recording stopped");
+					failed = true;
+				}
+			}
+
+			written_count.fetch_add(1, std::memory_order_release);
+		}
+		else if (stop)
+			break;
+		else
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+std::string VideoCapture::GetY4MHeader(unsigned int width, unsigned int height)
+{
+	return "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height)
+		+ " F" + std::to_string(System::clock_rate) + ":" + std::to_string(System::cycles_per_frame)
+		+ " Ip A1:1 C420jpeg XCOLORRANGE=FULL\n";
+}
+
+void VideoCapture::ConvertToYUV420(const unsigned int* pixels, unsigned int width, unsigned int height, unsigned int pitch, unsigned char* y, unsigned char* u, unsigned char* v, bool vectorized)
+{
+	auto convert = ConvertRowsScalar;
+
+#ifdef GBE_CAPTURE_SSE2
+	if (vectorized)
+		convert = ConvertRowsSSE2;
+#endif
+
+	for (unsigned int row = 0; row < height; row += 2)
+		convert(pixels + row * pitch, pixels + (row + 1) * pitch, width, y + row * width, y + (row + 1) * width, u + row / 2 * (width / 2), v + row / 2 * (width / 2));
+}
+
+void VideoCapture::ConvertToRGB24(const unsigned int* pixels, unsigned int width, unsigned int height, unsigned int pitch, unsigned char* rgb)
+{
+	for (unsigned int row = 0; row < height; ++row)
+	{
+		const unsigned int* colors = pixels + row * pitch;
+
+		for (unsigned int x = 0; x < width; ++x)
+		{
+			*rgb++ = static_cast<unsigned char>(colors[x] >> 16);
+			*rgb++ = static_cast<unsigned char>(colors[x] >> 8);
+			*rgb++ = static_cast<unsigned char>(colors[x]);
+		}
+	}
+}
+
+unsigned long long VideoCapture::GetFrameCount()
+{
+	return frame_count;
+}
+
+unsigned long long VideoCapture::GetWrittenFrameCount()
+{
+	return written_count;
+}
+
+unsigned long long VideoCapture::GetStallCount()
+{
+	return stall_count;
+}
+
+double VideoCapture::GetAverageEncodeTime()
+{
+	unsigned long long count = written_count;
+
+	return count == 0 ? 0.0 : encode_nanoseconds / 1e6 / count;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "FileLogger.h"
+#include "Scaler.h"
+#include "System.h"
+
+enum CaptureFormat
+{
+	// 4:2:0 full range YUV with a YUV4MPEG2 header, readable by ffmpeg and most players
+	CaptureFormat_Y4M,
+	// Headerless 24-bit RGB frames, e.g. for
+	// ffmpeg -f rawvideo -pix_fmt rgb24 -s 160x144 -r 59.7275 -i -
+	CaptureFormat_RGB
+};
+
+// Records the screen as video. PushFrame only copies the frame's shades into
+// a bounded lock-free queue; a background thread scales, converts and writes
+// them, so the emulation thread never touches the encoder or the disk. It
+// only waits when the writer falls a whole queue behind, a recording keeps
+// every frame.
+class VideoCapture
+{
+public:
+	static constexpr unsigned int queue_size = 32;
+
+	VideoCapture(FileLogger* logger);
+	~VideoCapture();
+
+	// A path of "-" writes to standard output, for piping into an encoder
+	bool Open(std::string path, CaptureFormat format, unsigned int factor = 1, ScaleFilter filter = ScaleFilter_Nearest);
+	// Writes out every queued frame first
+	void Close();
+	bool IsOpen();
+
+	// Takes a screen_width * screen_height framebuffer of shades
+	void PushFrame(const unsigned char* shades);
+
+	unsigned long long GetFrameCount();
+	unsigned long long GetWrittenFrameCount();
+	// Pushes that had to wait for the writer
+	unsigned long long GetStallCount();
+	// Milliseconds the writer spends scaling and converting a frame
+	double GetAverageEncodeTime();
+
+	static std::string GetY4MHeader(unsigned int width, unsigned int height);
+	// Width and height must be even, width a multiple of 8 for the SSE2 path.
+	// Pitch is in pixels. U and V are width / 2 by height / 2.
+	static void ConvertToYUV420(const unsigned int* pixels, unsigned int width, unsigned int height, unsigned int pitch, unsigned char* y, unsigned char* u, unsigned char* v, bool vectorized = true);
+	static void ConvertToRGB24(const unsigned int* pixels, unsigned int width, unsigned int height, unsigned int pitch, unsigned char* rgb);
+
+private:
+	struct Frame
+	{
+		unsigned char shades[System::screen_width * System::screen_height];
+	};
+
+	void WriterLoop();
+
+	std::ofstream file;
+	std::ostream* output{};
+
+	CaptureFormat format = CaptureFormat_Y4M;
+	Scaler* scaler{};
+
+	BoundedQueue<Frame, queue_size> frames;
+	std::thread writer;
+	std::atomic<bool> stopping = false;
+
+	unsigned long long frame_count{};
+	unsigned long long stall_count{};
+	std::atomic<unsigned long long> written_count{};
+	std::atomic<long long> encode_nanoseconds{};
+
+	FileLogger* logger;
+};
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "gbe_env.h"
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "EnvBatch.h"
+#include "FileLogger.h"
+
+struct gbe_env
+{
+	FileLogger* logger;
+	EnvBatch* batch;
+};
+
+gbe_env* gbe_env_create(const char* rom_path, unsigned int batch_size, unsigned int thread_count)
+{
+	if (rom_path == nullptr || batch_size == 0)
+		return nullptr;
+
+	std::ifstream input(rom_path, std::ios::in | std::ios::binary);
+
+	if (!input)
+		return nullptr;
+
+	std::vector<unsigned char> rom(std::istreambuf_iterator<char>(input), {});
+
+	gbe_env* env = new gbe_env();
+
+	env->logger = new FileLogger();
+	env->batch = new EnvBatch(env->logger, rom.data(), rom.size(), batch_size, thread_count);
+
+	return env;
+}
+
+void gbe_env_destroy(gbe_env* env)
+{
+	if (env == nullptr)
+		return;
+
+	delete env->batch;
+	delete env->logger;
+	delete env;
+}
+
+unsigned int gbe_env_batch_size(gbe_env* env)
+{
+	return env->batch->GetBatchSize();
+}
+
+void gbe_env_reset(gbe_env* env)
+{
+	env->batch->Reset();
+}
+
+void gbe_env_reset_one(gbe_env* env, unsigned int index)
+{
+	if (index < env->batch->GetBatchSize())
+		env->batch->Reset(index);
+}
+
+void gbe_env_step(gbe_env* env, unsigned int n_frames, const unsigned char* buttons, unsigned char* observations)
+{
+	env->batch->Step(n_frames, buttons, observations);
+}
+
+void gbe_env_get_framebuffer(gbe_env* env, unsigned char* output)
+{
+	env->batch->GetFramebuffers(output);
+}
+
+void gbe_env_get_ram(gbe_env* env, unsigned short address, unsigned int length, unsigned char* output)
+{
+	env->batch->GetRam(address, length, output);
+}
+
+void gbe_env_get_state_hash(gbe_env* env, unsigned long long* output)
+{
+	env->batch->GetStateHashes(output);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+ * Stable C interface for driving batches of emulator instances from training
+ * frameworks. All buffers are provided by the caller; stepping does not
+ * allocate.
+ *
+ * Buttons are one byte per instance with bit 0..7 = Right, Left, Up, Down,
+ * A, B, Select, Start. Observations are GBE_SCREEN_WIDTH * GBE_SCREEN_HEIGHT
+ * bytes per instance, one shade (0 = white .. 3 = black) per pixel.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32) && defined(GBE_ENV_EXPORTS)
+#define GBE_API __declspec(dllexport)
+#else
+#define GBE_API
+#endif
+
+#define GBE_SCREEN_WIDTH 160
+#define GBE_SCREEN_HEIGHT 144
+
+typedef struct gbe_env gbe_env;
+
+/* Returns NULL if the rom cannot be read. A thread_count of 0 uses every core. */
+GBE_API gbe_env* gbe_env_create(const char* rom_path, unsigned int batch_size, unsigned int thread_count);
+GBE_API void gbe_env_destroy(gbe_env* env);
+
+GBE_API unsigned int gbe_env_batch_size(gbe_env* env);
+
+/* Restarts every instance, or only the one at index */
+GBE_API void gbe_env_reset(gbe_env* env);
+GBE_API void gbe_env_reset_one(gbe_env* env, unsigned int index);
+
+/*
+ * Runs n_frames frames on every instance holding buttons[i] (NULL for none).
+ * If observations is not NULL the last frame of instance i is rendered into
+ * observations + i * GBE_SCREEN_WIDTH * GBE_SCREEN_HEIGHT; the buffer must
+ * stay valid until the next step or reset when gbe_env_get_framebuffer is used.
+ */
+GBE_API void gbe_env_step(gbe_env* env, unsigned int n_frames, const unsigned char* buttons, unsigned char* observations);
+
+/* Copies the latest frame of every instance, batch_size * width * height bytes */
+GBE_API void gbe_env_get_framebuffer(gbe_env* env, unsigned char* output);
+
+/* Copies length bytes starting at address from every instance, batch_size * length bytes */
+GBE_API void gbe_env_get_ram(gbe_env* env, unsigned short address, unsigned int length, unsigned char* output);
+
+/* Hash of the CPU and memory of every instance, batch_size values. Equal
+ * states hash equally, so a reset instance hashes like a newly created one. */
+GBE_API void gbe_env_get_state_hash(gbe_env* env, unsigned long long* output);
+
+#ifdef __cplusplus
+}
+#endif
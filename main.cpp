@@ -1,41 +1,274 @@
 #define SDL_MAIN_HANDLED
 #include <SDL.h>
 
+#include <chrono>
+#include <csignal>
+#include <thread>
+
 #include "Debug.h"
+#include "FrameDumper.h"
 #include "Input.h"
 #include "FileLogger.h"
+#include "FlightRecorder.h"
+#include "GdbServer.h"
+#include "Movie.h"
+#include "Rewind.h"
 #include "System.h"
 #include "Renderer.h"
+#include "TraceWriter.h"
+#include "VideoCapture.h"
+
+static FlightRecorder* crash_recorder{};
+
+// Writes the last instructions before a crash, then lets the signal take its usual course
+static void OnFatalSignal(int signal)
+{
+	if (crash_recorder != nullptr)
+		crash_recorder->DumpOnSignal();
+
+	std::signal(signal, SIG_DFL);
+	std::raise(signal);
+}
 
 int main(int argc, char** argv)
 {
-	FileLogger* logger = new FileLogger();
+	std::string rom_path = "./Games/tetris.gb";
+	std::string record_path;
+	std::string play_path;
+	std::string trace_path;
+	std::string log_records_path;
+	std::vector<unsigned short> breakpoints;
+	unsigned short gdb_port = 0;
+	std::string symbol_path;
+	unsigned int scale = Renderer::default_scale;
+	bool integer_scaling = true;
+	bool threaded_rendering = true;
+	ScaleFilter filter = ScaleFilter_Nearest;
+	std::string capture_path;
+	unsigned int capture_scale = 1;
+	std::string dump_prefix;
+	unsigned int dump_interval = 1;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--record" && i + 1 < argc)
+			record_path = argv[++i];
+		else if (arg == "--play" && i + 1 < argc)
+			play_path = argv[++i];
+		else if (arg == "--trace" && i + 1 < argc)
+			trace_path = argv[++i];
+		else if (arg == "--log-records" && i + 1 < argc)
+			log_records_path = argv[++i];
+		else if (arg == "--gdb" && i + 1 < argc)
+			gdb_port = static_cast<unsigned short>(std::stoul(argv[++i]));
+		else if (arg == "--scale" && i + 1 < argc)
+			scale = std::stoul(argv[++i]);
+		else if (arg == "--aspect")
+			integer_scaling = false;
+		else if (arg == "--sync-render")
+			threaded_rendering = false;
+		else if (arg == "--smooth")
+			filter = ScaleFilter_Smooth;
+		else if (arg == "--capture" && i + 1 < argc)
+			capture_path = argv[++i];
+		else if (arg == "--capture-scale" && i + 1 < argc)
+			capture_scale = std::stoul(argv[++i]);
+		else if (arg == "--dump" && i + 1 < argc)
+			dump_prefix = argv[++i];
+		else if (arg == "--dump-every" && i + 1 < argc)
+			dump_interval = std::stoul(argv[++i]);
+		else if (arg == "--sym" && i + 1 < argc)
+			symbol_path = argv[++i];
+		else if (arg == "--break" && i + 1 < argc)
+			breakpoints.push_back(static_cast<unsigned short>(std::stoul(argv[++i], nullptr, 16)));
+		else
+			rom_path = arg;
+	}
+
+	FileLogger* logger = new FileLogger(log_records_path);
 	System* system = new System(logger);
 
 	Debug* debug = new Debug(system);
+
+	if (!symbol_path.empty() && !debug->LoadSymbols(symbol_path))
+		logger->Log<LOG_ERROR>("Unable to load symbols: " + symbol_path);
+
+	for (unsigned short address : breakpoints)
+		system->AddBreakpoint(address);
+
+	// Only created when asked for, a normal run never touches a socket
+	GdbServer* gdb = nullptr;
+
+	if (gdb_port != 0)
+	{
+		gdb = new GdbServer(system, logger);
+
+		if (!gdb->Listen(gdb_port))
+		{
+			delete gdb;
+			gdb = nullptr;
+		}
+	}
+
 	Input* input = new Input(system, logger);
-	Renderer* renderer = new Renderer(system, logger);
+	Renderer* renderer = new Renderer(system, logger, scale, threaded_rendering, filter);
+	renderer->SetIntegerScaling(integer_scaling);
+
+#ifdef GBE_PROFILER
+	Profiler* profiler = new Profiler();
+	system->SetProfiler(profiler);
+#endif
+
+	logger->Log<LOG_INFO>("Test", "Test");
+
+	system->LoadRom(rom_path);
+
+	Movie* movie = new Movie(logger);
+	Rewind* rewind = new Rewind();
+	TraceWriter* trace = new TraceWriter(logger);
+	FlightRecorder* flight_recorder = new FlightRecorder();
+
+	flight_recorder->SetErrorDumpPath("./flight.bin");
+	system->SetFlightRecorder(flight_recorder);
+
+	// The handler can only write to a file that is already open
+	flight_recorder->OpenSignalDump("./flight.bin");
+	crash_recorder = flight_recorder;
+
+	for (int signal : { SIGSEGV, SIGABRT, SIGFPE, SIGILL })
+		std::signal(signal, OnFatalSignal);
+
+	bool flight_dump_held = false;
 
-	logger->Log(LOG_INFO, "Test", "Test");
+	if (!trace_path.empty() && trace->Open(trace_path))
+		system->SetTraceWriter(trace);
 
-	system->LoadRom("./Games/tetris.gb");
+	// Raw RGB unless the path asks for Y4M
+	VideoCapture* capture = new VideoCapture(logger);
+	bool capture_y4m = capture_path.size() >= 4 && capture_path.compare(capture_path.size() - 4, 4, ".y4m") == 0;
+
+	if (!capture_path.empty())
+		capture->Open(capture_path, capture_y4m ? CaptureFormat_Y4M : CaptureFormat_RGB, capture_scale, filter);
+
+	unsigned long long captured_frame = system->GetFrameCount();
+
+	// Frames go to <prefix><frame>.png, numbered by the emulated frame count
+	FrameDumper* dumper = dump_prefix.empty() ? nullptr : new FrameDumper(logger, dump_interval);
+	unsigned long long dumped_frame = system->GetFrameCount();
+
+	if (!record_path.empty())
+		movie->StartRecording(system);
+	else if (!play_path.empty() && !(movie->Load(play_path) && movie->StartPlayback(system)))
+		play_path.clear();
+
+	// A threaded renderer no longer holds the loop to vsync, frames are paced
+	// to the Game Boy's rate here instead
+	auto frame_duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(static_cast<double>(System::cycles_per_frame) / System::clock_rate));
+	auto next_frame = std::chrono::steady_clock::now();
 
 	while (system->IsRunning())
 	{
-		// debug->Step();
+		// The console debugger stays out of the way of a GDB client
+		if (gdb != nullptr)
+			gdb->Poll();
+
+		if (gdb == nullptr || !gdb->IsAttached())
+			debug->Step();
+
+		// Input is sampled once per frame, a playing movie replaces the keyboard
+		if (!play_path.empty())
+		{
+			if (!movie->PlayFrame(system))
+				break;
+		}
+		else
+		{
+			input->UpdateKeymap();
 
-		input->UpdateKeymap();
+			// Dump once per press
+			bool flight_dump_pressed = input->IsFlightDumpRequested();
 
-		system->EmulateCycle();
+			if (flight_dump_pressed && !flight_dump_held)
+				flight_recorder->Dump("./flight.bin");
+
+			flight_dump_held = flight_dump_pressed;
+
+			if (input->IsRewinding() && record_path.empty())
+				rewind->StepBack(system);
+			else if (system->GetStopReason() == Stop_None)
+			{
+				// A stopped CPU would only push the same state again, or record
+				// a frame that never ran
+				if (!record_path.empty())
+					movie->RecordFrame(system);
+				else
+				{
+					system->RunFrame();
+					rewind->Push(system);
+				}
+			}
+		}
 
 		renderer->Update();
+
+		if (capture->IsOpen() && system->GetFrameCount() != captured_frame)
+		{
+			captured_frame = system->GetFrameCount();
+			capture->PushFrame(system->GetFramebuffer());
+		}
+
+		if (dumper != nullptr && system->GetFrameCount() != dumped_frame)
+		{
+			dumped_frame = system->GetFrameCount();
+			dumper->PushFrame(system->GetFramebuffer(), dumped_frame, dump_prefix);
+		}
+
+		if (renderer->IsThreaded())
+		{
+			next_frame += frame_duration;
+
+			// After a long stall start over instead of racing to catch up
+			if (std::chrono::steady_clock::now() > next_frame + 4 * frame_duration)
+				next_frame = std::chrono::steady_clock::now();
+			else
+				std::this_thread::sleep_until(next_frame);
+		}
 	}
 
-	delete logger;
-	delete system;
-	delete debug;
+	if (!record_path.empty())
+	{
+		movie->StopRecording(system);
+		movie->Save(record_path);
+	}
+	else if (!play_path.empty() && movie->GetPosition() == movie->GetFrameCount() && system->GetStateHash() != movie->GetFinalHash())
+		logger->Log<LOG_ERROR>("Movie playback desynced.");
+
+#ifdef GBE_PROFILER
+	profiler->WriteCollapsedStacks("./profile.folded");
+	profiler->WriteReport("./profile.txt");
+
+	delete profiler;
+#endif
+
+	crash_recorder = nullptr;
+
+	delete capture;
+	delete dumper;
+	delete gdb;
+	delete flight_recorder;
+	delete trace;
+	delete rewind;
+	delete movie;
+
+	// The render and console threads use the System and the logger until
+	// their owners join them, both go last
 	delete input;
 	delete renderer;
+	delete debug;
+	delete system;
+	delete logger;
 
 	return 0;
 }
\ No newline at end of file